@@ -49,7 +49,8 @@ void define_enums(py::module &m) {
         .value("GPUShared", MemoryType::GPUShared)
         .value("GPUTexture", MemoryType::GPUTexture)
         .value("LockedCache", MemoryType::LockedCache)
-        .value("VTCM", MemoryType::VTCM);
+        .value("VTCM", MemoryType::VTCM)
+        .value("HugePage", MemoryType::HugePage);
 
     py::enum_<NameMangling>(m, "NameMangling")
         .value("Default", NameMangling::Default)
@@ -71,6 +72,10 @@ void define_enums(py::module &m) {
         .value("ShiftInwards", TailStrategy::ShiftInwards)
         .value("Auto", TailStrategy::Auto);
 
+    py::enum_<TaskPartition>(m, "TaskPartition")
+        .value("Auto", TaskPartition::Auto)
+        .value("Guided", TaskPartition::Guided);
+
     py::enum_<Target::OS>(m, "TargetOS")
         .value("OSUnknown", Target::OS::OSUnknown)
         .value("Linux", Target::OS::Linux)
@@ -189,6 +194,10 @@ void define_enums(py::module &m) {
         .value("VulkanV12", Target::VulkanV12)
         .value("VulkanV13", Target::VulkanV13)
         .value("Semihosting", Target::Feature::Semihosting)
+        .value("PooledMalloc", Target::Feature::PooledMalloc)
+        .value("ScratchArena", Target::Feature::ScratchArena)
+        .value("ProfileInstrumented", Target::Feature::ProfileInstrumented)
+        .value("ProfileLoops", Target::Feature::ProfileLoops)
         .value("FeatureEnd", Target::Feature::FeatureEnd);
 
     py::enum_<halide_type_code_t>(m, "TypeCode")
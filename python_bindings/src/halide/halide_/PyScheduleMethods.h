@@ -51,6 +51,7 @@ HALIDE_NEVER_INLINE void add_schedule_methods(PythonClass &class_instance) {
 
         .def("parallel", (T & (T::*)(const VarOrRVar &)) & T::parallel, py::arg("var"))
         .def("parallel", (T & (T::*)(const VarOrRVar &, const Expr &, TailStrategy)) & T::parallel, py::arg("var"), py::arg("task_size"), py::arg("tail") = TailStrategy::Auto)
+        .def("parallel", (T & (T::*)(const VarOrRVar &, TaskPartition)) & T::parallel, py::arg("var"), py::arg("partition"))
 
         .def("vectorize", (T & (T::*)(const VarOrRVar &)) & T::vectorize, py::arg("var"))
         .def("vectorize", (T & (T::*)(const VarOrRVar &, const Expr &, TailStrategy)) & T::vectorize, py::arg("var"), py::arg("factor"), py::arg("tail") = TailStrategy::Auto)
@@ -1318,7 +1318,7 @@ public:
             }
         }
 
-        return For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+        return For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body, op->partition);
     }
 
     Scope<> let_vars_in_scope;
@@ -2356,11 +2356,12 @@ void CodeGen_C::visit(const Allocate *op) {
             // Shouldn't ever currently be possible to have !on_stack && size_id.empty(),
             // but reality-check in case things change in the future.
             internal_assert(!size_id.empty());
+            const char *malloc_name = op->memory_type == MemoryType::HugePage ? "halide_huge_page_malloc" : "halide_malloc";
             stream << "*"
                    << op_name
                    << " = ("
                    << op_type
-                   << " *)halide_malloc(_ucon, sizeof("
+                   << " *)" << malloc_name << "(_ucon, sizeof("
                    << op_type
                    << ")*" << size_id << ");\n";
             heap_allocations.push(op->name);
@@ -2388,7 +2389,10 @@ void CodeGen_C::visit(const Allocate *op) {
         }
         create_assertion("(" + check.str() + ")", Call::make(Int(32), "halide_error_out_of_memory", {}, Call::Extern));
 
-        string free_function = op->free_function.empty() ? "halide_free" : op->free_function;
+        string free_function = op->free_function;
+        if (free_function.empty()) {
+            free_function = op->memory_type == MemoryType::HugePage ? "halide_huge_page_free" : "halide_free";
+        }
         emit_halide_free_helper(op_name, free_function);
     }
 
@@ -47,11 +47,15 @@ bool function_takes_user_context(const std::string &name) {
         "halide_do_async_consumer",
         "halide_error",
         "halide_free",
+        "halide_huge_page_free",
+        "halide_huge_page_malloc",
         "halide_malloc",
         "halide_print",
         "halide_profiler_memory_allocate",
         "halide_profiler_memory_free",
         "halide_profiler_pipeline_start",
+        "halide_profiler_instrumented_pipeline_start",
+        "halide_profiler_instrumented_calibrate",
         "halide_profiler_pipeline_end",
         "halide_profiler_stack_peak_update",
         "halide_spawn_thread",
@@ -61,7 +65,10 @@ bool function_takes_user_context(const std::string &name) {
         "halide_trace_helper",
         "halide_memoization_cache_lookup",
         "halide_memoization_cache_store",
+        "halide_memoization_cache_store_with_cost",
         "halide_memoization_cache_release",
+        "halide_scratch_arena_acquire",
+        "halide_scratch_arena_release",
         "halide_cuda_run",
         "halide_opencl_run",
         "halide_openglcompute_run",
@@ -88,6 +88,7 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
             const string str_max_size = target.has_large_buffers() ? "2^63 - 1" : "2^31 - 1";
             user_error << "Total size for allocation " << name << " is constant but exceeds " << str_max_size << ".";
         } else if (memory_type == MemoryType::Heap ||
+                   memory_type == MemoryType::HugePage ||
                    (memory_type != MemoryType::Register &&
                     !can_allocation_fit_on_stack(stack_bytes))) {
             // We should put the allocation on the heap if it's
@@ -264,15 +265,16 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
             allocation.ptr = codegen(new_expr);
         } else {
             // call malloc
-            llvm::Function *malloc_fn = module->getFunction("halide_malloc");
-            internal_assert(malloc_fn) << "Could not find halide_malloc in module\n";
+            const string malloc_name = memory_type == MemoryType::HugePage ? "halide_huge_page_malloc" : "halide_malloc";
+            llvm::Function *malloc_fn = module->getFunction(malloc_name);
+            internal_assert(malloc_fn) << "Could not find " << malloc_name << " in module\n";
             malloc_fn->setReturnDoesNotAlias();
 
             llvm::Function::arg_iterator arg_iter = malloc_fn->arg_begin();
             ++arg_iter;  // skip the user context *
             llvm_size = builder->CreateIntCast(llvm_size, arg_iter->getType(), false);
 
-            debug(4) << "Creating call to halide_malloc for allocation " << name
+            debug(4) << "Creating call to " << malloc_name << " for allocation " << name
                      << " of size " << type.bytes();
             for (const Expr &e : extents) {
                 debug(4) << " x " << e;
@@ -305,7 +307,7 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
 
         // Register a destructor for this allocation.
         if (free_function.empty()) {
-            free_function = "halide_free";
+            free_function = memory_type == MemoryType::HugePage ? "halide_huge_page_free" : "halide_free";
         }
         llvm::Function *free_fn = module->getFunction(free_function);
         internal_assert(free_fn) << "Could not find " << free_function << " in module.\n";
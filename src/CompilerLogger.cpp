@@ -17,7 +17,10 @@ namespace {
 // TODO: for now we are just going to ignore potential issues with
 // static-initialization-order-fiasco, as CompilerLogger isn't currently used
 // from any static-initialization execution scope.
-std::unique_ptr<CompilerLogger> active_compiler_logger;
+//
+// Each thread has its own, so that compile_multitarget can generate
+// code for several targets at once.
+thread_local std::unique_ptr<CompilerLogger> active_compiler_logger;
 
 class ObfuscateNames : public IRMutator {
     using IRMutator::visit;
@@ -116,6 +119,12 @@ void JSONCompilerLogger::record_compilation_time(Phase phase, double duration) {
     compilation_time[phase] += duration;
 }
 
+void JSONCompilerLogger::record_lowering_pass(const std::string &pass_name, double duration,
+                                              int64_t ir_nodes_before, int64_t ir_nodes_after,
+                                              int64_t peak_rss_delta) {
+    lowering_passes.push_back({pass_name, duration, ir_nodes_before, ir_nodes_after, peak_rss_delta});
+}
+
 void JSONCompilerLogger::obfuscate() {
     {
         std::map<std::string, std::vector<Expr>> n;
@@ -278,6 +287,23 @@ std::ostream &JSONCompilerLogger::emit_to_stream(std::ostream &o) {
         emit_key_value(o, indent, "compilation_time_llvm", compilation_time[Phase::LLVM]);
     }
 
+    if (!lowering_passes.empty()) {
+        emit_key(o, indent, "lowering_passes");
+        o << "[\n";
+        int commas_to_emit = (int)lowering_passes.size() - 1;
+        for (const auto &it : lowering_passes) {
+            o << std::string(indent + 1, ' ') << "{\n";
+            emit_key_value(o, indent + 2, "name", it.name);
+            emit_key_value(o, indent + 2, "time", it.duration);
+            emit_key_value(o, indent + 2, "ir_nodes_before", it.ir_nodes_before);
+            emit_key_value(o, indent + 2, "ir_nodes_after", it.ir_nodes_after);
+            emit_key_value(o, indent + 2, "peak_rss_delta", it.peak_rss_delta, false);
+            emit_object_key_close(o, indent + 1, (commas_to_emit-- > 0));
+        }
+        o << std::string(indent, ' ') << "]";
+        emit_eol(o);
+    }
+
     if (!matched_simplifier_rules.empty()) {
         emit_object_key_open(o, indent, "matched_simplifier_rules");
 
@@ -15,6 +15,7 @@
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "Expr.h"
 #include "Target.h"
@@ -53,15 +54,25 @@ public:
      */
     virtual void record_compilation_time(Phase phase, double duration) = 0;
 
+    /** Record the time (in seconds) taken by a single pass of Halide
+     * lowering, the number of distinct IR nodes in the Stmt before and
+     * after it, and how much it grew the peak resident set size of the
+     * process (in bytes; zero if unknown or unchanged). Called once per pass,
+     * in order; passes that run more than once are recorded each time.
+     */
+    virtual void record_lowering_pass(const std::string &pass_name, double duration,
+                                      int64_t ir_nodes_before, int64_t ir_nodes_after,
+                                      int64_t peak_rss_delta) = 0;
+
     /**
      * Emit all the gathered data to the given stream. This may be called multiple times.
      */
     virtual std::ostream &emit_to_stream(std::ostream &o) = 0;
 };
 
-/** Set the active CompilerLogger object, replacing any existing one.
- * It is legal to pass in a nullptr (which means "don't do any compiler logging").
- * Returns the previous CompilerLogger (if any). */
+/** Set the active CompilerLogger object for the calling thread, replacing
+ * any existing one. It is legal to pass in a nullptr (which means "don't do
+ * any compiler logging"). Returns the previous CompilerLogger (if any). */
 std::unique_ptr<CompilerLogger> set_compiler_logger(std::unique_ptr<CompilerLogger> compiler_logger);
 
 /** Return the currently active CompilerLogger object. If set_compiler_logger()
@@ -90,6 +101,9 @@ public:
     void record_failed_to_prove(Expr failed_to_prove, Expr original_expr) override;
     void record_object_code_size(uint64_t bytes) override;
     void record_compilation_time(Phase phase, double duration) override;
+    void record_lowering_pass(const std::string &pass_name, double duration,
+                              int64_t ir_nodes_before, int64_t ir_nodes_after,
+                              int64_t peak_rss_delta) override;
 
     std::ostream &emit_to_stream(std::ostream &o) override;
 
@@ -116,6 +130,15 @@ protected:
     // Map of the time take for each phase of compilation.
     std::map<Phase, double> compilation_time;
 
+    struct LoweringPass {
+        std::string name;
+        double duration;
+        int64_t ir_nodes_before, ir_nodes_after, peak_rss_delta;
+    };
+
+    // The lowering passes run, in order.
+    std::vector<LoweringPass> lowering_passes;
+
     void obfuscate();
     void emit();
 };
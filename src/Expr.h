@@ -384,6 +384,31 @@ enum class MemoryType {
     /** AMX Tile register for X86. Any data that would be used in an AMX matrix
      * multiplication must first be loaded into an AMX tile register. */
     AMXTile,
+
+    /** Heap memory backed by huge (2MB) pages where the OS supports it,
+     * to cut TLB misses on very large intermediates. Allocated using
+     * halide_huge_page_malloc, which falls back to halide_malloc
+     * elsewhere and for small allocations. See also
+     * halide_set_huge_page_prefault. */
+    HugePage,
+};
+
+/** An enum describing how the iterations of a parallel loop are
+ * divided among the threads of the default parallel runtime. Used
+ * with Func::parallel. */
+enum class TaskPartition {
+    /** Let the runtime decide. Currently threads claim one iteration
+     * at a time, or use work stealing if it is enabled (see
+     * halide_set_work_stealing). */
+    Auto,
+
+    /** Guided scheduling: each thread claims a chunk of contiguous
+     * iterations that is proportional to the number of iterations
+     * remaining divided by the number of threads, so chunks start
+     * large and shrink as the loop drains. This keeps the scheduling
+     * overhead of large loops low while still balancing load at the
+     * tail of loops with iterations of uneven cost. */
+    Guided,
 };
 
 namespace Internal {
@@ -1566,6 +1566,16 @@ Stage &Stage::parallel(const VarOrRVar &var, const Expr &factor, TailStrategy ta
     return *this;
 }
 
+Stage &Stage::parallel(const VarOrRVar &var, TaskPartition partition) {
+    parallel(var);
+    for (Dim &dim : definition.schedule().dims()) {
+        if (var_name_match(dim.var, var.name())) {
+            dim.partition = partition;
+        }
+    }
+    return *this;
+}
+
 Stage &Stage::vectorize(const VarOrRVar &var, const Expr &factor, TailStrategy tail) {
     if (var.is_rvar) {
         RVar tmp;
@@ -2266,6 +2276,12 @@ Func &Func::parallel(const VarOrRVar &var, const Expr &factor, TailStrategy tail
     return *this;
 }
 
+Func &Func::parallel(const VarOrRVar &var, TaskPartition partition) {
+    invalidate_cache();
+    Stage(func, func.definition(), 0).parallel(var, partition);
+    return *this;
+}
+
 Func &Func::vectorize(const VarOrRVar &var, const Expr &factor, TailStrategy tail) {
     invalidate_cache();
     Stage(func, func.definition(), 0).vectorize(var, factor, tail);
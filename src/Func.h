@@ -347,6 +347,7 @@ public:
     Stage &vectorize(const VarOrRVar &var);
     Stage &unroll(const VarOrRVar &var);
     Stage &parallel(const VarOrRVar &var, const Expr &task_size, TailStrategy tail = TailStrategy::Auto);
+    Stage &parallel(const VarOrRVar &var, TaskPartition partition);
     Stage &vectorize(const VarOrRVar &var, const Expr &factor, TailStrategy tail = TailStrategy::Auto);
     Stage &unroll(const VarOrRVar &var, const Expr &factor, TailStrategy tail = TailStrategy::Auto);
     Stage &tile(const VarOrRVar &x, const VarOrRVar &y,
@@ -1453,6 +1454,13 @@ public:
      * manually. */
     Func &parallel(const VarOrRVar &var, const Expr &task_size, TailStrategy tail = TailStrategy::Auto);
 
+    /** Mark a dimension to be traversed in parallel, and choose how
+     * its iterations are divided among threads. E.g. use
+     * TaskPartition::Guided for loops whose iterations vary a lot in
+     * cost, so that threads don't sit idle at the tail of the loop
+     * while a few large chunks finish. See the TaskPartition enum. */
+    Func &parallel(const VarOrRVar &var, TaskPartition partition);
+
     /** Mark a dimension to be computed all-at-once as a single
      * vector. The dimension should have constant extent -
      * e.g. because it is the inner dimension following a split by a
@@ -2413,7 +2421,8 @@ public:
 
     /** Trace all loads from this Func by emitting calls to
      * halide_trace. If the Func is inlined, this has no
-     * effect. */
+     * effect. Which events are traced can be narrowed at runtime
+     * with halide_set_trace_filter. */
     Func &trace_loads();
 
     /** Trace all stores to the buffer backing this Func by emitting
@@ -1124,6 +1124,48 @@ const map<string, FunctionPtr> &Function::wrappers() const {
     return contents->func_schedule.wrappers();
 }
 
+void Function::update_with_deserialization(const std::string &origin_name,
+                                           const std::vector<Type> &output_types,
+                                           const std::vector<Type> &required_types,
+                                           int required_dims,
+                                           const std::vector<std::string> &args,
+                                           const FuncSchedule &func_schedule,
+                                           const Definition &init_def,
+                                           const std::vector<Definition> &updates,
+                                           const std::string &debug_file,
+                                           const std::vector<Parameter> &output_buffers,
+                                           const std::vector<ExternFuncArgument> &extern_arguments,
+                                           const std::string &extern_function_name,
+                                           NameMangling mangling,
+                                           DeviceAPI device_api,
+                                           const Expr &extern_proxy_expr,
+                                           bool trace_loads,
+                                           bool trace_stores,
+                                           bool trace_realizations,
+                                           const std::vector<std::string> &trace_tags,
+                                           bool frozen) {
+    contents->origin_name = origin_name;
+    contents->output_types = output_types;
+    contents->required_types = required_types;
+    contents->required_dims = required_dims;
+    contents->args = args;
+    contents->func_schedule = func_schedule;
+    contents->init_def = init_def;
+    contents->updates = updates;
+    contents->debug_file = debug_file;
+    contents->output_buffers = output_buffers;
+    contents->extern_arguments = extern_arguments;
+    contents->extern_function_name = extern_function_name;
+    contents->extern_mangling = mangling;
+    contents->extern_function_device_api = device_api;
+    contents->extern_proxy_expr = extern_proxy_expr;
+    contents->trace_loads = trace_loads;
+    contents->trace_stores = trace_stores;
+    contents->trace_realizations = trace_realizations;
+    contents->trace_tags = trace_tags;
+    contents->frozen = frozen;
+}
+
 Function Function::new_function_in_same_group(const std::string &f) {
     int group_size = (int)(contents.group()->members.size());
     contents.group()->members.resize(group_size + 1);
@@ -1223,6 +1265,21 @@ Function &Function::substitute_calls(const Function &orig, const Function &subst
     return substitute_calls(substitutions);
 }
 
+vector<FunctionPtr> make_function_group(const vector<string> &names) {
+    IntrusivePtr<FunctionGroup> group(new FunctionGroup);
+    group->members.resize(names.size());
+    vector<FunctionPtr> result;
+    for (size_t i = 0; i < names.size(); i++) {
+        FunctionPtr ptr;
+        ptr.strong = group;
+        ptr.idx = (int)i;
+        ptr->name = names[i];
+        ptr->origin_name = names[i];
+        result.push_back(ptr);
+    }
+    return result;
+}
+
 // Deep copy an entire Function DAG.
 pair<vector<Function>, map<string, Function>> deep_copy(
     const vector<Function> &outputs, const map<string, Function> &env) {
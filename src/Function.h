@@ -320,6 +320,30 @@ public:
     /** Define the output buffers. If the Function has types specified, this can be called at
      * any time. If not, it can only be called for a Function with a pure definition. */
     void create_output_buffers(const std::vector<Type> &types, int dims) const;
+
+    /** Overwrite everything about this Function except its name with
+     * the given fields. Used to fill in the Functions made by
+     * make_function_group when deserializing a pipeline. */
+    void update_with_deserialization(const std::string &origin_name,
+                                     const std::vector<Type> &output_types,
+                                     const std::vector<Type> &required_types,
+                                     int required_dims,
+                                     const std::vector<std::string> &args,
+                                     const FuncSchedule &func_schedule,
+                                     const Definition &init_def,
+                                     const std::vector<Definition> &updates,
+                                     const std::string &debug_file,
+                                     const std::vector<Parameter> &output_buffers,
+                                     const std::vector<ExternFuncArgument> &extern_arguments,
+                                     const std::string &extern_function_name,
+                                     NameMangling mangling,
+                                     DeviceAPI device_api,
+                                     const Expr &extern_proxy_expr,
+                                     bool trace_loads,
+                                     bool trace_stores,
+                                     bool trace_realizations,
+                                     const std::vector<std::string> &trace_tags,
+                                     bool frozen);
 };
 
 /** Deep copy an entire Function DAG. */
@@ -327,6 +351,12 @@ std::pair<std::vector<Function>, std::map<std::string, Function>> deep_copy(
     const std::vector<Function> &outputs,
     const std::map<std::string, Function> &env);
 
+/** Make a group of empty Functions with the given names, which share a
+ * lifetime. The returned pointers are strong; references between
+ * members of the group (calls, wrappers, extern arguments) should use
+ * weakened copies of them, as in deep_copy. */
+std::vector<FunctionPtr> make_function_group(const std::vector<std::string> &names);
+
 }  // namespace Internal
 }  // namespace Halide
 
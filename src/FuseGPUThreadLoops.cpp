@@ -407,7 +407,7 @@ private:
         }
 
         return For::make(op->name, new_min, new_extent,
-                         op->for_type, op->device_api, body);
+                         op->for_type, op->device_api, body, op->partition);
     }
 
     Stmt visit(const Block *op) override {
@@ -1095,7 +1095,7 @@ class ExtractRegisterAllocations : public IRMutator {
                 allocations.swap(old);
             }
 
-            return For::make(op->name, mutate(op->min), mutate(op->extent), op->for_type, op->device_api, body);
+            return For::make(op->name, mutate(op->min), mutate(op->extent), op->for_type, op->device_api, body, op->partition);
         }
     }
 
@@ -1256,7 +1256,7 @@ class InjectThreadBarriers : public IRMutator {
                 body = Block::make(body, make_barrier(0));
             }
             return For::make(op->name, op->min, op->extent,
-                             op->for_type, op->device_api, body);
+                             op->for_type, op->device_api, body, op->partition);
         } else {
             return IRMutator::visit(op);
         }
@@ -1272,6 +1272,7 @@ class InjectThreadBarriers : public IRMutator {
             break;
         case MemoryType::Auto:
         case MemoryType::Heap:
+        case MemoryType::HugePage:
         case MemoryType::GPUTexture:
             debug(4) << "   memory type is heap or auto\n";
             device_stores.insert(op->name);
@@ -1297,6 +1298,7 @@ class InjectThreadBarriers : public IRMutator {
             break;
         case MemoryType::Auto:
         case MemoryType::Heap:
+        case MemoryType::HugePage:
         case MemoryType::GPUTexture:
             debug(4) << "   memory type is heap or auto\n";
             device_loads.insert(op->name);
@@ -1431,7 +1433,7 @@ class FuseGPUThreadLoopsSingleKernel : public IRMutator {
             if (body.same_as(op->body)) {
                 return op;
             } else {
-                return For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+                return For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body, op->partition);
             }
         } else {
             return IRMutator::visit(op);
@@ -1500,7 +1502,7 @@ class ZeroGPULoopMins : public IRMutator {
             internal_assert(op);
             Expr adjusted = Variable::make(Int(32), op->name) + op->min;
             Stmt body = substitute(op->name, adjusted, op->body);
-            stmt = For::make(op->name, 0, op->extent, op->for_type, op->device_api, body);
+            stmt = For::make(op->name, 0, op->extent, op->for_type, op->device_api, body, op->partition);
         }
         return stmt;
     }
@@ -1583,7 +1585,7 @@ class AddConditionToALoop : public IRMutator {
         }
 
         return For::make(op->name, op->min, op->extent, op->for_type, op->device_api,
-                         IfThenElse::make(condition, op->body, Stmt()));
+                         IfThenElse::make(condition, op->body, Stmt()), op->partition);
     }
 
 public:
@@ -1,5 +1,6 @@
 #include "IR.h"
 
+#include "IRHashCons.h"
 #include "IRMutator.h"
 #include "IROperator.h"
 #include "IRPrinter.h"
@@ -17,7 +18,7 @@ Expr Cast::make(Type t, Expr v) {
     Cast *node = new Cast;
     node->type = t;
     node->value = std::move(v);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Reinterpret::make(Type t, Expr v) {
@@ -33,7 +34,7 @@ Expr Reinterpret::make(Type t, Expr v) {
     Reinterpret *node = new Reinterpret;
     node->type = t;
     node->value = std::move(v);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Add::make(Expr a, Expr b) {
@@ -45,7 +46,7 @@ Expr Add::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Sub::make(Expr a, Expr b) {
@@ -57,7 +58,7 @@ Expr Sub::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Mul::make(Expr a, Expr b) {
@@ -69,7 +70,7 @@ Expr Mul::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Div::make(Expr a, Expr b) {
@@ -81,7 +82,7 @@ Expr Div::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Mod::make(Expr a, Expr b) {
@@ -93,7 +94,7 @@ Expr Mod::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Min::make(Expr a, Expr b) {
@@ -105,7 +106,7 @@ Expr Min::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Max::make(Expr a, Expr b) {
@@ -117,7 +118,7 @@ Expr Max::make(Expr a, Expr b) {
     node->type = a.type();
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr EQ::make(Expr a, Expr b) {
@@ -129,7 +130,7 @@ Expr EQ::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr NE::make(Expr a, Expr b) {
@@ -141,7 +142,7 @@ Expr NE::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr LT::make(Expr a, Expr b) {
@@ -153,7 +154,7 @@ Expr LT::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr LE::make(Expr a, Expr b) {
@@ -165,7 +166,7 @@ Expr LE::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr GT::make(Expr a, Expr b) {
@@ -177,7 +178,7 @@ Expr GT::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr GE::make(Expr a, Expr b) {
@@ -189,7 +190,7 @@ Expr GE::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr And::make(Expr a, Expr b) {
@@ -203,7 +204,7 @@ Expr And::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Or::make(Expr a, Expr b) {
@@ -217,7 +218,7 @@ Expr Or::make(Expr a, Expr b) {
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
     node->b = std::move(b);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Not::make(Expr a) {
@@ -227,7 +228,7 @@ Expr Not::make(Expr a) {
     Not *node = new Not;
     node->type = Bool(a.type().lanes());
     node->a = std::move(a);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Select::make(Expr condition, Expr true_value, Expr false_value) {
@@ -245,7 +246,7 @@ Expr Select::make(Expr condition, Expr true_value, Expr false_value) {
     node->condition = std::move(condition);
     node->true_value = std::move(true_value);
     node->false_value = std::move(false_value);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Load::make(Type type, const std::string &name, Expr index, Buffer<> image, Parameter param, Expr predicate, ModulusRemainder alignment) {
@@ -263,7 +264,7 @@ Expr Load::make(Type type, const std::string &name, Expr index, Buffer<> image,
     node->image = std::move(image);
     node->param = std::move(param);
     node->alignment = alignment;
-    return node;
+    return hash_cons(node);
 }
 
 Expr Ramp::make(Expr base, Expr stride, int lanes) {
@@ -277,7 +278,7 @@ Expr Ramp::make(Expr base, Expr stride, int lanes) {
     node->base = std::move(base);
     node->stride = std::move(stride);
     node->lanes = lanes;
-    return node;
+    return hash_cons(node);
 }
 
 Expr Broadcast::make(Expr value, int lanes) {
@@ -288,7 +289,7 @@ Expr Broadcast::make(Expr value, int lanes) {
     node->type = value.type().with_lanes(lanes * value.type().lanes());
     node->value = std::move(value);
     node->lanes = lanes;
-    return node;
+    return hash_cons(node);
 }
 
 Expr Let::make(const std::string &name, Expr value, Expr body) {
@@ -300,7 +301,7 @@ Expr Let::make(const std::string &name, Expr value, Expr body) {
     node->name = name;
     node->value = std::move(value);
     node->body = std::move(body);
-    return node;
+    return hash_cons(node);
 }
 
 Stmt LetStmt::make(const std::string &name, Expr value, Stmt body) {
@@ -342,7 +343,8 @@ Stmt ProducerConsumer::make_consume(const std::string &name, Stmt body) {
     return ProducerConsumer::make(name, false, std::move(body));
 }
 
-Stmt For::make(const std::string &name, Expr min, Expr extent, ForType for_type, DeviceAPI device_api, Stmt body) {
+Stmt For::make(const std::string &name, Expr min, Expr extent, ForType for_type, DeviceAPI device_api, Stmt body,
+               TaskPartition partition) {
     internal_assert(min.defined()) << "For of undefined\n";
     internal_assert(extent.defined()) << "For of undefined\n";
     internal_assert(min.type() == Int(32)) << "For with non-integer min\n";
@@ -356,6 +358,7 @@ Stmt For::make(const std::string &name, Expr min, Expr extent, ForType for_type,
     node->for_type = for_type;
     node->device_api = device_api;
     node->body = std::move(body);
+    node->partition = partition;
     return node;
 }
 
@@ -732,7 +735,7 @@ Expr Call::make(Type type, const std::string &name, const std::vector<Expr> &arg
     node->value_index = value_index;
     node->image = std::move(image);
     node->param = std::move(param);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Variable::make(Type type, const std::string &name, Buffer<> image, Parameter param, ReductionDomain reduction_domain) {
@@ -743,7 +746,7 @@ Expr Variable::make(Type type, const std::string &name, Buffer<> image, Paramete
     node->image = std::move(image);
     node->param = std::move(param);
     node->reduction_domain = std::move(reduction_domain);
-    return node;
+    return hash_cons(node);
 }
 
 Expr Shuffle::make(const std::vector<Expr> &vectors,
@@ -764,7 +767,7 @@ Expr Shuffle::make(const std::vector<Expr> &vectors,
     node->type = element_ty.with_lanes((int)indices.size());
     node->vectors = vectors;
     node->indices = indices;
-    return node;
+    return hash_cons(node);
 }
 
 Expr Shuffle::make_interleave(const std::vector<Expr> &vectors) {
@@ -930,7 +933,7 @@ Expr VectorReduce::make(VectorReduce::Operator op,
     node->type = vec.type().with_lanes(lanes);
     node->op = op;
     node->value = std::move(vec);
-    return node;
+    return hash_cons(node);
 }
 
 namespace {
@@ -792,7 +792,12 @@ struct For : public StmtNode<For> {
     DeviceAPI device_api;
     Stmt body;
 
-    static Stmt make(const std::string &name, Expr min, Expr extent, ForType for_type, DeviceAPI device_api, Stmt body);
+    /** How the iterations of a parallel loop are divided among
+     * threads. Ignored for other loop types. */
+    TaskPartition partition;
+
+    static Stmt make(const std::string &name, Expr min, Expr extent, ForType for_type, DeviceAPI device_api, Stmt body,
+                     TaskPartition partition = TaskPartition::Auto);
 
     bool is_unordered_parallel() const {
         return Halide::Internal::is_unordered_parallel(for_type);
@@ -1,4 +1,5 @@
 #include "IREquality.h"
+#include "IRHashCons.h"
 #include "IROperator.h"
 #include "IRVisitor.h"
 
@@ -497,6 +498,7 @@ void IRComparer::visit(const For *op) {
 
     compare_names(s->name, op->name);
     compare_scalar(s->for_type, op->for_type);
+    compare_scalar(s->partition, op->partition);
     compare_expr(s->min, op->min);
     compare_expr(s->extent, op->extent);
     compare_stmt(s->body, op->body);
@@ -641,10 +643,16 @@ void IRComparer::visit(const VectorReduce *op) {
 
 // Now the methods exposed in the header.
 bool equal(const Expr &a, const Expr &b) {
+    if (hash_consed_and_distinct(a, b)) {
+        return false;
+    }
     return IRComparer().compare_expr(a, b) == IRComparer::Equal;
 }
 
 bool graph_equal(const Expr &a, const Expr &b) {
+    if (hash_consed_and_distinct(a, b)) {
+        return false;
+    }
     IRCompareCache cache(8);
     return IRComparer(&cache).compare_expr(a, b) == IRComparer::Equal;
 }
@@ -0,0 +1,456 @@
+#include "IRHashCons.h"
+
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+
+#include "Debug.h"
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+struct ScopedHashConsing::Table {
+    struct Info {
+        // A hash of the node's structure, using the cached hashes of
+        // its children.
+        uint64_t hash;
+        // Whether every node reachable from this one is also in the
+        // table.
+        bool closed;
+    };
+
+    std::unordered_map<const BaseExprNode *, Info> nodes;
+
+    // The same nodes, by hash. This holds the references that keep
+    // them alive.
+    std::unordered_multimap<uint64_t, Expr> by_hash;
+
+    size_t hits = 0;
+};
+
+namespace {
+
+thread_local ScopedHashConsing::Table *current_table = nullptr;
+
+uint64_t mix(uint64_t h, uint64_t v) {
+    return h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+}
+
+bool is_shareable(const BaseExprNode *node) {
+    switch (node->node_type) {
+    case IRNodeType::Load:
+        return false;
+    case IRNodeType::Call: {
+        const Call *c = static_cast<const Call *>(node);
+        return c->is_pure() && !c->func.defined();
+    }
+    default:
+        return node->node_type <= StrongestExprNodeType;
+    }
+}
+
+class NodeHasher {
+    const ScopedHashConsing::Table &table;
+
+public:
+    uint64_t hash;
+    bool closed = true;
+
+    NodeHasher(const ScopedHashConsing::Table &t, const BaseExprNode *node)
+        : table(t),
+          hash(mix((uint64_t)node->node_type, ((halide_type_t)node->type).as_u32())) {
+    }
+
+    // Mark the node as one that equal() may consider equal to a
+    // different node in the table.
+    void open() {
+        closed = false;
+    }
+
+    void add(uint64_t v) {
+        hash = mix(hash, v);
+    }
+
+    void add(const std::string &s) {
+        add(std::hash<std::string>()(s));
+    }
+
+    void add(const Expr &e) {
+        if (!e.defined()) {
+            add((uint64_t)0);
+            return;
+        }
+        auto it = table.nodes.find(e.get());
+        if (it == table.nodes.end()) {
+            add((uint64_t)(uintptr_t)e.get());
+            closed = false;
+        } else {
+            add(it->second.hash);
+            closed = closed && it->second.closed;
+        }
+    }
+
+    void add(const std::vector<Expr> &v) {
+        add(v.size());
+        for (const Expr &e : v) {
+            add(e);
+        }
+    }
+};
+
+template<typename T>
+void hash_binary(NodeHasher &h, const BaseExprNode *node) {
+    const T *op = static_cast<const T *>(node);
+    h.add(op->a);
+    h.add(op->b);
+}
+
+template<typename T>
+bool same_binary(const BaseExprNode *a, const BaseExprNode *b) {
+    const T *x = static_cast<const T *>(a);
+    const T *y = static_cast<const T *>(b);
+    return x->a.same_as(y->a) && x->b.same_as(y->b);
+}
+
+bool same_exprs(const std::vector<Expr> &a, const std::vector<Expr> &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (!a[i].same_as(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t float_bits(double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+void hash_node(NodeHasher &h, const BaseExprNode *node) {
+    switch (node->node_type) {
+    case IRNodeType::IntImm:
+        h.add((uint64_t)static_cast<const IntImm *>(node)->value);
+        break;
+    case IRNodeType::UIntImm:
+        h.add(static_cast<const UIntImm *>(node)->value);
+        break;
+    case IRNodeType::FloatImm: {
+        const double v = static_cast<const FloatImm *>(node)->value;
+        h.add(float_bits(v));
+        if (v == 0 || std::isnan(v)) {
+            h.open();
+        }
+        break;
+    }
+    case IRNodeType::StringImm:
+        h.add(static_cast<const StringImm *>(node)->value);
+        break;
+    case IRNodeType::Broadcast: {
+        const Broadcast *op = static_cast<const Broadcast *>(node);
+        h.add(op->value);
+        h.add((uint64_t)op->lanes);
+        break;
+    }
+    case IRNodeType::Cast:
+        h.add(static_cast<const Cast *>(node)->value);
+        break;
+    case IRNodeType::Reinterpret:
+        h.add(static_cast<const Reinterpret *>(node)->value);
+        break;
+    case IRNodeType::Variable: {
+        const Variable *op = static_cast<const Variable *>(node);
+        h.add(op->name);
+        if (op->param.defined() || op->image.defined() || op->reduction_domain.defined()) {
+            h.open();
+        }
+        break;
+    }
+    case IRNodeType::Add:
+        hash_binary<Add>(h, node);
+        break;
+    case IRNodeType::Sub:
+        hash_binary<Sub>(h, node);
+        break;
+    case IRNodeType::Mod:
+        hash_binary<Mod>(h, node);
+        break;
+    case IRNodeType::Mul:
+        hash_binary<Mul>(h, node);
+        break;
+    case IRNodeType::Div:
+        hash_binary<Div>(h, node);
+        break;
+    case IRNodeType::Min:
+        hash_binary<Min>(h, node);
+        break;
+    case IRNodeType::Max:
+        hash_binary<Max>(h, node);
+        break;
+    case IRNodeType::EQ:
+        hash_binary<EQ>(h, node);
+        break;
+    case IRNodeType::NE:
+        hash_binary<NE>(h, node);
+        break;
+    case IRNodeType::LT:
+        hash_binary<LT>(h, node);
+        break;
+    case IRNodeType::LE:
+        hash_binary<LE>(h, node);
+        break;
+    case IRNodeType::GT:
+        hash_binary<GT>(h, node);
+        break;
+    case IRNodeType::GE:
+        hash_binary<GE>(h, node);
+        break;
+    case IRNodeType::And:
+        hash_binary<And>(h, node);
+        break;
+    case IRNodeType::Or:
+        hash_binary<Or>(h, node);
+        break;
+    case IRNodeType::Not:
+        h.add(static_cast<const Not *>(node)->a);
+        break;
+    case IRNodeType::Select: {
+        const Select *op = static_cast<const Select *>(node);
+        h.add(op->condition);
+        h.add(op->true_value);
+        h.add(op->false_value);
+        break;
+    }
+    case IRNodeType::Ramp: {
+        const Ramp *op = static_cast<const Ramp *>(node);
+        h.add(op->base);
+        h.add(op->stride);
+        h.add((uint64_t)op->lanes);
+        break;
+    }
+    case IRNodeType::Call: {
+        const Call *op = static_cast<const Call *>(node);
+        h.add(op->name);
+        h.add((uint64_t)op->call_type);
+        h.add((uint64_t)op->value_index);
+        h.add(op->args);
+        if (op->param.defined() || op->image.defined()) {
+            h.open();
+        }
+        break;
+    }
+    case IRNodeType::Let: {
+        const Let *op = static_cast<const Let *>(node);
+        h.add(op->name);
+        h.add(op->value);
+        h.add(op->body);
+        break;
+    }
+    case IRNodeType::Shuffle: {
+        const Shuffle *op = static_cast<const Shuffle *>(node);
+        h.add(op->vectors);
+        for (int i : op->indices) {
+            h.add((uint64_t)i);
+        }
+        break;
+    }
+    case IRNodeType::VectorReduce: {
+        const VectorReduce *op = static_cast<const VectorReduce *>(node);
+        h.add((uint64_t)op->op);
+        h.add(op->value);
+        break;
+    }
+    default:
+        internal_error << "Can't hash-cons IR node type " << (int)node->node_type << "\n";
+    }
+}
+
+// Whether two nodes of the same node type and Type have the same
+// fields and the same children.
+bool same_node(const BaseExprNode *a, const BaseExprNode *b) {
+    switch (a->node_type) {
+    case IRNodeType::IntImm:
+        return static_cast<const IntImm *>(a)->value == static_cast<const IntImm *>(b)->value;
+    case IRNodeType::UIntImm:
+        return static_cast<const UIntImm *>(a)->value == static_cast<const UIntImm *>(b)->value;
+    case IRNodeType::FloatImm:
+        // Compare the bits, so that 0 and -0 (and different NaNs) stay distinct.
+        return float_bits(static_cast<const FloatImm *>(a)->value) ==
+               float_bits(static_cast<const FloatImm *>(b)->value);
+    case IRNodeType::StringImm:
+        return static_cast<const StringImm *>(a)->value == static_cast<const StringImm *>(b)->value;
+    case IRNodeType::Broadcast: {
+        const Broadcast *x = static_cast<const Broadcast *>(a);
+        const Broadcast *y = static_cast<const Broadcast *>(b);
+        return x->lanes == y->lanes && x->value.same_as(y->value);
+    }
+    case IRNodeType::Cast:
+        return static_cast<const Cast *>(a)->value.same_as(static_cast<const Cast *>(b)->value);
+    case IRNodeType::Reinterpret:
+        return static_cast<const Reinterpret *>(a)->value.same_as(static_cast<const Reinterpret *>(b)->value);
+    case IRNodeType::Variable: {
+        // Variables that refer to different Parameters, Buffers or
+        // reduction domains are not interchangeable, even though they
+        // compare equal.
+        const Variable *x = static_cast<const Variable *>(a);
+        const Variable *y = static_cast<const Variable *>(b);
+        return (x->name == y->name &&
+                x->param.same_as(y->param) &&
+                x->image.same_as(y->image) &&
+                x->reduction_domain.same_as(y->reduction_domain));
+    }
+    case IRNodeType::Add:
+        return same_binary<Add>(a, b);
+    case IRNodeType::Sub:
+        return same_binary<Sub>(a, b);
+    case IRNodeType::Mod:
+        return same_binary<Mod>(a, b);
+    case IRNodeType::Mul:
+        return same_binary<Mul>(a, b);
+    case IRNodeType::Div:
+        return same_binary<Div>(a, b);
+    case IRNodeType::Min:
+        return same_binary<Min>(a, b);
+    case IRNodeType::Max:
+        return same_binary<Max>(a, b);
+    case IRNodeType::EQ:
+        return same_binary<EQ>(a, b);
+    case IRNodeType::NE:
+        return same_binary<NE>(a, b);
+    case IRNodeType::LT:
+        return same_binary<LT>(a, b);
+    case IRNodeType::LE:
+        return same_binary<LE>(a, b);
+    case IRNodeType::GT:
+        return same_binary<GT>(a, b);
+    case IRNodeType::GE:
+        return same_binary<GE>(a, b);
+    case IRNodeType::And:
+        return same_binary<And>(a, b);
+    case IRNodeType::Or:
+        return same_binary<Or>(a, b);
+    case IRNodeType::Not:
+        return static_cast<const Not *>(a)->a.same_as(static_cast<const Not *>(b)->a);
+    case IRNodeType::Select: {
+        const Select *x = static_cast<const Select *>(a);
+        const Select *y = static_cast<const Select *>(b);
+        return (x->condition.same_as(y->condition) &&
+                x->true_value.same_as(y->true_value) &&
+                x->false_value.same_as(y->false_value));
+    }
+    case IRNodeType::Ramp: {
+        const Ramp *x = static_cast<const Ramp *>(a);
+        const Ramp *y = static_cast<const Ramp *>(b);
+        return (x->lanes == y->lanes &&
+                x->base.same_as(y->base) &&
+                x->stride.same_as(y->stride));
+    }
+    case IRNodeType::Call: {
+        const Call *x = static_cast<const Call *>(a);
+        const Call *y = static_cast<const Call *>(b);
+        return (x->name == y->name &&
+                x->call_type == y->call_type &&
+                x->value_index == y->value_index &&
+                x->param.same_as(y->param) &&
+                x->image.same_as(y->image) &&
+                same_exprs(x->args, y->args));
+    }
+    case IRNodeType::Let: {
+        const Let *x = static_cast<const Let *>(a);
+        const Let *y = static_cast<const Let *>(b);
+        return (x->name == y->name &&
+                x->value.same_as(y->value) &&
+                x->body.same_as(y->body));
+    }
+    case IRNodeType::Shuffle: {
+        const Shuffle *x = static_cast<const Shuffle *>(a);
+        const Shuffle *y = static_cast<const Shuffle *>(b);
+        return x->indices == y->indices && same_exprs(x->vectors, y->vectors);
+    }
+    case IRNodeType::VectorReduce: {
+        const VectorReduce *x = static_cast<const VectorReduce *>(a);
+        const VectorReduce *y = static_cast<const VectorReduce *>(b);
+        return x->op == y->op && x->value.same_as(y->value);
+    }
+    default:
+        return false;
+    }
+}
+
+}  // namespace
+
+ScopedHashConsing::ScopedHashConsing() {
+    if (current_table) {
+        table = current_table;
+    } else {
+        table = new Table;
+        owns_table = true;
+        current_table = table;
+    }
+}
+
+ScopedHashConsing::~ScopedHashConsing() {
+    if (owns_table) {
+        debug(2) << "Hash-consing shared " << table->hits << " Exprs between "
+                 << table->nodes.size() << " distinct nodes\n";
+        current_table = nullptr;
+        delete table;
+    }
+}
+
+size_t ScopedHashConsing::unique_nodes() const {
+    return table->nodes.size();
+}
+
+size_t ScopedHashConsing::hits() const {
+    return table->hits;
+}
+
+const BaseExprNode *hash_cons_node(const BaseExprNode *node) {
+    ScopedHashConsing::Table *table = current_table;
+    if (!table || !is_shareable(node)) {
+        return node;
+    }
+
+    NodeHasher h(*table, node);
+    hash_node(h, node);
+
+    // Take a reference, so that the node is freed if we find an
+    // existing one.
+    Expr e(node);
+    auto range = table->by_hash.equal_range(h.hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        const BaseExprNode *existing = (const BaseExprNode *)it->second.get();
+        if (existing->node_type == node->node_type &&
+            existing->type == node->type &&
+            same_node(existing, node)) {
+            table->hits++;
+            return existing;
+        }
+    }
+
+    table->nodes.emplace(node, ScopedHashConsing::Table::Info{h.hash, h.closed});
+    table->by_hash.emplace(h.hash, std::move(e));
+    return node;
+}
+
+bool hash_consed_and_distinct(const Expr &a, const Expr &b) {
+    const ScopedHashConsing::Table *table = current_table;
+    if (!table || a.same_as(b) || !a.defined() || !b.defined()) {
+        return false;
+    }
+    auto ia = table->nodes.find(a.get());
+    if (ia == table->nodes.end() || !ia->second.closed) {
+        return false;
+    }
+    auto ib = table->nodes.find(b.get());
+    return ib != table->nodes.end() && ib->second.closed;
+}
+
+}  // namespace Internal
+}  // namespace Halide
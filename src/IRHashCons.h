@@ -0,0 +1,71 @@
+#ifndef HALIDE_IR_HASH_CONS_H
+#define HALIDE_IR_HASH_CONS_H
+
+/** \file
+ * Defines an optional mode in which structurally identical Exprs share
+ * a single IR node.
+ */
+
+#include <cstddef>
+
+#include "Expr.h"
+
+namespace Halide {
+namespace Internal {
+
+/** While an object of this type is alive, Exprs made on this thread
+ * are hash-consed: the make functions of most Expr nodes look up the
+ * new node in a table keyed by its fields and the identity of its
+ * children, and return the existing node if there is one. Common
+ * subexpressions then share storage, IRGraphMutator and IRGraphVisitor
+ * (which key on node identity) see each of them only once, and equal()
+ * can often answer without walking the trees.
+ *
+ * The table holds a reference to every node it has seen, so nodes made
+ * in the scope live until the scope ends, much like an arena that is
+ * freed at the end of a compilation. Loads, impure Calls and calls to
+ * Funcs are never shared, nor are Stmts. Scopes nest; an inner scope
+ * just uses the table of the outermost one. */
+class ScopedHashConsing {
+public:
+    ScopedHashConsing();
+    ~ScopedHashConsing();
+
+    ScopedHashConsing(const ScopedHashConsing &) = delete;
+    ScopedHashConsing &operator=(const ScopedHashConsing &) = delete;
+
+    /** The number of distinct nodes in the table, and the number of
+     * makes that returned an existing node instead of a new one. */
+    // @{
+    size_t unique_nodes() const;
+    size_t hits() const;
+    // @}
+
+    struct Table;
+
+private:
+    Table *table = nullptr;
+    bool owns_table = false;
+};
+
+/** Return the node in the current hash-consing table that is identical
+ * to the given newly-made node, deleting the new one, or add it to the
+ * table if there is none. Returns the argument unchanged if no
+ * ScopedHashConsing is active. The node must not yet be referenced by
+ * anything. */
+const BaseExprNode *hash_cons_node(const BaseExprNode *node);
+
+template<typename T>
+const T *hash_cons(const T *node) {
+    return static_cast<const T *>(hash_cons_node(node));
+}
+
+/** Returns true if the two Exprs are both in the current hash-consing
+ * table along with everything they refer to, and are different nodes,
+ * which means they are not equal. */
+bool hash_consed_and_distinct(const Expr &a, const Expr &b);
+
+}  // namespace Internal
+}  // namespace Halide
+
+#endif
@@ -153,6 +153,9 @@ std::ostream &operator<<(std::ostream &out, const MemoryType &t) {
     case MemoryType::AMXTile:
         out << "AMXTile";
         break;
+    case MemoryType::HugePage:
+        out << "HugePage";
+        break;
     }
     return out;
 }
@@ -184,6 +187,18 @@ std::ostream &operator<<(std::ostream &out, const TailStrategy &t) {
     return out;
 }
 
+std::ostream &operator<<(std::ostream &out, const TaskPartition &p) {
+    switch (p) {
+    case TaskPartition::Auto:
+        out << "Auto";
+        break;
+    case TaskPartition::Guided:
+        out << "Guided";
+        break;
+    }
+    return out;
+}
+
 ostream &operator<<(ostream &stream, const LoopLevel &loop_level) {
     return stream << "loop_level("
                   << (loop_level.defined() ? loop_level.to_string() : "undefined")
@@ -781,7 +796,11 @@ void IRPrinter::visit(const ProducerConsumer *op) {
 
 void IRPrinter::visit(const For *op) {
     ScopedBinding<> bind(known_type, op->name);
-    stream << get_indent() << op->for_type << op->device_api << " (" << op->name << ", ";
+    stream << get_indent() << op->for_type << op->device_api;
+    if (op->partition != TaskPartition::Auto) {
+        stream << "<" << op->partition << ">";
+    }
+    stream << " (" << op->name << ", ";
     print_no_parens(op->min);
     stream << ", ";
     print_no_parens(op->extent);
@@ -43,6 +43,9 @@ std::ostream &operator<<(std::ostream &stream, const MemoryType &);
 /** Emit a halide tail strategy in human-readable form */
 std::ostream &operator<<(std::ostream &stream, const TailStrategy &t);
 
+/** Emit a halide task partition in human-readable form */
+std::ostream &operator<<(std::ostream &stream, const TaskPartition &p);
+
 /** Emit a halide LoopLevel in human-readable form */
 std::ostream &operator<<(std::ostream &stream, const LoopLevel &);
 
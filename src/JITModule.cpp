@@ -1,6 +1,12 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <cstdlib>
+#include <map>
 #include <mutex>
 #include <set>
+#include <sstream>
 #include <string>
 
 #ifdef _WIN32
@@ -16,11 +22,15 @@
 #include "CodeGen_Internal.h"
 #include "CodeGen_LLVM.h"
 #include "Debug.h"
+#include "IRPrinter.h"
+#include "IRVisitor.h"
 #include "JITModule.h"
 #include "LLVM_Headers.h"
 #include "LLVM_Output.h"
 #include "LLVM_Runtime_Linker.h"
+#include "Module.h"
 #include "Pipeline.h"
+#include "Util.h"
 #include "WasmExecutor.h"
 
 namespace Halide {
@@ -285,27 +295,460 @@ public:
     }
 };
 
+llvm::orc::LLJITBuilderState::ObjectLinkingLayerCreator make_linker(const Target &target,
+                                                                     const std::vector<JITModule> &dependencies) {
+    if ((target.arch == Target::Arch::X86 && target.bits == 32) ||
+        (target.arch == Target::Arch::ARM && target.bits == 32)) {
+        // Fallback to RTDyld-based linking to workaround errors:
+        // i386: "JIT session error: Unsupported i386 relocation:4" (R_386_PLT32)
+        // ARM 32bit: Unsupported target machine architecture in ELF object shared runtime-jitted-objectbuffer
+        return [&](llvm::orc::ExecutionSession &session, const llvm::Triple &) {
+            return std::make_unique<llvm::orc::RTDyldObjectLinkingLayer>(session, [&]() {
+                return std::make_unique<HalideJITMemoryManager>(dependencies);
+            });
+        };
+    } else {
+        return [](llvm::orc::ExecutionSession &session, const llvm::Triple &) {
+            return std::make_unique<llvm::orc::ObjectLinkingLayer>(session);
+        };
+    }
+}
+
+// Make system symbols (like pthread, dl and others) and the exports of
+// the dependencies visible to the code in a JIT.
+void add_external_symbols(llvm::orc::LLJIT &JIT, const DataLayout &data_layout,
+                          const std::vector<JITModule> &dependencies) {
+    auto gen = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(data_layout.getGlobalPrefix());
+    internal_assert(gen) << llvm::toString(gen.takeError()) << "\n";
+    JIT.getMainJITDylib().addGenerator(std::move(gen.get()));
+
+    llvm::orc::SymbolMap newSymbols;
+    auto symbolStringPool = JIT.getExecutionSession().getExecutorProcessControl().getSymbolStringPool();
+    for (const auto &module : dependencies) {
+        for (auto const &iter : module.exports()) {
+            orc::SymbolStringPtr name = symbolStringPool->intern(iter.first);
+            orc::SymbolStringPtr _name = symbolStringPool->intern("_" + iter.first);
+#if LLVM_VERSION >= 170
+            auto symbol = llvm::orc::ExecutorAddr::fromPtr(iter.second.address);
+            if (!newSymbols.count(name)) {
+                newSymbols.insert({name, {symbol, JITSymbolFlags::Exported}});
+            }
+            if (!newSymbols.count(_name)) {
+                newSymbols.insert({_name, {symbol, JITSymbolFlags::Exported}});
+            }
+#else
+            auto symbol = llvm::JITEvaluatedSymbol::fromPointer(iter.second.address);
+            if (!newSymbols.count(name)) {
+                newSymbols.insert({name, symbol});
+            }
+            if (!newSymbols.count(_name)) {
+                newSymbols.insert({_name, symbol});
+            }
+#endif
+        }
+    }
+    auto err = JIT.getMainJITDylib().define(orc::absoluteSymbols(std::move(newSymbols)));
+    internal_assert(!err) << llvm::toString(std::move(err)) << "\n";
+}
+
+// Retrieve function pointers for the entrypoints and requested exports
+// (which also triggers compilation).
+std::map<std::string, JITModule::Symbol> get_exports(llvm::orc::LLJIT &JIT, const string &function_name,
+                                                     const std::vector<std::string> &requested_exports) {
+    std::map<std::string, JITModule::Symbol> exports;
+    if (!function_name.empty()) {
+        exports[function_name] = compile_and_get_function(JIT, function_name);
+        exports[function_name + "_argv"] = compile_and_get_function(JIT, function_name + "_argv");
+    }
+    for (const auto &requested_export : requested_exports) {
+        exports[requested_export] = compile_and_get_function(JIT, requested_export);
+    }
+    return exports;
+}
+
+// The printed IR rounds float constants, so the JIT disk cache key
+// includes their exact bits as well.
+class GetFloatConstantBits : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+
+    void visit(const FloatImm *op) override {
+        bits << reinterpret_bits<uint64_t>(op->value) << " ";
+    }
+
+public:
+    std::ostringstream bits;
+};
+
+// Everything about a module that the printed IR leaves out but that
+// affects the code LLVM generates for it.
+void print_jit_cache_key_details(std::ostream &key, const Module &m) {
+    for (const auto &s : m.submodules()) {
+        print_jit_cache_key_details(key, s);
+    }
+    key << "any_strict_float " << m.any_strict_float() << "\n";
+    for (const auto &b : m.buffers()) {
+        key << "buffer " << b.name() << " " << b.type() << " " << b.dimensions() << "\n";
+        if (b.data()) {
+            key.write((const char *)b.data(), b.size_in_bytes());
+        }
+        key << "\n";
+    }
+    GetFloatConstantBits floats;
+    for (const auto &f : m.functions()) {
+        key << "func " << f.name << " " << (int)f.name_mangling << "\n";
+        for (const auto &arg : f.args) {
+            key << "arg " << arg.name << " " << (int)arg.kind << " " << arg.type
+                << " " << (int)arg.dimensions
+                << " " << arg.alignment.modulus << " " << arg.alignment.remainder << "\n";
+        }
+        f.body.accept(&floats);
+    }
+    key << "floats " << floats.bits.str() << "\n";
+}
+
+// Extern calls in the IR, whose names the object code links against.
+class GetExternCallNames : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+
+    void visit(const Call *op) override {
+        IRGraphVisitor::visit(op);
+        if (op->call_type == Call::Extern ||
+            op->call_type == Call::ExternCPlusPlus ||
+            op->call_type == Call::PureExtern) {
+            names.insert(op->name);
+        }
+    }
+
+public:
+    std::set<std::string> names;
+};
+
+// The symbols a module's object code exports or imports. Unlike the
+// rest of the key, these are compared verbatim.
+void print_jit_cache_key_symbols(std::ostream &key, const Module &m) {
+    for (const auto &s : m.submodules()) {
+        print_jit_cache_key_symbols(key, s);
+    }
+    GetExternCallNames externs;
+    for (const auto &f : m.functions()) {
+        if (f.linkage != LinkageType::Internal) {
+            key << "export " << f.name << "\n";
+        }
+        f.body.accept(&externs);
+    }
+    for (const auto &name : externs.names) {
+        key << "import " << name << "\n";
+    }
+}
+
+// Renumber the names made by unique_name (like "t123" or "f$4") in
+// order of first appearance, so that the key doesn't depend on how
+// many names the process made before it compiled this module. String
+// constants are left alone.
+std::string canonicalize_unique_names(const std::string &text) {
+    std::map<std::string, std::map<std::string, int>> renumbering;
+    std::string result;
+    result.reserve(text.size());
+    auto is_name_char = [](char c) {
+        return isalnum((unsigned char)c) || c == '_' || c == '$';
+    };
+    auto all_digits = [](const std::string &s, size_t start) {
+        if (start >= s.size()) {
+            return false;
+        }
+        for (size_t i = start; i < s.size(); i++) {
+            if (!isdigit((unsigned char)s[i])) {
+                return false;
+            }
+        }
+        return true;
+    };
+    size_t i = 0;
+    while (i < text.size()) {
+        const char c = text[i];
+        if (c == '"') {
+            size_t end = i + 1;
+            while (end < text.size() && text[end] != '"') {
+                end += (text[end] == '\\') ? 2 : 1;
+            }
+            end = std::min(end + 1, text.size());
+            result.append(text, i, end - i);
+            i = end;
+        } else if (is_name_char(c)) {
+            size_t end = i;
+            while (end < text.size() && is_name_char(text[end])) {
+                end++;
+            }
+            const std::string word = text.substr(i, end - i);
+            const size_t dollar = word.rfind('$');
+            std::string base, number;
+            if (dollar != std::string::npos && all_digits(word, dollar + 1)) {
+                base = word.substr(0, dollar + 1);
+                number = word.substr(dollar + 1);
+            } else if (isalpha((unsigned char)word[0]) && all_digits(word, 1)) {
+                base = word.substr(0, 1);
+                number = word.substr(1);
+            }
+            if (base.empty()) {
+                result += word;
+            } else {
+                auto &numbers = renumbering[base];
+                auto it = numbers.emplace(number, (int)numbers.size()).first;
+                result += base + std::to_string(it->second);
+            }
+            i = end;
+        } else {
+            result += c;
+            i++;
+        }
+    }
+    return result;
+}
+
+// FNV-1a, which is stable across compilers and hosts.
+uint64_t fnv1a(const std::string &str, uint64_t h) {
+    for (char c : str) {
+        h = (h ^ (uint8_t)c) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+std::atomic<int> jit_disk_cache_hits{0};
+
+// An opt-in cache of JIT-compiled object code on disk, so that a
+// process compiling a pipeline some earlier process already compiled
+// can skip LLVM codegen. Enabled by setting HL_JIT_CACHE_DIR. Each
+// entry is a file holding a hash of the key (to catch collisions in
+// the file name), the llvm target triple and data layout, and the
+// object code. Once the entries add up to more than
+// HL_JIT_CACHE_MAX_SIZE bytes (1 GB by default), the least recently
+// used ones are deleted.
+class JITDiskCache : public llvm::ObjectCache {
+    std::string dir, path;
+    uint64_t check = 0;
+
+    static constexpr char magic[8] = {'H', 'L', 'J', 'I', 'T', '0', '0', '1'};
+
+public:
+    explicit JITDiskCache(const Module &m) {
+        dir = get_env_variable("HL_JIT_CACHE_DIR");
+        if (dir.empty()) {
+            return;
+        }
+
+        std::ostringstream ir;
+        // Print floats with as many digits as they need to round-trip
+        // (the exact bits are in the key details too).
+        ir.precision(std::numeric_limits<double>::max_digits10);
+        ir << m;
+        print_jit_cache_key_details(ir, m);
+
+        std::ostringstream key;
+        key << "Halide " << HALIDE_VERSION_MAJOR << "." << HALIDE_VERSION_MINOR << "." << HALIDE_VERSION_PATCH
+            << " LLVM " << LLVM_VERSION << "\n"
+            << "HL_LLVM_ARGS " << get_env_variable("HL_LLVM_ARGS") << "\n"
+            << canonicalize_unique_names(ir.str());
+        print_jit_cache_key_symbols(key, m);
+
+        const std::string k = key.str();
+        const uint64_t name_hash = fnv1a(k, 0xcbf29ce484222325ULL);
+        check = fnv1a(k, 0x84222325cbf29ce4ULL);
+
+        char name[64];
+        snprintf(name, sizeof(name), "/halide_jit_%016llx.o", (unsigned long long)name_hash);
+        path = dir + name;
+    }
+
+    bool enabled() const {
+        return !path.empty();
+    }
+
+    // Load the cached object code for the module, if there is any.
+    std::unique_ptr<llvm::MemoryBuffer> load(std::string &triple, std::string &data_layout) const {
+        auto file = llvm::MemoryBuffer::getFile(path);
+        if (!file) {
+            debug(2) << "No JIT disk cache entry at " << path << "\n";
+            return nullptr;
+        }
+        llvm::StringRef data = (*file)->getBuffer();
+        auto take = [&](size_t size, llvm::StringRef &result) {
+            if (data.size() < size) {
+                return false;
+            }
+            result = data.take_front(size);
+            data = data.drop_front(size);
+            return true;
+        };
+        auto take_size = [&](uint64_t &size) {
+            llvm::StringRef bytes;
+            if (!take(sizeof(size), bytes)) {
+                return false;
+            }
+            memcpy(&size, bytes.data(), sizeof(size));
+            return true;
+        };
+
+        llvm::StringRef m, t, d, o;
+        uint64_t c = 0, t_size = 0, d_size = 0, o_size = 0;
+        if (!take(sizeof(magic), m) ||
+            m != llvm::StringRef(magic, sizeof(magic)) ||
+            !take_size(c) ||
+            c != check ||
+            !take_size(t_size) || !take(t_size, t) ||
+            !take_size(d_size) || !take(d_size, d) ||
+            !take_size(o_size) || !take(o_size, o)) {
+            debug(1) << "Ignoring bad or mismatched JIT disk cache entry " << path << "\n";
+            return nullptr;
+        }
+        triple = t.str();
+        data_layout = d.str();
+
+        // Mark the entry as recently used.
+        int fd;
+        if (!llvm::sys::fs::openFileForRead(path, fd)) {
+            (void)llvm::sys::fs::setLastAccessAndModificationTime(fd, std::chrono::system_clock::now());
+            llvm::sys::fs::closeFile(fd);
+        }
+        jit_disk_cache_hits++;
+        return llvm::MemoryBuffer::getMemBufferCopy(o, path);
+    }
+
+    // Delete the least recently used entries until the cache fits in
+    // its size limit.
+    void trim() const {
+        uint64_t limit = 1024 * 1024 * 1024;
+        const std::string limit_str = get_env_variable("HL_JIT_CACHE_MAX_SIZE");
+        if (!limit_str.empty()) {
+            limit = std::strtoull(limit_str.c_str(), nullptr, 10);
+        }
+
+        struct Entry {
+            llvm::sys::TimePoint<> last_used;
+            uint64_t size;
+            std::string path;
+        };
+        std::vector<Entry> entries;
+        uint64_t total = 0;
+        std::error_code ec;
+        for (llvm::sys::fs::directory_iterator it(dir, ec), end; it != end && !ec; it.increment(ec)) {
+            const std::string name = llvm::sys::path::filename(it->path()).str();
+            if (!starts_with(name, "halide_jit_") || !ends_with(name, ".o")) {
+                continue;
+            }
+            llvm::sys::fs::file_status status;
+            if (llvm::sys::fs::status(it->path(), status)) {
+                continue;
+            }
+            entries.push_back({status.getLastModificationTime(), status.getSize(), it->path()});
+            total += status.getSize();
+        }
+        if (total <= limit) {
+            return;
+        }
+        std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+            return a.last_used < b.last_used;
+        });
+        for (const Entry &e : entries) {
+            if (total <= limit) {
+                break;
+            }
+            if (e.path != path && !llvm::sys::fs::remove(e.path)) {
+                debug(1) << "Evicted " << e.path << " from the JIT disk cache\n";
+                total -= e.size;
+            }
+        }
+    }
+
+    void notifyObjectCompiled(const llvm::Module *module, llvm::MemoryBufferRef object) override {
+        // Write a temporary file and rename it into place, so that
+        // other processes never see a partial entry.
+        auto tmp = llvm::sys::fs::TempFile::create(path + "-%%%%%%.tmp");
+        if (!tmp) {
+            debug(1) << "Could not add to the JIT disk cache: " << llvm::toString(tmp.takeError()) << "\n";
+            return;
+        }
+        {
+            llvm::raw_fd_ostream out(tmp->FD, /* shouldClose */ false);
+            auto write = [&](llvm::StringRef bytes, bool with_size) {
+                if (with_size) {
+                    const uint64_t size = bytes.size();
+                    out.write((const char *)&size, sizeof(size));
+                }
+                out << bytes;
+            };
+            write(llvm::StringRef(magic, sizeof(magic)), false);
+            out.write((const char *)&check, sizeof(check));
+            write(module->getTargetTriple(), true);
+            write(module->getDataLayoutStr(), true);
+            write(object.getBuffer(), true);
+        }
+        if (auto err = tmp->keep(path)) {
+            debug(1) << "Could not add to the JIT disk cache: " << llvm::toString(std::move(err)) << "\n";
+        } else {
+            debug(1) << "Added " << path << " to the JIT disk cache\n";
+            trim();
+        }
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *) override {
+        return nullptr;
+    }
+};
+
 }  // namespace
 
 JITModule::JITModule() {
     jit_module = new JITModuleContents();
 }
 
+int JITModule::disk_cache_hits() {
+    return jit_disk_cache_hits;
+}
+
 JITModule::JITModule(const Module &m, const LoweredFunc &fn,
                      const std::vector<JITModule> &dependencies) {
     jit_module = new JITModuleContents();
-    std::unique_ptr<llvm::Module> llvm_module(compile_module_to_llvm_module(m, *jit_module->context));
     std::vector<JITModule> deps_with_runtime = dependencies;
+
+    JITDiskCache disk_cache(m);
+    std::string triple, data_layout;
+    std::unique_ptr<llvm::MemoryBuffer> object;
+    if (disk_cache.enabled()) {
+        object = disk_cache.load(triple, data_layout);
+    }
+    if (object) {
+        debug(1) << "Loaded " << fn.name << " from the JIT disk cache\n";
+        // The shared runtime takes its target options from the first
+        // llvm module it's given, so if there's no runtime yet, make
+        // one from an empty module for the target.
+        std::unique_ptr<llvm::Module> options_module;
+        if (JITSharedRuntime::get(nullptr, m.target(), false).empty()) {
+            options_module = compile_module_to_llvm_module(Module(fn.name, m.target()), *jit_module->context);
+        }
+        std::vector<JITModule> shared_runtime = JITSharedRuntime::get(options_module.get(), m.target());
+        deps_with_runtime.insert(deps_with_runtime.end(), shared_runtime.begin(), shared_runtime.end());
+        compile_object(std::move(object), triple, data_layout, fn.name, m.target(), deps_with_runtime);
+        return;
+    }
+
+    std::unique_ptr<llvm::Module> llvm_module(compile_module_to_llvm_module(m, *jit_module->context));
     std::vector<JITModule> shared_runtime = JITSharedRuntime::get(llvm_module.get(), m.target());
     deps_with_runtime.insert(deps_with_runtime.end(), shared_runtime.begin(), shared_runtime.end());
-    compile_module(std::move(llvm_module), fn.name, m.target(), deps_with_runtime);
+    // Object code loaded from the cache has no static constructors or
+    // destructors run, so don't cache modules that have any.
+    const bool cacheable = disk_cache.enabled() &&
+                           !llvm_module->getNamedGlobal("llvm.global_ctors") &&
+                           !llvm_module->getNamedGlobal("llvm.global_dtors");
+    compile_module(std::move(llvm_module), fn.name, m.target(), deps_with_runtime, {},
+                   cacheable ? &disk_cache : nullptr);
     // If -time-passes is in HL_LLVM_ARGS, this will print llvm passes time statstics otherwise its no-op.
     llvm::reportAndResetTimings();
 }
 
 void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &function_name, const Target &target,
                                const std::vector<JITModule> &dependencies,
-                               const std::vector<std::string> &requested_exports) {
+                               const std::vector<std::string> &requested_exports,
+                               llvm::ObjectCache *object_cache) {
 
     // Ensure that LLVM is initialized
     CodeGen_LLVM::initialize_llvm();
@@ -345,30 +788,13 @@ void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &fu
     // Create LLJIT
     const auto compilerBuilder = [&](const llvm::orc::JITTargetMachineBuilder & /*jtmb*/)
         -> llvm::Expected<std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
-        return std::make_unique<llvm::orc::TMOwningSimpleCompiler>(std::move(*tm));
+        return std::make_unique<llvm::orc::TMOwningSimpleCompiler>(std::move(*tm), object_cache);
     };
 
-    llvm::orc::LLJITBuilderState::ObjectLinkingLayerCreator linkerBuilder;
-    if ((target.arch == Target::Arch::X86 && target.bits == 32) ||
-        (target.arch == Target::Arch::ARM && target.bits == 32)) {
-        // Fallback to RTDyld-based linking to workaround errors:
-        // i386: "JIT session error: Unsupported i386 relocation:4" (R_386_PLT32)
-        // ARM 32bit: Unsupported target machine architecture in ELF object shared runtime-jitted-objectbuffer
-        linkerBuilder = [&](llvm::orc::ExecutionSession &session, const llvm::Triple &) {
-            return std::make_unique<llvm::orc::RTDyldObjectLinkingLayer>(session, [&]() {
-                return std::make_unique<HalideJITMemoryManager>(dependencies);
-            });
-        };
-    } else {
-        linkerBuilder = [](llvm::orc::ExecutionSession &session, const llvm::Triple &) {
-            return std::make_unique<llvm::orc::ObjectLinkingLayer>(session);
-        };
-    }
-
     auto JIT = llvm::cantFail(llvm::orc::LLJITBuilder()
                                   .setDataLayout(target_data_layout)
                                   .setCompileFunctionCreator(compilerBuilder)
-                                  .setObjectLinkingLayerCreator(linkerBuilder)
+                                  .setObjectLinkingLayerCreator(make_linker(target, dependencies))
                                   .create());
 
     auto ctors = llvm::orc::getConstructors(*m);
@@ -379,74 +805,64 @@ void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &fu
     auto dtorRunner = std::make_unique<llvm::orc::CtorDtorRunner>(JIT->getMainJITDylib());
     dtorRunner->add(dtors);
 
-    // Resolve system symbols (like pthread, dl and others)
-    auto gen = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(target_data_layout.getGlobalPrefix());
-    internal_assert(gen) << llvm::toString(gen.takeError()) << "\n";
-    JIT->getMainJITDylib().addGenerator(std::move(gen.get()));
+    add_external_symbols(*JIT, target_data_layout, dependencies);
 
     llvm::orc::ThreadSafeModule tsm(std::move(m), std::move(jit_module->context));
     auto err = JIT->addIRModule(std::move(tsm));
     internal_assert(!err) << llvm::toString(std::move(err)) << "\n";
 
-    // Resolve symbol dependencies
-    llvm::orc::SymbolMap newSymbols;
-    auto symbolStringPool = JIT->getExecutionSession().getExecutorProcessControl().getSymbolStringPool();
-    for (const auto &module : dependencies) {
-        for (auto const &iter : module.exports()) {
-            orc::SymbolStringPtr name = symbolStringPool->intern(iter.first);
-            orc::SymbolStringPtr _name = symbolStringPool->intern("_" + iter.first);
-#if LLVM_VERSION >= 170
-            auto symbol = llvm::orc::ExecutorAddr::fromPtr(iter.second.address);
-            if (!newSymbols.count(name)) {
-                newSymbols.insert({name, {symbol, JITSymbolFlags::Exported}});
-            }
-            if (!newSymbols.count(_name)) {
-                newSymbols.insert({_name, {symbol, JITSymbolFlags::Exported}});
-            }
-#else
-            auto symbol = llvm::JITEvaluatedSymbol::fromPointer(iter.second.address);
-            if (!newSymbols.count(name)) {
-                newSymbols.insert({name, symbol});
-            }
-            if (!newSymbols.count(_name)) {
-                newSymbols.insert({_name, symbol});
-            }
-#endif
-        }
-    }
-    err = JIT->getMainJITDylib().define(orc::absoluteSymbols(std::move(newSymbols)));
-    internal_assert(!err) << llvm::toString(std::move(err)) << "\n";
-
-    // Retrieve function pointers from the compiled module (which also
-    // triggers compilation)
     debug(1) << "JIT compiling " << module_name
              << " for " << target.to_string() << "\n";
 
-    std::map<std::string, Symbol> exports;
+    std::map<std::string, Symbol> exports = get_exports(*JIT, function_name, requested_exports);
+
+    err = ctorRunner.run();
+    internal_assert(!err) << llvm::toString(std::move(err)) << "\n";
 
-    Symbol entrypoint;
-    Symbol argv_entrypoint;
+    // Stash the various objects that need to stay alive behind a reference-counted pointer.
+    jit_module->exports = exports;
+    jit_module->JIT = std::move(JIT);
+    jit_module->dtorRunner = std::move(dtorRunner);
+    jit_module->dependencies = dependencies;
     if (!function_name.empty()) {
-        entrypoint = compile_and_get_function(*JIT, function_name);
-        exports[function_name] = entrypoint;
-        argv_entrypoint = compile_and_get_function(*JIT, function_name + "_argv");
-        exports[function_name + "_argv"] = argv_entrypoint;
+        jit_module->entrypoint = exports[function_name];
+        jit_module->argv_entrypoint = exports[function_name + "_argv"];
     }
+    jit_module->name = function_name;
+}
 
-    for (const auto &requested_export : requested_exports) {
-        exports[requested_export] = compile_and_get_function(*JIT, requested_export);
-    }
+void JITModule::compile_object(std::unique_ptr<llvm::MemoryBuffer> object,
+                               const string &triple, const string &data_layout,
+                               const string &function_name, const Target &target,
+                               const std::vector<JITModule> &dependencies) {
+    // Ensure that LLVM is initialized
+    CodeGen_LLVM::initialize_llvm();
 
-    err = ctorRunner.run();
+    DataLayout target_data_layout(data_layout);
+    auto JIT = llvm::cantFail(llvm::orc::LLJITBuilder()
+                                  .setJITTargetMachineBuilder(llvm::orc::JITTargetMachineBuilder(llvm::Triple(triple)))
+                                  .setDataLayout(target_data_layout)
+                                  .setObjectLinkingLayerCreator(make_linker(target, dependencies))
+                                  .create());
+
+    add_external_symbols(*JIT, target_data_layout, dependencies);
+
+    auto err = JIT->addObjectFile(std::move(object));
     internal_assert(!err) << llvm::toString(std::move(err)) << "\n";
 
-    // Stash the various objects that need to stay alive behind a reference-counted pointer.
+    debug(1) << "JIT linking " << function_name
+             << " for " << target.to_string() << "\n";
+
+    std::map<std::string, Symbol> exports = get_exports(*JIT, function_name, {});
+
     jit_module->exports = exports;
+    jit_module->dtorRunner = std::make_unique<llvm::orc::CtorDtorRunner>(JIT->getMainJITDylib());
     jit_module->JIT = std::move(JIT);
-    jit_module->dtorRunner = std::move(dtorRunner);
     jit_module->dependencies = dependencies;
-    jit_module->entrypoint = entrypoint;
-    jit_module->argv_entrypoint = argv_entrypoint;
+    if (!function_name.empty()) {
+        jit_module->entrypoint = exports[function_name];
+        jit_module->argv_entrypoint = exports[function_name + "_argv"];
+    }
     jit_module->name = function_name;
 }
 
@@ -561,6 +977,53 @@ void JITModule::memoization_cache_evict(uint64_t eviction_key) const {
     }
 }
 
+void JITModule::memoization_cache_set_policy(halide_memoization_cache_policy_t policy) const {
+    std::map<std::string, Symbol>::const_iterator f =
+        exports().find("halide_memoization_cache_set_policy");
+    if (f != exports().end()) {
+        (reinterpret_bits<void (*)(halide_memoization_cache_policy_t)>(f->second.address))(policy);
+    }
+}
+
+void JITModule::memoization_cache_set_pipeline_quota(const std::string &pipeline_name, int64_t size) const {
+    std::map<std::string, Symbol>::const_iterator f =
+        exports().find("halide_memoization_cache_set_pipeline_quota");
+    if (f != exports().end()) {
+        int result = (reinterpret_bits<int (*)(const char *, int64_t)>(f->second.address))(pipeline_name.c_str(), size);
+        user_assert(result == 0) << "Could not set a memoization cache quota for " << pipeline_name
+                                 << ": too many pipelines already have quotas.\n";
+    }
+}
+
+void JITModule::memoization_cache_set_file(const std::string &filename, int64_t size) const {
+    std::map<std::string, Symbol>::const_iterator f =
+        exports().find("halide_memoization_cache_set_file");
+    if (f != exports().end()) {
+        int result = (reinterpret_bits<int (*)(void *, const char *, int64_t)>(f->second.address))(nullptr, filename.c_str(), size);
+        user_assert(result == 0) << "Could not use " << filename << " as the memoization cache file.\n";
+    }
+}
+
+halide_memoization_cache_stats_t JITModule::memoization_cache_get_stats(std::vector<halide_memoization_cache_func_stats_t> *func_stats) const {
+    halide_memoization_cache_stats_t stats = {};
+    std::map<std::string, Symbol>::const_iterator f =
+        exports().find("halide_memoization_cache_get_stats");
+    if (f != exports().end()) {
+        auto get_stats = reinterpret_bits<int (*)(halide_memoization_cache_stats_t *, halide_memoization_cache_func_stats_t *, int)>(f->second.address);
+        get_stats(&stats, nullptr, 0);
+        if (func_stats) {
+            // Funcs may be added between the two calls; get_stats
+            // fills at most as many as there is room for.
+            func_stats->resize(stats.num_funcs);
+            get_stats(&stats, func_stats->data(), (int)func_stats->size());
+            func_stats->resize(std::min((size_t)stats.num_funcs, func_stats->size()));
+        }
+    } else if (func_stats) {
+        func_stats->clear();
+    }
+    return stats;
+}
+
 void JITModule::reuse_device_allocations(bool b) const {
     std::map<std::string, Symbol>::const_iterator f =
         exports().find("halide_reuse_device_allocations");
@@ -579,6 +1042,9 @@ JITHandlers runtime_internal_handlers;
 JITHandlers default_handlers;
 JITHandlers active_handlers;
 int64_t default_cache_size;
+halide_memoization_cache_policy_t default_cache_policy = halide_memoization_cache_policy_lru;
+std::string default_cache_file;
+int64_t default_cache_file_size;
 
 void merge_handlers(JITHandlers &base, const JITHandlers &addins) {
     if (addins.custom_print) {
@@ -596,6 +1062,9 @@ void merge_handlers(JITHandlers &base, const JITHandlers &addins) {
     if (addins.custom_do_par_for) {
         base.custom_do_par_for = addins.custom_do_par_for;
     }
+    if (addins.custom_get_thread_pool) {
+        base.custom_get_thread_pool = addins.custom_get_thread_pool;
+    }
     if (addins.custom_error) {
         base.custom_error = addins.custom_error;
     }
@@ -664,6 +1133,14 @@ int do_par_for_handler(JITUserContext *context, int (*f)(JITUserContext *, int,
     }
 }
 
+halide_thread_pool_t *get_thread_pool_handler(JITUserContext *context) {
+    if (context && context->handlers.custom_get_thread_pool) {
+        return context->handlers.custom_get_thread_pool(context);
+    } else {
+        return active_handlers.custom_get_thread_pool(context);
+    }
+}
+
 void error_handler_handler(JITUserContext *context, const char *msg) {
     if (context && context->handlers.custom_error) {
         context->handlers.custom_error(context, msg);
@@ -935,6 +1412,9 @@ JITModule &make_module(llvm::Module *for_module, Target target,
             runtime_internal_handlers.custom_do_par_for =
                 hook_function(runtime.exports(), "halide_set_custom_do_par_for", do_par_for_handler);
 
+            runtime_internal_handlers.custom_get_thread_pool =
+                hook_function(runtime.exports(), "halide_set_custom_get_thread_pool", get_thread_pool_handler);
+
             runtime_internal_handlers.custom_error =
                 hook_function(runtime.exports(), "halide_set_error_handler", error_handler_handler);
 
@@ -956,6 +1436,12 @@ JITModule &make_module(llvm::Module *for_module, Target target,
             if (default_cache_size != 0) {
                 runtime.memoization_cache_set_size(default_cache_size);
             }
+            if (default_cache_policy != halide_memoization_cache_policy_lru) {
+                runtime.memoization_cache_set_policy(default_cache_policy);
+            }
+            if (!default_cache_file.empty()) {
+                runtime.memoization_cache_set_file(default_cache_file, default_cache_file_size);
+            }
 
             runtime.jit_module->name = "MainShared";
         } else {
@@ -1139,6 +1625,32 @@ void JITSharedRuntime::memoization_cache_evict(uint64_t eviction_key) {
     shared_runtimes(MainShared).memoization_cache_evict(eviction_key);
 }
 
+void JITSharedRuntime::memoization_cache_set_policy(halide_memoization_cache_policy_t policy) {
+    std::lock_guard<std::mutex> lock(shared_runtimes_mutex);
+
+    if (policy != default_cache_policy) {
+        default_cache_policy = policy;
+        shared_runtimes(MainShared).memoization_cache_set_policy(policy);
+    }
+}
+
+void JITSharedRuntime::memoization_cache_set_pipeline_quota(const std::string &pipeline_name, int64_t size) {
+    std::lock_guard<std::mutex> lock(shared_runtimes_mutex);
+    shared_runtimes(MainShared).memoization_cache_set_pipeline_quota(pipeline_name, size);
+}
+
+void JITSharedRuntime::memoization_cache_set_file(const std::string &filename, int64_t size) {
+    std::lock_guard<std::mutex> lock(shared_runtimes_mutex);
+    default_cache_file = filename;
+    default_cache_file_size = size;
+    shared_runtimes(MainShared).memoization_cache_set_file(filename, size);
+}
+
+halide_memoization_cache_stats_t JITSharedRuntime::memoization_cache_get_stats(std::vector<halide_memoization_cache_func_stats_t> *func_stats) {
+    std::lock_guard<std::mutex> lock(shared_runtimes_mutex);
+    return shared_runtimes(MainShared).memoization_cache_get_stats(func_stats);
+}
+
 void JITSharedRuntime::reuse_device_allocations(bool b) {
     std::lock_guard<std::mutex> lock(shared_runtimes_mutex);
     shared_runtimes(MainShared).reuse_device_allocations(b);
@@ -1193,7 +1705,9 @@ int JITCache::call_jit_code(const Target &target, const void *const *args) {
 
 void JITCache::finish_profiling(JITUserContext *context) {
     // If we're profiling, report runtimes and reset profiler stats.
-    if (jit_target.has_feature(Target::Profile) || jit_target.has_feature(Target::ProfileByTimer)) {
+    if (jit_target.has_feature(Target::Profile) ||
+        jit_target.has_feature(Target::ProfileByTimer) ||
+        jit_target.has_feature(Target::ProfileInstrumented)) {
         JITModule::Symbol report_sym = jit_module.find_symbol_by_name("halide_profiler_report");
         JITModule::Symbol reset_sym = jit_module.find_symbol_by_name("halide_profiler_reset");
         if (report_sym.address && reset_sym.address) {
@@ -1261,6 +1775,7 @@ JITFuncCallContext::JITFuncCallContext(JITUserContext *context, const JITHandler
              << "custom_free: " << (void *)context->handlers.custom_free << "\n"
              << "custom_do_task: " << (void *)context->handlers.custom_do_task << "\n"
              << "custom_do_par_for: " << (void *)context->handlers.custom_do_par_for << "\n"
+             << "custom_get_thread_pool: " << (void *)context->handlers.custom_get_thread_pool << "\n"
              << "custom_error: " << (void *)context->handlers.custom_error << "\n"
              << "custom_trace: " << (void *)context->handlers.custom_trace << "\n";
 }
@@ -17,7 +17,9 @@
 #include "runtime/HalideRuntime.h"
 
 namespace llvm {
+class MemoryBuffer;
 class Module;
+class ObjectCache;
 }
 
 namespace Halide {
@@ -84,6 +86,13 @@ struct JITHandlers {
      */
     int (*custom_do_par_for)(JITUserContext *, int (*)(JITUserContext *, int, uint8_t *), int, int, uint8_t *){nullptr};
 
+    /** Choose the thread pool that the default parallel runtime uses
+     * for a call. Return a pool made with halide_thread_pool_create,
+     * or nullptr for the default pool. Setting this in the handlers
+     * of a JITUserContext lets different pipelines, or different
+     * calls of the same pipeline, run on separate pools. */
+    halide_thread_pool_t *(*custom_get_thread_pool)(JITUserContext *){nullptr};
+
     /** The error handler function that be called in the case of
      * runtime errors during halide pipelines. */
     void (*custom_error)(JITUserContext *, const char *){nullptr};
@@ -155,9 +164,25 @@ struct JITModule {
     };
 
     JITModule();
+
+    /** Compile a lowered Halide module. If the environment variable
+     * HL_JIT_CACHE_DIR names a writable directory, the object code is
+     * also cached there, keyed by a hash of the lowered module, the
+     * target, and the Halide and LLVM versions. Later processes that
+     * compile the same module load it from there instead of running
+     * LLVM codegen. Names made by unique_name are renumbered in the
+     * key, so they don't stop other processes from finding the
+     * entry. The least recently used entries are deleted once the
+     * cache holds more than HL_JIT_CACHE_MAX_SIZE bytes (1 GB by
+     * default). Entries are not invalidated when Halide changes, so
+     * clear the cache by hand when working on Halide itself. */
     JITModule(const Module &m, const LoweredFunc &fn,
               const std::vector<JITModule> &dependencies = std::vector<JITModule>());
 
+    /** The number of modules this process has loaded from the JIT disk
+     * cache instead of compiling. */
+    static int disk_cache_hits();
+
     /** Take a list of JITExterns and generate trampoline functions
      * which can be called dynamically via a function pointer that
      * takes an array of void *'s for each argument and the return
@@ -232,11 +257,20 @@ struct JITModule {
     Symbol find_symbol_by_name(const std::string &) const;
 
     /** Take an llvm module and compile it. The requested exports will
-        be available via the exports method. */
+        be available via the exports method. If an object cache is
+        given, it's passed the object code once it's compiled. */
     void compile_module(std::unique_ptr<llvm::Module> mod,
                         const std::string &function_name, const Target &target,
                         const std::vector<JITModule> &dependencies = std::vector<JITModule>(),
-                        const std::vector<std::string> &requested_exports = std::vector<std::string>());
+                        const std::vector<std::string> &requested_exports = std::vector<std::string>(),
+                        llvm::ObjectCache *object_cache = nullptr);
+
+    /** Link object code previously compiled by compile_module for the
+     * given llvm target triple and data layout. */
+    void compile_object(std::unique_ptr<llvm::MemoryBuffer> object,
+                        const std::string &triple, const std::string &data_layout,
+                        const std::string &function_name, const Target &target,
+                        const std::vector<JITModule> &dependencies = std::vector<JITModule>());
 
     /** See JITSharedRuntime::memoization_cache_set_size */
     void memoization_cache_set_size(int64_t size) const;
@@ -244,6 +278,18 @@ struct JITModule {
     /** See JITSharedRuntime::memoization_cache_evict */
     void memoization_cache_evict(uint64_t eviction_key) const;
 
+    /** See JITSharedRuntime::memoization_cache_set_policy */
+    void memoization_cache_set_policy(halide_memoization_cache_policy_t policy) const;
+
+    /** See JITSharedRuntime::memoization_cache_set_pipeline_quota */
+    void memoization_cache_set_pipeline_quota(const std::string &pipeline_name, int64_t size) const;
+
+    /** See JITSharedRuntime::memoization_cache_set_file */
+    void memoization_cache_set_file(const std::string &filename, int64_t size) const;
+
+    /** See JITSharedRuntime::memoization_cache_get_stats */
+    halide_memoization_cache_stats_t memoization_cache_get_stats(std::vector<halide_memoization_cache_func_stats_t> *func_stats) const;
+
     /** See JITSharedRuntime::reuse_device_allocations */
     void reuse_device_allocations(bool) const;
 
@@ -271,6 +317,40 @@ public:
      */
     static void memoization_cache_evict(uint64_t eviction_key);
 
+    /** Set the policy used to choose memoization cache entries to
+     * evict. If you are compiling statically, you should include
+     * HalideRuntime.h and call halide_memoization_cache_set_policy()
+     * instead.
+     */
+    static void memoization_cache_set_policy(halide_memoization_cache_policy_t policy);
+
+    /** Limit the number of bytes of memoization cache used by the
+     * pipeline with the given name, which for JIT compilation is the
+     * name of the output Func. A size of zero removes the limit. If
+     * you are compiling statically, you should include HalideRuntime.h
+     * and call halide_memoization_cache_set_pipeline_quota() instead.
+     */
+    static void memoization_cache_set_pipeline_quota(const std::string &pipeline_name, int64_t size);
+
+    /** Back the memoization cache with a memory-mapped file of the
+     * given size (zero means 64MB) that is shared with other processes
+     * using the same file. Entries are keyed by the definitions of the
+     * memoized Funcs and the Buffers embedded in them, but not by
+     * extern code or input buffers beyond their memoize_tag; see
+     * halide_memoization_cache_set_file for details. If you are
+     * compiling statically, you should include HalideRuntime.h and
+     * call halide_memoization_cache_set_file() instead.
+     */
+    static void memoization_cache_set_file(const std::string &filename, int64_t size = 0);
+
+    /** Get the counters for the memoization cache, and if func_stats
+     * is not null, for each Func that has used it. The names in
+     * func_stats are valid until the cache is cleaned up. If you are
+     * compiling statically, you should include HalideRuntime.h and call
+     * halide_memoization_cache_get_stats() instead.
+     */
+    static halide_memoization_cache_stats_t memoization_cache_get_stats(std::vector<halide_memoization_cache_func_stats_t> *func_stats = nullptr);
+
     /** Set whether or not Halide may hold onto and reuse device
      * allocations to avoid calling expensive device API allocation
      * functions. If you are compiling statically, you should include
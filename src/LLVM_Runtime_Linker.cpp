@@ -87,7 +87,13 @@ DECLARE_CPP_INITMOD(cuda)
 DECLARE_CPP_INITMOD(destructors)
 DECLARE_CPP_INITMOD(device_interface)
 DECLARE_CPP_INITMOD(errors)
+DECLARE_CPP_INITMOD(fake_cycle_counter)
+DECLARE_CPP_INITMOD(fake_flight_recorder)
 DECLARE_CPP_INITMOD(fake_get_symbol)
+DECLARE_CPP_INITMOD(fake_huge_page)
+DECLARE_CPP_INITMOD(fake_map_file)
+DECLARE_CPP_INITMOD(fake_numa)
+DECLARE_CPP_INITMOD(fake_perf_counters)
 DECLARE_CPP_INITMOD(fake_thread_pool)
 DECLARE_CPP_INITMOD(float16_t)
 DECLARE_CPP_INITMOD(fopen)
@@ -105,6 +111,9 @@ DECLARE_CPP_INITMOD(hexagon_host)
 DECLARE_CPP_INITMOD(ios_io)
 DECLARE_CPP_INITMOD(linux_clock)
 DECLARE_CPP_INITMOD(linux_host_cpu_count)
+DECLARE_CPP_INITMOD(linux_huge_page)
+DECLARE_CPP_INITMOD(linux_numa)
+DECLARE_CPP_INITMOD(linux_perf_counters)
 DECLARE_CPP_INITMOD(linux_yield)
 DECLARE_CPP_INITMOD(module_aot_ref_count)
 DECLARE_CPP_INITMOD(module_jit_ref_count)
@@ -119,12 +128,15 @@ DECLARE_CPP_INITMOD(osx_get_symbol)
 DECLARE_CPP_INITMOD(osx_host_cpu_count)
 DECLARE_CPP_INITMOD(osx_opengl_context)
 DECLARE_CPP_INITMOD(osx_yield)
+DECLARE_CPP_INITMOD(pooled_allocator)
+DECLARE_CPP_INITMOD(pooled_allocator_default)
 DECLARE_CPP_INITMOD(posix_aligned_alloc)
 DECLARE_CPP_INITMOD(posix_allocator)
 DECLARE_CPP_INITMOD(posix_clock)
 DECLARE_CPP_INITMOD(posix_error_handler)
 DECLARE_CPP_INITMOD(posix_get_symbol)
 DECLARE_CPP_INITMOD(posix_io)
+DECLARE_CPP_INITMOD(posix_map_file)
 DECLARE_CPP_INITMOD(posix_print)
 DECLARE_CPP_INITMOD(posix_threads)
 DECLARE_CPP_INITMOD(posix_threads_tsan)
@@ -140,6 +152,7 @@ DECLARE_CPP_INITMOD(qurt_threads)
 DECLARE_CPP_INITMOD(qurt_threads_tsan)
 DECLARE_CPP_INITMOD(qurt_yield)
 DECLARE_CPP_INITMOD(runtime_api)
+DECLARE_CPP_INITMOD(scratch_arena)
 DECLARE_CPP_INITMOD(timer_profiler)
 DECLARE_CPP_INITMOD(to_string)
 DECLARE_CPP_INITMOD(trace_helper)
@@ -754,6 +767,9 @@ std::unique_ptr<llvm::Module> link_with_wasm_jit_runtime(llvm::LLVMContext *c, c
     modules.push_back(get_initmod_fake_thread_pool(c, bits_64, debug));
     modules.push_back(get_initmod_posix_aligned_alloc(c, bits_64, debug));
     modules.push_back(get_initmod_posix_allocator(c, bits_64, debug));
+    modules.push_back(get_initmod_pooled_allocator(c, bits_64, debug));
+    modules.push_back(get_initmod_scratch_arena(c, bits_64, debug));
+    modules.push_back(get_initmod_fake_huge_page(c, bits_64, debug));
     modules.push_back(get_initmod_halide_buffer_t(c, bits_64, debug));
     modules.push_back(get_initmod_destructors(c, bits_64, debug));
     // These two aren't necessary, since they are 100% alwaysinline
@@ -761,6 +777,7 @@ std::unique_ptr<llvm::Module> link_with_wasm_jit_runtime(llvm::LLVMContext *c, c
     // modules.push_back(get_initmod_wasm_math_ll(c));
     modules.push_back(get_initmod_tracing(c, bits_64, debug));
     modules.push_back(get_initmod_cache(c, bits_64, debug));
+    modules.push_back(get_initmod_fake_map_file(c, bits_64, debug));
     modules.push_back(get_initmod_to_string(c, bits_64, debug));
     modules.push_back(get_initmod_alignment_32(c, bits_64, debug));
     modules.push_back(get_initmod_fopen(c, bits_64, debug));
@@ -815,6 +832,10 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
     const auto add_allocator = [&]() {
         modules.push_back(get_initmod_posix_aligned_alloc(c, bits_64, debug));
         modules.push_back(get_initmod_posix_allocator(c, bits_64, debug));
+        modules.push_back(get_initmod_pooled_allocator(c, bits_64, debug));
+        if (t.has_feature(Target::PooledMalloc)) {
+            modules.push_back(get_initmod_pooled_allocator_default(c, bits_64, debug));
+        }
     };
 
     if (module_type != ModuleGPU) {
@@ -833,6 +854,8 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                 modules.push_back(get_initmod_posix_io(c, bits_64, debug));
                 modules.push_back(get_initmod_linux_host_cpu_count(c, bits_64, debug));
                 modules.push_back(get_initmod_linux_yield(c, bits_64, debug));
+                modules.push_back(get_initmod_linux_numa(c, bits_64, debug));
+                modules.push_back(get_initmod_posix_map_file(c, bits_64, debug));
                 if (tsan) {
                     modules.push_back(get_initmod_posix_threads_tsan(c, bits_64, debug));
                 } else {
@@ -850,9 +873,11 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                 if (t.has_feature(Target::WasmThreads)) {
                     // Assume that the wasm libc will be providing pthreads
                     modules.push_back(get_initmod_posix_threads(c, bits_64, debug));
+                    modules.push_back(get_initmod_fake_numa(c, bits_64, debug));
                 } else {
                     modules.push_back(get_initmod_fake_thread_pool(c, bits_64, debug));
                 }
+                modules.push_back(get_initmod_fake_map_file(c, bits_64, debug));
                 modules.push_back(get_initmod_fake_get_symbol(c, bits_64, debug));
             } else if (t.os == Target::OSX) {
                 add_allocator();
@@ -862,6 +887,8 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                 modules.push_back(get_initmod_posix_io(c, bits_64, debug));
                 modules.push_back(get_initmod_osx_host_cpu_count(c, bits_64, debug));
                 modules.push_back(get_initmod_osx_yield(c, bits_64, debug));
+                modules.push_back(get_initmod_fake_numa(c, bits_64, debug));
+                modules.push_back(get_initmod_posix_map_file(c, bits_64, debug));
                 if (tsan) {
                     modules.push_back(get_initmod_posix_threads_tsan(c, bits_64, debug));
                 } else {
@@ -881,6 +908,8 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                 modules.push_back(get_initmod_android_io(c, bits_64, debug));
                 modules.push_back(get_initmod_android_host_cpu_count(c, bits_64, debug));
                 modules.push_back(get_initmod_linux_yield(c, bits_64, debug));  // TODO: verify
+                modules.push_back(get_initmod_fake_numa(c, bits_64, debug));
+                modules.push_back(get_initmod_posix_map_file(c, bits_64, debug));
                 if (tsan) {
                     modules.push_back(get_initmod_posix_threads_tsan(c, bits_64, debug));
                 } else {
@@ -888,13 +917,14 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                 }
                 modules.push_back(get_initmod_posix_get_symbol(c, bits_64, debug));
             } else if (t.os == Target::Windows) {
-                modules.push_back(get_initmod_posix_aligned_alloc(c, bits_64, debug));
-                modules.push_back(get_initmod_posix_allocator(c, bits_64, debug));
+                add_allocator();
                 modules.push_back(get_initmod_posix_error_handler(c, bits_64, debug));
                 modules.push_back(get_initmod_posix_print(c, bits_64, debug));
                 modules.push_back(get_initmod_windows_clock(c, bits_64, debug));
                 modules.push_back(get_initmod_windows_io(c, bits_64, debug));
                 modules.push_back(get_initmod_windows_yield(c, bits_64, debug));
+                modules.push_back(get_initmod_fake_numa(c, bits_64, debug));
+                modules.push_back(get_initmod_fake_map_file(c, bits_64, debug));
                 if (tsan) {
                     modules.push_back(get_initmod_windows_threads_tsan(c, bits_64, debug));
                 } else {
@@ -909,6 +939,8 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                 modules.push_back(get_initmod_ios_io(c, bits_64, debug));
                 modules.push_back(get_initmod_osx_host_cpu_count(c, bits_64, debug));
                 modules.push_back(get_initmod_osx_yield(c, bits_64, debug));
+                modules.push_back(get_initmod_fake_numa(c, bits_64, debug));
+                modules.push_back(get_initmod_posix_map_file(c, bits_64, debug));
                 if (tsan) {
                     modules.push_back(get_initmod_posix_threads_tsan(c, bits_64, debug));
                 } else {
@@ -918,6 +950,8 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                 modules.push_back(get_initmod_posix_aligned_alloc(c, bits_64, debug));
                 modules.push_back(get_initmod_qurt_allocator(c, bits_64, debug));
                 modules.push_back(get_initmod_qurt_yield(c, bits_64, debug));
+                modules.push_back(get_initmod_fake_numa(c, bits_64, debug));
+                modules.push_back(get_initmod_fake_map_file(c, bits_64, debug));
                 if (tsan) {
                     modules.push_back(get_initmod_qurt_threads_tsan(c, bits_64, debug));
                 } else {
@@ -940,6 +974,7 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                     modules.push_back(get_initmod_posix_io(c, bits_64, debug));
                 }
                 modules.push_back(get_initmod_fake_thread_pool(c, bits_64, debug));
+                modules.push_back(get_initmod_fake_map_file(c, bits_64, debug));
             } else if (t.os == Target::Fuchsia) {
                 add_allocator();
                 modules.push_back(get_initmod_posix_error_handler(c, bits_64, debug));
@@ -948,6 +983,8 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                 modules.push_back(get_initmod_posix_io(c, bits_64, debug));
                 modules.push_back(get_initmod_fuchsia_host_cpu_count(c, bits_64, debug));
                 modules.push_back(get_initmod_fuchsia_yield(c, bits_64, debug));
+                modules.push_back(get_initmod_fake_numa(c, bits_64, debug));
+                modules.push_back(get_initmod_fake_map_file(c, bits_64, debug));
                 if (tsan) {
                     modules.push_back(get_initmod_posix_threads_tsan(c, bits_64, debug));
                 } else {
@@ -989,6 +1026,9 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                 // TODO: Support this module in the Hexagon backend,
                 // currently generates assert at src/HexagonOffload.cpp:279
                 modules.push_back(get_initmod_cache(c, bits_64, debug));
+            } else {
+                // halide_error still asks the flight recorder to dump.
+                modules.push_back(get_initmod_fake_flight_recorder(c, bits_64, debug));
             }
             modules.push_back(get_initmod_to_string(c, bits_64, debug));
 
@@ -1017,6 +1057,16 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
             }
 
             modules.push_back(get_initmod_allocation_cache(c, bits_64, debug));
+            modules.push_back(get_initmod_scratch_arena(c, bits_64, debug));
+            // linux_huge_page uses the mmap flag values of the generic
+            // Linux ABI, which some arches (e.g. MIPS) don't share.
+            if ((t.os == Target::Linux || t.os == Target::Android) &&
+                (t.arch == Target::X86 || t.arch == Target::ARM ||
+                 t.arch == Target::POWERPC || t.arch == Target::RISCV)) {
+                modules.push_back(get_initmod_linux_huge_page(c, bits_64, debug));
+            } else {
+                modules.push_back(get_initmod_fake_huge_page(c, bits_64, debug));
+            }
             modules.push_back(get_initmod_device_interface(c, bits_64, debug));
             modules.push_back(get_initmod_float16_t(c, bits_64, debug));
             modules.push_back(get_initmod_errors(c, bits_64, debug));
@@ -1037,6 +1087,11 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                         modules.push_back(get_initmod_profiler(c, bits_64, debug));
                     }
                 }
+                if (t.os == Target::Linux && t.arch == Target::X86) {
+                    modules.push_back(get_initmod_linux_perf_counters(c, bits_64, debug));
+                } else {
+                    modules.push_back(get_initmod_fake_perf_counters(c, bits_64, debug));
+                }
             }
 
 #ifdef HALIDE_INTERNAL_USING_MSAN
@@ -1115,6 +1170,24 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                 user_assert(t.os == Target::Linux) << "The timer based profiler currently can only be used on Linux.";
                 modules.push_back(get_initmod_profiler_inlined(c, bits_64, debug));
             }
+            if (t.has_feature(Target::ProfileInstrumented)) {
+                user_assert(!t.has_feature(Target::Profile) && !t.has_feature(Target::ProfileByTimer))
+                    << "Target::ProfileInstrumented can't be combined with Target::Profile or Target::ProfileByTimer.";
+                modules.push_back(get_initmod_profiler_inlined(c, bits_64, debug));
+            }
+            if (t.features_any_of({Target::Profile, Target::ProfileByTimer, Target::ProfileInstrumented}) &&
+                t.arch != Target::X86 && !(t.arch == Target::ARM && t.bits == 64)) {
+                // x86.ll and aarch64.ll read the cycle counter. Everything
+                // else falls back to the clock.
+                modules.push_back(get_initmod_fake_cycle_counter(c, bits_64, debug));
+            }
+            if (t.features_any_of({Target::Profile, Target::ProfileByTimer, Target::ProfileInstrumented}) &&
+                (t.os == Target::NoOS || t.os == Target::QuRT)) {
+                // profiler_inlined reports each thread's Func to the
+                // perf counter module, which the runtime above only
+                // links where there is a profiler runtime.
+                modules.push_back(get_initmod_fake_perf_counters(c, bits_64, debug));
+            }
             if (t.arch == Target::WebAssembly) {
                 modules.push_back(get_initmod_wasm_math_ll(c));
             }
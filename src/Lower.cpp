@@ -1,8 +1,18 @@
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <sstream>
+#include <unordered_set>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 
 #include "Lower.h"
 
@@ -32,6 +42,7 @@
 #include "FuseGPUThreadLoops.h"
 #include "FuzzFloatStores.h"
 #include "HexagonOffload.h"
+#include "IRHashCons.h"
 #include "IRMutator.h"
 #include "IROperator.h"
 #include "IRPrinter.h"
@@ -55,6 +66,7 @@
 #include "RemoveExternLoops.h"
 #include "RemoveUndef.h"
 #include "ScheduleFunctions.h"
+#include "ScratchArena.h"
 #include "SelectGPUAPI.h"
 #include "Simplify.h"
 #include "SimplifyCorrelatedDifferences.h"
@@ -86,11 +98,203 @@ using std::vector;
 
 namespace {
 
+// The peak resident set size of the process so far, in bytes, or zero
+// if we don't know how to get it on this platform.
+int64_t peak_rss_bytes() {
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return (int64_t)usage.ru_maxrss;
+#else
+    return (int64_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+// Count the distinct nodes in a Stmt. Counting every use of shared
+// nodes instead would take time exponential in the depth of DAG-shaped
+// IR, like nested lets after CSE.
+class CountIRNodes : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+
+    std::unordered_set<const IRNode *> seen;
+
+    void include(const Expr &e) override {
+        if (e.defined() && seen.insert(e.get()).second) {
+            e.accept(this);
+        }
+    }
+
+    void include(const Stmt &s) override {
+        if (s.defined() && seen.insert(s.get()).second) {
+            s.accept(this);
+        }
+    }
+
+public:
+    int64_t operator()(const Stmt &s) {
+        seen.clear();
+        include(s);
+        return (int64_t)seen.size();
+    }
+};
+
+struct LoweringPassStats {
+    string name;
+    // In seconds. The start time is relative to the first lowering in
+    // this process.
+    double start, duration;
+    int64_t ir_nodes_before, ir_nodes_after, peak_rss_delta;
+};
+
+std::chrono::steady_clock::time_point lowering_epoch() {
+    static const auto epoch = std::chrono::steady_clock::now();
+    return epoch;
+}
+
+string json_escape(const string &s) {
+    ostringstream o;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            o << '\\' << c;
+        } else if ((unsigned char)c < 0x20) {
+            o << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec;
+        } else {
+            o << c;
+        }
+    }
+    return o.str();
+}
+
+// The Chrome trace file named by HL_LOWERING_TRACE_FILE. It is opened
+// on the first lowering, each lowering appends its passes, and the
+// JSON array is closed when the process exits. Chrome's trace format
+// allows the closing bracket to be missing, so the file can be loaded
+// at any point, even if the process dies.
+class LoweringTraceFile {
+    std::ofstream f;
+    string filename;
+    bool empty = true;
+
+public:
+    ~LoweringTraceFile() {
+        if (f.is_open()) {
+            f << "\n]\n";
+        }
+    }
+
+    std::ostream *open(const string &name) {
+        if (name != filename) {
+            if (f.is_open()) {
+                f << "\n]\n";
+                f.close();
+            }
+            filename = name;
+            empty = true;
+            f.open(filename, std::ios::out | std::ios::trunc);
+            if (!f) {
+                user_warning << "Could not open lowering trace file " << filename << "\n";
+            }
+        }
+        return f ? &f : nullptr;
+    }
+
+    void add_event(const string &event) {
+        f << (empty ? "[\n" : ",\n") << event;
+        empty = false;
+    }
+};
+
+// Add the passes of one lowering to the Chrome trace file, with one
+// thread per lowering thread.
+void write_lowering_trace(const string &filename, const string &pipeline_name,
+                          const vector<LoweringPassStats> &passes) {
+    static std::mutex mutex;
+    static LoweringTraceFile trace;
+    static std::atomic<int> next_thread_id{0};
+    thread_local int thread_id = next_thread_id++;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ostream *f = trace.open(filename);
+    if (!f) {
+        return;
+    }
+    const string pipeline = json_escape(pipeline_name);
+    for (const LoweringPassStats &p : passes) {
+        ostringstream event;
+        event << "{\"name\": \"" << json_escape(p.name) << "\", \"cat\": \"lowering\", \"ph\": \"X\""
+              << ", \"ts\": " << (int64_t)(p.start * 1e6)
+              << ", \"dur\": " << (int64_t)(p.duration * 1e6)
+              << ", \"pid\": 0, \"tid\": " << thread_id
+              << ", \"args\": {\"pipeline\": \"" << pipeline << "\""
+              << ", \"ir_nodes_before\": " << p.ir_nodes_before
+              << ", \"ir_nodes_after\": " << p.ir_nodes_after
+              << ", \"peak_rss_delta\": " << p.peak_rss_delta << "}}";
+        trace.add_event(event.str());
+    }
+    f->flush();
+}
+
 class LoweringLogger {
     Stmt last_written;
 
+    // Per-pass statistics are only gathered if there's a
+    // CompilerLogger or a trace file to report them to, as counting IR
+    // nodes takes a while for large pipelines.
+    bool time_passes = false;
+    string trace_file;
+    std::chrono::steady_clock::time_point pass_start;
+    Stmt last_counted;
+    int64_t last_ir_nodes = 0, last_peak_rss = 0;
+    vector<LoweringPassStats> passes;
+
+    void start_pass() {
+        pass_start = std::chrono::steady_clock::now();
+    }
+
+    void end_pass(const string &name, const Stmt &s) {
+        const auto pass_end = std::chrono::steady_clock::now();
+        const int64_t peak_rss = peak_rss_bytes();
+        const int64_t ir_nodes = s.same_as(last_counted) ? last_ir_nodes : CountIRNodes()(s);
+        const std::chrono::duration<double> start = pass_start - lowering_epoch();
+        const std::chrono::duration<double> duration = pass_end - pass_start;
+        passes.push_back({name, start.count(), duration.count(),
+                          last_ir_nodes, ir_nodes, peak_rss - last_peak_rss});
+        last_counted = s;
+        last_ir_nodes = ir_nodes;
+        last_peak_rss = peak_rss;
+    }
+
 public:
+    LoweringLogger() {
+        trace_file = get_env_variable("HL_LOWERING_TRACE_FILE");
+        time_passes = get_compiler_logger() || !trace_file.empty();
+        if (time_passes) {
+            lowering_epoch();
+            last_peak_rss = peak_rss_bytes();
+            start_pass();
+        }
+    }
+
+    // Log the Stmt produced by a lowering pass. The pass is named
+    // after the message, less any "Lowering after" prefix.
     void operator()(const string &message, const Stmt &s) {
+        if (time_passes) {
+            string name = message;
+            const string prefix = "Lowering after ";
+            if (starts_with(name, prefix)) {
+                name = name.substr(prefix.size());
+            }
+            if (ends_with(name, ":")) {
+                name.pop_back();
+            }
+            end_pass(name, s);
+        }
         if (!s.same_as(last_written)) {
             debug(2) << message << "\n"
                      << s << "\n";
@@ -98,6 +302,31 @@ public:
         } else {
             debug(2) << message << " (unchanged)\n\n";
         }
+        if (time_passes) {
+            start_pass();
+        }
+    }
+
+    // Mark the end of a pass without logging the Stmt.
+    void mark(const string &name, const Stmt &s) {
+        if (time_passes) {
+            end_pass(name, s);
+            start_pass();
+        }
+    }
+
+    // Send the statistics for each pass to the CompilerLogger and the
+    // trace file, if any.
+    void report(const string &pipeline_name) {
+        if (auto *logger = get_compiler_logger()) {
+            for (const LoweringPassStats &p : passes) {
+                logger->record_lowering_pass(p.name, p.duration, p.ir_nodes_before,
+                                             p.ir_nodes_after, p.peak_rss_delta);
+            }
+        }
+        if (!trace_file.empty()) {
+            write_lowering_trace(trace_file, pipeline_name, passes);
+        }
     }
 };
 
@@ -335,7 +564,7 @@ void lower_impl(const vector<Function> &output_funcs,
     log("Lowering after rewriting vector interleavings:", s);
 
     debug(1) << "Partitioning loops to simplify boundary conditions...\n";
-    s = partition_loops(s);
+    s = partition_loops(s, t.has_feature(Target::ProfileLoops));
     s = simplify(s);
     log("Lowering after partitioning loops:", s);
 
@@ -349,8 +578,7 @@ void lower_impl(const vector<Function> &output_funcs,
 
     debug(1) << "Rebasing loops to zero...\n";
     s = rebase_loops_to_zero(s);
-    debug(2) << "Lowering after rebasing loops to zero:\n"
-             << s << "\n\n";
+    log("Lowering after rebasing loops to zero:", s);
 
     debug(1) << "Hoisting loop invariant if statements...\n";
     s = hoist_loop_invariant_if_statements(s);
@@ -374,9 +602,19 @@ void lower_impl(const vector<Function> &output_funcs,
     s = bound_small_allocations(s);
     log("Lowering after bounding small allocations:", s);
 
-    if (t.has_feature(Target::Profile) || t.has_feature(Target::ProfileByTimer)) {
+    if (t.has_feature(Target::ScratchArena)) {
+        debug(1) << "Injecting scratch arena...\n";
+        s = inject_scratch_arena(s, t);
+        log("Lowering after injecting scratch arena:", s);
+    }
+
+    if (t.has_feature(Target::Profile) ||
+        t.has_feature(Target::ProfileByTimer) ||
+        t.has_feature(Target::ProfileInstrumented)) {
         debug(1) << "Injecting profiling...\n";
-        s = inject_profiling(s, pipeline_name);
+        s = inject_profiling(s, pipeline_name,
+                             t.has_feature(Target::ProfileInstrumented),
+                             t.has_feature(Target::ProfileLoops));
         log("Lowering after injecting profiling:", s);
     }
 
@@ -429,14 +667,14 @@ void lower_impl(const vector<Function> &output_funcs,
             s = custom_passes[i]->mutate(s);
             debug(1) << "Lowering after custom pass " << i << ":\n"
                      << s << "\n\n";
+            log.mark("custom pass " + std::to_string(i), s);
         }
     }
 
     if (t.arch != Target::Hexagon && t.has_feature(Target::HVX)) {
         debug(1) << "Splitting off Hexagon offload...\n";
         s = inject_hexagon_rpc(s, t, result_module);
-        debug(2) << "Lowering after splitting off Hexagon offload:\n"
-                 << s << "\n";
+        log("Lowering after splitting off Hexagon offload:", s);
     } else {
         debug(1) << "Skipping Hexagon offload...\n";
     }
@@ -444,8 +682,7 @@ void lower_impl(const vector<Function> &output_funcs,
     if (t.has_gpu_feature()) {
         debug(1) << "Offloading GPU loops...\n";
         s = inject_gpu_offload(s, t);
-        debug(2) << "Lowering after splitting off GPU loops:\n"
-                 << s << "\n\n";
+        log("Lowering after splitting off GPU loops:", s);
     } else {
         debug(1) << "Skipping GPU offload...\n";
     }
@@ -475,8 +712,7 @@ void lower_impl(const vector<Function> &output_funcs,
     for (auto &lowered_func : closure_implementations) {
         result_module.append(lowered_func);
     }
-    debug(2) << "Lowering after generating parallel tasks and closures:\n"
-             << s << "\n\n";
+    log("Lowering after generating parallel tasks and closures:", s);
 
     vector<Argument> public_args = args;
     for (const auto &out : outputs) {
@@ -560,6 +796,8 @@ void lower_impl(const vector<Function> &output_funcs,
 
     result_module.append(main_func);
 
+    log.report(pipeline_name);
+
     auto *logger = get_compiler_logger();
     if (logger) {
         auto time_end = std::chrono::high_resolution_clock::now();
@@ -580,6 +818,10 @@ Module lower(const vector<Function> &output_funcs,
              const vector<IRMutator *> &custom_passes) {
     Module result_module{strip_namespaces(pipeline_name), t};
     run_with_large_stack([&]() {
+        std::unique_ptr<ScopedHashConsing> hash_consing;
+        if (get_env_variable("HL_HASH_CONS_IR") == "1") {
+            hash_consing = std::make_unique<ScopedHashConsing>();
+        }
         lower_impl(output_funcs, pipeline_name, t, args, linkage_type, requirements, trace_pipeline, custom_passes, result_module);
     });
     return result_module;
@@ -169,6 +169,7 @@ struct LowerParallelTasks : public IRMutator {
         Expr min, extent;
         Expr serial;
         std::string name;
+        TaskPartition partition = TaskPartition::Auto;
     };
 
     using IRMutator::visit;
@@ -212,7 +213,7 @@ struct LowerParallelTasks : public IRMutator {
 
         int num_tasks = (int)(tasks.size());
         std::vector<Expr> tasks_array_args;
-        tasks_array_args.reserve(num_tasks * 9);
+        tasks_array_args.reserve(num_tasks * 10);
 
         std::string closure_name = unique_name("parallel_closure");
         Expr closure_struct_allocation = closure.pack_into_struct();
@@ -229,11 +230,14 @@ struct LowerParallelTasks : public IRMutator {
             // Decide if we're going to call do_par_for or
             // do_parallel_tasks. halide_do_par_for is simpler, but
             // assumes a bunch of things. Programs that don't use async
-            // can also enter the task system via do_par_for.
+            // can also enter the task system via do_par_for. Loops
+            // with a non-default partition need to be handed chunks
+            // of iterations, which only loop tasks can take.
             const bool use_parallel_for = (num_tasks == 1 &&
                                            min_threads == 0 &&
                                            t.semaphores.empty() &&
-                                           !has_task_parent);
+                                           !has_task_parent &&
+                                           t.partition == TaskPartition::Auto);
 
             Expr closure_task_parent;
 
@@ -339,6 +343,7 @@ struct LowerParallelTasks : public IRMutator {
                 tasks_array_args.emplace_back(t.extent);
                 tasks_array_args.emplace_back(min_threads);
                 tasks_array_args.emplace_back(Cast::make(Bool(), t.serial));
+                tasks_array_args.emplace_back(make_bool(t.partition == TaskPartition::Guided));
             }
         }
 
@@ -380,7 +385,7 @@ struct LowerParallelTasks : public IRMutator {
             result.emplace_back(std::move(t));
         } else if (loop && loop->for_type == ForType::Parallel) {
             add_suffix(prefix, ".par_for." + loop->name);
-            ParallelTask t{loop->body, {}, loop->name, loop->min, loop->extent, const_false(), task_debug_name(prefix)};
+            ParallelTask t{loop->body, {}, loop->name, loop->min, loop->extent, const_false(), task_debug_name(prefix), loop->partition};
             result.emplace_back(std::move(t));
         } else if (loop &&
                    loop->for_type == ForType::Serial &&
@@ -1,15 +1,21 @@
 #include "Memoization.h"
+#include "Definition.h"
+#include "Buffer.h"
 #include "Error.h"
+#include "FindCalls.h"
 #include "Function.h"
 #include "IRMutator.h"
 #include "IROperator.h"
+#include "IRPrinter.h"
 #include "IRVisitor.h"
 #include "Param.h"
 #include "Scope.h"
 #include "Util.h"
 #include "Var.h"
 
+#include <algorithm>
 #include <map>
+#include <sstream>
 
 namespace Halide {
 namespace Internal {
@@ -150,6 +156,183 @@ public:
     std::map<DependencyKey, DependencyInfo> dependency_info;
 };
 
+// Estimate the relative cost of computing one element of a Func, for
+// the cost-aware eviction policy of the runtime cache. This is the
+// number of IR nodes in its definitions, including those of any Funcs
+// inlined into it, with each update scaled by the size of its
+// reduction domain.
+class EstimateComputeCost : public IRGraphVisitor {
+    int depth;
+
+    using IRGraphVisitor::visit;
+
+    void include(const Expr &e) override {
+        cost++;
+        IRGraphVisitor::include(e);
+    }
+
+    void visit(const Call *op) override {
+        if (op->call_type == Call::Halide && op->func.defined()) {
+            Function f(op->func);
+            if (f.schedule().compute_level().is_inlined()) {
+                cost += estimate_compute_cost(f, depth + 1);
+            }
+        }
+        IRGraphVisitor::visit(op);
+    }
+
+public:
+    uint64_t cost = 0;
+
+    EstimateComputeCost(int depth)
+        : depth(depth) {
+    }
+
+    static uint64_t estimate_compute_cost(const Function &f, int depth = 0) {
+        // Unknown work per element. Assume it is substantial.
+        const uint64_t extern_cost = 1000;
+        // Reduction domains with non-constant extents.
+        const uint64_t unknown_rdom_size = 16;
+        const uint64_t max_cost = 1 << 20;
+
+        if (depth > 8) {
+            return 1;
+        } else if (f.has_extern_definition()) {
+            return extern_cost;
+        }
+
+        uint64_t total = 0;
+        std::vector<Definition> definitions = {f.definition()};
+        definitions.insert(definitions.end(), f.updates().begin(), f.updates().end());
+        for (const Definition &def : definitions) {
+            EstimateComputeCost counter(depth);
+            for (const Expr &e : def.values()) {
+                e.accept(&counter);
+            }
+            for (const Expr &e : def.args()) {
+                e.accept(&counter);
+            }
+            uint64_t points = 1;
+            for (const ReductionVariable &rv : def.schedule().rvars()) {
+                const int64_t *extent = as_const_int(rv.extent);
+                points *= (extent && *extent > 0) ? (uint64_t)*extent : unknown_rdom_size;
+                points = std::min(points, max_cost);
+            }
+            total += std::min(counter.cost * points, max_cost);
+        }
+        return std::max<uint64_t>(1, std::min(total, max_cost));
+    }
+};
+
+// FNV-1a, which is stable across compilers and hosts, so keys in a
+// persistent cache file stay valid.
+uint64_t fnv1a(const uint8_t *data, size_t size, uint64_t h = 0xcbf29ce484222325ULL) {
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ data[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+uint64_t fnv1a(const std::string &s, uint64_t h = 0xcbf29ce484222325ULL) {
+    return fnv1a((const uint8_t *)s.data(), s.size(), h);
+}
+
+// Finds the Buffers embedded in the definitions of a Func.
+class FindEmbeddedBuffers : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+
+    void visit(const Call *op) override {
+        if (op->image.defined()) {
+            buffers[op->image.name()] = op->image;
+        }
+        IRGraphVisitor::visit(op);
+    }
+
+public:
+    std::map<std::string, Buffer<>> buffers;
+};
+
+void print_definition(std::ostream &stream, const Definition &def) {
+    for (const Expr &e : def.args()) {
+        stream << e << ",";
+    }
+    stream << "=";
+    for (const Expr &e : def.values()) {
+        stream << e << ",";
+    }
+    stream << "if " << def.predicate();
+    for (const ReductionVariable &rv : def.schedule().rvars()) {
+        stream << " " << rv.var << " in [" << rv.min << ", " << rv.extent << "]";
+    }
+    stream << "\n";
+}
+
+// A hash of the definitions of a Func and everything it calls, and of
+// the contents of the Buffers they use. It goes in the name at the
+// start of the cache key, so that results in a persistent cache file
+// computed by one version of a pipeline, or from other data, aren't
+// returned to a different one with the same names.
+uint64_t definition_hash(const Function &function) {
+    std::ostringstream stream;
+    FindEmbeddedBuffers embedded;
+    for (const auto &it : find_transitive_calls(function)) {
+        const Function &f = it.second;
+        f.accept(&embedded);
+        stream << f.name() << "(";
+        for (const std::string &arg : f.args()) {
+            stream << arg << ",";
+        }
+        stream << ")";
+        for (const Type &t : f.output_types()) {
+            stream << " " << t;
+        }
+        stream << "\n";
+        if (f.has_extern_definition()) {
+            stream << "extern " << f.extern_function_name() << "(";
+            for (const ExternFuncArgument &arg : f.extern_arguments()) {
+                if (arg.is_expr()) {
+                    stream << arg.expr;
+                } else if (arg.is_func()) {
+                    stream << Function(arg.func).name();
+                } else if (arg.is_buffer()) {
+                    stream << arg.buffer.name();
+                    embedded.buffers[arg.buffer.name()] = arg.buffer;
+                } else if (arg.is_image_param()) {
+                    stream << arg.image_param.name();
+                }
+                stream << ",";
+            }
+            stream << ")\n";
+        } else if (f.has_pure_definition()) {
+            print_definition(stream, f.definition());
+            for (const Definition &update : f.updates()) {
+                print_definition(stream, update);
+            }
+        }
+    }
+    for (const auto &it : embedded.buffers) {
+        const Buffer<> &b = it.second;
+        stream << it.first << ": " << b.type();
+        for (int i = 0; i < b.dimensions(); i++) {
+            stream << " [" << b.dim(i).min() << ", " << b.dim(i).extent() << "]";
+        }
+        stream << "\n";
+    }
+    uint64_t h = fnv1a(stream.str());
+    for (const auto &it : embedded.buffers) {
+        // Hash the elements in order, skipping any padding between
+        // them.
+        Buffer<> b = it.second;
+        if (b.number_of_elements() * b.type().bytes() != b.size_in_bytes()) {
+            b = b.copy();
+        }
+        if (b.data()) {
+            h = fnv1a(b.raw_buffer()->begin(), b.size_in_bytes(), h);
+        }
+    }
+    return h;
+}
+
 typedef std::pair<FindParameterDependencies::DependencyKey, FindParameterDependencies::DependencyInfo> DependencyKeyInfoPair;
 typedef std::pair<const FindParameterDependencies::DependencyKey, FindParameterDependencies::DependencyInfo> ConstDependencyKeyInfoPair;
 
@@ -158,7 +341,9 @@ class KeyInfo {
     Expr key_size_expr;
     const std::string &top_level_name;
     const std::string &function_name;
+    std::string cache_name;
     int memoize_instance;
+    uint64_t cost_per_element;
 
     size_t parameters_alignment() {
         int32_t max_alignment = 0;
@@ -186,19 +371,24 @@ class KeyInfo {
     // JIT situations where code is regenerated into the same region of
     // memory.
     //
-    // There is a plan to change the hash function used in the cache and
-    // after that happens, we'll measure performance again and maybe decide
-    // to choose one path or the other (see Git history for the implementation.
-    // It was deleted as part of the address_of intrinsic cleanup).
+    // The runtime doesn't hash the name pointer or the counter; it
+    // starts from key_seed(), a hash of the names computed here, so
+    // the length of the names doesn't affect lookup cost.
 
 public:
     KeyInfo(const Function &function, const std::string &name, int memoize_instance)
         : top_level_name(name),
           function_name(function.origin_name()),
-          memoize_instance(memoize_instance) {
+          memoize_instance(memoize_instance),
+          cost_per_element(EstimateComputeCost::estimate_compute_cost(function)) {
+        std::ostringstream name_stream;
+        name_stream << top_level_name.size() << ":" << top_level_name
+                    << function_name.size() << ":" << function_name
+                    << "#" << std::hex << definition_hash(function);
+        cache_name = name_stream.str();
         dependencies.visit_function(function);
         size_t size_so_far = 0;
-        size_so_far += Handle().bytes() + 4;
+        size_so_far += key_seed_offset() + 8;
 
         size_t needed_alignment = parameters_alignment();
         if (needed_alignment > 1) {
@@ -211,6 +401,24 @@ public:
         }
     }
 
+    // The offset of the hash of the parts of the key known at compile
+    // time. The runtime (see src/runtime/cache.cpp) uses it to seed the
+    // hash of the rest of the key, rather than hashing them on each
+    // lookup.
+    static size_t key_seed_offset() {
+        return Handle().bytes() + 8;
+    }
+
+    // A hash of the name and memoize instance.
+    uint64_t key_seed() const {
+        std::string s = cache_name;
+        s.push_back(0);
+        for (int i = 0; i < 4; i++) {
+            s.push_back((char)(memoize_instance >> (8 * i)));
+        }
+        return fnv1a(s);
+    }
+
     // Return the number of bytes needed to store the cache key
     // for the target function. Make sure it takes 4 bytes in cache key.
     Expr key_size() {
@@ -227,10 +435,11 @@ public:
         // Store a pointer to a string identifying the filter and
         // function. Assume this will be unique due to CSE. This can
         // break with loading and unloading of code, though the name
-        // mechanism can also break in those conditions.
+        // mechanism can also break in those conditions. The runtime's
+        // persistent cache file and statistics use the string this
+        // points to, so it must stay the first word of the key.
         writes.push_back(Store::make(key_name,
-                                     StringImm::make(std::to_string(top_level_name.size()) + ":" + top_level_name +
-                                                     std::to_string(function_name.size()) + ":" + function_name),
+                                     StringImm::make(cache_name),
                                      (index / Handle().bytes()), Parameter(), const_true(), ModulusRemainder()));
         size_t alignment = Handle().bytes();
         index += Handle().bytes();
@@ -243,6 +452,20 @@ public:
         alignment += 4;
         index += 4;
 
+        // Pad to eight bytes and store the precomputed hash of the
+        // above.
+        writes.push_back(Store::make(key_name, make_zero(UInt(32)),
+                                     (index / UInt(32).bytes()),
+                                     Parameter(), const_true(), ModulusRemainder()));
+        alignment += 4;
+        index += 4;
+        internal_assert(alignment == key_seed_offset());
+        writes.push_back(Store::make(key_name, make_const(UInt(64), key_seed()),
+                                     (index / UInt(64).bytes()),
+                                     Parameter(), const_true(), ModulusRemainder()));
+        alignment += 8;
+        index += 8;
+
         size_t needed_alignment = parameters_alignment();
         if (needed_alignment > 1) {
             while (alignment % needed_alignment) {
@@ -313,8 +536,10 @@ public:
             args.push_back(make_const(Bool(), false));
             args.push_back(make_const(UInt(64), 0));
         }
+        args.push_back(StringImm::make(top_level_name));
+        args.push_back(make_const(UInt(64), cost_per_element));
         // This is actually a void call. How to indicate that? Look at Extern_ stuff.
-        return Evaluate::make(Call::make(Int(32), "halide_memoization_cache_store", args, Call::Extern));
+        return Evaluate::make(Call::make(Int(32), "halide_memoization_cache_store_with_cost", args, Call::Extern));
     }
 };
 
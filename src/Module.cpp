@@ -1,9 +1,11 @@
 #include "Module.h"
 
 #include <array>
+#include <atomic>
 #include <fstream>
 #include <future>
 #include <memory>
+#include <thread>
 #include <utility>
 
 #include "CodeGen_C.h"
@@ -745,11 +747,69 @@ public:
         }
     }
 
+    explicit ScopedCompilerLogger(std::unique_ptr<CompilerLogger> compiler_logger) {
+        internal_assert(!get_compiler_logger());
+        set_compiler_logger(std::move(compiler_logger));
+    }
+
+    // Deactivate the logger early, handing it to the caller.
+    std::unique_ptr<CompilerLogger> release() {
+        return set_compiler_logger(nullptr);
+    }
+
     ~ScopedCompilerLogger() {
         set_compiler_logger(nullptr);
     }
 };
 
+// Run some independent jobs on up to HL_MULTITARGET_JOBS threads
+// (by default, one per core), including the calling one. Any
+// exception thrown by a job is rethrown here once they have all
+// finished.
+void run_jobs_concurrently(const std::vector<std::function<void()>> &jobs) {
+    int num_threads = (int)std::thread::hardware_concurrency();
+    const std::string jobs_env = get_env_variable("HL_MULTITARGET_JOBS");
+    if (!jobs_env.empty()) {
+        num_threads = std::atoi(jobs_env.c_str());
+    }
+    num_threads = std::min(std::max(num_threads, 1), (int)jobs.size());
+
+    std::atomic<size_t> next_job{0};
+#ifdef __cpp_exceptions
+    std::vector<std::exception_ptr> errors(jobs.size());
+#endif
+    const auto worker = [&]() {
+        for (size_t i = next_job++; i < jobs.size(); i = next_job++) {
+#ifdef __cpp_exceptions
+            try {
+                jobs[i]();
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+#else
+            jobs[i]();
+#endif
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_threads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto &t : threads) {
+        t.join();
+    }
+
+#ifdef __cpp_exceptions
+    for (const auto &e : errors) {
+        if (e) {
+            std::rethrow_exception(e);
+        }
+    }
+#endif
+}
+
 }  // namespace
 
 void compile_multitarget(const std::string &fn_name,
@@ -838,6 +898,15 @@ void compile_multitarget(const std::string &fn_name,
     std::vector<AutoSchedulerResults> auto_scheduler_results;
     MetadataNameMap metadata_name_map;
 
+    // The module factory runs Generator or Pipeline code that isn't
+    // safe to run on several threads at once, so the sub-modules are
+    // built one at a time here. Generating code for them is the bulk
+    // of the work, and that's done concurrently below. Each sub-module
+    // keeps the compiler logger that was active while it was built.
+    std::vector<Module> sub_modules;
+    std::vector<std::map<OutputFileType, std::string>> sub_outputs;
+    std::vector<std::unique_ptr<CompilerLogger>> sub_loggers;
+
     for (size_t i = 0; i < targets.size(); ++i) {
         const Target &target = targets[i];
 
@@ -892,13 +961,14 @@ void compile_multitarget(const std::string &fn_name,
             if (contains(sub_out, OutputFileType::compiler_log)) {
                 sub_out[OutputFileType::compiler_log] = temp_compiler_log_dir.add_temp_file(output_files.at(OutputFileType::compiler_log), suffix, target);
             }
-            debug(1) << "compile_multitarget: compile_sub_target " << sub_out[OutputFileType::object] << "\n";
-            sub_module.compile(sub_out);
             const auto *r = sub_module.get_auto_scheduler_results();
             auto_scheduler_results.push_back(r ? *r : AutoSchedulerResults());
             if (target == base_target) {
                 metadata_name_map = sub_module.get_metadata_name_map();
             }
+            sub_modules.push_back(sub_module);
+            sub_outputs.push_back(std::move(sub_out));
+            sub_loggers.push_back(activate.release());
         }
 
         uint64_t cur_target_features[kFeaturesWordCount] = {0};
@@ -929,6 +999,15 @@ void compile_multitarget(const std::string &fn_name,
         wrapper_args.emplace_back(sub_fn_name);
     }
 
+    std::vector<std::function<void()>> jobs;
+    for (size_t i = 0; i < sub_modules.size(); i++) {
+        jobs.emplace_back([&, i]() {
+            ScopedCompilerLogger activate(std::move(sub_loggers[i]));
+            debug(1) << "compile_multitarget: compile_sub_target " << sub_outputs[i].at(OutputFileType::object) << "\n";
+            sub_modules[i].compile(sub_outputs[i]);
+        });
+    }
+
     // If we haven't specified "no runtime", build a runtime with the base target
     // and add that to the result.
     if (!base_target.has_feature(Target::NoRuntime)) {
@@ -951,10 +1030,14 @@ void compile_multitarget(const std::string &fn_name,
 
         std::map<OutputFileType, std::string> runtime_out =
             {{OutputFileType::object, runtime_path}};
-        debug(1) << "compile_multitarget: compile_standalone_runtime " << runtime_out.at(OutputFileType::object) << "\n";
-        compile_standalone_runtime(runtime_out, runtime_target);
+        jobs.emplace_back([runtime_out, runtime_target]() {
+            debug(1) << "compile_multitarget: compile_standalone_runtime " << runtime_out.at(OutputFileType::object) << "\n";
+            compile_standalone_runtime(runtime_out, runtime_target);
+        });
     }
 
+    run_jobs_concurrently(jobs);
+
     if (needs_wrapper) {
         Expr indirect_result = Call::make(Int(32), Call::call_cached_indirect_function, wrapper_args, Call::Intrinsic);
         std::string private_result_name = unique_name(fn_name + "_result");
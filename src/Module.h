@@ -221,6 +221,12 @@ std::map<OutputFileType, std::string> compile_standalone_runtime(const std::map<
 using ModuleFactory = std::function<Module(const std::string &fn_name, const Target &target)>;
 using CompilerLoggerFactory = std::function<std::unique_ptr<Internal::CompilerLogger>(const std::string &fn_name, const Target &target)>;
 
+/** Compile a pipeline for several targets, with a wrapper that picks
+ * the first one the host can run at runtime. The module_factory is
+ * called for each target in turn on the calling thread, and the
+ * resulting modules (and the runtime) are then compiled to object code
+ * concurrently, on up to as many threads as there are cores. Set the
+ * environment variable HL_MULTITARGET_JOBS to change that limit. */
 void compile_multitarget(const std::string &fn_name,
                          const std::map<OutputFileType, std::string> &output_files,
                          const std::vector<Target> &targets,
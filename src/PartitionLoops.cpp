@@ -516,6 +516,30 @@ class PartitionLoops : public IRMutator {
 
     bool in_gpu_loop = false;
 
+    // Give the prologue and epilogue loops their own loop variables,
+    // so that later passes (e.g. the profiler) can tell them apart
+    // from the steady state.
+    bool name_partitions;
+
+    // Make a loop over a renamed variable, rebinding the old name
+    // inside the body.
+    Stmt make_renamed_loop(const For *op, const string &suffix,
+                           const Expr &min, const Expr &extent, const Stmt &body) {
+        if (!name_partitions || in_gpu_loop) {
+            return For::make(op->name, min, extent, op->for_type, op->device_api, body, op->partition);
+        }
+        string name = op->name + "." + suffix;
+        Stmt renamed = LetStmt::make(op->name, Variable::make(Int(32), name), body);
+        return For::make(name, min, extent, op->for_type, op->device_api, renamed, op->partition);
+    }
+
+public:
+    PartitionLoops(bool name_partitions)
+        : name_partitions(name_partitions) {
+    }
+
+private:
+
     Stmt visit(const For *op) override {
         Stmt body = op->body;
 
@@ -704,16 +728,14 @@ class PartitionLoops : public IRMutator {
         // Bust simple serial for loops up into three.
         if (op->for_type == ForType::Serial && !op->body.as<Acquire>()) {
             stmt = For::make(op->name, min_steady, max_steady - min_steady,
-                             op->for_type, op->device_api, simpler_body);
+                             op->for_type, op->device_api, simpler_body, op->partition);
 
             if (make_prologue) {
-                prologue = For::make(op->name, op->min, min_steady - op->min,
-                                     op->for_type, op->device_api, prologue);
+                prologue = make_renamed_loop(op, "prologue", op->min, min_steady - op->min, prologue);
                 stmt = Block::make(prologue, stmt);
             }
             if (make_epilogue) {
-                epilogue = For::make(op->name, max_steady, op->min + op->extent - max_steady,
-                                     op->for_type, op->device_api, epilogue);
+                epilogue = make_renamed_loop(op, "epilogue", max_steady, op->min + op->extent - max_steady, epilogue);
                 stmt = Block::make(stmt, epilogue);
             }
         } else {
@@ -741,7 +763,7 @@ class PartitionLoops : public IRMutator {
                     stmt = IfThenElse::make(loop_var < min_steady, prologue, stmt);
                 }
             }
-            stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, stmt);
+            stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, stmt, op->partition);
         }
 
         if (make_epilogue) {
@@ -864,7 +886,7 @@ class RenormalizeGPULoops : public IRMutator {
             internal_assert(!expr_uses_var(f->min, op->name) &&
                             !expr_uses_var(f->extent, op->name));
             Stmt inner = LetStmt::make(op->name, op->value, f->body);
-            inner = For::make(f->name, f->min, f->extent, f->for_type, f->device_api, inner);
+            inner = For::make(f->name, f->min, f->extent, f->for_type, f->device_api, inner, f->partition);
             return mutate(inner);
         } else if (a && in_gpu_loop && !in_thread_loop) {
             internal_assert(a->extents.size() == 1);
@@ -942,7 +964,7 @@ class RenormalizeGPULoops : public IRMutator {
                    for_a->min.same_as(for_b->min) &&
                    for_a->extent.same_as(for_b->extent)) {
             Stmt inner = IfThenElse::make(op->condition, for_a->body, for_b->body);
-            inner = For::make(for_a->name, for_a->min, for_a->extent, for_a->for_type, for_a->device_api, inner);
+            inner = For::make(for_a->name, for_a->min, for_a->extent, for_a->for_type, for_a->device_api, inner, for_a->partition);
             return mutate(inner);
         } else {
             internal_error << "Unexpected construct inside if statement: " << Stmt(op) << "\n";
@@ -1081,22 +1103,28 @@ bool has_likely_tag(const Expr &e) {
     return h.result;
 }
 
-Stmt partition_loops(Stmt s) {
+Stmt partition_loops(Stmt s, bool name_partitions) {
     s = LowerLikelyIfInnermost().mutate(s);
 
     // Walk inwards to the first loop before doing any more work.
     class Mutator : public IRMutator {
         using IRMutator::visit;
+        bool name_partitions;
         Stmt visit(const For *op) override {
             Stmt s = op;
             s = MarkClampedRampsAsLikely().mutate(s);
             s = ExpandSelects().mutate(s);
-            s = PartitionLoops().mutate(s);
+            s = PartitionLoops(name_partitions).mutate(s);
             s = RenormalizeGPULoops().mutate(s);
             s = CollapseSelects().mutate(s);
             return s;
         }
-    } mutator;
+
+    public:
+        Mutator(bool name_partitions)
+            : name_partitions(name_partitions) {
+        }
+    } mutator(name_partitions);
     s = mutator.mutate(s);
 
     s = remove_likelies(s);
@@ -21,8 +21,11 @@ bool has_likely_tag(const Expr &e);
 
 /** Partitions loop bodies into a prologue, a steady state, and an
  * epilogue. Finds the steady state by hunting for use of clamped
- * ramps, or the 'likely' intrinsic. */
-Stmt partition_loops(Stmt s);
+ * ramps, or the 'likely' intrinsic. If name_partitions is true, the
+ * prologue and epilogue of a serial loop over x become loops over
+ * x.prologue and x.epilogue (with x rebound inside), so that they can
+ * be distinguished from the steady state later on. */
+Stmt partition_loops(Stmt s, bool name_partitions = false);
 
 }  // namespace Internal
 }  // namespace Halide
@@ -16,6 +16,7 @@
 #include "Pipeline.h"
 #include "PrintLoopNest.h"
 #include "RealizationOrder.h"
+#include "Serialization.h"
 #include "WasmExecutor.h"
 
 using namespace Halide::Internal;
@@ -790,6 +791,27 @@ void Pipeline::trace_pipeline() {
     contents->trace_pipeline = true;
 }
 
+std::vector<uint8_t> Pipeline::serialize() const {
+    user_assert(defined()) << "Can't serialize an undefined Pipeline\n";
+    return serialize_pipeline(contents->outputs, contents->requirements, contents->trace_pipeline);
+}
+
+Pipeline Pipeline::deserialize(const std::vector<uint8_t> &data,
+                               const std::map<std::string, Parameter> &params) {
+    vector<Function> outputs;
+    vector<Stmt> requirements;
+    bool trace = false;
+    deserialize_pipeline(data, params, outputs, requirements, trace);
+    vector<Func> funcs;
+    for (const Function &f : outputs) {
+        funcs.emplace_back(f);
+    }
+    Pipeline p(funcs);
+    p.contents->requirements = requirements;
+    p.contents->trace_pipeline = trace;
+    return p;
+}
+
 // Make a vector of void *'s to pass to the jit call using the
 // currently bound value for all of the params and image
 // params.
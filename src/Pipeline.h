@@ -491,6 +491,18 @@ public:
     /** Generate begin_pipeline and end_pipeline tracing calls for this pipeline. */
     void trace_pipeline();
 
+    /** Serialize the Funcs of this pipeline, with their schedules
+     * and the pipeline's requirements, to a compact binary form that
+     * can be loaded again with Pipeline::deserialize. See
+     * Serialization.h for what is not recorded. */
+    std::vector<uint8_t> serialize() const;
+
+    /** Load a pipeline written by Pipeline::serialize. Params and
+     * ImageParams in the pipeline with the same name as one in params
+     * use it instead of a new, unbound Parameter. */
+    static Pipeline deserialize(const std::vector<uint8_t> &data,
+                                const std::map<std::string, Internal::Parameter> &params = {});
+
 private:
     std::string generate_function_name() const;
 };
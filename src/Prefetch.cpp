@@ -249,7 +249,7 @@ private:
 
         Stmt stmt;
         if (!body.same_as(op->body)) {
-            stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, std::move(body));
+            stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, std::move(body), op->partition);
         } else {
             stmt = op;
         }
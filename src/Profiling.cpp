@@ -63,10 +63,37 @@ Stmt claim_sampling_token(const Stmt &s, const Expr &shared_token, const Expr &l
                                       release_sampling_token(shared_token, local_token)}));
 }
 
+// The instrumented profiler keeps its running totals in a block of
+// stack per task, sized by the number of funcs. That isn't known
+// until the whole pipeline has been visited, so these placeholders
+// get substituted at the end.
+const char *const instrumented_num_funcs_name = "profiler_instrumented_num_funcs";
+const char *const instrumented_task_bytes_name = "profiler_instrumented_task_bytes";
+
+Expr instrumented_ticks() {
+    return Call::make(UInt(64), "halide_profiler_instrumented_ticks", {}, Call::Extern);
+}
+
+// Give s its own instrumented profiler task, which starts out billing
+// func, and adds what it measured to the pipeline's totals at the
+// end.
+Stmt instrumented_task(const Stmt &s, const Expr &task, const Expr &pipeline_state, int func) {
+    Expr num_funcs = Variable::make(Int(32), instrumented_num_funcs_name);
+    Expr bytes = Variable::make(Int(32), instrumented_task_bytes_name);
+    Stmt begin = Evaluate::make(Call::make(Int(32), "halide_profiler_instrumented_task_begin",
+                                           {task, num_funcs, func}, Call::Extern));
+    Stmt end = Evaluate::make(Call::make(Int(32), "halide_profiler_instrumented_task_end",
+                                         {pipeline_state, task}, Call::Extern));
+    return LetStmt::make(task.as<Variable>()->name,
+                         Call::make(Handle(), Call::alloca, {bytes}, Call::Intrinsic),
+                         Block::make({begin, s, end}));
+}
+
 class InjectProfiling : public IRMutator {
 
 public:
     map<string, int> indices;  // maps from func name -> index in buffer.
+    vector<string> names;      // the inverse of indices.
 
     vector<int> stack;  // What produce nodes are we currently inside of.
 
@@ -76,8 +103,17 @@ public:
     bool in_parallel = false;
     bool in_leaf_task = false;
 
-    InjectProfiling(const string &pipeline_name)
-        : pipeline_name(pipeline_name) {
+    // Time every produce/consume boundary with cycle counter reads,
+    // instead of leaving it to the sampling thread.
+    bool instrumented;
+
+    // Give every loop in host code its own id, nested under the Func
+    // or loop it's in.
+    bool profile_loops;
+    bool in_offload = false;
+
+    InjectProfiling(const string &pipeline_name, bool instrumented, bool profile_loops)
+        : pipeline_name(pipeline_name), instrumented(instrumented), profile_loops(profile_loops) {
         stack.push_back(get_func_id("overhead"));
         // ID 0 is treated specially in the runtime as overhead
         internal_assert(stack.back() == 0);
@@ -89,6 +125,7 @@ public:
         profiler_token = Variable::make(Int(32), "profiler_token");
         profiler_local_sampling_token = Variable::make(Handle(), "profiler_local_sampling_token");
         profiler_shared_sampling_token = Variable::make(Handle(), "profiler_shared_sampling_token");
+        profiler_instrumented_task = Variable::make(Handle(), "profiler_instrumented_task");
     }
 
     map<int, uint64_t> func_stack_current;  // map from func id -> current stack allocation
@@ -103,6 +140,7 @@ private:
     Expr profiler_token;
     Expr profiler_local_sampling_token;
     Expr profiler_shared_sampling_token;
+    Expr profiler_instrumented_task;
 
     // May need to be set to -1 at the start of control flow blocks
     // that have multiple incoming edges, if all sources don't have
@@ -125,26 +163,57 @@ private:
         return v[0];
     }
 
-    int get_func_id(const string &name) {
-        string norm_name = normalize_name(name);
+    int get_id(const string &name) {
         int idx = -1;
-        map<string, int>::iterator iter = indices.find(norm_name);
+        map<string, int>::iterator iter = indices.find(name);
         if (iter == indices.end()) {
             idx = (int)indices.size();
-            indices[norm_name] = idx;
+            indices[name] = idx;
+            names.push_back(name);
         } else {
             idx = iter->second;
         }
         return idx;
     }
 
+    int get_func_id(const string &name) {
+        return get_id(normalize_name(name));
+    }
+
+    // Loops are named by their path from the enclosing Func, which is
+    // how the runtime reconstructs the tree, e.g. f/s0.y/s0.x. A
+    // partitioned loop over x shows up as x, x.prologue and
+    // x.epilogue.
+    int get_loop_id(const string &loop_name) {
+        string name = loop_name;
+        const string rebased = ".rebased";
+        if (ends_with(name, rebased)) {
+            name = name.substr(0, name.size() - rebased.size());
+        }
+        if (stack.back() == 0) {
+            // Not inside any Func.
+            return get_id(name);
+        }
+        const string &parent = names[stack.back()];
+        const string func = parent.substr(0, parent.find('/'));
+        if (starts_with(name, func + ".")) {
+            name = name.substr(func.size() + 1);
+        }
+        return get_id(parent + "/" + name);
+    }
+
     Stmt set_current_func(int id) {
         if (most_recently_set_func == id) {
             return Evaluate::make(0);
         }
         most_recently_set_func = id;
+        if (instrumented) {
+            return Evaluate::make(Call::make(Int(32), "halide_profiler_instrumented_set_current_func",
+                                             {profiler_instrumented_task, id}, Call::Extern));
+        }
         Expr last_arg = in_leaf_task ? profiler_local_sampling_token : reinterpret(Handle(), cast<uint64_t>(0));
-        // This call gets inlined and becomes a single store instruction.
+        // This call gets inlined and becomes a store instruction, plus a
+        // call that records the Func for the current thread.
         Stmt s = Evaluate::make(Call::make(Int(32), "halide_profiler_set_current_func",
                                            {profiler_state, profiler_token, id, last_arg}, Call::Extern));
 
@@ -279,6 +348,44 @@ private:
         return stmt;
     }
 
+    // Add the ticks spent in s, including everything nested within
+    // it, to the inclusive time of the given id.
+    Stmt time_inclusive(const Stmt &s, int id) {
+        const string start_name = "profiler_inclusive_start";
+        Expr start = Variable::make(UInt(64), start_name);
+        Stmt add_inclusive =
+            Evaluate::make(Call::make(Int(32), "halide_profiler_instrumented_add_inclusive",
+                                      {profiler_instrumented_task, id, start}, Call::Extern));
+        return LetStmt::make(start_name, instrumented_ticks(), Block::make(s, add_inclusive));
+    }
+
+    // Wrap a statement that runs on another thread, or that blocks
+    // until other threads have made progress.
+    Stmt start_task(const Stmt &s) {
+        if (instrumented) {
+            return instrumented_task(s, profiler_instrumented_task, profiler_pipeline_state, stack.back());
+        } else {
+            return activate_thread(s, profiler_state);
+        }
+    }
+
+    // Wrap a statement during which the current thread waits on other
+    // tasks.
+    Stmt wait_for_tasks(const Stmt &s) {
+        if (instrumented) {
+            // Bill the time spent waiting to nobody, as the tasks
+            // account for it themselves.
+            auto set = [&](int id) {
+                return Evaluate::make(Call::make(Int(32), "halide_profiler_instrumented_set_current_func",
+                                                 {profiler_instrumented_task, id}, Call::Extern));
+            };
+            most_recently_set_func = stack.back();
+            return Block::make({set(-1), s, set(stack.back())});
+        } else {
+            return suspend_thread(s, profiler_state);
+        }
+    }
+
     Stmt visit(const ProducerConsumer *op) override {
         int idx;
         Stmt body;
@@ -288,6 +395,11 @@ private:
             Stmt set_current = set_current_func(idx);
             body = Block::make(set_current, mutate(op->body));
             stack.pop_back();
+            if (instrumented) {
+                // Also time the produce node as a whole, including
+                // anything computed within it.
+                return time_inclusive(ProducerConsumer::make(op->name, true, body), idx);
+            }
         } else {
             // At the beginning of the consume step, set the current task
             // back to the outer one.
@@ -305,7 +417,11 @@ private:
         } else if (const Acquire *a = s.as<Acquire>()) {
             s = Acquire::make(a->semaphore, a->count, visit_parallel_task(a->body));
         } else {
-            s = activate_thread(mutate(s), profiler_state);
+            if (instrumented) {
+                // The task starts out billing the enclosing Func.
+                most_recently_set_func = stack.back();
+            }
+            s = start_task(mutate(s));
         }
         if (most_recently_set_func != old) {
             most_recently_set_func = -1;
@@ -315,13 +431,13 @@ private:
 
     Stmt visit(const Acquire *op) override {
         Stmt s = visit_parallel_task(op);
-        return suspend_thread(s, profiler_state);
+        return wait_for_tasks(s);
     }
 
     Stmt visit(const Fork *op) override {
         ScopedValue<bool> bind(in_fork, true);
         Stmt s = visit_parallel_task(op);
-        return suspend_thread(s, profiler_state);
+        return wait_for_tasks(s);
     }
 
     Stmt visit(const For *op) override {
@@ -336,10 +452,26 @@ private:
 
         ScopedValue<bool> bind_in_parallel(in_parallel, in_parallel || op->is_unordered_parallel());
 
-        bool leaf_task = false;
-        if (update_active_threads) {
-            body = activate_thread(body, profiler_state);
+        if (instrumented) {
+            // There's no profiler state on the DSP to accumulate into.
+            update_active_threads = op->is_unordered_parallel();
+        }
 
+        int loop_id = -1;
+        Stmt enter_loop;
+        if (profile_loops && !in_offload &&
+            (op->device_api == DeviceAPI::None ||
+             op->device_api == DeviceAPI::Host)) {
+            // Bill the loop from the outside rather than at the top of
+            // every iteration, so that innermost loops cost nothing
+            // extra.
+            loop_id = get_loop_id(op->name);
+            enter_loop = set_current_func(loop_id);
+            stack.push_back(loop_id);
+        }
+
+        bool leaf_task = false;
+        if (update_active_threads && !instrumented) {
             class ContainsParallelOrBlockingNode : public IRVisitor {
                 using IRVisitor::visit;
                 void visit(const For *op) override {
@@ -360,24 +492,44 @@ private:
 
             body.accept(&contains_parallel_or_blocking_node);
             leaf_task = !contains_parallel_or_blocking_node.result;
-
-            if (leaf_task) {
-                body = claim_sampling_token(body, profiler_shared_sampling_token, profiler_local_sampling_token);
-            }
         }
         ScopedValue<bool> bind_leaf_task(in_leaf_task, in_leaf_task || leaf_task);
 
+        // Wrap the (already mutated) body of a loop that runs on other
+        // threads or another device for the sampling profiler.
+        auto activate_body = [&](Stmt s) {
+            if (update_active_threads && !instrumented) {
+                s = activate_thread(s, profiler_state);
+                if (leaf_task) {
+                    s = claim_sampling_token(s, profiler_shared_sampling_token, profiler_local_sampling_token);
+                }
+            }
+            return s;
+        };
+
         int old = most_recently_set_func;
 
         // We profile by storing a token to global memory, so don't enter GPU loops
-        if (op->device_api == DeviceAPI::Hexagon) {
+        if (update_active_threads && instrumented) {
+            // The body runs as its own task, billing the enclosing Func
+            // (or loop) until it reaches a produce node.
+            most_recently_set_func = stack.back();
+            body = start_task(mutate(body));
+        } else if (op->device_api == DeviceAPI::Hexagon && instrumented) {
+            // Time spent offloaded is billed to the enclosing Func.
+            body = op->body;
+        } else if (op->device_api == DeviceAPI::Hexagon) {
             // TODO: This is for all offload targets that support
             // limited internal profiling, which is currently just
             // hexagon. We don't support per-func stats remotely,
             // which means we can't do memory accounting.
             bool old_profiling_memory = profiling_memory;
             profiling_memory = false;
-            body = mutate(body);
+            {
+                // The remote profiler only knows about Funcs, not loops.
+                ScopedValue<bool> bind_in_offload(in_offload, true);
+                body = activate_body(mutate(body));
+            }
             profiling_memory = old_profiling_memory;
 
             // Get the profiler state pointer from scratch inside the
@@ -388,7 +540,25 @@ private:
             body = LetStmt::make("hvx_profiler_state", get_state, body);
         } else if (op->device_api == DeviceAPI::None ||
                    op->device_api == DeviceAPI::Host) {
-            body = mutate(body);
+            if (loop_id >= 0 && update_active_threads) {
+                // Each iteration may run on a different thread.
+                most_recently_set_func = -1;
+                Stmt set_current = set_current_func(loop_id);
+                body = Block::make(set_current, mutate(body));
+            } else if (update_active_threads) {
+                // Tell whichever thread runs the task which Func it is
+                // working on, for the per-thread hardware counters.
+                most_recently_set_func = -1;
+                Stmt set_current = set_current_func(stack.back());
+                body = Block::make(set_current, mutate(body));
+            } else {
+                body = mutate(body);
+                if (loop_id >= 0 && most_recently_set_func != loop_id) {
+                    // Switch back to the loop for the next iteration.
+                    body = Block::make(body, set_current_func(loop_id));
+                }
+            }
+            body = activate_body(body);
         } else {
             body = op->body;
         }
@@ -397,10 +567,19 @@ private:
             most_recently_set_func = -1;
         }
 
-        Stmt stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+        Stmt stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body, op->partition);
 
         if (update_active_threads) {
-            stmt = suspend_thread(stmt, profiler_state);
+            stmt = wait_for_tasks(stmt);
+        }
+
+        if (loop_id >= 0) {
+            stack.pop_back();
+            stmt = Block::make(enter_loop, stmt);
+            if (instrumented) {
+                stmt = time_inclusive(stmt, loop_id);
+            }
+            stmt = Block::make(stmt, set_current_func(stack.back()));
         }
 
         return stmt;
@@ -427,15 +606,16 @@ private:
 
 }  // namespace
 
-Stmt inject_profiling(Stmt s, const string &pipeline_name) {
-    InjectProfiling profiling(pipeline_name);
+Stmt inject_profiling(Stmt s, const string &pipeline_name, bool instrumented, bool profile_loops) {
+    InjectProfiling profiling(pipeline_name, instrumented, profile_loops);
     s = profiling.mutate(s);
 
     int num_funcs = (int)(profiling.indices.size());
 
     Expr func_names_buf = Variable::make(Handle(), "profiling_func_names");
 
-    Expr start_profiler = Call::make(Int(32), "halide_profiler_pipeline_start",
+    Expr start_profiler = Call::make(Int(32),
+                                     instrumented ? "halide_profiler_instrumented_pipeline_start" : "halide_profiler_pipeline_start",
                                      {pipeline_name, num_funcs, func_names_buf}, Call::Extern);
 
     Expr get_state = Call::make(Handle(), "halide_profiler_get_state", {}, Call::Extern);
@@ -459,18 +639,42 @@ Stmt inject_profiling(Stmt s, const string &pipeline_name) {
 
     Expr profiler_state = Variable::make(Handle(), "profiler_state");
 
-    s = activate_thread(s, profiler_state);
-
-    // Initialize the shared sampling token
-    Expr shared_sampling_token_var = Variable::make(Handle(), "profiler_shared_sampling_token");
-    Expr init_sampling_token =
-        Call::make(Int(32), "halide_profiler_init_sampling_token", {shared_sampling_token_var, 0}, Call::Extern);
-    s = Block::make({Evaluate::make(init_sampling_token), s});
-    s = LetStmt::make("profiler_shared_sampling_token",
-                      Call::make(Handle(), Call::alloca, {Int(32).bytes()}, Call::Intrinsic), s);
-
-    s = LetStmt::make("profiler_pipeline_state", get_pipeline_state, s);
-    s = LetStmt::make("profiler_state", get_state, s);
+    if (instrumented) {
+        // The pipeline body is the top-level task. Time it as a
+        // whole too, for the pipeline's total.
+        Expr profiler_pipeline_state = Variable::make(Handle(), "profiler_pipeline_state");
+        Expr task = Variable::make(Handle(), "profiler_instrumented_task");
+        Expr start = Variable::make(UInt(64), "profiler_pipeline_start_ticks");
+        Stmt end = Evaluate::make(Call::make(Int(32), "halide_profiler_instrumented_pipeline_end",
+                                             {profiler_pipeline_state, start}, Call::Extern));
+        s = instrumented_task(s, task, profiler_pipeline_state, 0);
+        s = LetStmt::make(start.as<Variable>()->name, instrumented_ticks(), Block::make(s, end));
+
+        Expr calibrate = Call::make(Int(32), "halide_profiler_instrumented_calibrate", {}, Call::Extern);
+        s = Block::make(Evaluate::make(calibrate), s);
+
+        // Each task's running totals are an InstrumentedTask header
+        // followed by exclusive and inclusive tick counts per func.
+        map<string, Expr> sizes;
+        sizes[instrumented_num_funcs_name] = num_funcs;
+        sizes[instrumented_task_bytes_name] = 16 + 16 * num_funcs;
+        s = substitute(sizes, s);
+
+        s = LetStmt::make("profiler_pipeline_state", get_pipeline_state, s);
+    } else {
+        s = activate_thread(s, profiler_state);
+
+        // Initialize the shared sampling token
+        Expr shared_sampling_token_var = Variable::make(Handle(), "profiler_shared_sampling_token");
+        Expr init_sampling_token =
+            Call::make(Int(32), "halide_profiler_init_sampling_token", {shared_sampling_token_var, 0}, Call::Extern);
+        s = Block::make({Evaluate::make(init_sampling_token), s});
+        s = LetStmt::make("profiler_shared_sampling_token",
+                          Call::make(Handle(), Call::alloca, {Int(32).bytes()}, Call::Intrinsic), s);
+
+        s = LetStmt::make("profiler_pipeline_state", get_pipeline_state, s);
+        s = LetStmt::make("profiler_state", get_state, s);
+    }
     // If there was a problem starting the profiler, it will call an
     // appropriate halide error function and then return the
     // (negative) error code as the token.
@@ -496,7 +700,10 @@ Stmt inject_profiling(Stmt s, const string &pipeline_name) {
     s = Block::make(s, Free::make("profiling_func_names"));
     s = Allocate::make("profiling_func_names", Handle(),
                        MemoryType::Auto, {num_funcs}, const_true(), s);
-    s = Block::make(Evaluate::make(stop_profiler), s);
+    if (!instrumented) {
+        // The instrumented profiler has no sampling thread to stop.
+        s = Block::make(Evaluate::make(stop_profiler), s);
+    }
 
     // We have nested definitions of the sampling token
     s = uniquify_variable_names(s);
@@ -36,8 +36,16 @@ namespace Internal {
  * times and counts will be logged at the end. Should be done before
  * storage flattening, but after all bounds inference.
  *
+ * If instrumented is true, there is no sampling thread. Instead every
+ * produce/consume boundary reads the cycle counter, and the ticks
+ * spent in each func are accumulated per task and added to the
+ * pipeline's totals as each task finishes (Target::ProfileInstrumented).
+ *
+ * If profile_loops is true, every loop in host code is billed under its
+ * own id, named by its path from the enclosing Func (e.g. f/s0.y/s0.x),
+ * and the report shows them as a tree (Target::ProfileLoops).
  */
-Stmt inject_profiling(Stmt, const std::string &);
+Stmt inject_profiling(Stmt, const std::string &, bool instrumented = false, bool profile_loops = false);
 
 }  // namespace Internal
 }  // namespace Halide
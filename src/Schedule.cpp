@@ -58,6 +58,15 @@ LoopLevel::LoopLevel(const std::string &func_name, const std::string &var_name,
     : contents(new Internal::LoopLevelContents(func_name, var_name, is_rvar, stage_index, locked)) {
 }
 
+void LoopLevel::get_fields(std::string &func_name, std::string &var_name,
+                           bool &is_rvar, int &stage_index, bool &locked) const {
+    func_name = contents->func_name;
+    var_name = contents->var_name;
+    is_rvar = contents->is_rvar;
+    stage_index = contents->stage_index;
+    locked = contents->locked;
+}
+
 LoopLevel::LoopLevel(const Internal::Function &f, const VarOrRVar &v, int stage_index)
     : LoopLevel(f.name(), v.name(), v.is_rvar, stage_index, false) {
 }
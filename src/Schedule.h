@@ -179,8 +179,6 @@ class LoopLevel {
     explicit LoopLevel(Internal::IntrusivePtr<Internal::LoopLevelContents> c)
         : contents(std::move(c)) {
     }
-    LoopLevel(const std::string &func_name, const std::string &var_name,
-              bool is_rvar, int stage_index, bool locked = false);
 
 public:
     /** Return the index of the function stage associated with this loop level.
@@ -213,6 +211,16 @@ public:
     // documented with plain comments (rather than Doxygen) to avoid being
     // present in user documentation.
 
+    // Construct a LoopLevel from its raw fields, as returned by
+    // get_fields(). Used when deserializing schedules.
+    LoopLevel(const std::string &func_name, const std::string &var_name,
+              bool is_rvar, int stage_index, bool locked = false);
+
+    // Get the raw fields of this LoopLevel, without checking whether
+    // it is defined or locked.
+    void get_fields(std::string &func_name, std::string &var_name,
+                    bool &is_rvar, int &stage_index, bool &locked) const;
+
     // Lock this LoopLevel.
     LoopLevel &lock();
 
@@ -424,6 +432,10 @@ struct Dim {
      * loop (see the DimType enum above). */
     DimType dim_type;
 
+    /** How the iterations are divided among threads, if the loop is
+     * parallel (see the TaskPartition enum). */
+    TaskPartition partition = TaskPartition::Auto;
+
     /** Can this loop be evaluated in any order (including in
      * parallel)? Equivalently, are there no data hazards between
      * evaluations of the Func at distinct values of this var? */
@@ -398,7 +398,7 @@ Stmt build_loop_nest(
             const Dim &dim = stage_s.dims()[nest[i].dim_idx];
             Expr min = Variable::make(Int(32), nest[i].name + ".loop_min");
             Expr extent = Variable::make(Int(32), nest[i].name + ".loop_extent");
-            stmt = For::make(nest[i].name, min, extent, dim.for_type, dim.device_api, stmt);
+            stmt = For::make(nest[i].name, min, extent, dim.for_type, dim.device_api, stmt, dim.partition);
         }
     }
 
@@ -968,7 +968,7 @@ private:
                              for_loop->extent,
                              for_loop->for_type,
                              for_loop->device_api,
-                             body);
+                             body, for_loop->partition);
         }
     }
 };
@@ -1066,7 +1066,7 @@ private:
 
             Stmt stmt = For::make(new_var, Variable::make(Int(32), new_var + ".loop_min"),
                                   Variable::make(Int(32), new_var + ".loop_extent"),
-                                  for_type, device_api, body);
+                                  for_type, device_api, body, op->partition);
 
             // Add let stmts defining the bound of the renamed for-loop.
             stmt = LetStmt::make(new_var + ".loop_min", min_val, stmt);
@@ -1107,7 +1107,7 @@ class ShiftLoopNest : public IRMutator {
             internal_assert(op);
             Expr adjusted = Variable::make(Int(32), op->name) + iter->second;
             Stmt body = substitute(op->name, adjusted, op->body);
-            stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+            stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body, op->partition);
         }
         return stmt;
     }
@@ -1272,7 +1272,7 @@ protected:
                              for_loop->extent,
                              for_loop->for_type,
                              for_loop->device_api,
-                             body);
+                             body, for_loop->partition);
         }
     }
 
@@ -0,0 +1,469 @@
+#include "ScratchArena.h"
+#include "CodeGen_Internal.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "IRVisitor.h"
+#include "Scope.h"
+#include "Simplify.h"
+#include "Substitute.h"
+#include "Target.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <map>
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::string;
+using std::vector;
+
+namespace {
+
+const string arena_name = "__scratch_arena";
+
+// Every slice starts on a multiple of this, which is at least the
+// alignment halide_malloc guarantees on every platform.
+const int arena_alignment = 128;
+
+class ContainsAllocate : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const Allocate *op) override {
+        result = true;
+    }
+
+public:
+    bool result = false;
+};
+
+bool contains_allocate(const Stmt &s) {
+    ContainsAllocate c;
+    s.accept(&c);
+    return c.result;
+}
+
+// Can the Expr be evaluated at the top of the region the arena
+// covers, instead of where it currently is? It must not refer to
+// anything defined inside the region, and must be safe to evaluate
+// unconditionally.
+class CanHoist : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+
+    const Scope<> &inner;
+
+    void visit(const Variable *op) override {
+        if (inner.contains(op->name)) {
+            result = false;
+        }
+    }
+
+    void visit(const Load *op) override {
+        result = false;
+    }
+
+    void visit(const Call *op) override {
+        if (!op->is_pure() && !starts_with(op->name, "_halide_buffer_get_")) {
+            result = false;
+        }
+        IRGraphVisitor::visit(op);
+    }
+
+public:
+    bool result = true;
+
+    CanHoist(const Scope<> &inner)
+        : inner(inner) {
+    }
+};
+
+// Count how many times each name is bound by a LetStmt.
+class CountLets : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const LetStmt *op) override {
+        counts[op->name]++;
+        IRVisitor::visit(op);
+    }
+
+public:
+    map<string, int> counts;
+};
+
+struct Candidate {
+    const Allocate *op;
+    Expr bytes;
+    // Non-zero if the size of the allocation, before padding, would be
+    // 2^63 bytes or more, in which case bytes may have wrapped.
+    Expr overflow;
+    // Position in program order of the Allocate node and of the point
+    // at which the allocation is dead.
+    int start, end;
+};
+
+// Find the allocations that can come from the arena, and their
+// lifetimes.
+class FindCandidates : public IRVisitor {
+    using IRVisitor::visit;
+
+    // Names defined inside the region whose values we can't compute
+    // at the top of it.
+    Scope<> inner;
+    // The values of the lets inside the region that we can, with the
+    // values of earlier such lets substituted in. Allocation bounds
+    // inference puts the extents of each realization in lets just
+    // outside it, so this is what makes most allocations eligible.
+    map<string, Expr> hoisted;
+    const map<string, int> &let_counts;
+    // Candidates currently in scope, by name.
+    Scope<int> live;
+    // The conditions of the enclosing if statements.
+    vector<Expr> conditions;
+    int loop_depth = 0;
+    int clock = 0;
+
+    bool can_hoist(const Expr &e) {
+        CanHoist c(inner);
+        e.accept(&c);
+        return c.result;
+    }
+
+    bool wants_arena(const Allocate *op) {
+        if (loop_depth > 0 ||
+            op->new_expr.defined() ||
+            op->extents.empty()) {
+            return false;
+        }
+        if (op->memory_type == MemoryType::Auto) {
+            // Constant-sized allocations that fit are put on the stack
+            // by codegen.
+            int32_t constant_size = Allocate::constant_allocation_size(op->extents, op->name);
+            if (constant_size > 0 &&
+                can_allocation_fit_on_stack((int64_t)constant_size * op->type.bytes())) {
+                return false;
+            }
+        } else if (op->memory_type != MemoryType::Heap) {
+            return false;
+        }
+        for (const Expr &e : op->extents) {
+            if (!can_hoist(e)) {
+                return false;
+            }
+        }
+        if (!can_hoist(op->condition)) {
+            return false;
+        }
+        for (const Expr &c : conditions) {
+            if (!can_hoist(c)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void allocation_bytes(const Allocate *op, Expr *bytes, Expr *overflow) {
+        // Multiply the extents together as codegen does for other
+        // heap allocations, tracking the high 32 bits of the product
+        // to catch overflow. The high bits must stay below 2^31, so
+        // that the padding and rounding below can't wrap either.
+        *bytes = make_const(UInt(64), op->type.bytes());
+        *overflow = make_zero(UInt(64));
+        Expr bytes_hi = make_zero(UInt(64));
+        Expr low_mask = make_const(UInt(64), (uint64_t)0xffffffff);
+        for (const Expr &e : op->extents) {
+            Expr extent = cast(UInt(64), max(0, e));
+            bytes_hi = bytes_hi * extent + (((*bytes & low_mask) * extent) >> 32);
+            *bytes = *bytes * extent;
+            *overflow = *overflow | (bytes_hi >> 31);
+        }
+        *bytes += make_const(UInt(64), (uint64_t)op->padding * op->type.bytes());
+        *bytes = ((*bytes + (arena_alignment - 1)) / arena_alignment) * arena_alignment;
+        Expr condition = op->condition;
+        for (const Expr &c : conditions) {
+            condition = condition && c;
+        }
+        if (!is_const_one(condition)) {
+            *bytes = select(condition, *bytes, make_zero(UInt(64)));
+            *overflow = select(condition, *overflow, make_zero(UInt(64)));
+        }
+        // The extents and condition are hoistable, so any names in
+        // them that are defined in the region are in hoisted.
+        *bytes = substitute(hoisted, *bytes);
+        *overflow = substitute(hoisted, *overflow);
+    }
+
+    void visit(const LetStmt *op) override {
+        op->value.accept(this);
+        // A name that is bound more than once may have different
+        // values in different places (e.g. in two specializations).
+        bool hoist = (loop_depth == 0 &&
+                      let_counts.at(op->name) == 1 &&
+                      can_hoist(op->value));
+        if (hoist) {
+            hoisted[op->name] = substitute(hoisted, op->value);
+        }
+        ScopedBinding<> bind(!hoist, inner, op->name);
+        op->body.accept(this);
+        hoisted.erase(op->name);
+    }
+
+    void visit(const For *op) override {
+        op->min.accept(this);
+        op->extent.accept(this);
+        ScopedBinding<> bind(inner, op->name);
+        loop_depth++;
+        op->body.accept(this);
+        loop_depth--;
+    }
+
+    void visit(const IfThenElse *op) override {
+        op->condition.accept(this);
+        conditions.push_back(op->condition);
+        op->then_case.accept(this);
+        conditions.back() = !op->condition;
+        if (op->else_case.defined()) {
+            op->else_case.accept(this);
+        }
+        conditions.pop_back();
+    }
+
+    void visit(const Fork *op) override {
+        int fork_start = clock++;
+        IRVisitor::visit(op);
+        forks.emplace_back(fork_start, clock++);
+    }
+
+    void visit(const Allocate *op) override {
+        for (const Expr &e : op->extents) {
+            e.accept(this);
+        }
+        op->condition.accept(this);
+        if (op->new_expr.defined()) {
+            op->new_expr.accept(this);
+        }
+        if (!wants_arena(op)) {
+            op->body.accept(this);
+            return;
+        }
+        int idx = (int)candidates.size();
+        Expr bytes, overflow;
+        allocation_bytes(op, &bytes, &overflow);
+        candidates.push_back({op, bytes, overflow, clock++, -1});
+        {
+            ScopedBinding<int> bind(live, op->name, idx);
+            op->body.accept(this);
+        }
+        if (candidates[idx].end < 0) {
+            candidates[idx].end = clock++;
+        }
+    }
+
+    void visit(const Free *op) override {
+        if (live.contains(op->name)) {
+            candidates[live.get(op->name)].end = clock++;
+        }
+    }
+
+public:
+    vector<Candidate> candidates;
+    vector<std::pair<int, int>> forks;
+
+    FindCandidates(const map<string, int> &let_counts)
+        : let_counts(let_counts) {
+    }
+};
+
+// Point the chosen allocations into the arena.
+class UseArena : public IRMutator {
+    using IRMutator::visit;
+
+    const map<const Allocate *, Expr> &offsets;
+
+    Stmt visit(const Allocate *op) override {
+        auto it = offsets.find(op);
+        if (it == offsets.end()) {
+            return IRMutator::visit(op);
+        }
+        Expr arena = Variable::make(Handle(), arena_name);
+        Expr slice = reinterpret(Handle(), reinterpret(UInt(64), arena) + it->second);
+        // Slices are released along with the arena, so give codegen a
+        // free function that does nothing.
+        return Allocate::make(op->name, op->type, MemoryType::Heap,
+                              op->extents, op->condition, mutate(op->body),
+                              slice, "halide_device_host_nop_free", op->padding);
+    }
+
+public:
+    UseArena(const map<const Allocate *, Expr> &offsets)
+        : offsets(offsets) {
+    }
+};
+
+Stmt inject_arena(const Stmt &s, const Target &t) {
+    CountLets counter;
+    s.accept(&counter);
+    FindCandidates finder(counter.counts);
+    s.accept(&finder);
+    vector<Candidate> &candidates = finder.candidates;
+    if (candidates.empty()) {
+        return s;
+    }
+
+    // Asynchronous producers run at the same time as their
+    // consumers, so anything live during a Fork must not share with
+    // anything else live during it.
+    for (const auto &fork : finder.forks) {
+        for (Candidate &c : candidates) {
+            if (c.start <= fork.second && c.end >= fork.first) {
+                c.start = std::min(c.start, fork.first);
+                c.end = std::max(c.end, fork.second);
+            }
+        }
+    }
+
+    // Assign the allocations to slots, greedily in program order,
+    // reusing the first slot whose previous occupants are all dead by
+    // the time the allocation is made. Each slot is as large as its
+    // largest occupant.
+    struct Slot {
+        int end;
+        Expr size;
+    };
+    vector<Slot> slots;
+    vector<int> slot_of(candidates.size());
+    vector<int> order(candidates.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = (int)i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return candidates[a].start < candidates[b].start;
+    });
+
+    // Each size is checked as soon as it is known, as codegen does
+    // for other heap allocations, and every partial sum of them is
+    // checked too, so that nothing can wrap on the way to the total.
+    struct SizeLet {
+        string name;
+        Expr value;
+        Stmt check;
+    };
+    vector<SizeLet> lets;
+    Expr max_size = make_const(UInt(64), t.maximum_buffer_size());
+    auto check_size = [&](const string &name, const Expr &size, const Expr &overflow) {
+        Expr ok = simplify(overflow == make_zero(UInt(64)) && size <= max_size);
+        if (is_const_one(ok)) {
+            return Stmt();
+        }
+        return AssertStmt::make(ok, Call::make(Int(32), "halide_error_buffer_allocation_too_large",
+                                               {name, size, max_size}, Call::Extern));
+    };
+    for (int i : order) {
+        const Candidate &c = candidates[i];
+        string bytes_name = arena_name + ".bytes." + std::to_string(i);
+        Expr bytes = Variable::make(UInt(64), bytes_name);
+        lets.push_back({bytes_name, c.bytes, check_size(c.op->name, bytes, c.overflow)});
+        bool placed = false;
+        for (size_t j = 0; j < slots.size(); j++) {
+            if (slots[j].end < c.start) {
+                slots[j].end = c.end;
+                slots[j].size = max(slots[j].size, bytes);
+                slot_of[i] = (int)j;
+                placed = true;
+                break;
+            }
+        }
+        if (!placed) {
+            slot_of[i] = (int)slots.size();
+            slots.push_back({c.end, bytes});
+        }
+    }
+
+    // Lay the slots out one after the other.
+    vector<Expr> slot_offsets;
+    Expr total = make_zero(UInt(64));
+    for (size_t j = 0; j < slots.size(); j++) {
+        string offset_name = arena_name + ".offset." + std::to_string(j);
+        Expr offset = Variable::make(UInt(64), offset_name);
+        lets.push_back({offset_name, total, check_size(arena_name, offset, make_zero(UInt(64)))});
+        slot_offsets.push_back(offset);
+        total = offset + slots[j].size;
+    }
+    string size_name = arena_name + ".size";
+    Expr size = Variable::make(UInt(64), size_name);
+    lets.push_back({size_name, total, check_size(arena_name, size, make_zero(UInt(64)))});
+
+    map<const Allocate *, Expr> offsets;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        offsets[candidates[i].op] = slot_offsets[slot_of[i]];
+    }
+    Stmt body = UseArena(offsets).mutate(s);
+
+    debug(2) << "Scratch arena holds " << candidates.size()
+             << " allocations in " << slots.size() << " slots\n";
+
+    Expr arena = Variable::make(Handle(), arena_name);
+    Stmt release =
+        Evaluate::make(Call::make(Handle(), Call::register_destructor,
+                                  {Expr("halide_scratch_arena_release"), arena},
+                                  Call::Intrinsic));
+    body = Block::make(release, body);
+    Stmt check_acquired =
+        AssertStmt::make(reinterpret(UInt(64), arena) != make_zero(UInt(64)) || size == make_zero(UInt(64)),
+                         Call::make(Int(32), "halide_error_out_of_memory", {}, Call::Extern));
+    body = Block::make(check_acquired, body);
+    body = LetStmt::make(arena_name,
+                         Call::make(Handle(), "halide_scratch_arena_acquire", {size}, Call::Extern),
+                         body);
+
+    for (auto it = lets.rbegin(); it != lets.rend(); it++) {
+        if (it->check.defined()) {
+            body = Block::make(it->check, body);
+        }
+        body = LetStmt::make(it->name, it->value, body);
+    }
+    return body;
+}
+
+}  // namespace
+
+Stmt inject_scratch_arena(const Stmt &s, const Target &t) {
+    // Place the arena just inside the leading lets and checks of the
+    // pipeline, so that the sizes of the allocations it replaces can
+    // refer to them.
+    vector<const LetStmt *> lets;
+    vector<Stmt> checks;
+    Stmt body = s;
+    while (true) {
+        if (const LetStmt *let = body.as<LetStmt>()) {
+            lets.push_back(let);
+            checks.emplace_back();
+            body = let->body;
+        } else if (const Block *block = body.as<Block>();
+                   block && !contains_allocate(block->first)) {
+            lets.push_back(nullptr);
+            checks.push_back(block->first);
+            body = block->rest;
+        } else {
+            break;
+        }
+    }
+
+    Stmt new_body = inject_arena(body, t);
+    if (new_body.same_as(body)) {
+        return s;
+    }
+    body = new_body;
+
+    for (size_t i = lets.size(); i > 0; i--) {
+        if (lets[i - 1]) {
+            body = LetStmt::make(lets[i - 1]->name, lets[i - 1]->value, body);
+        } else {
+            body = Block::make(checks[i - 1], body);
+        }
+    }
+    return body;
+}
+
+}  // namespace Internal
+}  // namespace Halide
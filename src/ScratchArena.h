@@ -0,0 +1,28 @@
+#ifndef HALIDE_SCRATCH_ARENA_H
+#define HALIDE_SCRATCH_ARENA_H
+
+/** \file
+ * Defines the lowering pass that carves the pipeline's top-level heap
+ * allocations out of a single per-invocation scratch arena.
+ */
+
+#include "Expr.h"
+
+namespace Halide {
+
+struct Target;
+
+namespace Internal {
+
+/** Replace the heap allocations that are not inside any loop, and
+ * whose sizes can be computed up front, with slices of one arena
+ * acquired from halide_scratch_arena_acquire at the top of the
+ * pipeline. Allocations whose lifetimes (from their Allocate node to
+ * their Free marker) don't overlap share the same slice. Must run
+ * after inject_early_frees. Used for Target::ScratchArena. */
+Stmt inject_scratch_arena(const Stmt &s, const Target &t);
+
+}  // namespace Internal
+}  // namespace Halide
+
+#endif
@@ -0,0 +1,1703 @@
+#include "Serialization.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Definition.h"
+#include "ExternFuncArgument.h"
+#include "FindCalls.h"
+#include "Function.h"
+#include "IR.h"
+#include "Reduction.h"
+#include "Schedule.h"
+#include "Target.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::string;
+using std::vector;
+
+namespace {
+
+// The layout of a serialized pipeline or module is:
+//
+//   "HLSZ" magic, version (varint), payload kind (byte), payload
+//
+// Everything in the payload is a byte, a LEB128 varint (signed values
+// are zigzag-coded first), or a raw little-endian 64-bit word for
+// floating point bits. Strings, IR nodes, Parameters, Buffers and
+// ReductionDomains are interned: the first time one appears it is
+// written in full and assigned the next index of its kind, and later
+// appearances just refer to that index. IR nodes get their index once
+// their children are written, so the reader can assign indices in the
+// same order as it builds the nodes bottom-up. Bump the version
+// whenever the layout changes.
+const char serialization_magic[4] = {'H', 'L', 'S', 'Z'};
+const uint64_t serialization_version = 1;
+
+enum class PayloadKind : uint8_t {
+    Pipeline = 1,
+    Module = 2,
+};
+
+class Serializer {
+    vector<uint8_t> &out;
+
+    // Funcs are only tracked when serializing a pipeline. Lowered
+    // Modules drop their references to Funcs.
+    bool keep_funcs;
+    map<const FunctionContents *, uint64_t> funcs;
+
+    map<string, uint64_t> strings;
+    map<const IRNode *, uint64_t> nodes;
+    map<Parameter, uint64_t> params;
+    map<const halide_buffer_t *, uint64_t> buffers;
+    map<ReductionDomain, uint64_t, ReductionDomain::Compare> rdoms;
+
+public:
+    Serializer(vector<uint8_t> &out, bool keep_funcs)
+        : out(out), keep_funcs(keep_funcs) {
+    }
+
+    void write_header(PayloadKind kind) {
+        out.insert(out.end(), serialization_magic, serialization_magic + sizeof(serialization_magic));
+        write_varint(serialization_version);
+        write_u8((uint8_t)kind);
+    }
+
+    void write_u8(uint8_t b) {
+        out.push_back(b);
+    }
+
+    void write_varint(uint64_t v) {
+        while (v >= 0x80) {
+            out.push_back((uint8_t)(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back((uint8_t)v);
+    }
+
+    void write_int(int64_t v) {
+        write_varint(((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+    }
+
+    void write_bool(bool b) {
+        write_u8(b ? 1 : 0);
+    }
+
+    void write_u64(uint64_t v) {
+        for (int i = 0; i < 8; i++) {
+            out.push_back((uint8_t)(v >> (i * 8)));
+        }
+    }
+
+    template<typename E>
+    void write_enum(E e) {
+        write_varint((uint64_t)e);
+    }
+
+    void write_string(const string &s) {
+        auto it = strings.find(s);
+        if (it != strings.end()) {
+            write_varint(it->second + 1);
+            return;
+        }
+        write_varint(0);
+        write_varint(s.size());
+        out.insert(out.end(), s.begin(), s.end());
+        strings.emplace(s, strings.size());
+    }
+
+    void write_strings(const vector<string> &v) {
+        write_varint(v.size());
+        for (const string &s : v) {
+            write_string(s);
+        }
+    }
+
+    void write_type(const Type &t) {
+        write_u8((uint8_t)t.code());
+        write_u8((uint8_t)t.bits());
+        write_varint(t.lanes());
+    }
+
+    void write_types(const vector<Type> &v) {
+        write_varint(v.size());
+        for (const Type &t : v) {
+            write_type(t);
+        }
+    }
+
+    void write_expr(const Expr &e) {
+        write_node(e.get());
+    }
+
+    void write_stmt(const Stmt &s) {
+        write_node(s.get());
+    }
+
+    void write_exprs(const vector<Expr> &v) {
+        write_varint(v.size());
+        for (const Expr &e : v) {
+            write_expr(e);
+        }
+    }
+
+    void write_region(const Region &r) {
+        write_varint(r.size());
+        for (const Range &range : r) {
+            write_expr(range.min);
+            write_expr(range.extent);
+        }
+    }
+
+    void write_alignment(const ModulusRemainder &a) {
+        write_int(a.modulus);
+        write_int(a.remainder);
+    }
+
+    template<typename T>
+    void write_binary(const IRNode *n) {
+        const T *op = (const T *)n;
+        write_expr(op->a);
+        write_expr(op->b);
+    }
+
+    void write_node(const IRNode *n);
+
+    void write_param(const Parameter &p) {
+        if (!p.defined()) {
+            write_varint(0);
+            return;
+        }
+        auto it = params.find(p);
+        if (it != params.end()) {
+            write_varint(it->second + 2);
+            return;
+        }
+        write_varint(1);
+        write_type(p.type());
+        write_bool(p.is_buffer());
+        write_int(p.dimensions());
+        write_string(p.name());
+        // Assign the index before writing the constraints, which may
+        // refer back to this Parameter.
+        params.emplace(p, params.size());
+        if (p.is_buffer()) {
+            write_enum(p.memory_type());
+            for (int i = 0; i < p.dimensions(); i++) {
+                write_expr(p.min_constraint(i));
+                write_expr(p.extent_constraint(i));
+                write_expr(p.stride_constraint(i));
+                write_expr(p.min_constraint_estimate(i));
+                write_expr(p.extent_constraint_estimate(i));
+            }
+            write_int(p.host_alignment());
+        } else {
+            uint64_t bits;
+            memcpy(&bits, p.scalar_address(), sizeof(bits));
+            write_u64(bits);
+            write_expr(p.min_value());
+            write_expr(p.max_value());
+            write_expr(p.estimate());
+            write_expr(p.default_value());
+        }
+    }
+
+    void write_buffer(const Buffer<> &b) {
+        if (!b.defined()) {
+            write_varint(0);
+            return;
+        }
+        auto it = buffers.find(b.raw_buffer());
+        if (it != buffers.end()) {
+            write_varint(it->second + 2);
+            return;
+        }
+        user_assert(!b.device_dirty())
+            << "Can't serialize Buffer " << b.name() << " because it is dirty on the device\n";
+        write_varint(1);
+        write_string(b.name());
+        write_type(b.type());
+        // Write a dense copy of the contents, with the same storage
+        // order as the original.
+        Buffer<> dense = b.copy();
+        write_varint(dense.dimensions());
+        for (int i = 0; i < dense.dimensions(); i++) {
+            write_int(dense.dim(i).min());
+            write_int(dense.dim(i).extent());
+            write_int(dense.dim(i).stride());
+        }
+        const uint8_t *data = (const uint8_t *)dense.data();
+        write_varint(dense.size_in_bytes());
+        out.insert(out.end(), data, data + dense.size_in_bytes());
+        buffers.emplace(b.raw_buffer(), buffers.size());
+    }
+
+    void write_rdom(const ReductionDomain &r) {
+        if (!r.defined()) {
+            write_varint(0);
+            return;
+        }
+        auto it = rdoms.find(r);
+        if (it != rdoms.end()) {
+            write_varint(it->second + 2);
+            return;
+        }
+        write_varint(1);
+        write_rvars(r.domain());
+        rdoms.emplace(r, rdoms.size());
+        write_expr(r.predicate());
+        write_bool(r.frozen());
+    }
+
+    void write_rvars(const vector<ReductionVariable> &v) {
+        write_varint(v.size());
+        for (const ReductionVariable &rv : v) {
+            write_string(rv.var);
+            write_expr(rv.min);
+            write_expr(rv.extent);
+        }
+    }
+
+    void add_funcs(const map<string, Function> &env) {
+        internal_assert(keep_funcs);
+        for (const auto &it : env) {
+            funcs.emplace(it.second.get_contents().get(), funcs.size());
+        }
+    }
+
+    void write_func_ref(const FunctionPtr &f) {
+        if (!f.defined() || !keep_funcs) {
+            write_varint(0);
+            return;
+        }
+        auto it = funcs.find(f.get());
+        internal_assert(it != funcs.end()) << "Func not in the serialized environment\n";
+        write_varint(it->second + 1);
+    }
+
+    void write_loop_level(const LoopLevel &l) {
+        string func_name, var_name;
+        bool is_rvar, locked;
+        int stage_index;
+        l.get_fields(func_name, var_name, is_rvar, stage_index, locked);
+        write_string(func_name);
+        write_string(var_name);
+        write_bool(is_rvar);
+        write_int(stage_index);
+        write_bool(locked);
+    }
+
+    void write_bounds(const vector<Bound> &v) {
+        write_varint(v.size());
+        for (const Bound &b : v) {
+            write_string(b.var);
+            write_expr(b.min);
+            write_expr(b.extent);
+            write_expr(b.modulus);
+            write_expr(b.remainder);
+        }
+    }
+
+    void write_prefetch(const PrefetchDirective &p) {
+        write_string(p.name);
+        write_string(p.at);
+        write_string(p.from);
+        write_expr(p.offset);
+        write_enum(p.strategy);
+        write_param(p.param);
+    }
+
+    void write_func_schedule(const FuncSchedule &s) {
+        write_loop_level(s.store_level());
+        write_loop_level(s.compute_level());
+        write_varint(s.storage_dims().size());
+        for (const StorageDim &d : s.storage_dims()) {
+            write_string(d.var);
+            write_expr(d.alignment);
+            write_expr(d.bound);
+            write_expr(d.fold_factor);
+            write_bool(d.fold_forward);
+        }
+        write_bounds(s.bounds());
+        write_bounds(s.estimates());
+        write_varint(s.wrappers().size());
+        for (const auto &it : s.wrappers()) {
+            write_string(it.first);
+            write_func_ref(it.second);
+        }
+        write_enum(s.memory_type());
+        write_bool(s.memoized());
+        write_bool(s.async());
+        write_expr(s.memoize_eviction_key());
+    }
+
+    void write_stage_schedule(const StageSchedule &s) {
+        write_rvars(s.rvars());
+        write_varint(s.splits().size());
+        for (const Split &split : s.splits()) {
+            write_string(split.old_var);
+            write_string(split.outer);
+            write_string(split.inner);
+            write_expr(split.factor);
+            write_bool(split.exact);
+            write_enum(split.tail);
+            write_enum(split.split_type);
+        }
+        write_varint(s.dims().size());
+        for (const Dim &d : s.dims()) {
+            write_string(d.var);
+            write_enum(d.for_type);
+            write_enum(d.device_api);
+            write_enum(d.dim_type);
+            write_enum(d.partition);
+        }
+        write_varint(s.prefetches().size());
+        for (const PrefetchDirective &p : s.prefetches()) {
+            write_prefetch(p);
+        }
+        write_loop_level(s.fuse_level().level);
+        write_varint(s.fuse_level().align.size());
+        for (const auto &it : s.fuse_level().align) {
+            write_string(it.first);
+            write_enum(it.second);
+        }
+        write_varint(s.fused_pairs().size());
+        for (const FusedPair &p : s.fused_pairs()) {
+            write_string(p.func_1);
+            write_string(p.func_2);
+            write_varint(p.stage_1);
+            write_varint(p.stage_2);
+            write_string(p.var_name);
+        }
+        write_bool(s.touched());
+        write_bool(s.allow_race_conditions());
+        write_bool(s.atomic());
+        write_bool(s.override_atomic_associativity_test());
+    }
+
+    void write_definition(const Definition &d) {
+        write_bool(d.is_init());
+        write_expr(d.predicate());
+        write_exprs(d.args());
+        write_exprs(d.values());
+        write_stage_schedule(d.schedule());
+        write_varint(d.specializations().size());
+        for (const Specialization &s : d.specializations()) {
+            write_expr(s.condition);
+            write_definition(s.definition);
+            write_string(s.failure_message);
+        }
+    }
+
+    void write_function(const Function &f) {
+        write_string(f.origin_name());
+        write_types(f.output_types());
+        write_types(f.required_types());
+        write_int(f.required_dimensions());
+        write_strings(f.args());
+        write_func_schedule(f.schedule());
+        write_bool(f.definition().defined());
+        if (f.definition().defined()) {
+            write_definition(f.definition());
+        }
+        write_varint(f.updates().size());
+        for (const Definition &d : f.updates()) {
+            write_definition(d);
+        }
+        write_string(f.debug_file());
+        write_varint(f.output_buffers().size());
+        for (const Parameter &p : f.output_buffers()) {
+            write_param(p);
+        }
+        write_varint(f.extern_arguments().size());
+        for (const ExternFuncArgument &a : f.extern_arguments()) {
+            write_enum(a.arg_type);
+            switch (a.arg_type) {
+            case ExternFuncArgument::UndefinedArg:
+                break;
+            case ExternFuncArgument::FuncArg:
+                write_func_ref(a.func);
+                break;
+            case ExternFuncArgument::BufferArg:
+                write_buffer(a.buffer);
+                break;
+            case ExternFuncArgument::ExprArg:
+                write_expr(a.expr);
+                break;
+            case ExternFuncArgument::ImageParamArg:
+                write_param(a.image_param);
+                break;
+            }
+        }
+        write_string(f.extern_function_name());
+        write_enum(f.extern_definition_name_mangling());
+        write_enum(f.extern_function_device_api());
+        write_expr(f.extern_definition_proxy_expr());
+        write_bool(f.is_tracing_loads());
+        write_bool(f.is_tracing_stores());
+        write_bool(f.is_tracing_realizations());
+        write_strings(f.get_trace_tags());
+        write_bool(f.frozen());
+    }
+
+    void write_module(const Module &m) {
+        write_string(m.name());
+        write_string(m.target().to_string());
+        const MetadataNameMap names = m.get_metadata_name_map();
+        write_varint(names.size());
+        for (const auto &it : names) {
+            write_string(it.first);
+            write_string(it.second);
+        }
+        write_bool(m.any_strict_float());
+        write_varint(m.buffers().size());
+        for (const Buffer<> &b : m.buffers()) {
+            write_buffer(b);
+        }
+        write_varint(m.functions().size());
+        for (const LoweredFunc &f : m.functions()) {
+            write_string(f.name);
+            write_varint(f.args.size());
+            for (const LoweredArgument &a : f.args) {
+                write_string(a.name);
+                write_enum(a.kind);
+                write_type(a.type);
+                write_varint(a.dimensions);
+                write_expr(a.argument_estimates.scalar_def);
+                write_expr(a.argument_estimates.scalar_min);
+                write_expr(a.argument_estimates.scalar_max);
+                write_expr(a.argument_estimates.scalar_estimate);
+                write_region(a.argument_estimates.buffer_estimates);
+                write_alignment(a.alignment);
+            }
+            write_stmt(f.body);
+            write_enum(f.linkage);
+            write_enum(f.name_mangling);
+        }
+        write_varint(m.submodules().size());
+        for (const Module &sub : m.submodules()) {
+            write_module(sub);
+        }
+    }
+};
+
+void Serializer::write_node(const IRNode *n) {
+    if (!n) {
+        write_varint(0);
+        return;
+    }
+    auto it = nodes.find(n);
+    if (it != nodes.end()) {
+        write_varint(it->second + 2);
+        return;
+    }
+    write_varint(1);
+    write_enum(n->node_type);
+
+    switch (n->node_type) {
+    case IRNodeType::IntImm: {
+        const IntImm *op = (const IntImm *)n;
+        write_type(op->type);
+        write_int(op->value);
+        break;
+    }
+    case IRNodeType::UIntImm: {
+        const UIntImm *op = (const UIntImm *)n;
+        write_type(op->type);
+        write_varint(op->value);
+        break;
+    }
+    case IRNodeType::FloatImm: {
+        const FloatImm *op = (const FloatImm *)n;
+        uint64_t bits;
+        memcpy(&bits, &op->value, sizeof(bits));
+        write_type(op->type);
+        write_u64(bits);
+        break;
+    }
+    case IRNodeType::StringImm:
+        write_string(((const StringImm *)n)->value);
+        break;
+    case IRNodeType::Broadcast: {
+        const Broadcast *op = (const Broadcast *)n;
+        write_expr(op->value);
+        write_varint(op->lanes);
+        break;
+    }
+    case IRNodeType::Cast: {
+        const Cast *op = (const Cast *)n;
+        write_type(op->type);
+        write_expr(op->value);
+        break;
+    }
+    case IRNodeType::Reinterpret: {
+        const Reinterpret *op = (const Reinterpret *)n;
+        write_type(op->type);
+        write_expr(op->value);
+        break;
+    }
+    case IRNodeType::Variable: {
+        const Variable *op = (const Variable *)n;
+        write_type(op->type);
+        write_string(op->name);
+        write_buffer(op->image);
+        write_param(op->param);
+        write_rdom(op->reduction_domain);
+        break;
+    }
+    case IRNodeType::Add:
+        write_binary<Add>(n);
+        break;
+    case IRNodeType::Sub:
+        write_binary<Sub>(n);
+        break;
+    case IRNodeType::Mod:
+        write_binary<Mod>(n);
+        break;
+    case IRNodeType::Mul:
+        write_binary<Mul>(n);
+        break;
+    case IRNodeType::Div:
+        write_binary<Div>(n);
+        break;
+    case IRNodeType::Min:
+        write_binary<Min>(n);
+        break;
+    case IRNodeType::Max:
+        write_binary<Max>(n);
+        break;
+    case IRNodeType::EQ:
+        write_binary<EQ>(n);
+        break;
+    case IRNodeType::NE:
+        write_binary<NE>(n);
+        break;
+    case IRNodeType::LT:
+        write_binary<LT>(n);
+        break;
+    case IRNodeType::LE:
+        write_binary<LE>(n);
+        break;
+    case IRNodeType::GT:
+        write_binary<GT>(n);
+        break;
+    case IRNodeType::GE:
+        write_binary<GE>(n);
+        break;
+    case IRNodeType::And:
+        write_binary<And>(n);
+        break;
+    case IRNodeType::Or:
+        write_binary<Or>(n);
+        break;
+    case IRNodeType::Not:
+        write_expr(((const Not *)n)->a);
+        break;
+    case IRNodeType::Select: {
+        const Select *op = (const Select *)n;
+        write_expr(op->condition);
+        write_expr(op->true_value);
+        write_expr(op->false_value);
+        break;
+    }
+    case IRNodeType::Load: {
+        const Load *op = (const Load *)n;
+        write_type(op->type);
+        write_string(op->name);
+        write_expr(op->index);
+        write_buffer(op->image);
+        write_param(op->param);
+        write_expr(op->predicate);
+        write_alignment(op->alignment);
+        break;
+    }
+    case IRNodeType::Ramp: {
+        const Ramp *op = (const Ramp *)n;
+        write_expr(op->base);
+        write_expr(op->stride);
+        write_varint(op->lanes);
+        break;
+    }
+    case IRNodeType::Call: {
+        const Call *op = (const Call *)n;
+        write_type(op->type);
+        write_string(op->name);
+        write_exprs(op->args);
+        write_enum(op->call_type);
+        write_func_ref(op->func);
+        write_int(op->value_index);
+        write_buffer(op->image);
+        write_param(op->param);
+        break;
+    }
+    case IRNodeType::Let: {
+        const Let *op = (const Let *)n;
+        write_string(op->name);
+        write_expr(op->value);
+        write_expr(op->body);
+        break;
+    }
+    case IRNodeType::Shuffle: {
+        const Shuffle *op = (const Shuffle *)n;
+        write_exprs(op->vectors);
+        write_varint(op->indices.size());
+        for (int i : op->indices) {
+            write_int(i);
+        }
+        break;
+    }
+    case IRNodeType::VectorReduce: {
+        const VectorReduce *op = (const VectorReduce *)n;
+        write_enum(op->op);
+        write_expr(op->value);
+        write_varint(op->type.lanes());
+        break;
+    }
+    case IRNodeType::LetStmt: {
+        const LetStmt *op = (const LetStmt *)n;
+        write_string(op->name);
+        write_expr(op->value);
+        write_stmt(op->body);
+        break;
+    }
+    case IRNodeType::AssertStmt: {
+        const AssertStmt *op = (const AssertStmt *)n;
+        write_expr(op->condition);
+        write_expr(op->message);
+        break;
+    }
+    case IRNodeType::ProducerConsumer: {
+        const ProducerConsumer *op = (const ProducerConsumer *)n;
+        write_string(op->name);
+        write_bool(op->is_producer);
+        write_stmt(op->body);
+        break;
+    }
+    case IRNodeType::For: {
+        const For *op = (const For *)n;
+        write_string(op->name);
+        write_expr(op->min);
+        write_expr(op->extent);
+        write_enum(op->for_type);
+        write_enum(op->device_api);
+        write_enum(op->partition);
+        write_stmt(op->body);
+        break;
+    }
+    case IRNodeType::Acquire: {
+        const Acquire *op = (const Acquire *)n;
+        write_expr(op->semaphore);
+        write_expr(op->count);
+        write_stmt(op->body);
+        break;
+    }
+    case IRNodeType::Store: {
+        const Store *op = (const Store *)n;
+        write_string(op->name);
+        write_expr(op->value);
+        write_expr(op->index);
+        write_param(op->param);
+        write_expr(op->predicate);
+        write_alignment(op->alignment);
+        break;
+    }
+    case IRNodeType::Provide: {
+        const Provide *op = (const Provide *)n;
+        write_string(op->name);
+        write_exprs(op->values);
+        write_exprs(op->args);
+        write_expr(op->predicate);
+        break;
+    }
+    case IRNodeType::Allocate: {
+        const Allocate *op = (const Allocate *)n;
+        write_string(op->name);
+        write_type(op->type);
+        write_enum(op->memory_type);
+        write_exprs(op->extents);
+        write_expr(op->condition);
+        write_stmt(op->body);
+        write_expr(op->new_expr);
+        write_string(op->free_function);
+        write_int(op->padding);
+        break;
+    }
+    case IRNodeType::Free:
+        write_string(((const Free *)n)->name);
+        break;
+    case IRNodeType::Realize: {
+        const Realize *op = (const Realize *)n;
+        write_string(op->name);
+        write_types(op->types);
+        write_enum(op->memory_type);
+        write_region(op->bounds);
+        write_expr(op->condition);
+        write_stmt(op->body);
+        break;
+    }
+    case IRNodeType::Block: {
+        const Block *op = (const Block *)n;
+        write_stmt(op->first);
+        write_stmt(op->rest);
+        break;
+    }
+    case IRNodeType::Fork: {
+        const Fork *op = (const Fork *)n;
+        write_stmt(op->first);
+        write_stmt(op->rest);
+        break;
+    }
+    case IRNodeType::IfThenElse: {
+        const IfThenElse *op = (const IfThenElse *)n;
+        write_expr(op->condition);
+        write_stmt(op->then_case);
+        write_stmt(op->else_case);
+        break;
+    }
+    case IRNodeType::Evaluate:
+        write_expr(((const Evaluate *)n)->value);
+        break;
+    case IRNodeType::Prefetch: {
+        const Prefetch *op = (const Prefetch *)n;
+        write_string(op->name);
+        write_types(op->types);
+        write_region(op->bounds);
+        write_prefetch(op->prefetch);
+        write_expr(op->condition);
+        write_stmt(op->body);
+        break;
+    }
+    case IRNodeType::Atomic: {
+        const Atomic *op = (const Atomic *)n;
+        write_string(op->producer_name);
+        write_string(op->mutex_name);
+        write_stmt(op->body);
+        break;
+    }
+    }
+
+    nodes.emplace(n, nodes.size());
+}
+
+class Deserializer {
+    const vector<uint8_t> &in;
+    size_t pos = 0;
+
+    const map<string, Parameter> &user_params;
+
+    // Weak references to the Functions being deserialized, for use
+    // within the group.
+    vector<FunctionPtr> funcs;
+
+    vector<string> strings;
+    vector<IRHandle> nodes;
+    vector<Parameter> params;
+    vector<Buffer<>> buffers;
+    vector<ReductionDomain> rdoms;
+
+    void check_available(size_t size) {
+        user_assert(size <= in.size() - pos)
+            << "Serialized Halide data is truncated\n";
+    }
+
+    template<typename T>
+    const T &lookup(const vector<T> &v, uint64_t idx, const char *what) {
+        user_assert(idx < v.size())
+            << "Serialized Halide data has a bad " << what << " reference\n";
+        return v[idx];
+    }
+
+public:
+    Deserializer(const vector<uint8_t> &in, const map<string, Parameter> &user_params)
+        : in(in), user_params(user_params) {
+    }
+
+    void read_header(PayloadKind expected) {
+        check_available(sizeof(serialization_magic));
+        user_assert(memcmp(in.data(), serialization_magic, sizeof(serialization_magic)) == 0)
+            << "Data is not a serialized Halide pipeline or module\n";
+        pos += sizeof(serialization_magic);
+        const uint64_t version = read_varint();
+        user_assert(version == serialization_version)
+            << "Serialized Halide data has version " << version
+            << ", but this version of Halide reads version " << serialization_version << "\n";
+        const PayloadKind kind = (PayloadKind)read_u8();
+        user_assert(kind == expected)
+            << "Serialized Halide data holds a "
+            << (kind == PayloadKind::Pipeline ? "Pipeline" : "Module")
+            << ", not a " << (expected == PayloadKind::Pipeline ? "Pipeline" : "Module") << "\n";
+    }
+
+    void check_done() {
+        user_assert(pos == in.size())
+            << "Serialized Halide data has " << (in.size() - pos) << " trailing bytes\n";
+    }
+
+    uint8_t read_u8() {
+        check_available(1);
+        return in[pos++];
+    }
+
+    uint64_t read_varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const uint8_t b = read_u8();
+            v |= (uint64_t)(b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                return v;
+            }
+        }
+        user_error << "Serialized Halide data has a bad varint\n";
+        return 0;
+    }
+
+    int64_t read_int() {
+        const uint64_t v = read_varint();
+        return (int64_t)((v >> 1) ^ (0 - (v & 1)));
+    }
+
+    bool read_bool() {
+        return read_u8() != 0;
+    }
+
+    uint64_t read_u64() {
+        uint64_t v = 0;
+        for (int i = 0; i < 8; i++) {
+            v |= (uint64_t)read_u8() << (i * 8);
+        }
+        return v;
+    }
+
+    template<typename E>
+    E read_enum() {
+        return (E)read_varint();
+    }
+
+    string read_string() {
+        const uint64_t ref = read_varint();
+        if (ref > 0) {
+            return lookup(strings, ref - 1, "string");
+        }
+        const uint64_t size = read_varint();
+        check_available(size);
+        strings.emplace_back((const char *)in.data() + pos, size);
+        pos += size;
+        return strings.back();
+    }
+
+    vector<string> read_strings() {
+        vector<string> v(read_varint());
+        for (string &s : v) {
+            s = read_string();
+        }
+        return v;
+    }
+
+    Type read_type() {
+        const uint8_t code = read_u8();
+        const uint8_t bits = read_u8();
+        const int lanes = (int)read_varint();
+        return Type((halide_type_code_t)code, bits, lanes);
+    }
+
+    vector<Type> read_types() {
+        vector<Type> v(read_varint());
+        for (Type &t : v) {
+            t = read_type();
+        }
+        return v;
+    }
+
+    IRHandle read_node();
+
+    Expr read_expr() {
+        IRHandle h = read_node();
+        user_assert(!h.defined() || h->node_type <= StrongestExprNodeType)
+            << "Serialized Halide data has a Stmt where an Expr should be\n";
+        return Expr((const BaseExprNode *)h.get());
+    }
+
+    Stmt read_stmt() {
+        IRHandle h = read_node();
+        user_assert(!h.defined() || h->node_type > StrongestExprNodeType)
+            << "Serialized Halide data has an Expr where a Stmt should be\n";
+        return Stmt((const BaseStmtNode *)h.get());
+    }
+
+    vector<Expr> read_exprs() {
+        vector<Expr> v(read_varint());
+        for (Expr &e : v) {
+            e = read_expr();
+        }
+        return v;
+    }
+
+    Region read_region() {
+        Region r(read_varint());
+        for (Range &range : r) {
+            range.min = read_expr();
+            range.extent = read_expr();
+        }
+        return r;
+    }
+
+    ModulusRemainder read_alignment() {
+        const int64_t modulus = read_int();
+        const int64_t remainder = read_int();
+        return ModulusRemainder(modulus, remainder);
+    }
+
+    template<typename T>
+    Expr read_binary() {
+        Expr a = read_expr();
+        Expr b = read_expr();
+        return T::make(std::move(a), std::move(b));
+    }
+
+    Parameter read_param() {
+        const uint64_t ref = read_varint();
+        if (ref == 0) {
+            return Parameter();
+        } else if (ref > 1) {
+            return lookup(params, ref - 2, "Parameter");
+        }
+        const Type t = read_type();
+        const bool is_buffer = read_bool();
+        const int dimensions = (int)read_int();
+        const string name = read_string();
+
+        // A Parameter supplied by the caller keeps its own constraints
+        // and value. We still have to read past the serialized ones.
+        auto it = user_params.find(name);
+        const bool replaced = it != user_params.end();
+        Parameter p = replaced ? it->second : Parameter(t, is_buffer, dimensions, name);
+        user_assert(p.type() == t && p.is_buffer() == is_buffer && p.dimensions() == dimensions)
+            << "The Parameter " << name << " passed in does not match the serialized one\n";
+        params.push_back(p);
+
+        if (is_buffer) {
+            const MemoryType memory_type = read_enum<MemoryType>();
+            for (int i = 0; i < dimensions; i++) {
+                Expr min = read_expr();
+                Expr extent = read_expr();
+                Expr stride = read_expr();
+                Expr min_estimate = read_expr();
+                Expr extent_estimate = read_expr();
+                if (!replaced) {
+                    p.set_min_constraint(i, min);
+                    p.set_extent_constraint(i, extent);
+                    p.set_stride_constraint(i, stride);
+                    p.set_min_constraint_estimate(i, min_estimate);
+                    p.set_extent_constraint_estimate(i, extent_estimate);
+                }
+            }
+            const int host_alignment = (int)read_int();
+            if (!replaced) {
+                p.store_in(memory_type);
+                p.set_host_alignment(host_alignment);
+            }
+        } else {
+            const uint64_t bits = read_u64();
+            Expr min_value = read_expr();
+            Expr max_value = read_expr();
+            Expr estimate = read_expr();
+            Expr default_value = read_expr();
+            if (!replaced) {
+                halide_scalar_value_t value;
+                value.u.u64 = bits;
+                p.set_scalar(t, value);
+                p.set_min_value(min_value);
+                p.set_max_value(max_value);
+                p.set_estimate(estimate);
+                p.set_default_value(default_value);
+            }
+        }
+        return p;
+    }
+
+    Buffer<> read_buffer() {
+        const uint64_t ref = read_varint();
+        if (ref == 0) {
+            return Buffer<>();
+        } else if (ref > 1) {
+            return lookup(buffers, ref - 2, "Buffer");
+        }
+        const string name = read_string();
+        const Type t = read_type();
+        const int dimensions = (int)read_varint();
+        vector<int> mins(dimensions), extents(dimensions), strides(dimensions);
+        for (int i = 0; i < dimensions; i++) {
+            mins[i] = (int)read_int();
+            extents[i] = (int)read_int();
+            strides[i] = (int)read_int();
+        }
+        // Recreate the storage order from the strides.
+        vector<int> storage_order(dimensions);
+        for (int i = 0; i < dimensions; i++) {
+            storage_order[i] = i;
+        }
+        std::stable_sort(storage_order.begin(), storage_order.end(),
+                         [&](int a, int b) { return strides[a] < strides[b]; });
+        Buffer<> b(t, extents, storage_order, name);
+        b.set_min(mins);
+        const uint64_t size = read_varint();
+        user_assert(size == b.size_in_bytes())
+            << "Serialized Buffer " << name << " has the wrong size\n";
+        check_available(size);
+        memcpy(b.data(), in.data() + pos, size);
+        pos += size;
+        buffers.push_back(b);
+        return b;
+    }
+
+    vector<ReductionVariable> read_rvars() {
+        vector<ReductionVariable> v(read_varint());
+        for (ReductionVariable &rv : v) {
+            rv.var = read_string();
+            rv.min = read_expr();
+            rv.extent = read_expr();
+        }
+        return v;
+    }
+
+    ReductionDomain read_rdom() {
+        const uint64_t ref = read_varint();
+        if (ref == 0) {
+            return ReductionDomain();
+        } else if (ref > 1) {
+            return lookup(rdoms, ref - 2, "ReductionDomain");
+        }
+        ReductionDomain r(read_rvars());
+        rdoms.push_back(r);
+        Expr predicate = read_expr();
+        if (predicate.defined()) {
+            r.set_predicate(predicate);
+        }
+        if (read_bool()) {
+            r.freeze();
+        }
+        return r;
+    }
+
+    void set_funcs(const vector<FunctionPtr> &group) {
+        for (FunctionPtr f : group) {
+            f.weaken();
+            funcs.push_back(f);
+        }
+    }
+
+    FunctionPtr read_func_ref() {
+        const uint64_t ref = read_varint();
+        if (ref == 0) {
+            return FunctionPtr();
+        }
+        return lookup(funcs, ref - 1, "Func");
+    }
+
+    LoopLevel read_loop_level() {
+        const string func_name = read_string();
+        const string var_name = read_string();
+        const bool is_rvar = read_bool();
+        const int stage_index = (int)read_int();
+        const bool locked = read_bool();
+        return LoopLevel(func_name, var_name, is_rvar, stage_index, locked);
+    }
+
+    vector<Bound> read_bounds() {
+        vector<Bound> v(read_varint());
+        for (Bound &b : v) {
+            b.var = read_string();
+            b.min = read_expr();
+            b.extent = read_expr();
+            b.modulus = read_expr();
+            b.remainder = read_expr();
+        }
+        return v;
+    }
+
+    PrefetchDirective read_prefetch() {
+        PrefetchDirective p;
+        p.name = read_string();
+        p.at = read_string();
+        p.from = read_string();
+        p.offset = read_expr();
+        p.strategy = read_enum<PrefetchBoundStrategy>();
+        p.param = read_param();
+        return p;
+    }
+
+    FuncSchedule read_func_schedule() {
+        FuncSchedule s;
+        s.store_level() = read_loop_level();
+        s.compute_level() = read_loop_level();
+        s.storage_dims().resize(read_varint());
+        for (StorageDim &d : s.storage_dims()) {
+            d.var = read_string();
+            d.alignment = read_expr();
+            d.bound = read_expr();
+            d.fold_factor = read_expr();
+            d.fold_forward = read_bool();
+        }
+        s.bounds() = read_bounds();
+        s.estimates() = read_bounds();
+        const uint64_t wrappers = read_varint();
+        for (uint64_t i = 0; i < wrappers; i++) {
+            const string name = read_string();
+            s.wrappers()[name] = read_func_ref();
+        }
+        s.memory_type() = read_enum<MemoryType>();
+        s.memoized() = read_bool();
+        s.async() = read_bool();
+        s.memoize_eviction_key() = read_expr();
+        return s;
+    }
+
+    void read_stage_schedule(StageSchedule &s) {
+        s.rvars() = read_rvars();
+        s.splits().resize(read_varint());
+        for (Split &split : s.splits()) {
+            split.old_var = read_string();
+            split.outer = read_string();
+            split.inner = read_string();
+            split.factor = read_expr();
+            split.exact = read_bool();
+            split.tail = read_enum<TailStrategy>();
+            split.split_type = read_enum<Split::SplitType>();
+        }
+        s.dims().resize(read_varint());
+        for (Dim &d : s.dims()) {
+            d.var = read_string();
+            d.for_type = read_enum<ForType>();
+            d.device_api = read_enum<DeviceAPI>();
+            d.dim_type = read_enum<DimType>();
+            d.partition = read_enum<TaskPartition>();
+        }
+        s.prefetches().resize(read_varint());
+        for (PrefetchDirective &p : s.prefetches()) {
+            p = read_prefetch();
+        }
+        s.fuse_level().level = read_loop_level();
+        const uint64_t aligns = read_varint();
+        for (uint64_t i = 0; i < aligns; i++) {
+            const string var = read_string();
+            s.fuse_level().align[var] = read_enum<LoopAlignStrategy>();
+        }
+        s.fused_pairs().resize(read_varint());
+        for (FusedPair &p : s.fused_pairs()) {
+            p.func_1 = read_string();
+            p.func_2 = read_string();
+            p.stage_1 = read_varint();
+            p.stage_2 = read_varint();
+            p.var_name = read_string();
+        }
+        s.touched() = read_bool();
+        s.allow_race_conditions() = read_bool();
+        s.atomic() = read_bool();
+        s.override_atomic_associativity_test() = read_bool();
+    }
+
+    Definition read_definition() {
+        const bool is_init = read_bool();
+        Expr predicate = read_expr();
+        vector<Expr> args = read_exprs();
+        vector<Expr> values = read_exprs();
+        Definition d(args, values, ReductionDomain(), is_init);
+        d.predicate() = predicate;
+        read_stage_schedule(d.schedule());
+        d.specializations().resize(read_varint());
+        for (Specialization &s : d.specializations()) {
+            s.condition = read_expr();
+            s.definition = read_definition();
+            s.failure_message = read_string();
+        }
+        return d;
+    }
+
+    void read_function(Function f) {
+        const string origin_name = read_string();
+        const vector<Type> output_types = read_types();
+        const vector<Type> required_types = read_types();
+        const int required_dims = (int)read_int();
+        const vector<string> args = read_strings();
+        const FuncSchedule func_schedule = read_func_schedule();
+        Definition init_def;
+        if (read_bool()) {
+            init_def = read_definition();
+        }
+        vector<Definition> updates(read_varint());
+        for (Definition &d : updates) {
+            d = read_definition();
+        }
+        const string debug_file = read_string();
+        vector<Parameter> output_buffers(read_varint());
+        for (Parameter &p : output_buffers) {
+            p = read_param();
+        }
+        vector<ExternFuncArgument> extern_arguments(read_varint());
+        for (ExternFuncArgument &a : extern_arguments) {
+            a.arg_type = read_enum<ExternFuncArgument::ArgType>();
+            switch (a.arg_type) {
+            case ExternFuncArgument::UndefinedArg:
+                break;
+            case ExternFuncArgument::FuncArg:
+                a.func = read_func_ref();
+                break;
+            case ExternFuncArgument::BufferArg:
+                a.buffer = read_buffer();
+                break;
+            case ExternFuncArgument::ExprArg:
+                a.expr = read_expr();
+                break;
+            case ExternFuncArgument::ImageParamArg:
+                a.image_param = read_param();
+                break;
+            default:
+                user_error << "Serialized Halide data has a bad extern argument\n";
+            }
+        }
+        const string extern_function_name = read_string();
+        const NameMangling mangling = read_enum<NameMangling>();
+        const DeviceAPI device_api = read_enum<DeviceAPI>();
+        const Expr extern_proxy_expr = read_expr();
+        const bool trace_loads = read_bool();
+        const bool trace_stores = read_bool();
+        const bool trace_realizations = read_bool();
+        const vector<string> trace_tags = read_strings();
+        const bool frozen = read_bool();
+        f.update_with_deserialization(origin_name, output_types, required_types, required_dims,
+                                      args, func_schedule, init_def, updates, debug_file,
+                                      output_buffers, extern_arguments, extern_function_name,
+                                      mangling, device_api, extern_proxy_expr,
+                                      trace_loads, trace_stores, trace_realizations,
+                                      trace_tags, frozen);
+    }
+
+    Module read_module() {
+        const string name = read_string();
+        const Target target(read_string());
+        MetadataNameMap names;
+        const uint64_t num_names = read_varint();
+        for (uint64_t i = 0; i < num_names; i++) {
+            const string from = read_string();
+            names[from] = read_string();
+        }
+        Module m(name, target, names);
+        m.set_any_strict_float(read_bool());
+        const uint64_t num_buffers = read_varint();
+        for (uint64_t i = 0; i < num_buffers; i++) {
+            m.append(read_buffer());
+        }
+        const uint64_t num_functions = read_varint();
+        for (uint64_t i = 0; i < num_functions; i++) {
+            const string fn_name = read_string();
+            vector<LoweredArgument> args(read_varint());
+            for (LoweredArgument &a : args) {
+                a.name = read_string();
+                a.kind = read_enum<Argument::Kind>();
+                a.type = read_type();
+                a.dimensions = (uint8_t)read_varint();
+                a.argument_estimates.scalar_def = read_expr();
+                a.argument_estimates.scalar_min = read_expr();
+                a.argument_estimates.scalar_max = read_expr();
+                a.argument_estimates.scalar_estimate = read_expr();
+                a.argument_estimates.buffer_estimates = read_region();
+                a.alignment = read_alignment();
+            }
+            Stmt body = read_stmt();
+            const LinkageType linkage = read_enum<LinkageType>();
+            const NameMangling mangling = read_enum<NameMangling>();
+            m.append(LoweredFunc(fn_name, args, body, linkage, mangling));
+        }
+        const uint64_t num_submodules = read_varint();
+        for (uint64_t i = 0; i < num_submodules; i++) {
+            m.append(read_module());
+        }
+        return m;
+    }
+};
+
+IRHandle Deserializer::read_node() {
+    const uint64_t ref = read_varint();
+    if (ref == 0) {
+        return IRHandle();
+    } else if (ref > 1) {
+        return lookup(nodes, ref - 2, "IR node");
+    }
+
+    const IRNodeType node_type = read_enum<IRNodeType>();
+    IRHandle result;
+    switch (node_type) {
+    case IRNodeType::IntImm: {
+        const Type t = read_type();
+        result = IntImm::make(t, read_int());
+        break;
+    }
+    case IRNodeType::UIntImm: {
+        const Type t = read_type();
+        result = UIntImm::make(t, read_varint());
+        break;
+    }
+    case IRNodeType::FloatImm: {
+        const Type t = read_type();
+        const uint64_t bits = read_u64();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        result = FloatImm::make(t, value);
+        break;
+    }
+    case IRNodeType::StringImm:
+        result = StringImm::make(read_string());
+        break;
+    case IRNodeType::Broadcast: {
+        Expr value = read_expr();
+        const int lanes = (int)read_varint();
+        result = Broadcast::make(value, lanes);
+        break;
+    }
+    case IRNodeType::Cast: {
+        const Type t = read_type();
+        result = Cast::make(t, read_expr());
+        break;
+    }
+    case IRNodeType::Reinterpret: {
+        const Type t = read_type();
+        result = Reinterpret::make(t, read_expr());
+        break;
+    }
+    case IRNodeType::Variable: {
+        const Type t = read_type();
+        const string name = read_string();
+        Buffer<> image = read_buffer();
+        Parameter param = read_param();
+        ReductionDomain rdom = read_rdom();
+        result = Variable::make(t, name, image, param, rdom);
+        break;
+    }
+    case IRNodeType::Add:
+        result = read_binary<Add>();
+        break;
+    case IRNodeType::Sub:
+        result = read_binary<Sub>();
+        break;
+    case IRNodeType::Mod:
+        result = read_binary<Mod>();
+        break;
+    case IRNodeType::Mul:
+        result = read_binary<Mul>();
+        break;
+    case IRNodeType::Div:
+        result = read_binary<Div>();
+        break;
+    case IRNodeType::Min:
+        result = read_binary<Min>();
+        break;
+    case IRNodeType::Max:
+        result = read_binary<Max>();
+        break;
+    case IRNodeType::EQ:
+        result = read_binary<EQ>();
+        break;
+    case IRNodeType::NE:
+        result = read_binary<NE>();
+        break;
+    case IRNodeType::LT:
+        result = read_binary<LT>();
+        break;
+    case IRNodeType::LE:
+        result = read_binary<LE>();
+        break;
+    case IRNodeType::GT:
+        result = read_binary<GT>();
+        break;
+    case IRNodeType::GE:
+        result = read_binary<GE>();
+        break;
+    case IRNodeType::And:
+        result = read_binary<And>();
+        break;
+    case IRNodeType::Or:
+        result = read_binary<Or>();
+        break;
+    case IRNodeType::Not:
+        result = Not::make(read_expr());
+        break;
+    case IRNodeType::Select: {
+        Expr condition = read_expr();
+        Expr true_value = read_expr();
+        Expr false_value = read_expr();
+        result = Select::make(condition, true_value, false_value);
+        break;
+    }
+    case IRNodeType::Load: {
+        const Type t = read_type();
+        const string name = read_string();
+        Expr index = read_expr();
+        Buffer<> image = read_buffer();
+        Parameter param = read_param();
+        Expr predicate = read_expr();
+        const ModulusRemainder alignment = read_alignment();
+        result = Load::make(t, name, index, image, param, predicate, alignment);
+        break;
+    }
+    case IRNodeType::Ramp: {
+        Expr base = read_expr();
+        Expr stride = read_expr();
+        const int lanes = (int)read_varint();
+        result = Ramp::make(base, stride, lanes);
+        break;
+    }
+    case IRNodeType::Call: {
+        const Type t = read_type();
+        const string name = read_string();
+        vector<Expr> args = read_exprs();
+        const Call::CallType call_type = read_enum<Call::CallType>();
+        FunctionPtr func = read_func_ref();
+        const int value_index = (int)read_int();
+        Buffer<> image = read_buffer();
+        Parameter param = read_param();
+        result = Call::make(t, name, args, call_type, func, value_index, image, param);
+        break;
+    }
+    case IRNodeType::Let: {
+        const string name = read_string();
+        Expr value = read_expr();
+        Expr body = read_expr();
+        result = Let::make(name, value, body);
+        break;
+    }
+    case IRNodeType::Shuffle: {
+        vector<Expr> vectors = read_exprs();
+        vector<int> indices(read_varint());
+        for (int &i : indices) {
+            i = (int)read_int();
+        }
+        result = Shuffle::make(vectors, indices);
+        break;
+    }
+    case IRNodeType::VectorReduce: {
+        const VectorReduce::Operator op = read_enum<VectorReduce::Operator>();
+        Expr value = read_expr();
+        const int lanes = (int)read_varint();
+        result = VectorReduce::make(op, value, lanes);
+        break;
+    }
+    case IRNodeType::LetStmt: {
+        const string name = read_string();
+        Expr value = read_expr();
+        Stmt body = read_stmt();
+        result = LetStmt::make(name, value, body);
+        break;
+    }
+    case IRNodeType::AssertStmt: {
+        Expr condition = read_expr();
+        Expr message = read_expr();
+        result = AssertStmt::make(condition, message);
+        break;
+    }
+    case IRNodeType::ProducerConsumer: {
+        const string name = read_string();
+        const bool is_producer = read_bool();
+        result = ProducerConsumer::make(name, is_producer, read_stmt());
+        break;
+    }
+    case IRNodeType::For: {
+        const string name = read_string();
+        Expr min = read_expr();
+        Expr extent = read_expr();
+        const ForType for_type = read_enum<ForType>();
+        const DeviceAPI device_api = read_enum<DeviceAPI>();
+        const TaskPartition partition = read_enum<TaskPartition>();
+        Stmt body = read_stmt();
+        result = For::make(name, min, extent, for_type, device_api, body, partition);
+        break;
+    }
+    case IRNodeType::Acquire: {
+        Expr semaphore = read_expr();
+        Expr count = read_expr();
+        Stmt body = read_stmt();
+        result = Acquire::make(semaphore, count, body);
+        break;
+    }
+    case IRNodeType::Store: {
+        const string name = read_string();
+        Expr value = read_expr();
+        Expr index = read_expr();
+        Parameter param = read_param();
+        Expr predicate = read_expr();
+        const ModulusRemainder alignment = read_alignment();
+        result = Store::make(name, value, index, param, predicate, alignment);
+        break;
+    }
+    case IRNodeType::Provide: {
+        const string name = read_string();
+        vector<Expr> values = read_exprs();
+        vector<Expr> args = read_exprs();
+        Expr predicate = read_expr();
+        result = Provide::make(name, values, args, predicate);
+        break;
+    }
+    case IRNodeType::Allocate: {
+        const string name = read_string();
+        const Type t = read_type();
+        const MemoryType memory_type = read_enum<MemoryType>();
+        vector<Expr> extents = read_exprs();
+        Expr condition = read_expr();
+        Stmt body = read_stmt();
+        Expr new_expr = read_expr();
+        const string free_function = read_string();
+        const int padding = (int)read_int();
+        result = Allocate::make(name, t, memory_type, extents, condition, body,
+                                new_expr, free_function, padding);
+        break;
+    }
+    case IRNodeType::Free:
+        result = Free::make(read_string());
+        break;
+    case IRNodeType::Realize: {
+        const string name = read_string();
+        const vector<Type> types = read_types();
+        const MemoryType memory_type = read_enum<MemoryType>();
+        const Region bounds = read_region();
+        Expr condition = read_expr();
+        Stmt body = read_stmt();
+        result = Realize::make(name, types, memory_type, bounds, condition, body);
+        break;
+    }
+    case IRNodeType::Block: {
+        Stmt first = read_stmt();
+        Stmt rest = read_stmt();
+        result = Block::make(first, rest);
+        break;
+    }
+    case IRNodeType::Fork: {
+        Stmt first = read_stmt();
+        Stmt rest = read_stmt();
+        result = Fork::make(first, rest);
+        break;
+    }
+    case IRNodeType::IfThenElse: {
+        Expr condition = read_expr();
+        Stmt then_case = read_stmt();
+        Stmt else_case = read_stmt();
+        result = IfThenElse::make(condition, then_case, else_case);
+        break;
+    }
+    case IRNodeType::Evaluate:
+        result = Evaluate::make(read_expr());
+        break;
+    case IRNodeType::Prefetch: {
+        const string name = read_string();
+        const vector<Type> types = read_types();
+        const Region bounds = read_region();
+        const PrefetchDirective prefetch = read_prefetch();
+        Expr condition = read_expr();
+        Stmt body = read_stmt();
+        result = Prefetch::make(name, types, bounds, prefetch, condition, body);
+        break;
+    }
+    case IRNodeType::Atomic: {
+        const string producer_name = read_string();
+        const string mutex_name = read_string();
+        result = Atomic::make(producer_name, mutex_name, read_stmt());
+        break;
+    }
+    default:
+        user_error << "Serialized Halide data has a bad IR node type\n";
+    }
+
+    nodes.push_back(result);
+    return result;
+}
+
+}  // namespace
+
+vector<uint8_t> serialize_pipeline(const vector<Function> &outputs,
+                                   const vector<Stmt> &requirements,
+                                   bool trace_pipeline) {
+    vector<uint8_t> result;
+    Serializer s(result, true);
+    s.write_header(PayloadKind::Pipeline);
+
+    // Write all the names up front, so that the Functions can be
+    // referred to before they are written.
+    const map<string, Function> env = build_environment(outputs);
+    s.add_funcs(env);
+    s.write_varint(env.size());
+    for (const auto &it : env) {
+        s.write_string(it.first);
+    }
+    for (const auto &it : env) {
+        s.write_function(it.second);
+    }
+
+    map<string, size_t> indices;
+    for (const auto &it : env) {
+        indices.emplace(it.first, indices.size());
+    }
+    s.write_varint(outputs.size());
+    for (const Function &f : outputs) {
+        s.write_varint(indices.at(f.name()));
+    }
+    s.write_varint(requirements.size());
+    for (const Stmt &r : requirements) {
+        s.write_stmt(r);
+    }
+    s.write_bool(trace_pipeline);
+    return result;
+}
+
+void deserialize_pipeline(const vector<uint8_t> &data,
+                          const map<string, Parameter> &params,
+                          vector<Function> &outputs,
+                          vector<Stmt> &requirements,
+                          bool &trace_pipeline) {
+    Deserializer d(data, params);
+    d.read_header(PayloadKind::Pipeline);
+
+    const vector<FunctionPtr> group = make_function_group(d.read_strings());
+    d.set_funcs(group);
+    for (const FunctionPtr &f : group) {
+        d.read_function(Function(f));
+    }
+
+    outputs.resize(d.read_varint());
+    for (Function &f : outputs) {
+        const uint64_t idx = d.read_varint();
+        user_assert(idx < group.size())
+            << "Serialized Halide data has a bad output Func\n";
+        f = Function(group[idx]);
+    }
+    requirements.resize(d.read_varint());
+    for (Stmt &r : requirements) {
+        r = d.read_stmt();
+    }
+    trace_pipeline = d.read_bool();
+    d.check_done();
+}
+
+}  // namespace Internal
+
+using namespace Halide::Internal;
+
+std::vector<uint8_t> serialize_module(const Module &module) {
+    std::vector<uint8_t> result;
+    Serializer s(result, false);
+    s.write_header(PayloadKind::Module);
+    s.write_module(module);
+    return result;
+}
+
+Module deserialize_module(const std::vector<uint8_t> &data,
+                          const std::map<std::string, Internal::Parameter> &params) {
+    Deserializer d(data, params);
+    d.read_header(PayloadKind::Module);
+    Module m = d.read_module();
+    d.check_done();
+    return m;
+}
+
+}  // namespace Halide
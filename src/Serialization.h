@@ -0,0 +1,66 @@
+#ifndef HALIDE_SERIALIZATION_H
+#define HALIDE_SERIALIZATION_H
+
+/** \file
+ *
+ * Defines a compact binary format for Halide pipelines and lowered
+ * Modules, so they can be saved and loaded without re-running the
+ * code that built them.
+ *
+ * The format is a versioned stream of LEB128 varints. Strings, IR
+ * nodes, Parameters, Buffers and reduction domains are written once
+ * and referred to by index thereafter, so shared subexpressions stay
+ * shared after a round trip. It does not record:
+ * - The Buffers bound to ImageParams. Pass in the Parameters to use
+ *   (keyed by name) when deserializing to reconnect them.
+ * - The C++ type of handle-typed values.
+ * - Custom lowering passes, JIT handlers, autoscheduler results or
+ *   anything else that is not part of the Func DAG or the IR.
+ */
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Expr.h"
+#include "Module.h"
+#include "Parameter.h"
+
+namespace Halide {
+
+namespace Internal {
+
+class Function;
+
+/** Serialize the Func DAG reachable from the given outputs, along with
+ * their schedules and the pipeline's requirements. */
+std::vector<uint8_t> serialize_pipeline(const std::vector<Function> &outputs,
+                                        const std::vector<Stmt> &requirements,
+                                        bool trace_pipeline);
+
+/** Reconstruct a Func DAG written by serialize_pipeline. Any Parameter
+ * in the serialized pipeline with the same name as one in params is
+ * replaced by it; the rest are recreated unbound. All of the
+ * deserialized Functions share a single lifetime. */
+void deserialize_pipeline(const std::vector<uint8_t> &data,
+                          const std::map<std::string, Parameter> &params,
+                          std::vector<Function> &outputs,
+                          std::vector<Stmt> &requirements,
+                          bool &trace_pipeline);
+
+}  // namespace Internal
+
+/** Serialize a lowered Module, including its submodules and any
+ * Buffers it contains. Calls to Funcs in the IR lose their reference
+ * to the Func, which codegen does not need. */
+std::vector<uint8_t> serialize_module(const Module &module);
+
+/** Reconstruct a Module written by serialize_module. Parameters are
+ * matched by name against params, as for Pipeline::deserialize. */
+Module deserialize_module(const std::vector<uint8_t> &data,
+                          const std::map<std::string, Internal::Parameter> &params = {});
+
+}  // namespace Halide
+
+#endif
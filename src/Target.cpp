@@ -552,6 +552,10 @@ const std::map<std::string, Target::Feature> feature_name_map = {
     {"vk_v12", Target::VulkanV12},
     {"vk_v13", Target::VulkanV13},
     {"semihosting", Target::Semihosting},
+    {"pooled_malloc", Target::PooledMalloc},
+    {"scratch_arena", Target::ScratchArena},
+    {"profile_instrumented", Target::ProfileInstrumented},
+    {"profile_loops", Target::ProfileLoops},
     // NOTE: When adding features to this map, be sure to update PyEnums.cpp as well.
 };
 
@@ -1238,7 +1242,7 @@ bool Target::get_runtime_compatible_target(const Target &other, Target &result)
     // (c) must match across both targets; it is an error if one target has the feature and the other doesn't
 
     // clang-format off
-    const std::array<Feature, 23> union_features = {{
+    const std::array<Feature, 24> union_features = {{
         // These are true union features.
         CUDA,
         D3D12Compute,
@@ -1248,6 +1252,7 @@ bool Target::get_runtime_compatible_target(const Target &other, Target &result)
         OpenGLCompute,
         Vulkan,
         WebGPU,
+        PooledMalloc,
 
         // These features are actually intersection-y, but because targets only record the _highest_,
         // we have to put their union in the result and then take a lower bound.
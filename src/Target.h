@@ -167,6 +167,10 @@ struct Target {
         VulkanV12 = halide_target_feature_vulkan_version12,
         VulkanV13 = halide_target_feature_vulkan_version13,
         Semihosting = halide_target_feature_semihosting,
+        PooledMalloc = halide_target_feature_pooled_malloc,
+        ScratchArena = halide_target_feature_scratch_arena,
+        ProfileInstrumented = halide_target_feature_profile_instrumented,
+        ProfileLoops = halide_target_feature_profile_loops,
         FeatureEnd = halide_target_feature_end
     };
     Target() = default;
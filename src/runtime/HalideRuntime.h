@@ -287,6 +287,12 @@ struct halide_parallel_task_t {
     // one executing at a time. If false, any order is fine, and
     // concurrency is fine.
     bool serial;
+
+    // If true (and serial is false), the function should be called on
+    // chunks of iterations that shrink as the range drains, rather
+    // than one iteration at a time. Set by scheduling a loop with
+    // TaskPartition::Guided.
+    bool guided;
 };
 
 /** Enqueue some number of the tasks described above and wait for them
@@ -379,6 +385,141 @@ extern void halide_join_thread(struct halide_thread *);
  */
 extern int halide_set_num_threads(int n);
 
+/** Select how the default thread pool distributes the iterations of
+ * parallel loops that do not wait on semaphores. When enabled, each
+ * loop is split into one contiguous range of iterations per worker
+ * thread, which the worker pulls from without taking the thread pool
+ * lock, and idle workers steal half of the remaining iterations of a
+ * randomly-chosen busy worker. When disabled, workers claim one
+ * iteration at a time from a job queue shared by all threads. Loops
+ * that acquire semaphores (e.g. consumers of async producers) always
+ * use the shared job queue. Returns the old setting.
+ *
+ * The initial setting is taken from the environment variable
+ * HL_WORK_STEALING, and is off if it is unset or zero.
+ *
+ * (As with halide_set_num_threads, this only affects the default
+ * implementations of halide_do_par_for and halide_do_parallel_tasks.)
+ */
+extern bool halide_set_work_stealing(bool enabled);
+
+/** Make the default thread pool NUMA-aware. When enabled, worker
+ * threads spawned afterwards are dealt out round-robin to the host's
+ * NUMA nodes and pinned to the cpus of their node, and parallel loops
+ * are distributed by work stealing (see halide_set_work_stealing) with
+ * their per-thread ranges split into one contiguous block per node. A
+ * thread joining a loop takes a range from its own node's block if it
+ * can, and idle threads steal from threads on their own node before
+ * stealing from other nodes. Because the same iterations of a loop
+ * go to the same node on every run, memory first touched by one
+ * parallel loop stays local to the threads that use it in later loops
+ * over the same domain.
+ *
+ * Workers that are already running are not re-pinned, so this should
+ * be called before the thread pool is first used, or followed by
+ * halide_shutdown_thread_pool. This has no effect on hosts with a
+ * single NUMA node, or on platforms where the topology can't be
+ * determined (currently everything except Linux). Returns the old
+ * setting.
+ *
+ * The initial setting is taken from the environment variable
+ * HL_NUMA_AFFINITY, and is off if it is unset or zero.
+ */
+extern bool halide_set_numa_affinity(bool enabled);
+
+/** Get the number of NUMA nodes the default thread pool can spread
+ * work across. Returns 1 if the topology can't be determined. */
+extern int halide_get_numa_node_count();
+
+/** An opaque struct representing a thread pool, with its own worker
+ * threads and job queue, that is separate from the default one. */
+struct halide_thread_pool_t;
+
+/** Create a new thread pool with the given number of threads (0 means
+ * use the same default as halide_set_num_threads). No threads are
+ * spawned until the pool is first used. The pool starts with the work
+ * stealing and NUMA affinity settings of the default pool. Returns
+ * nullptr on failure. */
+extern struct halide_thread_pool_t *halide_thread_pool_create(int num_threads);
+
+/** Shut down a thread pool made by halide_thread_pool_create and free
+ * its resources. Nothing may be running on the pool when it is
+ * destroyed. */
+extern void halide_thread_pool_destroy(struct halide_thread_pool_t *pool);
+
+/** Halide calls this function to find the thread pool that the
+ * parallel work of a pipeline invocation should run on, given the
+ * invocation's user_context. A return value of nullptr means the
+ * default thread pool. Nested parallel work always runs on the same
+ * pool as its parent. The default implementation always returns
+ * nullptr. To route different pipelines or calls to different pools,
+ * set a custom handler that looks up the pool from the user_context
+ * (in JIT-compiled code, use JITHandlers::custom_get_thread_pool).
+ *
+ * (As with halide_set_num_threads, this only affects the default
+ * implementations of halide_do_par_for and halide_do_parallel_tasks.)
+ */
+// @{
+extern struct halide_thread_pool_t *halide_get_thread_pool(void *user_context);
+typedef struct halide_thread_pool_t *(*halide_get_thread_pool_t)(void *user_context);
+extern halide_get_thread_pool_t halide_set_custom_get_thread_pool(halide_get_thread_pool_t f);
+extern struct halide_thread_pool_t *halide_default_get_thread_pool(void *user_context);
+// @}
+
+/** Counters describing what the threads of a thread pool have been
+ * doing, for telling e.g. whether a slow pipeline is compute-bound or
+ * starved of work. Times are in nanoseconds, and are zero on
+ * platforms without a clock. */
+struct halide_thread_pool_stats_t {
+    /** The number of calls made to task functions. A call on a chunk
+     * of iterations (serial or guided loops) counts once. */
+    uint64_t tasks_run;
+
+    /** The number of parallel jobs enqueued: one per call to
+     * halide_do_par_for, and one per task of a call to
+     * halide_do_parallel_tasks. */
+    uint64_t jobs_enqueued;
+
+    /** The number of times a thread took iterations from another
+     * thread's range (see halide_set_work_stealing). */
+    uint64_t steals;
+
+    /** Time spent idle, spinning while waiting for work. */
+    uint64_t spin_ns;
+
+    /** Time spent idle, asleep while waiting for work. */
+    uint64_t sleep_ns;
+
+    /** The part of the idle time during which the only jobs that
+     * could have run were waiting to acquire semaphores, e.g. the
+     * consumers of async producers. */
+    uint64_t semaphore_wait_ns;
+
+    /** The largest number of jobs in the queue at once. */
+    int max_queue_depth;
+};
+
+/** Get the counters of a thread pool (nullptr means the default
+ * pool). The counters are kept for each thread, and accumulate until
+ * halide_thread_pool_reset_stats is called, including across calls to
+ * halide_shutdown_thread_pool. Their sum over all threads is written
+ * to total, if it is non-null. The counters of at most max_threads
+ * threads are written to per_thread, if it is non-null. The first
+ * entry is shared by all threads that are waiting on parallel work
+ * they enqueued: threads calling into Halide, and workers running
+ * nested parallel loops. The rest are the pool's workers, in the order
+ * they started. Returns the number of entries there are in total. The
+ * counters are always maintained, and cost a few increments per task
+ * and two clock reads each time a thread goes idle. */
+extern int halide_thread_pool_get_stats(struct halide_thread_pool_t *pool,
+                                        struct halide_thread_pool_stats_t *total,
+                                        struct halide_thread_pool_stats_t *per_thread,
+                                        int max_threads);
+
+/** Zero the counters of a thread pool (nullptr means the default
+ * pool). */
+extern void halide_thread_pool_reset_stats(struct halide_thread_pool_t *pool);
+
 /** Halide calls these functions to allocate and free memory. To
  * replace in AOT code, use the halide_set_custom_malloc and
  * halide_set_custom_free, or (on platforms that support weak
@@ -407,6 +548,70 @@ extern halide_malloc_t halide_set_custom_malloc(halide_malloc_t user_malloc);
 extern halide_free_t halide_set_custom_free(halide_free_t user_free);
 //@}
 
+/** A pooling replacement for halide_default_malloc/free. Freed blocks
+ * are kept on free lists bucketed by size class (steps of 1x and 1.5x
+ * a power of two, up to 16 MB) and handed back out to later
+ * allocations of the same class, so pipelines that allocate on every
+ * tile or every invocation stop paying for the system allocator.
+ * Requests larger than 16 MB are passed straight through.
+ *
+ * Install both with halide_set_custom_malloc/free before running any
+ * pipeline, or compile with Target::PooledMalloc to have the runtime
+ * install them at load time. Memory from halide_pooled_malloc must
+ * only be released with halide_pooled_free, and vice versa. */
+//@{
+extern void *halide_pooled_malloc(void *user_context, size_t x);
+extern void halide_pooled_free(void *user_context, void *ptr);
+//@}
+
+/** Set the most memory, in bytes, that the pooled allocator keeps
+ * around in free blocks. Blocks freed beyond this are returned to the
+ * system. The default is 256 MB. */
+extern void halide_pooled_malloc_set_cache_limit(int64_t bytes);
+
+/** Return all free blocks held by the pooled allocator to the
+ * system. Blocks that are still in use are unaffected. */
+extern void halide_pooled_malloc_release_unused(void *user_context);
+
+/** Pipelines compiled with Target::ScratchArena call these once per
+ * invocation to get and give back a single block of memory, from
+ * which they carve all of their top-level heap allocations. The
+ * default implementations use halide_malloc and halide_free. To hand
+ * the pipeline a preallocated scratch buffer instead (for example one
+ * reached through the user_context), define these functions yourself
+ * or install replacements with halide_set_custom_scratch_arena_acquire
+ * and halide_set_custom_scratch_arena_release. The block must be
+ * aligned as for halide_malloc, and at least size bytes long.
+ */
+//@{
+extern void *halide_scratch_arena_acquire(void *user_context, uint64_t size);
+extern void halide_scratch_arena_release(void *user_context, void *ptr);
+typedef void *(*halide_scratch_arena_acquire_t)(void *, uint64_t);
+typedef void (*halide_scratch_arena_release_t)(void *, void *);
+extern halide_scratch_arena_acquire_t halide_set_custom_scratch_arena_acquire(halide_scratch_arena_acquire_t acquire);
+extern halide_scratch_arena_release_t halide_set_custom_scratch_arena_release(halide_scratch_arena_release_t release);
+//@}
+
+/** Allocations stored in MemoryType::HugePage are made and freed with
+ * these. On Linux and Android on x86, ARM, PowerPC and RISC-V,
+ * allocations of 1 MB or more are mapped directly, aligned to 2 MB,
+ * and marked with MADV_HUGEPAGE so the kernel can back them with
+ * transparent huge pages. Smaller
+ * allocations, and all allocations on other platforms, go through
+ * halide_malloc and halide_free. Memory from halide_huge_page_malloc
+ * must only be released with halide_huge_page_free. */
+//@{
+extern void *halide_huge_page_malloc(void *user_context, size_t x);
+extern void halide_huge_page_free(void *user_context, void *ptr);
+//@}
+
+/** If set, halide_huge_page_malloc touches every page of a mapped
+ * allocation before returning it, in parallel using halide_do_par_for,
+ * so that the page faults are taken up front and spread across the
+ * thread pool. Defaults to on if the HL_HUGE_PAGE_PREFAULT environment
+ * variable is set to 1. No effect on platforms without huge pages. */
+extern void halide_set_huge_page_prefault(bool on);
+
 /** Halide calls these functions to interact with the underlying
  * system runtime functions. To replace in AOT code on platforms that
  * support weak linking, define these functions yourself, or use
@@ -610,8 +815,12 @@ struct halide_trace_event_t {
  * implementation either prints events via halide_print, or if
  * HL_TRACE_FILE is defined, dumps the trace to that file in a
  * sequence of trace packets. The header for a trace packet is defined
- * below. If the trace is going to be large, you may want to make the
- * file a named pipe, and then read from that pipe into gzip.
+ * below. Packets are buffered per thread and written out by a
+ * background thread. If HL_TRACE_COMPRESS=1, they are written in a
+ * delta-coded binary format instead, which tools/halide_trace_reader.h
+ * decodes; this is usually several times smaller. If the trace is
+ * going to be large, you may want to make the file a named pipe, and
+ * then read from that pipe into gzip.
  *
  * halide_trace returns a unique ID which will be passed to future
  * events that "belong" to the earlier event as the parent id. The
@@ -744,6 +953,54 @@ extern int halide_get_trace_file(void *user_context);
  * (flushing the trace). Returns zero on success. */
 extern int halide_shutdown_trace();
 
+/** Turn the default halide_trace into a flight recorder, which keeps
+ * the last events_per_thread events other than loads and stores that
+ * each thread traced in memory, instead of writing out a trace. The
+ * recorded events are printed by halide_error, or on demand by
+ * halide_trace_flight_recorder_dump. Zero turns it off. If never
+ * called, the environment variable HL_TRACE_FLIGHT_RECORDER is
+ * checked for events_per_thread. Compiling with
+ * Target::TraceRealizations gives the recorder the realizations and
+ * the produce and consume events of every Func, which are cheap to
+ * trace. Must not be called while traced pipelines are
+ * running. Returns zero on success. */
+extern int halide_set_trace_flight_recorder(int events_per_thread);
+
+/** Print the events in the flight recorder, oldest first. Does
+ * nothing if the flight recorder is off. */
+extern void halide_trace_flight_recorder_dump(void *user_context);
+
+/** A filter on the trace events that pipelines emit, checked before
+ * they reach halide_trace. This lets tracing stay compiled into a
+ * pipeline and be enabled selectively. Events of a func that is
+ * filtered out get the id zero. Pipeline begin/end events and trace
+ * tags always pass. */
+struct halide_trace_filter_t {
+    /** Only trace every Nth load or store that passes the other
+     * filters. Zero or one traces them all. */
+    uint32_t sample_every;
+
+    /** Only trace loads and stores with at least one lane inside a
+     * box of this many dimensions (at most 8), given by box_min and
+     * box_extent. Zero means no box. Dimensions beyond those of an
+     * event are ignored. */
+    int box_dimensions;
+    const int32_t *box_min, *box_extent;
+
+    /** Only trace events of the funcs with these names (at most
+     * 64). Zero means all funcs. */
+    int num_funcs;
+    const char *const *funcs;
+};
+
+/** Set the filter that trace events must pass, which is copied. Pass
+ * nullptr to trace everything. If never called, the filter is built
+ * from the environment variables HL_TRACE_SAMPLE (N),
+ * HL_TRACE_FUNCS (a comma-separated list of names), and HL_TRACE_BOX
+ * (a comma-separated list of min, extent pairs). Must not be called
+ * while traced pipelines are running. Returns zero on success. */
+extern int halide_set_trace_filter(const struct halide_trace_filter_t *filter);
+
 /** All Halide GPU or device backend implementations provide an
  * interface to be used with halide_device_malloc, etc. This is
  * accessed via the functions below.
@@ -918,6 +1175,118 @@ extern int halide_get_gpu_device(void *user_context);
  */
 extern void halide_memoization_cache_set_size(int64_t size);
 
+/** The policies the memoization cache can use to choose which entries
+ * to evict when it is over its size limit or a pipeline is over its
+ * quota. Entries still in use are never evicted. */
+typedef enum halide_memoization_cache_policy_t {
+    /** Evict the least recently used entry. This is the default. */
+    halide_memoization_cache_policy_lru = 0,
+    /** Evict the entry with the fewest cache hits, breaking ties by
+     * recency. */
+    halide_memoization_cache_policy_lfu = 1,
+    /** Entries start on probation and leave it the first time they
+     * are hit. Entries on probation are evicted before any others,
+     * and each group is evicted in LRU order. This keeps a burst of
+     * one-off results from flushing the reused working set. Unlike
+     * 2Q, the group of reused entries has no size limit of its own,
+     * and evicted keys are not remembered. */
+    halide_memoization_cache_policy_probation = 2,
+    /** Evict the entry that is cheapest to recompute per byte it
+     * occupies, weighted by how often it is hit and aged so that
+     * entries that are no longer used eventually go
+     * (GreedyDual-Size-Frequency). The compiler passes an estimate of
+     * the cost of each memoized Func to
+     * halide_memoization_cache_store_with_cost. */
+    halide_memoization_cache_policy_cost_aware = 3,
+} halide_memoization_cache_policy_t;
+
+/** Set the policy the memoization cache uses to choose entries to
+ * evict. Entries already in the cache are re-ranked under the new
+ * policy. */
+extern void halide_memoization_cache_set_policy(halide_memoization_cache_policy_t policy);
+
+/** Limit the number of bytes the memoization cache will hold for
+ * results computed by the pipeline with the given name (the name of
+ * the generated function, or of the output Func for JIT
+ * compilation). Entries from the pipeline are evicted, in policy
+ * order, to keep within the quota; entries from other pipelines are
+ * unaffected. A size of zero removes the limit. Quotas can be set for
+ * at most 16 distinct pipelines; returns an error if there is no
+ * room for another. */
+extern int halide_memoization_cache_set_pipeline_quota(const char *pipeline_name, int64_t size);
+
+/** Back the memoization cache with a memory-mapped file, so that
+ * results stored by one process can be found by later runs of it or
+ * by other processes running at the same time. The file is created if
+ * it doesn't exist, and grown to size bytes if it is smaller (a size
+ * of zero means 64MB). Results are appended until the file is full,
+ * and are never evicted from it; hits in the file return pointers
+ * straight into the mapping rather than copies. Results memoized with
+ * an eviction key are not written to the file.
+ *
+ * Cache keys include the names of the pipeline and Func, the values of
+ * the parameters it depends on, and a hash of the definitions of the
+ * Func and everything it calls and of the contents of Buffers embedded
+ * in them. They don't cover extern code it calls, or the contents of
+ * input buffers beyond what is passed to memoize_tag, so delete the
+ * file when those change.
+ *
+ * The file can be set once per process, and stays mapped until the
+ * process exits, as results returned from it may still be in use after
+ * halide_memoization_cache_cleanup. If it is not set before the
+ * cache is first used, the file named by the environment variable
+ * HL_MEMOIZATION_CACHE_FILE is used, with a size in megabytes taken
+ * from HL_MEMOIZATION_CACHE_FILE_MB. Returns an error if the file
+ * can't be mapped, is not a memoization cache file, or if a file is
+ * already in use. Platforms without shared file mappings always
+ * return an error. */
+extern int halide_memoization_cache_set_file(void *user_context, const char *filename, int64_t size);
+
+/** Counters for the results of one memoized Func in the memoization
+ * cache. */
+struct halide_memoization_cache_func_stats_t {
+    /** The name of the pipeline and of the Func. These are owned by
+     * the cache and remain valid until
+     * halide_memoization_cache_cleanup is called. */
+    const char *pipeline_name;
+    const char *func_name;
+
+    /** The number of lookups that found a result in memory, and that
+     * didn't. */
+    uint64_t hits, misses;
+
+    /** How many of the misses were found in the cache file. */
+    uint64_t file_hits;
+
+    /** The number of results stored, and the number evicted. */
+    uint64_t stores, evictions;
+
+    /** The bytes and number of entries currently held in memory. */
+    int64_t bytes, entries;
+};
+
+/** Counters for the whole memoization cache. */
+struct halide_memoization_cache_stats_t {
+    uint64_t hits, misses, file_hits, stores, evictions;
+    int64_t entries;
+
+    /** The bytes currently held in memory, and the maximum set with
+     * halide_memoization_cache_set_size. */
+    int64_t current_size, max_size;
+
+    /** The number of Funcs with counters. */
+    int num_funcs;
+};
+
+/** Get the counters for the memoization cache, and for up to
+ * max_funcs of the Funcs that have used it. func_stats may be null if
+ * max_funcs is zero. Counters are kept for at most 256 Funcs. They are
+ * reset by halide_memoization_cache_cleanup. Returns zero on
+ * success. */
+extern int halide_memoization_cache_get_stats(struct halide_memoization_cache_stats_t *stats,
+                                              struct halide_memoization_cache_func_stats_t *func_stats,
+                                              int max_funcs);
+
 /** Given a cache key for a memoized result, currently constructed
  *  from the Func name and top-level Func name plus the arguments of
  *  the computation, determine if the result is in the cache and
@@ -962,6 +1331,24 @@ extern int halide_memoization_cache_store(void *user_context, const uint8_t *cac
                                           struct halide_buffer_t **tuple_buffers,
                                           bool has_eviction_key, uint64_t eviction_key);
 
+/** The call generated code makes to store a memoized result. It takes
+ * the arguments of halide_memoization_cache_store, followed by
+ * pipeline_name, the name of the pipeline storing the result (used
+ * for halide_memoization_cache_set_pipeline_quota), and
+ * cost_per_element, the compiler's estimate of the relative cost of
+ * computing one element of the memoized Func (used by the cost-aware
+ * eviction policy). The default implementation makes these available
+ * to the default halide_memoization_cache_store and then calls it, so
+ * a replacement cache only needs to replace
+ * halide_memoization_cache_store.
+ */
+extern int halide_memoization_cache_store_with_cost(void *user_context, const uint8_t *cache_key, int32_t size,
+                                                    struct halide_buffer_t *realized_bounds,
+                                                    int32_t tuple_count,
+                                                    struct halide_buffer_t **tuple_buffers,
+                                                    bool has_eviction_key, uint64_t eviction_key,
+                                                    const char *pipeline_name, uint64_t cost_per_element);
+
 /** Evict all cache entries that were tagged with the given
  *  eviction_key in the memoize scheduling directive.
  */
@@ -1403,6 +1790,10 @@ typedef enum halide_target_feature_t {
     halide_target_feature_vulkan_version12,       ///< Enable Vulkan v1.2 runtime target support.
     halide_target_feature_vulkan_version13,       ///< Enable Vulkan v1.3 runtime target support.
     halide_target_feature_semihosting,            ///< Used together with Target::NoOS for the baremetal target built with semihosting library and run with semihosting mode where minimum I/O communication with a host PC is available.
+    halide_target_feature_pooled_malloc,          ///< Make halide_pooled_malloc/free the default heap allocator.
+    halide_target_feature_scratch_arena,          ///< Carve top-level heap allocations out of one arena per pipeline invocation. See halide_scratch_arena_acquire.
+    halide_target_feature_profile_instrumented,   ///< Alternative to halide_target_feature_profile that times every Func exactly using cycle counter reads at each produce/consume boundary, instead of sampling.
+    halide_target_feature_profile_loops,          ///< Used with halide_target_feature_profile or halide_target_feature_profile_instrumented. Bill time to every loop in the final loop nest, including partitioned prologues and epilogues, and report it as a tree under each Func.
     halide_target_feature_end                     ///< A sentinel. Every target is considered to have this feature, and setting this feature does nothing.
 } halide_target_feature_t;
 
@@ -1800,6 +2191,20 @@ struct HALIDE_ATTRIBUTE_ALIGN(8) halide_profiler_func_stats {
 
     /** The total number of memory allocation of this Func. */
     int num_allocs;
+
+    /** User-space CPU cycles, instructions retired, last-level cache
+     * misses and branch mispredictions, counted on each thread while
+     * that thread was computing this Func. Only gathered by the thread based
+     * profiler on x86 Linux, when the HL_PROFILER_PERF_COUNTERS
+     * environment variable is set to 1. Zero otherwise. */
+    uint64_t cycles, instructions, llc_misses, branch_misses;
+
+    /** Total time from the start to the end of this Func's produce
+     * nodes, including any other Funcs computed within them (in
+     * nanoseconds). Only measured by the instrumented profiler, in
+     * which case the time field is exclusive time summed across
+     * all threads. */
+    uint64_t inclusive_time;
 };
 
 /** Per-pipeline state tracked by the sampling profiler. These exist
@@ -1845,6 +2250,10 @@ struct HALIDE_ATTRIBUTE_ALIGN(8) halide_profiler_pipeline_stats {
 
     /** The total number of memory allocation of funcs in this pipeline. */
     int num_allocs;
+
+    /** The hardware performance counter totals for this
+     * pipeline. See halide_profiler_func_stats. */
+    uint64_t cycles, instructions, llc_misses, branch_misses;
 };
 
 /** The global state of the profiler. */
@@ -1906,6 +2315,16 @@ extern struct halide_profiler_pipeline_stats *halide_profiler_get_pipeline_state
  * accurate time interval if desired. */
 extern int halide_profiler_sample(struct halide_profiler_state *s, uint64_t *prev_t);
 
+/** Called by pipelines compiled with Target::ProfileInstrumented in
+ * place of the internal function that starts the sampling profiler.
+ * Registers the pipeline's Funcs and counts the run, but doesn't
+ * spawn a sampling thread. Returns the pipeline's first func id, or a
+ * negative error code. */
+extern int halide_profiler_instrumented_pipeline_start(void *user_context,
+                                                       const char *pipeline_name,
+                                                       int num_funcs,
+                                                       const uint64_t *func_names);
+
 /** Reset profiler state cheaply. May leave threads running or some
  * memory allocated but all accumluated statistics are reset.
  * WARNING: Do NOT call this method while any halide pipeline is
@@ -1925,6 +2344,25 @@ void halide_profiler_shutdown();
  * reset. Also happens at process exit. */
 extern void halide_profiler_report(void *user_context);
 
+/** Write the profile gathered since the last reset in a format other
+ * tools can read. halide_profiler_write_pprof writes the per-Func
+ * totals (time, heap bytes and heap allocations) as an uncompressed
+ * pprof protobuf. halide_profiler_write_chrome_trace writes a
+ * timeline of which Func each sample was billed to, as Chrome trace
+ * event JSON. The timeline is only recorded after a call to
+ * halide_profiler_record_timeline(true), or if the
+ * HL_PROFILER_CHROME_TRACE environment variable is set.
+ *
+ * Setting HL_PROFILER_CHROME_TRACE or HL_PROFILER_PPROF to a
+ * filename also writes the corresponding file every time the text
+ * report is printed. Both functions return a halide_error_code_t.
+ */
+//@{
+extern void halide_profiler_record_timeline(bool on);
+extern int halide_profiler_write_chrome_trace(void *user_context, const char *filename);
+extern int halide_profiler_write_pprof(void *user_context, const char *filename);
+//@}
+
 /** For timer based profiling, this routine starts the timer chain running.
  * halide_get_profiler_state can be called to get the current timer interval.
  */
@@ -1,6 +1,7 @@
 #include "HalideRuntime.h"
 #include "device_buffer_utils.h"
 #include "printer.h"
+#include "runtime_atomics.h"
 #include "scoped_mutex_lock.h"
 
 namespace Halide {
@@ -54,8 +55,24 @@ WEAK void debug_print_key(void *user_context, const char *msg, const uint8_t *ca
 }
 #endif
 
+// Compare keys a word at a time. Keys are short, so this beats a call
+// to memcmp.
 WEAK bool keys_equal(const uint8_t *key1, const uint8_t *key2, size_t key_size) {
-    return memcmp(key1, key2, key_size) == 0;
+    size_t i = 0;
+    for (; i + 8 <= key_size; i += 8) {
+        uint64_t a, b;
+        memcpy(&a, key1 + i, 8);
+        memcpy(&b, key2 + i, 8);
+        if (a != b) {
+            return false;
+        }
+    }
+    for (; i < key_size; i++) {
+        if (key1[i] != key2[i]) {
+            return false;
+        }
+    }
+    return true;
 }
 
 WEAK bool buffer_has_shape(const halide_buffer_t *buf, const halide_dimension_t *shape) {
@@ -74,7 +91,7 @@ struct CacheEntry {
     uint8_t *metadata_storage;
     size_t key_size;
     uint8_t *key;
-    uint32_t hash;
+    uint64_t hash;
     uint32_t in_use_count;  // 0 if none returned from halide_cache_lookup
     uint32_t tuple_count;
     // The shape of the computed data. There may be more data allocated than this.
@@ -84,19 +101,34 @@ struct CacheEntry {
     halide_buffer_t *buf;
     uint64_t eviction_key;
     bool has_eviction_key;
+    // Stamp from cache_use_clock taken when the entry was last stored or looked up.
+    uint64_t last_use;
+    // Estimated cost of recomputing the entry, and the number of
+    // lookups that have hit it.
+    uint64_t cost;
+    uint32_t hits;
+    // Eviction order under the current policy. Lowest goes first.
+    uint64_t priority;
+    // Hash of the name of the pipeline that stored the entry, and the
+    // slot in pipeline_quotas it is accounted against, or -1.
+    uint32_t pipeline_hash;
+    int32_t quota_slot;
+    // The slot in func_stats for the Func the entry belongs to, or -1.
+    int32_t stats_slot;
 
     bool init(const uint8_t *cache_key, size_t cache_key_size,
-              uint32_t key_hash,
+              uint64_t key_hash,
               const halide_buffer_t *computed_bounds_buf,
               int32_t tuples, halide_buffer_t **tuple_buffers,
               bool has_eviction_key, uint64_t eviction_key);
     void destroy();
     halide_buffer_t &buffer(int32_t i);
+    int64_t size_in_bytes() const;
 };
 
 struct CacheBlockHeader {
     CacheEntry *entry;
-    uint32_t hash;
+    uint64_t hash;
 };
 
 // Each host block has extra space to store a header just before the
@@ -115,10 +147,17 @@ WEAK CacheBlockHeader *get_pointer_to_header(uint8_t *host) {
 }
 
 WEAK bool CacheEntry::init(const uint8_t *cache_key, size_t cache_key_size,
-                           uint32_t key_hash, const halide_buffer_t *computed_bounds_buf,
+                           uint64_t key_hash, const halide_buffer_t *computed_bounds_buf,
                            int32_t tuples, halide_buffer_t **tuple_buffers,
                            bool has_eviction_key_arg, uint64_t eviction_key_arg) {
     next = nullptr;
+    last_use = 0;
+    cost = 0;
+    hits = 0;
+    priority = 0;
+    pipeline_hash = 0;
+    quota_slot = -1;
+    stats_slot = -1;
     more_recent = nullptr;
     less_recent = nullptr;
     key_size = cache_key_size;
@@ -188,42 +227,402 @@ WEAK void CacheEntry::destroy() {
     halide_free(nullptr, metadata_storage);
 }
 
-WEAK uint32_t djb_hash(const uint8_t *key, size_t key_size) {
-    uint32_t h = 5381;
-    for (size_t i = 0; i < key_size; i++) {
-        h = (h << 5) + h + key[i];
+WEAK int64_t CacheEntry::size_in_bytes() const {
+    int64_t bytes = 0;
+    for (uint32_t i = 0; i < tuple_count; i++) {
+        bytes += buf[i].size_in_bytes();
+    }
+    return bytes;
+}
+
+ALWAYS_INLINE uint64_t hash_mix(uint64_t h, uint64_t word) {
+    h ^= word;
+    h *= 0x9e3779b97f4a7c15ULL;
+    return h ^ (h >> 29);
+}
+
+// Hash a key a word at a time, starting from seed.
+WEAK uint64_t hash_bytes(const uint8_t *key, size_t key_size, uint64_t seed) {
+    uint64_t h = seed ^ key_size;
+    size_t i = 0;
+    for (; i + 8 <= key_size; i += 8) {
+        uint64_t word;
+        memcpy(&word, key + i, 8);
+        h = hash_mix(h, word);
+    }
+    if (i < key_size) {
+        uint64_t word = 0;
+        for (size_t j = 0; i + j < key_size; j++) {
+            word |= (uint64_t)key[i + j] << (8 * j);
+        }
+        h = hash_mix(h, word);
     }
+    // Final avalanche, so that the low bits used to pick the shard
+    // and bucket depend on every byte.
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
     return h;
 }
 
-WEAK halide_mutex memoization_lock = {{0}};
+// Keys generated by Halide (see Memoization.cpp) start with a pointer
+// to the pipeline and Func names and the memoize instance, followed
+// at kKeySeedOffset by a hash of those computed at compile time. Only
+// the bytes after the seed are hashed at runtime. Other keys are
+// hashed in full.
+const size_t kKeySeedOffset = 16;
+const size_t kKeyPrefixBytes = kKeySeedOffset + 8;
+
+WEAK uint64_t hash_key(const uint8_t *key, size_t key_size) {
+    if (key_size < kKeyPrefixBytes) {
+        return hash_bytes(key, key_size, 0);
+    }
+    uint64_t seed;
+    memcpy(&seed, key + kKeySeedOffset, 8);
+    return hash_bytes(key + kKeyPrefixBytes, key_size - kKeyPrefixBytes, seed);
+}
 
-const size_t kHashTableSize = 256;
+// The cache is split into shards, each with its own lock, hash
+// buckets, and MRU/LRU chain, so that memoized Funcs used from many
+// threads at once only contend when their keys land in the same
+// shard. The size budget is global; pruning walks the shards one at a
+// time (never holding more than one shard lock) and evicts the entry
+// that the current eviction policy ranks lowest.
+const size_t kCacheShards = 16;
+const size_t kHashTableSize = 64;  // buckets per shard
+
+struct CacheShard {
+    halide_mutex lock;
+    CacheEntry *entries[kHashTableSize];
+    CacheEntry *most_recently_used;
+    CacheEntry *least_recently_used;
+    // A lower bound on the priority of the entries in the shard that
+    // are not in use, or zero if there are none. Written under the
+    // lock, read without it when choosing a shard to prune.
+    uint64_t min_priority;
+    // Counters for halide_memoization_cache_get_stats, guarded by the lock.
+    uint64_t hits, misses, stores, evictions;
+    int64_t entry_count;
+    // Keep neighbouring shard locks off the same cache line.
+    uint8_t padding[64];
+};
 
-WEAK CacheEntry *cache_entries[kHashTableSize];
+WEAK CacheShard cache_shards[kCacheShards];
 
-WEAK CacheEntry *most_recently_used = nullptr;
-WEAK CacheEntry *least_recently_used = nullptr;
+// Source of the use stamps that order entries across shards.
+WEAK uint64_t cache_use_clock = 0;
 
 const uint64_t kDefaultCacheSize = 1 << 20;
 WEAK int64_t max_cache_size = kDefaultCacheSize;
 WEAK int64_t current_cache_size = 0;
 
+WEAK halide_memoization_cache_policy_t cache_policy = halide_memoization_cache_policy_lru;
+
+// For the cost-aware policy: the priority of the last entry evicted,
+// which is added to the priority of entries as they are used so that
+// entries that were valuable once but are no longer used eventually
+// age out (GreedyDual-Size-Frequency).
+WEAK uint64_t cache_inflation = 0;
+
+// Byte quotas for the entries stored by individual pipelines. Slots
+// are never freed, so an entry's quota_slot stays valid for its
+// lifetime. A limit of zero means no limit.
+struct PipelineQuota {
+    uint32_t pipeline_hash;
+    int64_t limit;
+    int64_t used;
+};
+
+const int kMaxPipelineQuotas = 16;
+WEAK PipelineQuota pipeline_quotas[kMaxPipelineQuotas];
+WEAK int pipeline_quota_count = 0;
+WEAK halide_mutex pipeline_quota_lock = {{0}};
+
+// The extra arguments of the halide_memoization_cache_store_with_cost
+// calls in flight, for the halide_memoization_cache_store call each
+// makes to find by cache key. Going through halide_memoization_cache_store
+// keeps replacements of it working with generated code that passes
+// costs. The nodes live on the callers' stacks.
+struct PendingStore {
+    const uint8_t *cache_key;
+    const char *pipeline_name;
+    uint64_t cost_per_element;
+    PendingStore *next;
+};
+
+WEAK PendingStore *pending_stores = nullptr;
+WEAK halide_mutex pending_stores_lock = {{0}};
+
+// Counters for each memoized Func that has used the cache, in an open
+// addressed table keyed by the contents of the name at the start of
+// its cache keys. The address of the name isn't enough, as a JIT
+// module that is freed and recompiled puts the same name elsewhere,
+// and another name may take its place. Slots are claimed under
+// func_stats_lock and are kept until
+// halide_memoization_cache_cleanup; the counters are updated
+// atomically without the lock.
+struct FuncStats {
+    // A copy of the name, set last when the slot is claimed.
+    char *key_name;
+    uint64_t key_hash;
+    char *pipeline_name;
+    char *func_name;
+    uint64_t hits, misses, file_hits, stores, evictions;
+    int64_t bytes, entries;
+};
+
+const int kMaxFuncStats = 256;
+WEAK FuncStats func_stats[kMaxFuncStats];
+WEAK int func_stats_count = 0;
+WEAK halide_mutex func_stats_lock = {{0}};
+
+// Lookups served from the cache file, which don't touch a shard.
+WEAK uint64_t cache_file_hits = 0;
+
+ALWAYS_INLINE CacheShard &shard_for_hash(uint64_t h) {
+    return cache_shards[h % kCacheShards];
+}
+
+ALWAYS_INLINE uint32_t bucket_for_hash(uint64_t h) {
+    return (h / kCacheShards) % kHashTableSize;
+}
+
+WEAK uint32_t pipeline_name_hash(const char *pipeline_name) {
+    if (pipeline_name == nullptr) {
+        return 0;
+    }
+    return (uint32_t)hash_bytes((const uint8_t *)pipeline_name, strlen(pipeline_name), 0);
+}
+
+WEAK char *copy_name(const char *name, size_t size) {
+    char *result = (char *)malloc(size + 1);
+    if (result != nullptr) {
+        memcpy(result, name, size);
+        result[size] = 0;
+    }
+    return result;
+}
+
+// Parse one "<length>:<name>" part of the name at the start of a
+// cache key (see Memoization.cpp).
+WEAK bool parse_name_part(const char **cursor, const char *end, const char **part, size_t *part_size) {
+    const char *c = *cursor;
+    size_t size = 0;
+    while (c < end && *c >= '0' && *c <= '9') {
+        size = size * 10 + (*c++ - '0');
+    }
+    if (c == *cursor || c == end || *c != ':' || (size_t)(end - c - 1) < size) {
+        return false;
+    }
+    *part = c + 1;
+    *part_size = size;
+    *cursor = c + 1 + size;
+    return true;
+}
+
+ALWAYS_INLINE bool func_stats_match(const FuncStats &stats, const char *key_name, uint64_t key_hash) {
+    return stats.key_hash == key_hash && strcmp(stats.key_name, key_name) == 0;
+}
+
+WEAK int claim_func_stats_slot(const char *key_name, size_t key_name_size, uint64_t key_hash, int start) {
+    ScopedMutexLock lock(&func_stats_lock);
+    for (int i = 0; i < kMaxFuncStats; i++) {
+        FuncStats &stats = func_stats[(start + i) % kMaxFuncStats];
+        if (stats.key_name != nullptr) {
+            if (func_stats_match(stats, key_name, key_hash)) {
+                return (start + i) % kMaxFuncStats;
+            }
+        } else {
+            char *name_copy = copy_name(key_name, key_name_size);
+            if (name_copy == nullptr) {
+                return -1;
+            }
+            const char *end = key_name + key_name_size;
+            const char *cursor = key_name;
+            const char *pipeline, *func;
+            size_t pipeline_size, func_size;
+            if (parse_name_part(&cursor, end, &pipeline, &pipeline_size) &&
+                parse_name_part(&cursor, end, &func, &func_size)) {
+                stats.pipeline_name = copy_name(pipeline, pipeline_size);
+                stats.func_name = copy_name(func, func_size);
+            } else {
+                stats.pipeline_name = copy_name("", 0);
+                stats.func_name = copy_name(key_name, end - key_name);
+            }
+            stats.hits = stats.misses = stats.file_hits = stats.stores = stats.evictions = 0;
+            stats.bytes = stats.entries = 0;
+            stats.key_hash = key_hash;
+            func_stats_count++;
+            Synchronization::atomic_store_release(&stats.key_name, &name_copy);
+            return (start + i) % kMaxFuncStats;
+        }
+    }
+    return -1;
+}
+
+// Find the counters for the Func a cache key belongs to, or -1 if the
+// key wasn't generated by Halide or the table is full.
+WEAK int find_func_stats_slot(const uint8_t *cache_key, int32_t size) {
+    if ((size_t)size < sizeof(const char *)) {
+        return -1;
+    }
+    const char *key_name;
+    memcpy(&key_name, cache_key, sizeof(key_name));
+    if (key_name == nullptr) {
+        return -1;
+    }
+    const size_t key_name_size = strlen(key_name);
+    const uint64_t key_hash = hash_bytes((const uint8_t *)key_name, key_name_size, 0);
+    int start = (int)(key_hash % kMaxFuncStats);
+    for (int i = 0; i < kMaxFuncStats; i++) {
+        FuncStats &stats = func_stats[(start + i) % kMaxFuncStats];
+        char *existing;
+        Synchronization::atomic_load_acquire(&stats.key_name, &existing);
+        if (existing == nullptr) {
+            return claim_func_stats_slot(key_name, key_name_size, key_hash, start);
+        } else if (func_stats_match(stats, key_name, key_hash)) {
+            return (start + i) % kMaxFuncStats;
+        }
+    }
+    return -1;
+}
+
+ALWAYS_INLINE void count_func_stat(int slot, uint64_t FuncStats::*counter) {
+    if (slot >= 0) {
+        Synchronization::atomic_fetch_add_sequentially_consistent(&(func_stats[slot].*counter), (uint64_t)1);
+    }
+}
+
+ALWAYS_INLINE void add_func_residency(int slot, int64_t bytes, int64_t entries) {
+    if (slot >= 0) {
+        Synchronization::atomic_fetch_add_sequentially_consistent(&func_stats[slot].bytes, bytes);
+        Synchronization::atomic_fetch_add_sequentially_consistent(&func_stats[slot].entries, entries);
+    }
+}
+
+WEAK int find_quota_slot_already_locked(uint32_t pipeline_hash) {
+    for (int i = 0; i < pipeline_quota_count; i++) {
+        if (pipeline_quotas[i].pipeline_hash == pipeline_hash) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+WEAK bool over_quota(int quota_slot) {
+    int64_t limit, used;
+    Synchronization::atomic_load_acquire(&pipeline_quotas[quota_slot].limit, &limit);
+    Synchronization::atomic_load_acquire(&pipeline_quotas[quota_slot].used, &used);
+    return limit > 0 && used > limit;
+}
+
+// Compute the eviction priority of an entry under the current
+// policy. Priorities are never zero, so that zero can mean an empty
+// shard.
+WEAK uint64_t compute_priority(const CacheEntry *entry) {
+    halide_memoization_cache_policy_t policy;
+    Synchronization::atomic_load_relaxed(&cache_policy, &policy);
+    switch (policy) {
+    case halide_memoization_cache_policy_lfu: {
+        // Order by hit count, then by recency.
+        const uint64_t max_hits = (1 << 19) - 1;
+        uint64_t hits = entry->hits < max_hits ? entry->hits : max_hits;
+        return (hits << 44) | (entry->last_use & ((1ULL << 44) - 1)) | 1;
+    }
+    case halide_memoization_cache_policy_probation:
+        // Entries that have only been stored and never hit are kept on
+        // probation and evicted before any entry that has been reused,
+        // so that one-off results can't flush the working set.
+        return (entry->hits > 0 ? (1ULL << 63) : 0) | entry->last_use;
+    case halide_memoization_cache_policy_cost_aware: {
+        // Recompute cost per 256 bytes of storage, scaled by use.
+        uint64_t units = (uint64_t)entry->size_in_bytes() / 256 + 1;
+        uint64_t value = entry->cost / units;
+        uint64_t uses = (uint64_t)entry->hits + 1;
+        value = value > (~0ULL >> 1) / uses ? (~0ULL >> 1) : value * uses;
+        uint64_t inflation;
+        Synchronization::atomic_load_relaxed(&cache_inflation, &inflation);
+        return inflation + value + 1;
+    }
+    case halide_memoization_cache_policy_lru:
+    default:
+        return entry->last_use;
+    }
+}
+
+WEAK void set_min_priority_already_locked(CacheShard &shard, uint64_t priority) {
+    Synchronization::atomic_store_release(&shard.min_priority, &priority);
+}
+
+// Lower the shard's min_priority bound to account for an entry that
+// has become a candidate for eviction.
+WEAK void note_priority_already_locked(CacheShard &shard, uint64_t priority) {
+    if (shard.min_priority == 0 || priority < shard.min_priority) {
+        set_min_priority_already_locked(shard, priority);
+    }
+}
+
+WEAK void unlink_from_lru(CacheShard &shard, CacheEntry *entry) {
+    if (entry->more_recent != nullptr) {
+        entry->more_recent->less_recent = entry->less_recent;
+    } else {
+        halide_abort_if_false(nullptr, shard.most_recently_used == entry);
+        shard.most_recently_used = entry->less_recent;
+    }
+    if (entry->less_recent != nullptr) {
+        entry->less_recent->more_recent = entry->more_recent;
+    } else {
+        halide_abort_if_false(nullptr, shard.least_recently_used == entry);
+        shard.least_recently_used = entry->more_recent;
+    }
+    entry->more_recent = nullptr;
+    entry->less_recent = nullptr;
+}
+
+WEAK void push_most_recent(CacheShard &shard, CacheEntry *entry) {
+    entry->last_use = Synchronization::atomic_add_fetch_sequentially_consistent(&cache_use_clock, (uint64_t)1);
+    entry->more_recent = nullptr;
+    entry->less_recent = shard.most_recently_used;
+    if (shard.most_recently_used != nullptr) {
+        shard.most_recently_used->more_recent = entry;
+    }
+    shard.most_recently_used = entry;
+    if (shard.least_recently_used == nullptr) {
+        shard.least_recently_used = entry;
+    }
+}
+
+// Unlink an entry from its shard, account for its size, and free it.
+WEAK void remove_entry_already_locked(CacheShard &shard, CacheEntry **prev_hash_entry, CacheEntry *entry) {
+    *prev_hash_entry = entry->next;
+    unlink_from_lru(shard, entry);
+
+    int64_t freed = entry->size_in_bytes();
+    Synchronization::atomic_fetch_sub_sequentially_consistent(&current_cache_size, freed);
+    if (entry->quota_slot >= 0) {
+        Synchronization::atomic_fetch_sub_sequentially_consistent(&pipeline_quotas[entry->quota_slot].used, freed);
+    }
+    shard.evictions++;
+    shard.entry_count--;
+    count_func_stat(entry->stats_slot, &FuncStats::evictions);
+    add_func_residency(entry->stats_slot, -freed, -1);
+
+    entry->destroy();
+    halide_free(nullptr, entry);
+}
+
 #if CACHE_DEBUGGING
-WEAK void validate_cache() {
-    print(nullptr) << "validating cache, "
-                   << "current size " << current_cache_size
-                   << " of maximum " << max_cache_size << "\n";
+WEAK void validate_shard(CacheShard &shard) {
     int entries_in_hash_table = 0;
     for (size_t i = 0; i < kHashTableSize; i++) {
-        CacheEntry *entry = cache_entries[i];
+        CacheEntry *entry = shard.entries[i];
         while (entry != nullptr) {
             entries_in_hash_table++;
-            if (entry->more_recent == nullptr && entry != most_recently_used) {
+            if (entry->more_recent == nullptr && entry != shard.most_recently_used) {
                 halide_print(nullptr, "cache invalid case 1\n");
                 __builtin_trap();
             }
-            if (entry->less_recent == nullptr && entry != least_recently_used) {
+            if (entry->less_recent == nullptr && entry != shard.least_recently_used) {
                 halide_print(nullptr, "cache invalid case 2\n");
                 __builtin_trap();
             }
@@ -231,18 +630,19 @@ WEAK void validate_cache() {
         }
     }
     int entries_from_mru = 0;
-    CacheEntry *mru_chain = most_recently_used;
+    CacheEntry *mru_chain = shard.most_recently_used;
     while (mru_chain != nullptr) {
         entries_from_mru++;
         mru_chain = mru_chain->less_recent;
     }
     int entries_from_lru = 0;
-    CacheEntry *lru_chain = least_recently_used;
+    CacheEntry *lru_chain = shard.least_recently_used;
     while (lru_chain != nullptr) {
         entries_from_lru++;
         lru_chain = lru_chain->more_recent;
     }
-    print(nullptr) << "hash entries " << entries_in_hash_table
+    print(nullptr) << "shard " << (int)(&shard - cache_shards)
+                   << ": hash entries " << entries_in_hash_table
                    << ", mru entries " << entries_from_mru
                    << ", lru entries " << entries_from_lru << "\n";
     if (entries_in_hash_table != entries_from_mru) {
@@ -253,6 +653,16 @@ WEAK void validate_cache() {
         halide_print(nullptr, "cache invalid case 4\n");
         __builtin_trap();
     }
+}
+
+WEAK void validate_cache() {
+    print(nullptr) << "validating cache, "
+                   << "current size " << current_cache_size
+                   << " of maximum " << max_cache_size << "\n";
+    for (size_t i = 0; i < kCacheShards; i++) {
+        ScopedMutexLock lock(&cache_shards[i].lock);
+        validate_shard(cache_shards[i]);
+    }
     if (current_cache_size < 0) {
         halide_print(nullptr, "cache size is negative\n");
         __builtin_trap();
@@ -260,62 +670,426 @@ WEAK void validate_cache() {
 }
 #endif
 
+// Find the entry with the lowest priority that is not in use and,
+// if quota_slot is not -1, is accounted against that quota. Returns
+// the lowest priority of the other entries not in use in next_min, or
+// zero if there are none.
+WEAK CacheEntry *find_victim_already_locked(CacheShard &shard, int quota_slot,
+                                            CacheEntry ***prev_hash_entry, uint64_t *next_min) {
+    CacheEntry *victim = nullptr;
+    *next_min = 0;
+
+    halide_memoization_cache_policy_t policy;
+    Synchronization::atomic_load_relaxed(&cache_policy, &policy);
+    if (policy == halide_memoization_cache_policy_lru && quota_slot < 0) {
+        // Priorities follow the LRU chain, so there is no need to
+        // scan the whole shard.
+        for (CacheEntry *entry = shard.least_recently_used; entry != nullptr; entry = entry->more_recent) {
+            if (entry->in_use_count != 0) {
+                continue;
+            } else if (victim == nullptr) {
+                victim = entry;
+            } else {
+                *next_min = entry->priority;
+                break;
+            }
+        }
+        if (victim != nullptr) {
+            CacheEntry **prev = &shard.entries[bucket_for_hash(victim->hash)];
+            while (*prev != victim) {
+                halide_abort_if_false(nullptr, *prev != nullptr);
+                prev = &(*prev)->next;
+            }
+            *prev_hash_entry = prev;
+        }
+        return victim;
+    }
+
+    for (auto &entry_ref : shard.entries) {
+        for (CacheEntry **prev = &entry_ref; *prev != nullptr; prev = &(*prev)->next) {
+            CacheEntry *entry = *prev;
+            if (entry->in_use_count != 0) {
+                continue;
+            }
+            CacheEntry *other = entry;
+            if ((quota_slot < 0 || entry->quota_slot == quota_slot) &&
+                (victim == nullptr || entry->priority < victim->priority)) {
+                other = victim;
+                victim = entry;
+                *prev_hash_entry = prev;
+            }
+            if (other != nullptr && (*next_min == 0 || other->priority < *next_min)) {
+                *next_min = other->priority;
+            }
+        }
+    }
+    return victim;
+}
+
+WEAK void evict_victim_already_locked(CacheShard &shard, CacheEntry **prev_hash_entry,
+                                      CacheEntry *victim, uint64_t next_min) {
+    halide_memoization_cache_policy_t policy;
+    Synchronization::atomic_load_relaxed(&cache_policy, &policy);
+    if (policy == halide_memoization_cache_policy_cost_aware) {
+        uint64_t inflation;
+        Synchronization::atomic_load_relaxed(&cache_inflation, &inflation);
+        while (victim->priority > inflation &&
+               !Synchronization::atomic_cas_weak_relacq_relaxed(&cache_inflation, &inflation, &victim->priority)) {
+        }
+    }
+    remove_entry_already_locked(shard, prev_hash_entry, victim);
+    set_min_priority_already_locked(shard, next_min);
+}
+
+// Evict from the whole cache until it fits in max_cache_size. Must be
+// called with no shard lock held.
 WEAK void prune_cache() {
+    static_assert(kCacheShards <= 32, "shard masks are 32 bits");
+    uint32_t exhausted_shards = 0;
+    uint32_t refreshed_shards = 0;
+    while (true) {
+        int64_t current_size, max_size;
+        Synchronization::atomic_load_acquire(&current_cache_size, &current_size);
+        Synchronization::atomic_load_acquire(&max_cache_size, &max_size);
+        if (current_size <= max_size) {
+            break;
+        }
+
+        // Pick the shard that may hold the lowest priority entry.
+        int chosen = -1;
+        uint64_t lowest = 0;
+        for (size_t i = 0; i < kCacheShards; i++) {
+            uint64_t bound;
+            Synchronization::atomic_load_acquire(&cache_shards[i].min_priority, &bound);
+            if (bound != 0 && !(exhausted_shards & (1U << i)) &&
+                (chosen < 0 || bound < lowest)) {
+                chosen = (int)i;
+                lowest = bound;
+            }
+        }
+        if (chosen < 0) {
+            break;
+        }
+
+        CacheShard &shard = cache_shards[chosen];
+        ScopedMutexLock lock(&shard.lock);
+        CacheEntry **prev_hash_entry = nullptr;
+        uint64_t next_min = 0;
+        CacheEntry *victim = find_victim_already_locked(shard, -1, &prev_hash_entry, &next_min);
+        if (victim == nullptr) {
+            // Everything left in this shard is in use.
+            exhausted_shards |= (1U << chosen);
+            set_min_priority_already_locked(shard, 0);
+        } else if (victim->priority <= lowest || (refreshed_shards & (1U << chosen))) {
+            evict_victim_already_locked(shard, prev_hash_entry, victim, next_min);
+            refreshed_shards &= ~(1U << chosen);
+        } else {
+            // The bound was stale because entries in the shard have
+            // been used since it was set. Refresh it and choose again.
+            set_min_priority_already_locked(shard, victim->priority);
+            refreshed_shards |= (1U << chosen);
+        }
+    }
 #if CACHE_DEBUGGING
     validate_cache();
 #endif
-    CacheEntry *prune_candidate = least_recently_used;
-    while (current_cache_size > max_cache_size &&
-           prune_candidate != nullptr) {
-        CacheEntry *more_recent = prune_candidate->more_recent;
-
-        if (prune_candidate->in_use_count == 0) {
-            uint32_t h = prune_candidate->hash;
-            uint32_t index = h % kHashTableSize;
-
-            // Remove from hash table
-            CacheEntry *prev_hash_entry = cache_entries[index];
-            if (prev_hash_entry == prune_candidate) {
-                cache_entries[index] = prune_candidate->next;
-            } else {
-                while (prev_hash_entry != nullptr && prev_hash_entry->next != prune_candidate) {
-                    prev_hash_entry = prev_hash_entry->next;
-                }
-                halide_abort_if_false(nullptr, prev_hash_entry != nullptr);
-                prev_hash_entry->next = prune_candidate->next;
-            }
+}
 
-            // Remove from less recent chain.
-            if (least_recently_used == prune_candidate) {
-                least_recently_used = more_recent;
+// Evict entries stored by one pipeline until it fits in its quota.
+// Must be called with no shard lock held.
+WEAK void prune_pipeline(int quota_slot) {
+    uint32_t exhausted_shards = 0;
+    while (over_quota(quota_slot)) {
+        int chosen = -1;
+        uint64_t lowest = 0;
+        for (size_t i = 0; i < kCacheShards; i++) {
+            if (exhausted_shards & (1U << i)) {
+                continue;
             }
-            if (more_recent != nullptr) {
-                more_recent->less_recent = prune_candidate->less_recent;
+            ScopedMutexLock lock(&cache_shards[i].lock);
+            CacheEntry **prev_hash_entry = nullptr;
+            uint64_t next_min = 0;
+            CacheEntry *victim = find_victim_already_locked(cache_shards[i], quota_slot, &prev_hash_entry, &next_min);
+            if (victim == nullptr) {
+                exhausted_shards |= (1U << i);
+            } else if (chosen < 0 || victim->priority < lowest) {
+                chosen = (int)i;
+                lowest = victim->priority;
             }
+        }
+        if (chosen < 0) {
+            break;
+        }
+
+        CacheShard &shard = cache_shards[chosen];
+        ScopedMutexLock lock(&shard.lock);
+        CacheEntry **prev_hash_entry = nullptr;
+        uint64_t next_min = 0;
+        CacheEntry *victim = find_victim_already_locked(shard, quota_slot, &prev_hash_entry, &next_min);
+        if (victim != nullptr) {
+            evict_victim_already_locked(shard, prev_hash_entry, victim, next_min);
+        }
+    }
+}
+
+
+// The optional backing file, shared with other processes that map
+// the same file. It is an append-only hash table: a header holding
+// the bucket heads, followed by records that are never moved or
+// freed. A file of zeroes is a valid empty table. Space for a record
+// is reserved by bumping the cursor, the record is filled in, and it
+// is then published by swapping it in as the head of its bucket, so
+// readers in any process see either the old chain or a complete
+// record. Lookups that hit return pointers directly into the mapping.
+//
+// The first pointer-sized word of a key generated by Halide points to
+// a string naming the pipeline and Func (see Memoization.cpp). That
+// address is meaningless in another process, so the file is keyed by
+// the string it points to followed by the rest of the key.
+const uint64_t kCacheFileMagic = 0x32656863616d6c68ULL;  // "hlmache2"
+const size_t kCacheFileBuckets = 4096;
+const size_t kCacheFileAlignment = 128;
+const int64_t kDefaultCacheFileSize = 64 << 20;
+
+struct CacheFileHeader {
+    uint64_t magic;
+    // Bytes reserved for records so far, counted from the end of the header.
+    uint64_t cursor;
+    uint64_t buckets[kCacheFileBuckets];
+};
 
-            // Remove from more recent chain.
-            if (most_recently_used == prune_candidate) {
-                most_recently_used = prune_candidate->less_recent;
+// Followed by the key, the computed bounds, and then a
+// CacheFileTuple and the allocated bounds for each tuple element.
+struct CacheFileRecord {
+    uint64_t next;
+    uint32_t hash;
+    uint32_t key_size;
+    int32_t dimensions;
+    int32_t tuple_count;
+};
+
+struct CacheFileTuple {
+    halide_type_t type;
+    uint32_t padding;
+    uint64_t data_offset;
+    uint64_t data_size;
+};
+
+WEAK uint8_t *cache_file_base = nullptr;
+WEAK size_t cache_file_size = 0;
+WEAK bool cache_file_env_checked = false;
+WEAK halide_mutex cache_file_lock = {{0}};
+
+ALWAYS_INLINE size_t align_to_cache_file(size_t x) {
+    return (x + kCacheFileAlignment - 1) & ~(kCacheFileAlignment - 1);
+}
+
+ALWAYS_INLINE size_t cache_file_header_bytes() {
+    return align_to_cache_file(sizeof(CacheFileHeader));
+}
+
+// The process independent part of a key. Returns false if the key
+// is too short to have been generated by Halide.
+WEAK bool persistent_key(const uint8_t *cache_key, int32_t size,
+                         const char **name, size_t *name_size, uint32_t *hash) {
+    if ((size_t)size < sizeof(const char *)) {
+        return false;
+    }
+    memcpy(name, cache_key, sizeof(const char *));
+    *name_size = strlen(*name);
+    *hash = (uint32_t)hash_bytes(cache_key + sizeof(const char *), size - sizeof(const char *),
+                                 hash_bytes((const uint8_t *)*name, *name_size, 0));
+    return true;
+}
+
+WEAK bool in_cache_file(const void *host) {
+    uint8_t *base;
+    Synchronization::atomic_load_acquire(&cache_file_base, &base);
+    return base != nullptr && (const uint8_t *)host >= base && (const uint8_t *)host < base + cache_file_size;
+}
+
+ALWAYS_INLINE bool cache_file_range_valid(uint64_t offset, uint64_t bytes) {
+    return offset >= cache_file_header_bytes() && offset <= cache_file_size && bytes <= cache_file_size - offset;
+}
+
+WEAK int map_cache_file_already_locked(void *user_context, const char *filename, int64_t size) {
+    if (cache_file_base != nullptr) {
+        error(user_context) << "The memoization cache file has already been set.\n";
+        return halide_error_code_generic_error;
+    }
+    if (size <= 0) {
+        size = kDefaultCacheFileSize;
+    }
+    size_t min_size = (size_t)size < cache_file_header_bytes() ? cache_file_header_bytes() : (size_t)size;
+    size_t mapped_size = 0;
+    uint8_t *base = (uint8_t *)halide_map_shared_file(user_context, filename, min_size, &mapped_size);
+    if (base == nullptr) {
+        error(user_context) << "Could not map memoization cache file " << filename << "\n";
+        return halide_error_code_generic_error;
+    }
+
+    // Claim a new file, or check an existing one is ours.
+    CacheFileHeader *header = (CacheFileHeader *)base;
+    uint64_t expected = 0, desired = kCacheFileMagic;
+    if (!Synchronization::atomic_cas_strong_sequentially_consistent(&header->magic, &expected, &desired) &&
+        expected != kCacheFileMagic) {
+        halide_unmap_shared_file(user_context, base, mapped_size);
+        error(user_context) << filename << " is not a memoization cache file.\n";
+        return halide_error_code_generic_error;
+    }
+
+    cache_file_size = mapped_size;
+    Synchronization::atomic_store_release(&cache_file_base, &base);
+    return halide_error_code_success;
+}
+
+// Map the file named by HL_MEMOIZATION_CACHE_FILE, if any, the first
+// time the cache is used.
+WEAK void check_cache_file_env(void *user_context) {
+    bool checked;
+    Synchronization::atomic_load_acquire(&cache_file_env_checked, &checked);
+    if (checked) {
+        return;
+    }
+    ScopedMutexLock lock(&cache_file_lock);
+    if (!cache_file_env_checked) {
+        const char *filename = getenv("HL_MEMOIZATION_CACHE_FILE");
+        if (filename && *filename && cache_file_base == nullptr) {
+            const char *mb = getenv("HL_MEMOIZATION_CACHE_FILE_MB");
+            map_cache_file_already_locked(user_context, filename, mb ? (int64_t)atoi(mb) << 20 : 0);
+        }
+        checked = true;
+        Synchronization::atomic_store_release(&cache_file_env_checked, &checked);
+    }
+}
+
+// Point the tuple buffers at a matching record in the cache file, if
+// there is one.
+WEAK bool cache_file_lookup(const uint8_t *cache_key, int32_t size,
+                            const halide_buffer_t *computed_bounds,
+                            int32_t tuple_count, halide_buffer_t **tuple_buffers) {
+    uint8_t *base;
+    Synchronization::atomic_load_acquire(&cache_file_base, &base);
+    const char *name;
+    size_t name_size;
+    uint32_t h;
+    if (base == nullptr || !persistent_key(cache_key, size, &name, &name_size, &h)) {
+        return false;
+    }
+    size_t rest_size = size - sizeof(const char *);
+    size_t dims = computed_bounds->dimensions;
+    size_t dims_bytes = dims * sizeof(halide_dimension_t);
+    size_t record_bytes = sizeof(CacheFileRecord) + name_size + rest_size + dims_bytes +
+                          tuple_count * (sizeof(CacheFileTuple) + dims_bytes);
+
+    CacheFileHeader *header = (CacheFileHeader *)base;
+    uint64_t offset;
+    Synchronization::atomic_load_acquire(&header->buckets[h % kCacheFileBuckets], &offset);
+    while (offset != 0 && cache_file_range_valid(offset, sizeof(CacheFileRecord))) {
+        const CacheFileRecord *record = (const CacheFileRecord *)(base + offset);
+        if (record->hash == h &&
+            record->key_size == name_size + rest_size &&
+            record->dimensions == (int32_t)dims &&
+            record->tuple_count == tuple_count &&
+            cache_file_range_valid(offset, record_bytes)) {
+            const uint8_t *key = (const uint8_t *)(record + 1);
+            const halide_dimension_t *bounds = (const halide_dimension_t *)(key + record->key_size);
+            bool match = keys_equal(key, (const uint8_t *)name, name_size) &&
+                         keys_equal(key + name_size, cache_key + sizeof(const char *), rest_size) &&
+                         buffer_has_shape(computed_bounds, bounds);
+            const uint8_t *tuple_info = (const uint8_t *)(bounds + dims);
+            for (int32_t i = 0; match && i < tuple_count; i++) {
+                const CacheFileTuple *tuple = (const CacheFileTuple *)tuple_info;
+                const halide_dimension_t *tuple_dims = (const halide_dimension_t *)(tuple + 1);
+                match = tuple->type == tuple_buffers[i]->type &&
+                        buffer_has_shape(tuple_buffers[i], tuple_dims) &&
+                        tuple->data_size == tuple_buffers[i]->size_in_bytes() &&
+                        cache_file_range_valid(tuple->data_offset, tuple->data_size);
+                tuple_info += sizeof(CacheFileTuple) + dims_bytes;
             }
-            if (prune_candidate->less_recent != nullptr) {
-                prune_candidate->less_recent = more_recent;
+            if (match) {
+                tuple_info = (const uint8_t *)(bounds + dims);
+                for (int32_t i = 0; i < tuple_count; i++) {
+                    const CacheFileTuple *tuple = (const CacheFileTuple *)tuple_info;
+                    halide_buffer_t *buf = tuple_buffers[i];
+                    // The data starts at the lowest addressed element,
+                    // which is not the host pointer if any stride is
+                    // negative.
+                    buf->host = base + tuple->data_offset;
+                    buf->host += buf->host - buf->begin();
+                    tuple_info += sizeof(CacheFileTuple) + dims_bytes;
+                }
+                return true;
             }
+        }
+        offset = record->next;
+    }
+    return false;
+}
 
-            // Decrease cache used amount.
-            for (uint32_t i = 0; i < prune_candidate->tuple_count; i++) {
-                current_cache_size -= prune_candidate->buf[i].size_in_bytes();
-            }
+// Append a computed result to the cache file. Gives up silently if
+// the file is full.
+WEAK void cache_file_store(const uint8_t *cache_key, int32_t size,
+                           const halide_buffer_t *computed_bounds,
+                           int32_t tuple_count, halide_buffer_t **tuple_buffers) {
+    uint8_t *base;
+    Synchronization::atomic_load_acquire(&cache_file_base, &base);
+    const char *name;
+    size_t name_size;
+    uint32_t h;
+    if (base == nullptr || !persistent_key(cache_key, size, &name, &name_size, &h)) {
+        return;
+    }
+    size_t rest_size = size - sizeof(const char *);
+    size_t dims = computed_bounds->dimensions;
+    size_t dims_bytes = dims * sizeof(halide_dimension_t);
+    size_t bytes = align_to_cache_file(sizeof(CacheFileRecord) + name_size + rest_size + dims_bytes +
+                                       tuple_count * (sizeof(CacheFileTuple) + dims_bytes));
+    for (int32_t i = 0; i < tuple_count; i++) {
+        bytes += align_to_cache_file(tuple_buffers[i]->size_in_bytes());
+    }
+
+    CacheFileHeader *header = (CacheFileHeader *)base;
+    uint64_t offset = cache_file_header_bytes() +
+                      Synchronization::atomic_fetch_add_sequentially_consistent(&header->cursor, (uint64_t)bytes);
+    if (!cache_file_range_valid(offset, bytes)) {
+        return;
+    }
 
-            // Deallocate the entry.
-            prune_candidate->destroy();
-            halide_free(nullptr, prune_candidate);
+    CacheFileRecord *record = (CacheFileRecord *)(base + offset);
+    record->hash = h;
+    record->key_size = name_size + rest_size;
+    record->dimensions = dims;
+    record->tuple_count = tuple_count;
+    uint8_t *key = (uint8_t *)(record + 1);
+    memcpy(key, name, name_size);
+    memcpy(key + name_size, cache_key + sizeof(const char *), rest_size);
+    halide_dimension_t *bounds = (halide_dimension_t *)(key + record->key_size);
+    for (size_t i = 0; i < dims; i++) {
+        bounds[i] = computed_bounds->dim[i];
+    }
+    uint8_t *tuple_info = (uint8_t *)(bounds + dims);
+    uint64_t data_offset = offset + align_to_cache_file(tuple_info + tuple_count * (sizeof(CacheFileTuple) + dims_bytes) - (uint8_t *)record);
+    for (int32_t i = 0; i < tuple_count; i++) {
+        const halide_buffer_t *buf = tuple_buffers[i];
+        CacheFileTuple *tuple = (CacheFileTuple *)tuple_info;
+        tuple->type = buf->type;
+        tuple->padding = 0;
+        tuple->data_offset = data_offset;
+        tuple->data_size = buf->size_in_bytes();
+        halide_dimension_t *tuple_dims = (halide_dimension_t *)(tuple + 1);
+        for (size_t j = 0; j < dims; j++) {
+            tuple_dims[j] = buf->dim[j];
         }
+        memcpy(base + data_offset, buf->begin(), tuple->data_size);
+        data_offset += align_to_cache_file(tuple->data_size);
+        tuple_info += sizeof(CacheFileTuple) + dims_bytes;
+    }
 
-        prune_candidate = more_recent;
+    uint64_t *bucket = &header->buckets[h % kCacheFileBuckets];
+    Synchronization::atomic_load_relaxed(bucket, &record->next);
+    while (!Synchronization::atomic_cas_weak_relacq_relaxed(bucket, &record->next, &offset)) {
     }
-#if CACHE_DEBUGGING
-    validate_cache();
-#endif
 }
 
 }  // namespace Internal
@@ -329,18 +1103,122 @@ WEAK void halide_memoization_cache_set_size(int64_t size) {
         size = kDefaultCacheSize;
     }
 
-    ScopedMutexLock lock(&memoization_lock);
-
-    max_cache_size = size;
+    Synchronization::atomic_store_sequentially_consistent(&max_cache_size, &size);
     prune_cache();
 }
 
+WEAK void halide_memoization_cache_set_policy(halide_memoization_cache_policy_t policy) {
+    Synchronization::atomic_store_sequentially_consistent(&cache_policy, &policy);
+
+    // Re-rank everything already in the cache under the new policy.
+    for (auto &shard : cache_shards) {
+        ScopedMutexLock lock(&shard.lock);
+        uint64_t min_priority = 0;
+        for (CacheEntry *entry : shard.entries) {
+            for (; entry != nullptr; entry = entry->next) {
+                entry->priority = compute_priority(entry);
+                if (min_priority == 0 || entry->priority < min_priority) {
+                    min_priority = entry->priority;
+                }
+            }
+        }
+        set_min_priority_already_locked(shard, min_priority);
+    }
+}
+
+WEAK int halide_memoization_cache_set_pipeline_quota(const char *pipeline_name, int64_t size) {
+    uint32_t pipeline_hash = pipeline_name_hash(pipeline_name);
+    int slot;
+    {
+        ScopedMutexLock lock(&pipeline_quota_lock);
+
+        slot = find_quota_slot_already_locked(pipeline_hash);
+        if (slot < 0) {
+            if (pipeline_quota_count == kMaxPipelineQuotas) {
+                return halide_error_code_generic_error;
+            }
+            slot = pipeline_quota_count;
+            pipeline_quotas[slot].pipeline_hash = pipeline_hash;
+            pipeline_quotas[slot].limit = 0;
+            pipeline_quotas[slot].used = 0;
+
+            // Account for entries this pipeline stored before it had
+            // a quota.
+            for (auto &shard : cache_shards) {
+                ScopedMutexLock shard_lock(&shard.lock);
+                for (CacheEntry *entry : shard.entries) {
+                    for (; entry != nullptr; entry = entry->next) {
+                        if (entry->pipeline_hash == pipeline_hash && entry->quota_slot < 0) {
+                            entry->quota_slot = slot;
+                            pipeline_quotas[slot].used += entry->size_in_bytes();
+                        }
+                    }
+                }
+            }
+            int count = slot + 1;
+            Synchronization::atomic_store_sequentially_consistent(&pipeline_quota_count, &count);
+        }
+        Synchronization::atomic_store_sequentially_consistent(&pipeline_quotas[slot].limit, &size);
+    }
+
+    prune_pipeline(slot);
+    return halide_error_code_success;
+}
+
+WEAK int halide_memoization_cache_set_file(void *user_context, const char *filename, int64_t size) {
+    ScopedMutexLock lock(&cache_file_lock);
+    int result = map_cache_file_already_locked(user_context, filename, size);
+    if (result == halide_error_code_success) {
+        // Don't let the environment override an explicit choice.
+        bool checked = true;
+        Synchronization::atomic_store_release(&cache_file_env_checked, &checked);
+    }
+    return result;
+}
+
+WEAK int halide_memoization_cache_get_stats(halide_memoization_cache_stats_t *stats,
+                                            halide_memoization_cache_func_stats_t *funcs,
+                                            int max_funcs) {
+    memset(stats, 0, sizeof(*stats));
+    for (auto &shard : cache_shards) {
+        ScopedMutexLock lock(&shard.lock);
+        stats->hits += shard.hits;
+        stats->misses += shard.misses;
+        stats->stores += shard.stores;
+        stats->evictions += shard.evictions;
+        stats->entries += shard.entry_count;
+    }
+    Synchronization::atomic_load_relaxed(&cache_file_hits, &stats->file_hits);
+    Synchronization::atomic_load_acquire(&current_cache_size, &stats->current_size);
+    Synchronization::atomic_load_acquire(&max_cache_size, &stats->max_size);
+
+    ScopedMutexLock lock(&func_stats_lock);
+    stats->num_funcs = func_stats_count;
+    int count = 0;
+    for (int i = 0; i < kMaxFuncStats && count < max_funcs; i++) {
+        FuncStats &s = func_stats[i];
+        if (s.key_name == nullptr) {
+            continue;
+        }
+        halide_memoization_cache_func_stats_t &f = funcs[count++];
+        f.pipeline_name = s.pipeline_name;
+        f.func_name = s.func_name;
+        Synchronization::atomic_load_relaxed(&s.hits, &f.hits);
+        Synchronization::atomic_load_relaxed(&s.misses, &f.misses);
+        Synchronization::atomic_load_relaxed(&s.file_hits, &f.file_hits);
+        Synchronization::atomic_load_relaxed(&s.stores, &f.stores);
+        Synchronization::atomic_load_relaxed(&s.evictions, &f.evictions);
+        Synchronization::atomic_load_relaxed(&s.bytes, &f.bytes);
+        Synchronization::atomic_load_relaxed(&s.entries, &f.entries);
+    }
+    return halide_error_code_success;
+}
+
 WEAK int halide_memoization_cache_lookup(void *user_context, const uint8_t *cache_key, int32_t size,
                                          halide_buffer_t *computed_bounds, int32_t tuple_count, halide_buffer_t **tuple_buffers) {
-    uint32_t h = djb_hash(cache_key, size);
-    uint32_t index = h % kHashTableSize;
-
-    ScopedMutexLock lock(&memoization_lock);
+    uint64_t h = hash_key(cache_key, size);
+    CacheShard &shard = shard_for_hash(h);
+    int stats_slot = find_func_stats_slot(cache_key, size);
 
 #if CACHE_DEBUGGING
     debug_print_key(user_context, "halide_memoization_cache_lookup", cache_key, size);
@@ -355,52 +1233,55 @@ WEAK int halide_memoization_cache_lookup(void *user_context, const uint8_t *cach
     }
 #endif
 
-    CacheEntry *entry = cache_entries[index];
-    while (entry != nullptr) {
-        if (entry->hash == h && entry->key_size == (size_t)size &&
-            keys_equal(entry->key, cache_key, size) &&
-            buffer_has_shape(computed_bounds, entry->computed_bounds) &&
-            entry->tuple_count == (uint32_t)tuple_count) {
-
-            // Check all the tuple buffers have the same bounds (they should).
-            bool all_bounds_equal = true;
-            for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
-                all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
-            }
+    {
+        ScopedMutexLock lock(&shard.lock);
 
-            if (all_bounds_equal) {
-                if (entry != most_recently_used) {
-                    halide_abort_if_false(user_context, entry->more_recent != nullptr);
-                    if (entry->less_recent != nullptr) {
-                        entry->less_recent->more_recent = entry->more_recent;
-                    } else {
-                        halide_abort_if_false(user_context, least_recently_used == entry);
-                        least_recently_used = entry->more_recent;
-                    }
-                    halide_abort_if_false(user_context, entry->more_recent != nullptr);
-                    entry->more_recent->less_recent = entry->less_recent;
+        CacheEntry *entry = shard.entries[bucket_for_hash(h)];
+        while (entry != nullptr) {
+            if (entry->hash == h && entry->key_size == (size_t)size &&
+                keys_equal(entry->key, cache_key, size) &&
+                buffer_has_shape(computed_bounds, entry->computed_bounds) &&
+                entry->tuple_count == (uint32_t)tuple_count) {
 
-                    entry->more_recent = nullptr;
-                    entry->less_recent = most_recently_used;
-                    if (most_recently_used != nullptr) {
-                        most_recently_used->more_recent = entry;
-                    }
-                    most_recently_used = entry;
+                // Check all the tuple buffers have the same bounds (they should).
+                bool all_bounds_equal = true;
+                for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
+                    all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
                 }
 
-                for (int32_t i = 0; i < tuple_count; i++) {
-                    halide_buffer_t *buf = tuple_buffers[i];
-                    *buf = entry->buf[i];
-                }
+                if (all_bounds_equal) {
+                    unlink_from_lru(shard, entry);
+                    push_most_recent(shard, entry);
+                    entry->hits++;
+                    entry->priority = compute_priority(entry);
+
+                    for (int32_t i = 0; i < tuple_count; i++) {
+                        halide_buffer_t *buf = tuple_buffers[i];
+                        *buf = entry->buf[i];
+                    }
 
-                entry->in_use_count += tuple_count;
+                    entry->in_use_count += tuple_count;
 
-                return 0;
+                    shard.hits++;
+                    count_func_stat(stats_slot, &FuncStats::hits);
+                    return 0;
+                }
             }
+            entry = entry->next;
         }
-        entry = entry->next;
+        shard.misses++;
     }
+    count_func_stat(stats_slot, &FuncStats::misses);
 
+    check_cache_file_env(user_context);
+    if (cache_file_lookup(cache_key, size, computed_bounds, tuple_count, tuple_buffers)) {
+        Synchronization::atomic_fetch_add_sequentially_consistent(&cache_file_hits, (uint64_t)1);
+        count_func_stat(stats_slot, &FuncStats::file_hits);
+        return 0;
+    }
+
+    // A miss. The allocation doesn't touch the cache, so do it
+    // without holding the shard lock.
     for (int32_t i = 0; i < tuple_count; i++) {
         halide_buffer_t *buf = tuple_buffers[i];
 
@@ -418,10 +1299,6 @@ WEAK int halide_memoization_cache_lookup(void *user_context, const uint8_t *cach
         header->entry = nullptr;
     }
 
-#if CACHE_DEBUGGING
-    validate_cache();
-#endif
-
     return 1;
 }
 
@@ -431,11 +1308,22 @@ WEAK int halide_memoization_cache_store(void *user_context, const uint8_t *cache
                                         bool has_eviction_key, uint64_t eviction_key) {
     debug(user_context) << "halide_memoization_cache_store has_eviction_key: " << has_eviction_key << " eviction_key " << eviction_key << " .\n";
 
-    uint32_t h = get_pointer_to_header(tuple_buffers[0]->host)->hash;
-
-    uint32_t index = h % kHashTableSize;
+    const char *pipeline_name = nullptr;
+    uint64_t cost_per_element = 1;
+    {
+        ScopedMutexLock lock(&pending_stores_lock);
+        for (PendingStore *p = pending_stores; p != nullptr; p = p->next) {
+            if (p->cache_key == cache_key) {
+                pipeline_name = p->pipeline_name;
+                cost_per_element = p->cost_per_element;
+                break;
+            }
+        }
+    }
 
-    ScopedMutexLock lock(&memoization_lock);
+    uint64_t h = get_pointer_to_header(tuple_buffers[0]->host)->hash;
+    CacheShard &shard = shard_for_hash(h);
+    uint32_t index = bucket_for_hash(h);
 
 #if CACHE_DEBUGGING
     debug_print_key(user_context, "halide_memoization_cache_store", cache_key, size);
@@ -450,94 +1338,151 @@ WEAK int halide_memoization_cache_store(void *user_context, const uint8_t *cache
     }
 #endif
 
-    CacheEntry *entry = cache_entries[index];
-    while (entry != nullptr) {
-        if (entry->hash == h && entry->key_size == (size_t)size &&
-            keys_equal(entry->key, cache_key, size) &&
-            buffer_has_shape(computed_bounds, entry->computed_bounds) &&
-            entry->tuple_count == (uint32_t)tuple_count) {
+    uint32_t pipeline_hash = pipeline_name_hash(pipeline_name);
+    int stats_slot = find_func_stats_slot(cache_key, size);
+    int quota_slot = -1;
+    int quota_count;
+    Synchronization::atomic_load_acquire(&pipeline_quota_count, &quota_count);
+    if (quota_count > 0) {
+        ScopedMutexLock lock(&pipeline_quota_lock);
+        quota_slot = find_quota_slot_already_locked(pipeline_hash);
+    }
 
-            bool all_bounds_equal = true;
-            bool no_host_pointers_equal = true;
-            {
-                for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
-                    halide_buffer_t *buf = tuple_buffers[i];
-                    all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
-                    if (entry->buf[i].host == buf->host) {
-                        no_host_pointers_equal = false;
+    {
+        ScopedMutexLock lock(&shard.lock);
+
+        CacheEntry *entry = shard.entries[index];
+        while (entry != nullptr) {
+            if (entry->hash == h && entry->key_size == (size_t)size &&
+                keys_equal(entry->key, cache_key, size) &&
+                buffer_has_shape(computed_bounds, entry->computed_bounds) &&
+                entry->tuple_count == (uint32_t)tuple_count) {
+
+                bool all_bounds_equal = true;
+                bool no_host_pointers_equal = true;
+                {
+                    for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
+                        halide_buffer_t *buf = tuple_buffers[i];
+                        all_bounds_equal = buffer_has_shape(tuple_buffers[i], entry->buf[i].dim);
+                        if (entry->buf[i].host == buf->host) {
+                            no_host_pointers_equal = false;
+                        }
                     }
                 }
-            }
-            if (all_bounds_equal) {
-                halide_abort_if_false(user_context, no_host_pointers_equal);
-                // This entry is still in use by the caller. Mark it as having no cache entry
-                // so halide_memoization_cache_release can free the buffer.
-                for (int32_t i = 0; i < tuple_count; i++) {
-                    get_pointer_to_header(tuple_buffers[i]->host)->entry = nullptr;
+                if (all_bounds_equal) {
+                    halide_abort_if_false(user_context, no_host_pointers_equal);
+                    // This entry is still in use by the caller. Mark it as having no cache entry
+                    // so halide_memoization_cache_release can free the buffer.
+                    for (int32_t i = 0; i < tuple_count; i++) {
+                        get_pointer_to_header(tuple_buffers[i]->host)->entry = nullptr;
+                    }
+                    return halide_error_code_success;
                 }
-                return halide_error_code_success;
             }
+            entry = entry->next;
         }
-        entry = entry->next;
-    }
 
-    uint64_t added_size = 0;
-    {
-        for (int32_t i = 0; i < tuple_count; i++) {
-            halide_buffer_t *buf = tuple_buffers[i];
-            added_size += buf->size_in_bytes();
+        CacheEntry *new_entry = (CacheEntry *)halide_malloc(nullptr, sizeof(CacheEntry));
+        bool inited = false;
+        if (new_entry) {
+            inited = new_entry->init(cache_key, size, h, computed_bounds, tuple_count, tuple_buffers,
+                                     has_eviction_key, eviction_key);
         }
-    }
-    current_cache_size += added_size;
-    prune_cache();
+        if (!inited) {
+            // This entry is still in use by the caller. Mark it as having no cache entry
+            // so halide_memoization_cache_release can free the buffer.
+            for (int32_t i = 0; i < tuple_count; i++) {
+                get_pointer_to_header(tuple_buffers[i]->host)->entry = nullptr;
+            }
 
-    CacheEntry *new_entry = (CacheEntry *)halide_malloc(nullptr, sizeof(CacheEntry));
-    bool inited = false;
-    if (new_entry) {
-        inited = new_entry->init(cache_key, size, h, computed_bounds, tuple_count, tuple_buffers,
-                                 has_eviction_key, eviction_key);
-    }
-    if (!inited) {
-        current_cache_size -= added_size;
+            if (new_entry) {
+                halide_free(user_context, new_entry);
+            }
+            return halide_error_code_success;
+        }
 
-        // This entry is still in use by the caller. Mark it as having no cache entry
-        // so halide_memoization_cache_release can free the buffer.
-        for (int32_t i = 0; i < tuple_count; i++) {
-            get_pointer_to_header(tuple_buffers[i]->host)->entry = nullptr;
+        uint64_t elements = 1;
+        for (int32_t i = 0; i < computed_bounds->dimensions; i++) {
+            elements *= computed_bounds->dim[i].extent;
+        }
+        new_entry->cost = cost_per_element * elements;
+        new_entry->pipeline_hash = pipeline_hash;
+        new_entry->quota_slot = quota_slot;
+        new_entry->stats_slot = stats_slot;
+
+        int64_t added_size = new_entry->size_in_bytes();
+        Synchronization::atomic_fetch_add_sequentially_consistent(&current_cache_size, added_size);
+        if (quota_slot >= 0) {
+            Synchronization::atomic_fetch_add_sequentially_consistent(&pipeline_quotas[quota_slot].used, added_size);
         }
+        shard.stores++;
+        shard.entry_count++;
+        count_func_stat(stats_slot, &FuncStats::stores);
+        add_func_residency(stats_slot, added_size, 1);
 
-        if (new_entry) {
-            halide_free(user_context, new_entry);
+        new_entry->next = shard.entries[index];
+        shard.entries[index] = new_entry;
+        push_most_recent(shard, new_entry);
+        new_entry->priority = compute_priority(new_entry);
+
+        // The new entry is in use by the caller, so the prune below
+        // can't evict it. It becomes a candidate when released.
+        new_entry->in_use_count = tuple_count;
+
+        for (int32_t i = 0; i < tuple_count; i++) {
+            get_pointer_to_header(tuple_buffers[i]->host)->entry = new_entry;
         }
-        return halide_error_code_success;
     }
 
-    new_entry->next = cache_entries[index];
-    new_entry->less_recent = most_recently_used;
-    if (most_recently_used != nullptr) {
-        most_recently_used->more_recent = new_entry;
-    }
-    most_recently_used = new_entry;
-    if (least_recently_used == nullptr) {
-        least_recently_used = new_entry;
+    prune_cache();
+    if (quota_slot >= 0) {
+        prune_pipeline(quota_slot);
     }
-    cache_entries[index] = new_entry;
 
-    new_entry->in_use_count = tuple_count;
-
-    for (int32_t i = 0; i < tuple_count; i++) {
-        get_pointer_to_header(tuple_buffers[i]->host)->entry = new_entry;
+    // Entries with an eviction key can't be evicted from the file,
+    // and device dirty results aren't on the host yet.
+    bool persistable = !has_eviction_key;
+    for (int32_t i = 0; persistable && i < tuple_count; i++) {
+        persistable = !tuple_buffers[i]->device_dirty();
+    }
+    if (persistable) {
+        cache_file_store(cache_key, size, computed_bounds, tuple_count, tuple_buffers);
     }
 
-#if CACHE_DEBUGGING
-    validate_cache();
-#endif
     debug(user_context) << "Exiting halide_memoization_cache_store\n";
 
     return halide_error_code_success;
 }
 
+WEAK int halide_memoization_cache_store_with_cost(void *user_context, const uint8_t *cache_key, int32_t size,
+                                                  halide_buffer_t *computed_bounds,
+                                                  int32_t tuple_count, halide_buffer_t **tuple_buffers,
+                                                  bool has_eviction_key, uint64_t eviction_key,
+                                                  const char *pipeline_name, uint64_t cost_per_element) {
+    PendingStore pending = {cache_key, pipeline_name, cost_per_element, nullptr};
+    {
+        ScopedMutexLock lock(&pending_stores_lock);
+        pending.next = pending_stores;
+        pending_stores = &pending;
+    }
+    int result = halide_memoization_cache_store(user_context, cache_key, size, computed_bounds,
+                                                tuple_count, tuple_buffers, has_eviction_key, eviction_key);
+    {
+        ScopedMutexLock lock(&pending_stores_lock);
+        PendingStore **prev = &pending_stores;
+        while (*prev != &pending) {
+            prev = &(*prev)->next;
+        }
+        *prev = pending.next;
+    }
+    return result;
+}
+
 WEAK void halide_memoization_cache_release(void *user_context, void *host) {
+    if (in_cache_file(host)) {
+        // Hits in the cache file are owned by the mapping.
+        return;
+    }
     CacheBlockHeader *header = get_pointer_to_header((uint8_t *)host);
     debug(user_context) << "halide_memoization_cache_release\n";
     CacheEntry *entry = header->entry;
@@ -545,13 +1490,13 @@ WEAK void halide_memoization_cache_release(void *user_context, void *host) {
     if (entry == nullptr) {
         halide_free(user_context, header);
     } else {
-        ScopedMutexLock lock(&memoization_lock);
+        ScopedMutexLock lock(&shard_for_hash(header->hash).lock);
 
         halide_abort_if_false(user_context, entry->in_use_count > 0);
         entry->in_use_count--;
-#if CACHE_DEBUGGING
-        validate_cache();
-#endif
+        if (entry->in_use_count == 0) {
+            note_priority_already_locked(shard_for_hash(header->hash), entry->priority);
+        }
     }
 
     debug(user_context) << "Exited halide_memoization_cache_release.\n";
@@ -559,48 +1504,56 @@ WEAK void halide_memoization_cache_release(void *user_context, void *host) {
 
 WEAK void halide_memoization_cache_cleanup() {
     debug(nullptr) << "halide_memoization_cache_cleanup\n";
-    for (auto &entry_ref : cache_entries) {
-        CacheEntry *entry = entry_ref;
-        entry_ref = nullptr;
-        while (entry != nullptr) {
-            CacheEntry *next = entry->next;
-            entry->destroy();
-            halide_free(nullptr, entry);
-            entry = next;
+    for (auto &shard : cache_shards) {
+        for (auto &entry_ref : shard.entries) {
+            CacheEntry *entry = entry_ref;
+            entry_ref = nullptr;
+            while (entry != nullptr) {
+                CacheEntry *next = entry->next;
+                entry->destroy();
+                halide_free(nullptr, entry);
+                entry = next;
+            }
         }
+        shard.most_recently_used = nullptr;
+        shard.least_recently_used = nullptr;
+        shard.min_priority = 0;
+        shard.hits = shard.misses = shard.stores = shard.evictions = 0;
+        shard.entry_count = 0;
+    }
+    for (auto &stats : func_stats) {
+        if (stats.key_name != nullptr) {
+            free(stats.key_name);
+            free(stats.pipeline_name);
+            free(stats.func_name);
+            stats.key_name = nullptr;
+        }
+    }
+    func_stats_count = 0;
+    cache_file_hits = 0;
+    for (int i = 0; i < pipeline_quota_count; i++) {
+        pipeline_quotas[i].used = 0;
     }
     current_cache_size = 0;
-    most_recently_used = nullptr;
-    least_recently_used = nullptr;
+    cache_inflation = 0;
+
+    // The cache file stays mapped, and set, until the process exits:
+    // buffers returned from it may still be in use.
 }
 
 WEAK void halide_memoization_cache_evict(void *user_context, uint64_t eviction_key) {
-    ScopedMutexLock lock(&memoization_lock);
+    for (auto &shard : cache_shards) {
+        ScopedMutexLock lock(&shard.lock);
 
-    for (auto &entry_ref : cache_entries) {
-        CacheEntry *entry = entry_ref;
-        if (entry != nullptr) {
+        for (auto &entry_ref : shard.entries) {
             CacheEntry **prev = &entry_ref;
-            while (entry != nullptr) {
-                CacheEntry *next = entry->next;
+            while (*prev != nullptr) {
+                CacheEntry *entry = *prev;
                 if (entry->has_eviction_key && entry->eviction_key == eviction_key) {
-                    *prev = next;
-                    if (entry->more_recent != nullptr) {
-                        entry->more_recent->less_recent = entry->less_recent;
-                    } else {
-                        most_recently_used = entry->less_recent;
-                    }
-                    if (entry->less_recent != nullptr) {
-                        entry->less_recent->more_recent = entry->more_recent;
-                    } else {
-                        least_recently_used = entry->more_recent;
-                    }
-                    entry->destroy();
-                    halide_free(user_context, entry);
+                    remove_entry_already_locked(shard, prev, entry);
                 } else {
                     prev = &entry->next;
                 }
-                entry = next;
             }
         }
     }
@@ -0,0 +1,12 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+extern "C" {
+
+// The tracing module isn't linked on this target, so there is never a
+// flight recorder for the error handler to dump.
+
+WEAK void halide_trace_flight_recorder_dump(void *user_context) {
+}
+
+}  // extern "C"
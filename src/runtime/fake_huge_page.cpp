@@ -0,0 +1,20 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+extern "C" {
+
+// This platform has no way to ask for huge pages, so HugePage
+// allocations are ordinary heap allocations.
+
+WEAK void *halide_huge_page_malloc(void *user_context, size_t x) {
+    return halide_malloc(user_context, x);
+}
+
+WEAK void halide_huge_page_free(void *user_context, void *ptr) {
+    halide_free(user_context, ptr);
+}
+
+WEAK void halide_set_huge_page_prefault(bool on) {
+}
+
+}  // extern "C"
@@ -0,0 +1,16 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+extern "C" {
+
+// This platform can't map files shared between processes, so the
+// memoization cache is kept in memory only.
+
+WEAK void *halide_map_shared_file(void *user_context, const char *filename, size_t min_size, size_t *size) {
+    return nullptr;
+}
+
+WEAK void halide_unmap_shared_file(void *user_context, void *addr, size_t size) {
+}
+
+}  // extern "C"
@@ -0,0 +1,21 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+extern "C" {
+
+// This platform doesn't expose its NUMA topology, so the thread pool
+// treats the host as a single node and never pins threads.
+
+WEAK int halide_host_numa_topology(int *cpu_nodes, int max_cpus) {
+    return 0;
+}
+
+WEAK int halide_host_current_cpu() {
+    return -1;
+}
+
+WEAK int halide_pin_current_thread(const int *cpus, int num_cpus) {
+    return -1;
+}
+
+}  // extern "C"
@@ -0,0 +1,26 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+extern "C" {
+
+// This platform has no hardware performance counters the profiler
+// knows how to read, so the profiler reports none.
+
+WEAK bool halide_profiler_perf_counters_start() {
+    return false;
+}
+
+WEAK void halide_profiler_perf_counters_set_thread_func(int func) {
+}
+
+WEAK void halide_profiler_perf_counters_set_thread_active(int active) {
+}
+
+WEAK int halide_profiler_perf_counters_sample(int *funcs, uint64_t *deltas, int max_funcs) {
+    return 0;
+}
+
+WEAK void halide_profiler_perf_counters_stop() {
+}
+
+}  // extern "C"
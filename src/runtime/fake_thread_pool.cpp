@@ -67,6 +67,7 @@ WEAK halide_semaphore_init_t custom_semaphore_init = halide_default_semaphore_in
 WEAK halide_semaphore_try_acquire_t custom_semaphore_try_acquire = halide_default_semaphore_try_acquire;
 WEAK halide_semaphore_release_t custom_semaphore_release = halide_default_semaphore_release;
 WEAK halide_mutex_array halide_fake_mutex_array;
+WEAK halide_get_thread_pool_t custom_get_thread_pool = halide_default_get_thread_pool;
 
 }  // namespace Internal
 }  // namespace Runtime
@@ -84,6 +85,15 @@ WEAK void halide_join_thread(halide_thread *thread_arg) {
     halide_error(nullptr, "halide_join_thread not implemented on this platform.");
 }
 
+// There is only ever one thread.
+WEAK uintptr_t halide_current_thread_id() {
+    return 0;
+}
+
+WEAK bool halide_can_spawn_threads() {
+    return false;
+}
+
 // Don't need to do anything with mutexes since we are in a fake thread pool.
 WEAK void halide_mutex_lock(halide_mutex *mutex) {
 }
@@ -122,6 +132,56 @@ WEAK int halide_set_num_threads(int n) {
     return 1;
 }
 
+WEAK bool halide_set_work_stealing(bool enabled) {
+    // There is only ever one thread, so there is nothing to steal.
+    return false;
+}
+
+WEAK bool halide_set_numa_affinity(bool enabled) {
+    return false;
+}
+
+WEAK int halide_get_numa_node_count() {
+    return 1;
+}
+
+// Like the mutex arrays above, thread pools are fake but non-null, so
+// that code which makes its own pool can run unchanged.
+WEAK halide_thread_pool_t *halide_thread_pool_create(int num_threads) {
+    return (halide_thread_pool_t *)&halide_fake_mutex_array;
+}
+
+WEAK void halide_thread_pool_destroy(halide_thread_pool_t *pool) {
+}
+
+WEAK int halide_thread_pool_get_stats(halide_thread_pool_t *pool,
+                                      halide_thread_pool_stats_t *total,
+                                      halide_thread_pool_stats_t *per_thread,
+                                      int max_threads) {
+    // Nothing is counted, as tasks are run directly.
+    if (total) {
+        memset(total, 0, sizeof(halide_thread_pool_stats_t));
+    }
+    return 0;
+}
+
+WEAK void halide_thread_pool_reset_stats(halide_thread_pool_t *pool) {
+}
+
+WEAK halide_thread_pool_t *halide_default_get_thread_pool(void *user_context) {
+    return nullptr;
+}
+
+WEAK halide_get_thread_pool_t halide_set_custom_get_thread_pool(halide_get_thread_pool_t f) {
+    halide_get_thread_pool_t result = custom_get_thread_pool;
+    custom_get_thread_pool = f;
+    return result;
+}
+
+WEAK halide_thread_pool_t *halide_get_thread_pool(void *user_context) {
+    return custom_get_thread_pool(user_context);
+}
+
 WEAK halide_do_task_t halide_set_custom_do_task(halide_do_task_t f) {
     halide_do_task_t result = custom_do_task;
     custom_do_task = f;
@@ -0,0 +1,149 @@
+#include "HalideRuntime.h"
+#include "runtime_atomics.h"
+#include "runtime_internal.h"
+
+extern "C" {
+
+extern void *mmap(void *addr, size_t length, int prot, int flags, int fd, long offset);
+extern int munmap(void *addr, size_t length);
+extern int madvise(void *addr, size_t length, int advice);
+
+// The values used by x86, ARM, PowerPC and RISC-V. Others, such as
+// MIPS, differ, and use fake_huge_page instead (see
+// LLVM_Runtime_Linker.cpp).
+#define PROT_READ 0x1
+#define PROT_WRITE 0x2
+#define MAP_PRIVATE 0x2
+#define MAP_ANONYMOUS 0x20
+#define MADV_HUGEPAGE 14
+
+}  // extern "C"
+
+namespace Halide {
+namespace Runtime {
+namespace Internal {
+namespace HugePage {
+
+const size_t kHugePageSize = 2 * 1024 * 1024;
+const size_t kSmallPageSize = 4096;
+
+// Below this size a huge page would be mostly wasted, so we just use
+// halide_malloc.
+const size_t kMinHugePageAllocation = kHugePageSize / 2;
+
+// Sits in the halide_internal_malloc_alignment() bytes before the
+// pointer we hand out. mapping is null if the block came from
+// halide_malloc.
+struct Header {
+    void *mapping;
+    size_t mapped_size;
+};
+
+// -1 until first use, when HL_HUGE_PAGE_PREFAULT is consulted.
+WEAK int prefault = -1;
+
+ALWAYS_INLINE bool should_prefault() {
+    using namespace Halide::Runtime::Internal::Synchronization;
+    int p;
+    atomic_load_relaxed(&prefault, &p);
+    if (p < 0) {
+        const char *env = getenv("HL_HUGE_PAGE_PREFAULT");
+        p = (env && env[0] == '1') ? 1 : 0;
+        atomic_store_release(&prefault, &p);
+    }
+    return p != 0;
+}
+
+struct PrefaultClosure {
+    uint8_t *base;
+    size_t size;
+};
+
+// Touch every small page in one huge-page-sized chunk, so that the
+// kernel populates the mapping from the thread (and so the NUMA node)
+// that will likely use it, rather than faulting it in during the
+// pipeline's first pass over it.
+WEAK int prefault_task(void *user_context, int chunk, uint8_t *closure) {
+    const PrefaultClosure *c = (const PrefaultClosure *)closure;
+    const size_t begin = (size_t)chunk * kHugePageSize;
+    const size_t end = begin + kHugePageSize < c->size ? begin + kHugePageSize : c->size;
+    for (size_t i = begin; i < end; i += kSmallPageSize) {
+        ((volatile uint8_t *)c->base)[i] = 0;
+    }
+    return halide_error_code_success;
+}
+
+}  // namespace HugePage
+}  // namespace Internal
+}  // namespace Runtime
+}  // namespace Halide
+
+using namespace Halide::Runtime::Internal::HugePage;
+
+extern "C" {
+
+WEAK void *halide_huge_page_malloc(void *user_context, size_t x) {
+    const size_t alignment = ::halide_internal_malloc_alignment();
+    halide_debug_assert(user_context, alignment >= sizeof(Header));
+
+    if (x >= kMinHugePageAllocation) {
+        const size_t size = (alignment + x + kHugePageSize - 1) & ~(kHugePageSize - 1);
+        // mmap only promises small-page alignment, so over-allocate by
+        // a huge page and trim the ends back to a huge page boundary.
+        uint8_t *raw = (uint8_t *)mmap(nullptr, size + kHugePageSize, PROT_READ | PROT_WRITE,
+                                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw != (uint8_t *)-1) {
+            uint8_t *mapping = (uint8_t *)(((uintptr_t)raw + kHugePageSize - 1) & ~(uintptr_t)(kHugePageSize - 1));
+            const size_t head = mapping - raw;
+            if (head) {
+                munmap(raw, head);
+            }
+            // Rounding up moves by less than a huge page, so there is
+            // always a tail to trim.
+            halide_debug_assert(user_context, head < kHugePageSize);
+            munmap(mapping + size, kHugePageSize - head);
+            // Failure just means no transparent huge pages on this
+            // kernel; the mapping is still usable.
+            (void)madvise(mapping, size, MADV_HUGEPAGE);
+
+            if (should_prefault()) {
+                PrefaultClosure closure = {mapping, size};
+                (void)halide_do_par_for(user_context, prefault_task, 0, (int)(size / kHugePageSize),
+                                        (uint8_t *)&closure);
+            }
+
+            Header *h = (Header *)mapping;
+            h->mapping = mapping;
+            h->mapped_size = size;
+            return mapping + alignment;
+        }
+    }
+
+    Header *h = (Header *)halide_malloc(user_context, alignment + x);
+    if (!h) {
+        return nullptr;
+    }
+    h->mapping = nullptr;
+    h->mapped_size = 0;
+    return (uint8_t *)h + alignment;
+}
+
+WEAK void halide_huge_page_free(void *user_context, void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    Header *h = (Header *)((uint8_t *)ptr - ::halide_internal_malloc_alignment());
+    if (h->mapping) {
+        munmap(h->mapping, h->mapped_size);
+    } else {
+        halide_free(user_context, h);
+    }
+}
+
+WEAK void halide_set_huge_page_prefault(bool on) {
+    using namespace Halide::Runtime::Internal::Synchronization;
+    int p = on ? 1 : 0;
+    atomic_store_release(&prefault, &p);
+}
+
+}  // extern "C"
@@ -0,0 +1,103 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+extern "C" {
+
+extern int sched_getcpu();
+extern int sched_setaffinity(int pid, size_t cpusetsize, const void *mask);
+extern ssize_t read(int fd, void *buf, size_t count);
+
+}  // extern "C"
+
+namespace Halide {
+namespace Runtime {
+namespace Internal {
+
+// Node ids in /sys need not be dense, so we look this far for them.
+constexpr int max_numa_node_id = 64;
+
+// Largest cpu id we can express in an affinity mask.
+constexpr int max_affinity_cpus = 1024;
+
+// Read the cpulist of a node (e.g. "0-3,8-11") and set cpu_nodes[cpu]
+// to node for each cpu in it. Returns false if the node doesn't exist.
+WEAK bool read_numa_node_cpus(int node_id, int node, int *cpu_nodes, int max_cpus) {
+    char path[64];
+    char *end = path + sizeof(path);
+    char *dst = halide_string_to_string(path, end, "/sys/devices/system/node/node");
+    dst = halide_int64_to_string(dst, end, node_id, 1);
+    halide_string_to_string(dst, end, "/cpulist");
+
+    void *f = halide_fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    char buf[4096];
+    ssize_t len = read(fileno(f), buf, sizeof(buf) - 1);
+    fclose(f);
+    if (len <= 0) {
+        return false;
+    }
+    buf[len] = 0;
+
+    const char *p = buf;
+    while (*p >= '0' && *p <= '9') {
+        int first = 0;
+        while (*p >= '0' && *p <= '9') {
+            first = first * 10 + (*p++ - '0');
+        }
+        int last = first;
+        if (*p == '-') {
+            p++;
+            last = 0;
+            while (*p >= '0' && *p <= '9') {
+                last = last * 10 + (*p++ - '0');
+            }
+        }
+        for (int cpu = first; cpu <= last && cpu < max_cpus; cpu++) {
+            cpu_nodes[cpu] = node;
+        }
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return true;
+}
+
+}  // namespace Internal
+}  // namespace Runtime
+}  // namespace Halide
+
+using namespace Halide::Runtime::Internal;
+
+extern "C" {
+
+WEAK int halide_host_numa_topology(int *cpu_nodes, int max_cpus) {
+    for (int i = 0; i < max_cpus; i++) {
+        cpu_nodes[i] = -1;
+    }
+    int num_nodes = 0;
+    for (int node_id = 0; node_id < max_numa_node_id; node_id++) {
+        if (read_numa_node_cpus(node_id, num_nodes, cpu_nodes, max_cpus)) {
+            num_nodes++;
+        }
+    }
+    return num_nodes;
+}
+
+WEAK int halide_host_current_cpu() {
+    return sched_getcpu();
+}
+
+WEAK int halide_pin_current_thread(const int *cpus, int num_cpus) {
+    uint64_t mask[max_affinity_cpus / 64] = {0};
+    for (int i = 0; i < num_cpus; i++) {
+        if (cpus[i] >= 0 && cpus[i] < max_affinity_cpus) {
+            mask[cpus[i] / 64] |= (uint64_t)1 << (cpus[i] % 64);
+        }
+    }
+    // A pid of zero means the calling thread.
+    return sched_setaffinity(0, sizeof(mask), mask);
+}
+
+}  // extern "C"
@@ -0,0 +1,275 @@
+#include "HalideRuntime.h"
+#include "runtime_atomics.h"
+#include "runtime_internal.h"
+
+// Hardware performance counters for the sampling profiler, read
+// through Linux perf_event. Each thread that runs Halide code opens
+// counters on itself the first time it reports what it is doing, and
+// keeps a note of the Func it is computing and whether it is doing any
+// work at all. The sampling thread reads every thread's counters and
+// bills each thread's deltas to that thread's own Func.
+
+extern "C" {
+
+extern long syscall(long num, ...);
+extern long read(int fd, void *buf, size_t count);
+
+// The syscall numbers vary across platforms. This module is only
+// linked for x86.
+#ifdef BITS_64
+#define SYS_PERF_EVENT_OPEN 298
+#endif
+
+#ifdef BITS_32
+#define SYS_PERF_EVENT_OPEN 336
+#endif
+
+#define PERF_TYPE_HARDWARE 0
+#define PERF_COUNT_HW_CPU_CYCLES 0
+#define PERF_COUNT_HW_INSTRUCTIONS 1
+#define PERF_COUNT_HW_CACHE_MISSES 3
+#define PERF_COUNT_HW_BRANCH_MISSES 5
+#define PERF_FLAG_FD_CLOEXEC 8
+
+// The leading fields of struct perf_event_attr, padded out to
+// PERF_ATTR_SIZE_VER5. Everything we don't set is left zero.
+struct perf_event_attr {
+    uint32_t type;
+    uint32_t size;
+    uint64_t config;
+    uint64_t sample_period;
+    uint64_t sample_type;
+    uint64_t read_format;
+    uint64_t flags;
+    uint8_t unused[64];
+};
+
+#define PERF_ATTR_FLAG_EXCLUDE_KERNEL (1ULL << 5)
+#define PERF_ATTR_FLAG_EXCLUDE_HV (1ULL << 6)
+
+}  // extern "C"
+
+namespace Halide {
+namespace Runtime {
+namespace Internal {
+namespace PerfCounters {
+
+// In the order halide_profiler_perf_counters_sample reports them.
+const int kNumCounters = 4;
+const uint64_t kCounterConfigs[kNumCounters] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+// Threads beyond this many go uncounted.
+const int kMaxThreads = 256;
+
+// A slot is claimed by a thread setting id to its own thread id, and
+// is then only written by that thread until it sets ready. After that
+// the owning thread only writes func and active, and the sampling
+// thread owns last. Slots are never released, so a new thread that
+// reuses the id of one that has exited inherits its (now idle)
+// counters. Halide's own thread pool workers live until the thread
+// pool is shut down, so in practice this only affects user threads.
+struct ThreadCounters {
+    uintptr_t id;
+    int ready;
+    int func;
+    int active;
+    int fd[kNumCounters];
+    uint64_t last[kNumCounters];
+};
+
+WEAK ThreadCounters threads[kMaxThreads];
+WEAK int enabled = 0;
+
+WEAK int open_counter(uint64_t config) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    // Count user-space events only, which is all that
+    // perf_event_paranoid <= 2 permits.
+    attr.flags = PERF_ATTR_FLAG_EXCLUDE_KERNEL | PERF_ATTR_FLAG_EXCLUDE_HV;
+    // pid 0 and cpu -1 count the calling thread wherever it runs.
+    return (int)syscall(SYS_PERF_EVENT_OPEN, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+WEAK bool read_counter(int fd, uint64_t *value) {
+    return fd >= 0 && read(fd, value, sizeof(*value)) == (long)sizeof(*value);
+}
+
+// Find the calling thread's slot, claiming one and opening counters
+// on the calling thread if it doesn't have one yet.
+WEAK ThreadCounters *current_thread() {
+    using namespace Halide::Runtime::Internal::Synchronization;
+
+    uintptr_t me = halide_current_thread_id();
+    // Thread ids are usually pointers, so drop the low bits.
+    const uintptr_t h = (me >> 4) ^ (me >> 12);
+    for (int i = 0; i < kMaxThreads; i++) {
+        ThreadCounters *t = &threads[(h + i) % kMaxThreads];
+        uintptr_t id;
+        atomic_load_acquire(&t->id, &id);
+        if (id == me) {
+            return t;
+        }
+        if (id != 0) {
+            continue;
+        }
+        uintptr_t expected = 0;
+        if (!atomic_cas_strong_sequentially_consistent(&t->id, &expected, &me)) {
+            if (expected == me) {
+                return t;
+            }
+            continue;
+        }
+        t->func = -1;
+        t->active = 0;
+        for (int c = 0; c < kNumCounters; c++) {
+            t->fd[c] = open_counter(kCounterConfigs[c]);
+            t->last[c] = 0;
+            read_counter(t->fd[c], &t->last[c]);
+        }
+        int one = 1;
+        atomic_store_release(&t->ready, &one);
+        return t;
+    }
+    return nullptr;
+}
+
+}  // namespace PerfCounters
+}  // namespace Internal
+}  // namespace Runtime
+}  // namespace Halide
+
+using namespace Halide::Runtime::Internal::PerfCounters;
+
+extern "C" {
+
+WEAK bool halide_profiler_perf_counters_start() {
+    using namespace Halide::Runtime::Internal::Synchronization;
+
+    if (enabled) {
+        return true;
+    }
+    const char *env = getenv("HL_PROFILER_PERF_COUNTERS");
+    if (!env || env[0] != '1') {
+        return false;
+    }
+    // Check that we are allowed to count anything at all before
+    // asking every thread to try.
+    const int fd = open_counter(PERF_COUNT_HW_CPU_CYCLES);
+    if (fd < 0) {
+        halide_print(nullptr, "Could not open hardware performance counters; "
+                              "check /proc/sys/kernel/perf_event_paranoid.\n");
+        return false;
+    }
+    close(fd);
+
+    // Counters left over from a previous run have counted events
+    // since then that nobody should be billed for.
+    for (int i = 0; i < kMaxThreads; i++) {
+        int ready;
+        atomic_load_acquire(&threads[i].ready, &ready);
+        if (ready) {
+            for (int c = 0; c < kNumCounters; c++) {
+                read_counter(threads[i].fd[c], &threads[i].last[c]);
+            }
+        }
+    }
+    int one = 1;
+    atomic_store_release(&enabled, &one);
+    return true;
+}
+
+WEAK void halide_profiler_perf_counters_set_thread_func(int func) {
+    using namespace Halide::Runtime::Internal::Synchronization;
+
+    if (!enabled) {
+        return;
+    }
+    ThreadCounters *t = current_thread();
+    if (t) {
+        atomic_store_release(&t->func, &func);
+    }
+}
+
+WEAK void halide_profiler_perf_counters_set_thread_active(int active) {
+    using namespace Halide::Runtime::Internal::Synchronization;
+
+    if (!enabled) {
+        return;
+    }
+    ThreadCounters *t = current_thread();
+    if (t) {
+        atomic_store_release(&t->active, &active);
+    }
+}
+
+WEAK int halide_profiler_perf_counters_sample(int *funcs, uint64_t *deltas, int max_funcs) {
+    using namespace Halide::Runtime::Internal::Synchronization;
+
+    if (!enabled) {
+        return 0;
+    }
+    int num_funcs = 0;
+    for (int i = 0; i < kMaxThreads; i++) {
+        ThreadCounters &t = threads[i];
+        int ready;
+        atomic_load_acquire(&t.ready, &ready);
+        if (!ready) {
+            continue;
+        }
+        // Read every thread, including idle ones, so that what they
+        // count while idle isn't billed to their next Func.
+        uint64_t d[kNumCounters];
+        for (int c = 0; c < kNumCounters; c++) {
+            uint64_t value;
+            if (read_counter(t.fd[c], &value)) {
+                d[c] = value - t.last[c];
+                t.last[c] = value;
+            } else {
+                d[c] = 0;
+            }
+        }
+        int func, active;
+        atomic_load_acquire(&t.func, &func);
+        atomic_load_acquire(&t.active, &active);
+        if (func < 0 || active <= 0) {
+            continue;
+        }
+        int j = 0;
+        while (j < num_funcs && funcs[j] != func) {
+            j++;
+        }
+        if (j == max_funcs) {
+            continue;
+        }
+        if (j == num_funcs) {
+            funcs[j] = func;
+            for (int c = 0; c < kNumCounters; c++) {
+                deltas[j * kNumCounters + c] = 0;
+            }
+            num_funcs++;
+        }
+        for (int c = 0; c < kNumCounters; c++) {
+            deltas[j * kNumCounters + c] += d[c];
+        }
+    }
+    return num_funcs;
+}
+
+WEAK void halide_profiler_perf_counters_stop() {
+    using namespace Halide::Runtime::Internal::Synchronization;
+
+    // Threads may still be registering, so leave their counters open
+    // for the next start rather than racing them.
+    int zero = 0;
+    atomic_store_release(&enabled, &zero);
+}
+
+}  // extern "C"
@@ -0,0 +1,222 @@
+#include "HalideRuntime.h"
+#include "runtime_atomics.h"
+#include "runtime_internal.h"
+#include "scoped_mutex_lock.h"
+
+// A size-class pooling allocator that can stand in for
+// halide_default_malloc/free. Pipelines that heap-allocate inside a
+// parallel loop ask for the same few sizes on every tile and every
+// invocation, so instead of handing freed blocks back to the system
+// allocator (and serializing on its lock), we keep them on per-class
+// free lists and hand them straight back out.
+
+namespace Halide {
+namespace Runtime {
+namespace Internal {
+namespace Pool {
+
+// Size classes alternate between powers of two and one-and-a-half
+// times a power of two, from 128 bytes to 16 MB, so a block is never
+// more than a third bigger than the request it serves. Larger
+// requests bypass the pool.
+const int kMinClassLog2 = 7;
+const int kMaxClassLog2 = 24;
+const int kNumClasses = 2 * (kMaxClassLog2 - kMinClassLog2) + 1;
+static_assert(kNumClasses <= 64, "class masks are 64 bits");
+
+const uint32_t kMagic = 0x6c6f6f70;  // "pool"
+const int32_t kUnpooled = -1;
+
+// Every block is preceded by halide_internal_malloc_alignment() bytes
+// of header, which records where the block goes back to when freed.
+struct BlockHeader {
+    uint32_t magic;
+    int32_t size_class;
+    // Link in the free list, only meaningful while the block is free.
+    BlockHeader *next;
+};
+
+// The runtime has no thread-local storage, so the free lists are
+// sharded instead, and each thread picks its shard by hashing the
+// address of its own stack. Threads that free a block will usually
+// get it back on their next allocation of that size without
+// contending with anyone else. A thread whose shard is empty steals
+// from the others before going to the system allocator.
+const int kNumShards = 16;
+
+struct Shard {
+    halide_mutex lock;
+    BlockHeader *free_lists[kNumClasses];
+    // Bit i is set when free_lists[i] is non-empty. Written under the
+    // lock, read without it when looking for a block to steal.
+    uint64_t nonempty;
+    // Keep neighbouring shard locks off the same cache line.
+    uint8_t padding[64];
+};
+
+WEAK Shard shards[kNumShards];
+
+// Bytes sitting on free lists across all shards, and the most we are
+// willing to hold on to. Frees that would push us over the limit go
+// back to the system instead.
+const int64_t kDefaultCacheLimit = 256 * 1024 * 1024;
+WEAK int64_t cached_bytes = 0;
+WEAK int64_t cache_limit = kDefaultCacheLimit;
+
+ALWAYS_INLINE size_t class_size(int c) {
+    const size_t base = (size_t)1 << (kMinClassLog2 + c / 2);
+    return (c & 1) ? base + base / 2 : base;
+}
+
+// The smallest class that fits x bytes, or -1 if x is too large.
+ALWAYS_INLINE int size_class(size_t x) {
+    if (x <= ((size_t)1 << kMinClassLog2)) {
+        return 0;
+    }
+    if (x > ((size_t)1 << kMaxClassLog2)) {
+        return -1;
+    }
+    // 2^b < x <= 2^(b + 1)
+    const int b = 63 - __builtin_clzll((uint64_t)(x - 1));
+    const size_t half_step = ((size_t)1 << b) + ((size_t)1 << (b - 1));
+    return x <= half_step ? 2 * (b - kMinClassLog2) + 1 : 2 * (b + 1 - kMinClassLog2);
+}
+
+ALWAYS_INLINE int current_shard() {
+    // Thread stacks are at least a few hundred KB apart, so the
+    // address of a local is a stable per-thread value once the low
+    // bits are dropped. Mix the rest with a multiplicative hash, as
+    // stacks are often laid out at a fixed power-of-two stride.
+    int marker;
+    const uint64_t stack = (uint64_t)(uintptr_t)&marker >> 18;
+    return (int)((stack * 0x9e3779b97f4a7c15ULL) >> 60) % kNumShards;
+}
+
+ALWAYS_INLINE BlockHeader *pop_already_locked(Shard &s, int c) {
+    BlockHeader *b = s.free_lists[c];
+    if (b) {
+        s.free_lists[c] = b->next;
+        if (!b->next) {
+            uint64_t mask = s.nonempty & ~((uint64_t)1 << c);
+            Synchronization::atomic_store_release(&s.nonempty, &mask);
+        }
+    }
+    return b;
+}
+
+WEAK BlockHeader *take_block(int c) {
+    const uint64_t bit = (uint64_t)1 << c;
+    const int home = current_shard();
+    for (int i = 0; i < kNumShards; i++) {
+        Shard &s = shards[(home + i) % kNumShards];
+        uint64_t mask;
+        Synchronization::atomic_load_relaxed(&s.nonempty, &mask);
+        if (!(mask & bit)) {
+            continue;
+        }
+        ScopedMutexLock lock(&s.lock);
+        BlockHeader *b = pop_already_locked(s, c);
+        if (b) {
+            return b;
+        }
+    }
+    return nullptr;
+}
+
+}  // namespace Pool
+}  // namespace Internal
+}  // namespace Runtime
+}  // namespace Halide
+
+using namespace Halide::Runtime::Internal::Pool;
+
+extern "C" {
+
+WEAK void *halide_pooled_malloc(void *user_context, size_t x) {
+    const size_t alignment = ::halide_internal_malloc_alignment();
+    halide_debug_assert(user_context, alignment >= sizeof(BlockHeader));
+    const int c = size_class(x);
+    BlockHeader *b = nullptr;
+    if (c >= 0) {
+        b = take_block(c);
+        if (b) {
+            Halide::Runtime::Internal::Synchronization::atomic_fetch_sub_sequentially_consistent(
+                &cached_bytes, (int64_t)(class_size(c) + alignment));
+            return (uint8_t *)b + alignment;
+        }
+        x = class_size(c);
+    }
+    b = (BlockHeader *)::halide_internal_aligned_alloc(alignment, alignment + x);
+    if (!b) {
+        return nullptr;
+    }
+    b->magic = kMagic;
+    b->size_class = c >= 0 ? c : kUnpooled;
+    return (uint8_t *)b + alignment;
+}
+
+WEAK void halide_pooled_free(void *user_context, void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    const size_t alignment = ::halide_internal_malloc_alignment();
+    BlockHeader *b = (BlockHeader *)((uint8_t *)ptr - alignment);
+    halide_debug_assert(user_context, b->magic == kMagic);
+    const int c = b->size_class;
+    if (c == kUnpooled) {
+        ::halide_internal_aligned_free(b);
+        return;
+    }
+
+    using namespace Halide::Runtime::Internal::Synchronization;
+    const int64_t bytes = (int64_t)(class_size(c) + alignment);
+    int64_t limit;
+    atomic_load_relaxed(&cache_limit, &limit);
+    if (atomic_add_fetch_sequentially_consistent(&cached_bytes, bytes) > limit) {
+        atomic_fetch_sub_sequentially_consistent(&cached_bytes, bytes);
+        ::halide_internal_aligned_free(b);
+        return;
+    }
+
+    Shard &s = shards[current_shard()];
+    ScopedMutexLock lock(&s.lock);
+    b->next = s.free_lists[c];
+    s.free_lists[c] = b;
+    uint64_t mask = s.nonempty | ((uint64_t)1 << c);
+    atomic_store_release(&s.nonempty, &mask);
+}
+
+WEAK void halide_pooled_malloc_set_cache_limit(int64_t bytes) {
+    using namespace Halide::Runtime::Internal::Synchronization;
+    atomic_store_sequentially_consistent(&cache_limit, &bytes);
+}
+
+WEAK void halide_pooled_malloc_release_unused(void *user_context) {
+    using namespace Halide::Runtime::Internal::Synchronization;
+    const size_t alignment = ::halide_internal_malloc_alignment();
+    for (int i = 0; i < kNumShards; i++) {
+        Shard &s = shards[i];
+        ScopedMutexLock lock(&s.lock);
+        for (int c = 0; c < kNumClasses; c++) {
+            BlockHeader *b = s.free_lists[c];
+            while (b) {
+                BlockHeader *next = b->next;
+                atomic_fetch_sub_sequentially_consistent(&cached_bytes, (int64_t)(class_size(c) + alignment));
+                ::halide_internal_aligned_free(b);
+                b = next;
+            }
+            s.free_lists[c] = nullptr;
+        }
+        uint64_t mask = 0;
+        atomic_store_release(&s.nonempty, &mask);
+    }
+}
+}
+
+namespace {
+
+WEAK __attribute__((destructor)) void halide_pooled_malloc_cleanup() {
+    halide_pooled_malloc_release_unused(nullptr);
+}
+
+}  // namespace
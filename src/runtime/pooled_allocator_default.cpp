@@ -0,0 +1,20 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+// Linked in when a pipeline is compiled with the pooled_malloc target
+// feature: make the pooled allocator the one behind halide_malloc and
+// halide_free. This runs before any pipeline can allocate, so no
+// block can end up freed by a different allocator than the one that
+// allocated it.
+
+extern "C" {
+
+namespace {
+
+WEAK __attribute__((constructor)) void halide_install_pooled_malloc() {
+    halide_set_custom_malloc(halide_pooled_malloc);
+    halide_set_custom_free(halide_pooled_free);
+}
+
+}  // namespace
+}
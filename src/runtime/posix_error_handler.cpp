@@ -36,6 +36,10 @@ WEAK halide_error_handler_t error_handler = halide_default_error;
 extern "C" {
 
 WEAK void halide_error(void *user_context, const char *msg) {
+    // Print the recent history of the pipeline, if the flight recorder
+    // is on, before the handler gets a chance to abort.
+    // Targets without the tracing module link in a stub.
+    halide_trace_flight_recorder_dump(user_context);
     (*error_handler)(user_context, msg);
 }
 
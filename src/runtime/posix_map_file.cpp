@@ -0,0 +1,51 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+extern "C" {
+
+extern void *mmap(void *addr, size_t length, int prot, int flags, int fd, long offset);
+extern int munmap(void *addr, size_t length);
+extern int ftruncate(int fd, long length);
+extern long lseek(int fd, long offset, int whence);
+
+#define PROT_READ 0x1
+#define PROT_WRITE 0x2
+#define MAP_SHARED 0x1
+#define SEEK_END 2
+
+WEAK void *halide_map_shared_file(void *user_context, const char *filename, size_t min_size, size_t *size) {
+    // "a+" creates the file if needed without truncating it.
+    void *f = halide_fopen(filename, "a+");
+    if (f == nullptr) {
+        return nullptr;
+    }
+    int fd = fileno(f);
+
+    void *result = nullptr;
+    long file_size = lseek(fd, 0, SEEK_END);
+    if (file_size >= 0 && (size_t)file_size < min_size) {
+        if (ftruncate(fd, (long)min_size) == 0) {
+            file_size = (long)min_size;
+        } else {
+            file_size = -1;
+        }
+    }
+    if (file_size > 0) {
+        result = mmap(nullptr, (size_t)file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (result == (void *)-1) {
+            result = nullptr;
+        } else {
+            *size = (size_t)file_size;
+        }
+    }
+
+    // The mapping stays valid after the file is closed.
+    fclose(f);
+    return result;
+}
+
+WEAK void halide_unmap_shared_file(void *user_context, void *addr, size_t size) {
+    munmap(addr, size);
+}
+
+}  // extern "C"
@@ -20,6 +20,7 @@ typedef long pthread_t;
 extern int pthread_create(pthread_t *, const void *attr,
                           void *(*start_routine)(void *), void *arg);
 extern int pthread_join(pthread_t thread, void **retval);
+extern pthread_t pthread_self();
 extern int pthread_cond_init(pthread_cond_t *cond, const void *attr);
 extern int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex);
 extern int pthread_cond_signal(pthread_cond_t *cond);
@@ -75,6 +76,14 @@ WEAK void halide_join_thread(struct halide_thread *thread_arg) {
     pthread_join(t->handle, &ret);
     free(t);
 }
+
+WEAK uintptr_t halide_current_thread_id() {
+    return (uintptr_t)pthread_self();
+}
+
+WEAK bool halide_can_spawn_threads() {
+    return true;
+}
 }
 
 namespace Halide {
@@ -14,6 +14,22 @@ WEAK halide_profiler_state *halide_profiler_get_state() {
     return &s;
 }
 
+// The cache module isn't linked on Hexagon, so only report on it if
+// it is present.
+WEAK int halide_memoization_cache_get_stats(halide_memoization_cache_stats_t *stats,
+                                            halide_memoization_cache_func_stats_t *func_stats,
+                                            int max_funcs);
+
+// Hardware performance counters. Platforms without them link in
+// stubs that report none. halide_profiler_perf_counters_sample
+// returns the number of Funcs that threads have been running since
+// the last call, and fills in the id of each, followed by the cycles,
+// instructions, LLC misses and branch misses counted by the threads
+// running it. They are only called from the sampling thread.
+extern bool halide_profiler_perf_counters_start();
+extern int halide_profiler_perf_counters_sample(int *funcs, uint64_t *deltas, int max_funcs);
+extern void halide_profiler_perf_counters_stop();
+
 #if TIMER_PROFILING
 extern "C" void halide_start_timer_chain();
 extern "C" void halide_disable_timer_interrupt();
@@ -75,6 +91,10 @@ WEAK halide_profiler_pipeline_stats *find_or_create_pipeline(const char *pipelin
     p->num_allocs = 0;
     p->active_threads_numerator = 0;
     p->active_threads_denominator = 0;
+    p->cycles = 0;
+    p->instructions = 0;
+    p->llc_misses = 0;
+    p->branch_misses = 0;
     p->funcs = (halide_profiler_func_stats *)malloc(num_funcs * sizeof(halide_profiler_func_stats));
     if (!p->funcs) {
         free(p);
@@ -82,6 +102,7 @@ WEAK halide_profiler_pipeline_stats *find_or_create_pipeline(const char *pipelin
     }
     for (int i = 0; i < num_funcs; i++) {
         p->funcs[i].time = 0;
+        p->funcs[i].inclusive_time = 0;
         p->funcs[i].name = (const char *)(func_names[i]);
         p->funcs[i].memory_current = 0;
         p->funcs[i].memory_peak = 0;
@@ -90,12 +111,62 @@ WEAK halide_profiler_pipeline_stats *find_or_create_pipeline(const char *pipelin
         p->funcs[i].stack_peak = 0;
         p->funcs[i].active_threads_numerator = 0;
         p->funcs[i].active_threads_denominator = 0;
+        p->funcs[i].cycles = 0;
+        p->funcs[i].instructions = 0;
+        p->funcs[i].llc_misses = 0;
+        p->funcs[i].branch_misses = 0;
     }
     s->first_free_id += num_funcs;
     s->pipelines = p;
     return p;
 }
 
+// A record of which Func was running when, for the Chrome trace
+// exporter. Consecutive samples of the same Func are merged into one
+// event. The buffer is allocated up front by
+// halide_profiler_pipeline_start, because halide_profiler_sample may
+// be running in a signal handler, and samples that don't fit are
+// dropped.
+struct TimelineEvent {
+    uint64_t start, end;
+    int func_id;
+    int active_threads;
+};
+
+const int kTimelineCapacity = 1 << 18;
+WEAK TimelineEvent *timeline = nullptr;
+WEAK int timeline_size = 0;
+WEAK bool timeline_dropped = false;
+WEAK bool timeline_requested = false;
+
+WEAK void record_timeline(int func_id, uint64_t start, uint64_t end, int active_threads) {
+    if (!timeline) {
+        return;
+    }
+    if (timeline_size > 0) {
+        TimelineEvent &last = timeline[timeline_size - 1];
+        if (last.func_id == func_id &&
+            last.active_threads == active_threads &&
+            last.end == start) {
+            last.end = end;
+            return;
+        }
+    }
+    if (timeline_size == kTimelineCapacity) {
+        timeline_dropped = true;
+        return;
+    }
+    timeline[timeline_size++] = {start, end, func_id, active_threads};
+}
+
+WEAK bool timeline_wanted() {
+    if (timeline_requested) {
+        return true;
+    }
+    const char *trace = getenv("HL_PROFILER_CHROME_TRACE");
+    return trace && *trace;
+}
+
 WEAK void bill_func(halide_profiler_state *s, int func_id, uint64_t time, int active_threads) {
     halide_profiler_pipeline_stats *p_prev = nullptr;
     for (halide_profiler_pipeline_stats *p = s->pipelines; p;
@@ -142,14 +213,53 @@ extern "C" WEAK int halide_profiler_sample(struct halide_profiler_state *s, uint
         // Assume all time since I was last awake is due to
         // the currently running func.
         bill_func(s, func, t_now - *prev_t, active_threads);
+        record_timeline(func, *prev_t, t_now, active_threads);
     }
     *prev_t = t_now;
     return s->sleep_time;
 }
 
+// Find the pipeline and Func stats for a global func id.
+WEAK bool find_func(halide_profiler_state *s, int func_id,
+                    halide_profiler_pipeline_stats **pipeline, halide_profiler_func_stats **func) {
+    for (halide_profiler_pipeline_stats *p = s->pipelines; p;
+         p = (halide_profiler_pipeline_stats *)(p->next)) {
+        if (func_id >= p->first_func_id && func_id < p->first_func_id + p->num_funcs) {
+            *pipeline = p;
+            *func = p->funcs + func_id - p->first_func_id;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Add hardware performance counter deltas to a Func and its
+// pipeline. Must be called with the profiler lock held.
+WEAK void bill_counters(halide_profiler_state *s, int func_id, const uint64_t *counters) {
+    halide_profiler_pipeline_stats *p;
+    halide_profiler_func_stats *f;
+    if (!find_func(s, func_id, &p, &f)) {
+        return;
+    }
+    f->cycles += counters[0];
+    f->instructions += counters[1];
+    f->llc_misses += counters[2];
+    f->branch_misses += counters[3];
+    p->cycles += counters[0];
+    p->instructions += counters[1];
+    p->llc_misses += counters[2];
+    p->branch_misses += counters[3];
+}
+
 WEAK void sampling_profiler_thread(void *) {
     halide_profiler_state *s = halide_profiler_get_state();
 
+    const bool use_counters = halide_profiler_perf_counters_start();
+    const int kMaxCounterFuncs = 64;
+    int counter_funcs[kMaxCounterFuncs];
+    uint64_t counters[kMaxCounterFuncs * 4];
+    int num_counter_funcs = 0;
+
     // grab the lock
     halide_mutex_lock(&s->lock);
 
@@ -158,17 +268,396 @@ WEAK void sampling_profiler_thread(void *) {
         uint64_t t = t1;
         while (true) {
             int sleep_ms = halide_profiler_sample(s, &t);
+            for (int i = 0; i < num_counter_funcs; i++) {
+                bill_counters(s, counter_funcs[i], counters + i * 4);
+            }
             if (sleep_ms < 0) {
                 break;
             }
             // Release the lock, sleep, reacquire.
             halide_mutex_unlock(&s->lock);
             halide_sleep_ms(nullptr, sleep_ms);
+            // Reading the counters takes a syscall per counter per
+            // thread, so do it before retaking the lock. Each thread's
+            // deltas go to the Func that thread is running.
+            num_counter_funcs = use_counters ? halide_profiler_perf_counters_sample(counter_funcs, counters, kMaxCounterFuncs) : 0;
             halide_mutex_lock(&s->lock);
         }
     }
 
     halide_mutex_unlock(&s->lock);
+
+    halide_profiler_perf_counters_stop();
+}
+
+// Print the memoization cache counters for the Funcs of a pipeline.
+WEAK void report_memoization_cache(void *user_context, const char *pipeline_name,
+                                   const halide_memoization_cache_func_stats_t *funcs, int num_funcs) {
+    StringStreamPrinter<1024> sstr(user_context);
+    for (int i = 0; i < num_funcs; i++) {
+        const halide_memoization_cache_func_stats_t &fs = funcs[i];
+        if (fs.pipeline_name == nullptr || strcmp(fs.pipeline_name, pipeline_name) != 0) {
+            continue;
+        }
+        sstr.clear();
+        uint64_t lookups = fs.hits + fs.misses;
+        int percent = lookups ? (int)((100 * (fs.hits + fs.file_hits)) / lookups) : 0;
+        sstr << "  memoized " << fs.func_name << ": hits: " << fs.hits
+             << "  misses: " << fs.misses;
+        if (fs.file_hits) {
+            sstr << "  file hits: " << fs.file_hits;
+        }
+        sstr << "  (" << percent << "% hit)"
+             << "  evictions: " << fs.evictions
+             << "  resident: " << fs.bytes << " bytes in " << fs.entries << " entries\n";
+        halide_print(user_context, sstr.str());
+    }
+}
+
+// Buffered writes to a file, so that the exporters can stream out
+// small pieces without caring about the size of the whole thing.
+class FileWriter {
+    void *f;
+    bool ok;
+
+public:
+    explicit FileWriter(const char *filename)
+        : f(halide_fopen(filename, "wb")), ok(f != nullptr) {
+    }
+
+    ~FileWriter() {
+        if (f) {
+            fclose(f);
+        }
+    }
+
+    void write(const void *data, size_t size) {
+        if (ok && size) {
+            ok = fwrite(data, size, 1, f) == 1;
+        }
+    }
+
+    void write(const char *str) {
+        write(str, strlen(str));
+    }
+
+    bool succeeded() const {
+        return ok;
+    }
+};
+
+// Write a string as a JSON string literal.
+WEAK void write_json_string(FileWriter &out, const char *str) {
+    out.write("\"");
+    for (const char *c = str; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            out.write("\\", 1);
+            out.write(c, 1);
+        } else if ((unsigned char)*c < 0x20) {
+            out.write(" ");
+        } else {
+            out.write(c, 1);
+        }
+    }
+    out.write("\"");
+}
+
+// Print a time in nanoseconds as microseconds with three decimal
+// places. Printing a double would round large timestamps to seven
+// significant digits.
+WEAK void print_microseconds(StringStreamPrinter<1024> &sstr, uint64_t ns) {
+    uint64_t frac = ns % 1000;
+    sstr << ns / 1000 << "." << (frac < 100 ? "0" : "") << (frac < 10 ? "0" : "") << frac;
+}
+
+// Write the timeline as Chrome trace event JSON, which can be loaded
+// into chrome://tracing or Perfetto. Each run of samples billed to
+// one Func becomes a complete event on a single track, and the
+// number of active threads becomes a counter track.
+WEAK int write_chrome_trace_unlocked(void *user_context, halide_profiler_state *s, const char *filename) {
+    FileWriter out(filename);
+    StringStreamPrinter<1024> sstr(user_context);
+
+    out.write("{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n"
+              "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": 0, "
+              "\"args\": {\"name\": \"Halide\"}}");
+    for (int i = 0; i < timeline_size; i++) {
+        const TimelineEvent &e = timeline[i];
+        halide_profiler_pipeline_stats *p;
+        halide_profiler_func_stats *f;
+        if (!find_func(s, e.func_id, &p, &f)) {
+            continue;
+        }
+        out.write(",\n{\"name\": ");
+        write_json_string(out, f->name);
+        out.write(", \"cat\": ");
+        write_json_string(out, p->name);
+        sstr.clear();
+        sstr << ", \"ph\": \"X\", \"pid\": 0, \"tid\": 0, \"ts\": ";
+        print_microseconds(sstr, e.start);
+        sstr << ", \"dur\": ";
+        print_microseconds(sstr, e.end - e.start);
+        sstr << "},\n{\"name\": \"active threads\", \"ph\": \"C\", \"pid\": 0, \"ts\": ";
+        print_microseconds(sstr, e.start);
+        sstr << ", \"args\": {\"threads\": " << e.active_threads << "}}";
+        out.write(sstr.str());
+    }
+    out.write("\n]}\n");
+
+    if (timeline_dropped) {
+        sstr.clear();
+        sstr << "Profiler timeline was truncated at " << kTimelineCapacity << " events\n";
+        halide_print(user_context, sstr.str());
+    }
+    return out.succeeded() ? halide_error_code_success : halide_error_code_generic_error;
+}
+
+// Just enough of a protocol buffer encoder to write a pprof profile.
+class ProtoWriter {
+    uint8_t *buf = nullptr;
+    size_t size = 0, capacity = 0;
+    bool ok = true;
+
+    void append(const void *data, size_t n) {
+        if (!ok) {
+            return;
+        }
+        if (size + n > capacity) {
+            size_t new_capacity = capacity ? capacity * 2 : 256;
+            while (new_capacity < size + n) {
+                new_capacity *= 2;
+            }
+            uint8_t *new_buf = (uint8_t *)malloc(new_capacity);
+            if (!new_buf) {
+                ok = false;
+                return;
+            }
+            if (buf) {
+                memcpy(new_buf, buf, size);
+                free(buf);
+            }
+            buf = new_buf;
+            capacity = new_capacity;
+        }
+        memcpy(buf + size, data, n);
+        size += n;
+    }
+
+    void varint(uint64_t v) {
+        uint8_t bytes[10];
+        int n = 0;
+        do {
+            bytes[n] = (v & 0x7f) | (v > 0x7f ? 0x80 : 0);
+            v >>= 7;
+            n++;
+        } while (v);
+        append(bytes, n);
+    }
+
+public:
+    ProtoWriter() = default;
+    ProtoWriter(const ProtoWriter &) = delete;
+    ProtoWriter &operator=(const ProtoWriter &) = delete;
+
+    ~ProtoWriter() {
+        free(buf);
+    }
+
+    void uint_field(int field, uint64_t v) {
+        varint((uint64_t)field << 3);
+        varint(v);
+    }
+
+    void bytes_field(int field, const void *data, size_t n) {
+        varint(((uint64_t)field << 3) | 2);
+        varint(n);
+        append(data, n);
+    }
+
+    void string_field(int field, const char *str) {
+        bytes_field(field, str, strlen(str));
+    }
+
+    void message_field(int field, const ProtoWriter &m) {
+        bytes_field(field, m.buf, m.size);
+    }
+
+    void clear() {
+        size = 0;
+    }
+
+    const uint8_t *data() const {
+        return buf;
+    }
+
+    size_t length() const {
+        return size;
+    }
+
+    bool succeeded() const {
+        return ok;
+    }
+};
+
+// Write the per-Func totals as a pprof profile (profile.proto,
+// uncompressed, which pprof accepts). Each Func is a sample whose
+// stack is the Func inside its pipeline, with the total time, heap
+// bytes allocated and heap allocation count as values.
+WEAK int write_pprof_unlocked(void *user_context, halide_profiler_state *s, const char *filename) {
+    // Fields of the messages in profile.proto
+    enum {
+        kProfileSampleType = 1,
+        kProfileSample = 2,
+        kProfileLocation = 4,
+        kProfileFunction = 5,
+        kProfileStringTable = 6,
+        kProfileDurationNanos = 10,
+        kProfilePeriodType = 11,
+        kProfilePeriod = 12,
+        kValueTypeType = 1,
+        kValueTypeUnit = 2,
+        kSampleLocationId = 1,
+        kSampleValue = 2,
+        kLocationId = 1,
+        kLocationLine = 4,
+        kLineFunctionId = 1,
+        kFunctionId = 1,
+        kFunctionName = 2,
+        kFunctionSystemName = 3,
+    };
+
+    ProtoWriter profile, m, sub;
+    int64_t strings = 0;
+    const auto add_string = [&](const char *str) {
+        profile.string_field(kProfileStringTable, str);
+        return strings++;
+    };
+    const auto add_value_type = [&](int field, int64_t type, int64_t unit) {
+        m.clear();
+        m.uint_field(kValueTypeType, type);
+        m.uint_field(kValueTypeUnit, unit);
+        profile.message_field(field, m);
+    };
+
+    add_string("");
+    const int64_t time_str = add_string("time");
+    const int64_t ns_str = add_string("nanoseconds");
+    const int64_t alloc_space_str = add_string("alloc_space");
+    const int64_t bytes_str = add_string("bytes");
+    const int64_t allocs_str = add_string("allocations");
+    const int64_t count_str = add_string("count");
+    add_value_type(kProfileSampleType, time_str, ns_str);
+    add_value_type(kProfileSampleType, alloc_space_str, bytes_str);
+    add_value_type(kProfileSampleType, allocs_str, count_str);
+    add_value_type(kProfilePeriodType, time_str, ns_str);
+    profile.uint_field(kProfilePeriod, (uint64_t)s->sleep_time * 1000000);
+
+    // Every Func and pipeline gets a function and a location with the
+    // same id.
+    uint64_t next_id = 1;
+    const auto add_function = [&](const char *name) {
+        const uint64_t id = next_id++;
+        const int64_t name_str = add_string(name);
+        m.clear();
+        m.uint_field(kFunctionId, id);
+        m.uint_field(kFunctionName, name_str);
+        m.uint_field(kFunctionSystemName, name_str);
+        profile.message_field(kProfileFunction, m);
+        sub.clear();
+        sub.uint_field(kLineFunctionId, id);
+        m.clear();
+        m.uint_field(kLocationId, id);
+        m.message_field(kLocationLine, sub);
+        profile.message_field(kProfileLocation, m);
+        return id;
+    };
+
+    uint64_t duration = 0;
+    for (halide_profiler_pipeline_stats *p = s->pipelines; p;
+         p = (halide_profiler_pipeline_stats *)(p->next)) {
+        if (!p->runs) {
+            continue;
+        }
+        duration += p->time;
+        const uint64_t pipeline_id = add_function(p->name);
+        for (int i = 0; i < p->num_funcs; i++) {
+            const halide_profiler_func_stats *fs = p->funcs + i;
+            if (!fs->time && !fs->memory_total) {
+                continue;
+            }
+            const uint64_t func_id = add_function(fs->name);
+            m.clear();
+            // Stacks are leaf first. Repeated scalars may be written
+            // unpacked, which keeps this simple.
+            m.uint_field(kSampleLocationId, func_id);
+            m.uint_field(kSampleLocationId, pipeline_id);
+            m.uint_field(kSampleValue, fs->time);
+            m.uint_field(kSampleValue, fs->memory_total);
+            m.uint_field(kSampleValue, fs->num_allocs);
+            profile.message_field(kProfileSample, m);
+        }
+    }
+    profile.uint_field(kProfileDurationNanos, duration);
+
+    if (!profile.succeeded() || !m.succeeded() || !sub.succeeded()) {
+        return halide_error_code_out_of_memory;
+    }
+    FileWriter out(filename);
+    out.write(profile.data(), profile.length());
+    return out.succeeded() ? halide_error_code_success : halide_error_code_generic_error;
+}
+
+// Write out whatever the HL_PROFILER_CHROME_TRACE and HL_PROFILER_PPROF
+// environment variables ask for, alongside the text report.
+WEAK void export_from_environment(void *user_context, halide_profiler_state *s) {
+    const char *trace = getenv("HL_PROFILER_CHROME_TRACE");
+    if (trace && *trace && timeline &&
+        write_chrome_trace_unlocked(user_context, s, trace) != halide_error_code_success) {
+        halide_print(user_context, "Failed to write profiler Chrome trace\n");
+    }
+    const char *pprof = getenv("HL_PROFILER_PPROF");
+    if (pprof && *pprof &&
+        write_pprof_unlocked(user_context, s, pprof) != halide_error_code_success) {
+        halide_print(user_context, "Failed to write profiler pprof profile\n");
+    }
+}
+
+// With Target::ProfileLoops, each loop gets an id named by its path
+// from the enclosing Func, e.g. "f/s0.y/s0.x". Returns the index of
+// the func or loop that funcs[i] is nested in, or -1 for a root.
+WEAK int find_parent(const halide_profiler_pipeline_stats *p, int i) {
+    const char *name = p->funcs[i].name;
+    int slash = -1;
+    for (int c = 0; name[c]; c++) {
+        if (name[c] == '/') {
+            slash = c;
+        }
+    }
+    if (slash < 0) {
+        return -1;
+    }
+    // Parents are always assigned lower ids than their children.
+    for (int j = 0; j < i; j++) {
+        const char *other = p->funcs[j].name;
+        if (strncmp(other, name, slash) == 0 && other[slash] == 0) {
+            return j;
+        }
+    }
+    return -1;
+}
+
+// Lay out the funcs of a pipeline depth-first, so that each loop is
+// reported beneath its parent. Returns the number of entries written.
+WEAK int tree_order(const halide_profiler_pipeline_stats *p, const int *parents,
+                    int parent, int depth, int *order, int *depths, int n) {
+    for (int i = 0; i < p->num_funcs; i++) {
+        if (parents[i] == parent) {
+            order[n] = i;
+            depths[n] = depth;
+            n = tree_order(p, parents, i, depth + 1, order, depths, n + 1);
+        }
+    }
+    return n;
 }
 
 }  // namespace Internal
@@ -229,6 +718,31 @@ WEAK int halide_profiler_pipeline_start(void *user_context,
 #endif
     }
 
+    if (!timeline && timeline_wanted()) {
+        timeline = (TimelineEvent *)malloc(kTimelineCapacity * sizeof(TimelineEvent));
+    }
+
+    halide_profiler_pipeline_stats *p =
+        find_or_create_pipeline(pipeline_name, num_funcs, func_names);
+    if (!p) {
+        // Allocating space to track the statistics failed.
+        return halide_error_out_of_memory(user_context);
+    }
+    p->runs++;
+
+    return p->first_func_id;
+}
+
+WEAK int halide_profiler_instrumented_pipeline_start(void *user_context,
+                                                     const char *pipeline_name,
+                                                     int num_funcs,
+                                                     const uint64_t *func_names) {
+    halide_profiler_state *s = halide_profiler_get_state();
+
+    LockProfiler lock(s);
+
+    halide_start_clock(user_context);
+
     halide_profiler_pipeline_stats *p =
         find_or_create_pipeline(pipeline_name, num_funcs, func_names);
     if (!p) {
@@ -333,6 +847,20 @@ WEAK void halide_profiler_memory_free(void *user_context,
 WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_state *s) {
     StringStreamPrinter<1024> sstr(user_context);
 
+    halide_memoization_cache_stats_t cache_stats = {};
+    halide_memoization_cache_func_stats_t *cache_funcs = nullptr;
+    int num_cache_funcs = 0;
+    if (halide_memoization_cache_get_stats != nullptr) {
+        halide_memoization_cache_get_stats(&cache_stats, nullptr, 0);
+    }
+    if (cache_stats.num_funcs > 0) {
+        cache_funcs = (halide_memoization_cache_func_stats_t *)malloc(cache_stats.num_funcs * sizeof(halide_memoization_cache_func_stats_t));
+        if (cache_funcs) {
+            halide_memoization_cache_get_stats(&cache_stats, cache_funcs, cache_stats.num_funcs);
+            num_cache_funcs = cache_stats.num_funcs;
+        }
+    }
+
     for (halide_profiler_pipeline_stats *p = s->pipelines; p;
          p = (halide_profiler_pipeline_stats *)(p->next)) {
         float t = p->time / 1000000.0f;
@@ -352,6 +880,12 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
         }
         sstr << " heap allocations: " << p->num_allocs
              << "  peak heap usage: " << p->memory_peak << " bytes\n";
+        if (p->cycles) {
+            sstr << " cycles: " << p->cycles
+                 << "  instructions: " << p->instructions
+                 << "  LLC misses: " << p->llc_misses
+                 << "  branch misses: " << p->branch_misses << "\n";
+        }
         halide_print(user_context, sstr.str());
 
         bool print_f_states = p->time || p->memory_total;
@@ -366,7 +900,23 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
         }
 
         if (print_f_states) {
-            for (int i = 0; i < p->num_funcs; i++) {
+            // Report loops as a tree under their Funcs. Without
+            // Target::ProfileLoops every func is a root, and this is
+            // just the order they were registered in.
+            int *order = (int *)malloc(3 * p->num_funcs * sizeof(int));
+            int *depths = nullptr;
+            if (order) {
+                depths = order + p->num_funcs;
+                int *parents = depths + p->num_funcs;
+                for (int i = 0; i < p->num_funcs; i++) {
+                    parents[i] = find_parent(p, i);
+                }
+                tree_order(p, parents, -1, 0, order, depths, 0);
+            }
+
+            for (int k = 0; k < p->num_funcs; k++) {
+                const int i = order ? order[k] : k;
+                const int depth = order ? depths[k] : 0;
                 size_t cursor = 0;
                 sstr.clear();
                 halide_profiler_func_stats *fs = p->funcs + i;
@@ -377,7 +927,20 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
                     continue;
                 }
 
-                sstr << "  " << fs->name << ": ";
+                sstr << "  ";
+                const char *name = fs->name;
+                if (depth > 0) {
+                    for (int d = 0; d < depth; d++) {
+                        sstr << "  ";
+                    }
+                    // Just the last component of the loop's path.
+                    for (const char *c = fs->name; *c; c++) {
+                        if (*c == '/') {
+                            name = c + 1;
+                        }
+                    }
+                }
+                sstr << name << ": ";
                 cursor += 25;
                 while (sstr.size() < cursor) {
                     sstr << " ";
@@ -433,12 +996,46 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
                 if (fs->stack_peak > 0) {
                     sstr << " stack: " << fs->stack_peak;
                 }
+                if (fs->inclusive_time) {
+                    sstr << " inclusive: " << fs->inclusive_time / (p->runs * 1000000.0f);
+                    sstr.erase(3);
+                    sstr << "ms";
+                }
+                if (fs->cycles) {
+                    // Instructions per cycle, and misses per thousand
+                    // instructions. A low IPC with a high LLC miss rate
+                    // marks a memory-bound stage.
+                    const float kinst = fs->instructions / 1000.0f + 1e-10f;
+                    sstr << " ipc: " << (float)fs->instructions / fs->cycles;
+                    sstr.erase(4);
+                    sstr << " llc mpki: " << fs->llc_misses / kinst;
+                    sstr.erase(4);
+                    sstr << " branch mpki: " << fs->branch_misses / kinst;
+                    sstr.erase(4);
+                }
                 sstr << "\n";
 
                 halide_print(user_context, sstr.str());
             }
+            free(order);
         }
+
+        report_memoization_cache(user_context, p->name, cache_funcs, num_cache_funcs);
     }
+
+    if (cache_stats.hits + cache_stats.misses > 0) {
+        sstr.clear();
+        sstr << "memoization cache: hits: " << cache_stats.hits
+             << "  misses: " << cache_stats.misses
+             << "  file hits: " << cache_stats.file_hits
+             << "  evictions: " << cache_stats.evictions
+             << "  resident: " << cache_stats.current_size << " of " << cache_stats.max_size
+             << " bytes in " << cache_stats.entries << " entries\n";
+        halide_print(user_context, sstr.str());
+    }
+    free(cache_funcs);
+
+    export_from_environment(user_context, s);
 }
 
 WEAK void halide_profiler_report(void *user_context) {
@@ -447,6 +1044,24 @@ WEAK void halide_profiler_report(void *user_context) {
     halide_profiler_report_unlocked(user_context, s);
 }
 
+WEAK void halide_profiler_record_timeline(bool on) {
+    halide_profiler_state *s = halide_profiler_get_state();
+    LockProfiler lock(s);
+    timeline_requested = on;
+}
+
+WEAK int halide_profiler_write_chrome_trace(void *user_context, const char *filename) {
+    halide_profiler_state *s = halide_profiler_get_state();
+    LockProfiler lock(s);
+    return write_chrome_trace_unlocked(user_context, s, filename);
+}
+
+WEAK int halide_profiler_write_pprof(void *user_context, const char *filename) {
+    halide_profiler_state *s = halide_profiler_get_state();
+    LockProfiler lock(s);
+    return write_pprof_unlocked(user_context, s, filename);
+}
+
 WEAK void halide_profiler_reset_unlocked(halide_profiler_state *s) {
     while (s->pipelines) {
         halide_profiler_pipeline_stats *p = s->pipelines;
@@ -455,6 +1070,10 @@ WEAK void halide_profiler_reset_unlocked(halide_profiler_state *s) {
         free(p);
     }
     s->first_free_id = 0;
+    free(timeline);
+    timeline = nullptr;
+    timeline_size = 0;
+    timeline_dropped = false;
 }
 
 WEAK void halide_profiler_reset() {
@@ -3,6 +3,51 @@
 
 extern "C" {
 
+// Defined by the arch-specific runtime modules that have a user-space
+// cycle counter, and by fake_cycle_counter (which returns the time in
+// nanoseconds) everywhere else.
+extern uint64_t halide_profiler_read_cycle_counter();
+
+// Tell the hardware performance counters what the calling thread is
+// doing. Stubs on platforms without them.
+extern void halide_profiler_perf_counters_set_thread_func(int func);
+extern void halide_profiler_perf_counters_set_thread_active(int active);
+}
+
+namespace Halide {
+namespace Runtime {
+namespace Internal {
+
+// Nanoseconds per tick of halide_profiler_read_cycle_counter, measured
+// once by halide_profiler_instrumented_calibrate.
+WEAK double instrumented_ns_per_tick = 0.0;
+
+// The per-task state of the instrumented profiler. Each task (the
+// pipeline itself, and each iteration of a parallel loop) gets one of
+// these on its stack, followed by two arrays of num_funcs tick counts,
+// so that threads only touch the shared stats when the task ends.
+struct InstrumentedTask {
+    uint64_t last;
+    int32_t current;
+    int32_t num_funcs;
+};
+
+ALWAYS_INLINE uint64_t *instrumented_exclusive(InstrumentedTask *task) {
+    return (uint64_t *)(task + 1);
+}
+
+ALWAYS_INLINE uint64_t *instrumented_inclusive(InstrumentedTask *task) {
+    return (uint64_t *)(task + 1) + task->num_funcs;
+}
+
+}  // namespace Internal
+}  // namespace Runtime
+}  // namespace Halide
+
+using namespace Halide::Runtime::Internal;
+
+extern "C" {
+
 WEAK_INLINE int halide_profiler_set_current_func(halide_profiler_state *state, int pipeline, int func, int *sampling_token) {
     if (sampling_token == nullptr || *sampling_token == 0) {
 
@@ -15,6 +60,9 @@ WEAK_INLINE int halide_profiler_set_current_func(halide_profiler_state *state, i
         asm volatile ("":::);
         // clang-format on
     }
+    // Every thread tracks its own Func for the counters, whether or
+    // not it holds the sampling token.
+    halide_profiler_perf_counters_set_thread_func(pipeline + func);
     return 0;
 }
 
@@ -45,12 +93,99 @@ WEAK_INLINE int halide_profiler_init_sampling_token(int32_t *sampling_token, int
 WEAK_INLINE int halide_profiler_incr_active_threads(halide_profiler_state *state) {
     using namespace Halide::Runtime::Internal::Synchronization;
 
+    // A thread's own increments and decrements alternate, even across
+    // nested parallel loops, so it is either working or it isn't.
+    halide_profiler_perf_counters_set_thread_active(1);
     return atomic_fetch_add_sequentially_consistent(&(state->active_threads), 1);
 }
 
 WEAK_INLINE int halide_profiler_decr_active_threads(halide_profiler_state *state) {
     using namespace Halide::Runtime::Internal::Synchronization;
 
+    halide_profiler_perf_counters_set_thread_active(0);
     return atomic_fetch_sub_sequentially_consistent(&(state->active_threads), 1);
 }
+
+WEAK_INLINE uint64_t halide_profiler_instrumented_ticks() {
+    return halide_profiler_read_cycle_counter();
+}
+
+WEAK_INLINE int halide_profiler_instrumented_calibrate(void *user_context) {
+    if (instrumented_ns_per_tick != 0.0) {
+        return 0;
+    }
+    // Watch the counter for a millisecond. This only happens on the
+    // first run.
+    const uint64_t t0 = halide_current_time_ns(user_context);
+    const uint64_t c0 = halide_profiler_read_cycle_counter();
+    uint64_t t1, c1;
+    do {
+        t1 = halide_current_time_ns(user_context);
+        c1 = halide_profiler_read_cycle_counter();
+    } while (t1 - t0 < 1000000);
+    instrumented_ns_per_tick = (c1 > c0) ? (double)(t1 - t0) / (double)(c1 - c0) : 1.0;
+    return 0;
+}
+
+WEAK_INLINE int halide_profiler_instrumented_task_begin(void *task, int num_funcs, int func) {
+    InstrumentedTask *t = (InstrumentedTask *)task;
+    t->current = func;
+    t->num_funcs = num_funcs;
+    uint64_t *counts = instrumented_exclusive(t);
+    for (int i = 0; i < 2 * num_funcs; i++) {
+        counts[i] = 0;
+    }
+    t->last = halide_profiler_instrumented_ticks();
+    return 0;
+}
+
+// Bill the time since the last switch to the current Func, and start
+// billing func. A negative func bills nothing, for when this task is
+// blocked waiting on others.
+WEAK_INLINE int halide_profiler_instrumented_set_current_func(void *task, int func) {
+    InstrumentedTask *t = (InstrumentedTask *)task;
+    const uint64_t now = halide_profiler_instrumented_ticks();
+    if (t->current >= 0) {
+        instrumented_exclusive(t)[t->current] += now - t->last;
+    }
+    t->last = now;
+    t->current = func;
+    return 0;
+}
+
+WEAK_INLINE int halide_profiler_instrumented_add_inclusive(void *task, int func, uint64_t start) {
+    InstrumentedTask *t = (InstrumentedTask *)task;
+    instrumented_inclusive(t)[func] += halide_profiler_instrumented_ticks() - start;
+    return 0;
+}
+
+// Add everything this task measured to the pipeline's stats.
+WEAK_INLINE int halide_profiler_instrumented_task_end(void *pipeline_state, void *task) {
+    using namespace Halide::Runtime::Internal::Synchronization;
+
+    halide_profiler_instrumented_set_current_func(task, -1);
+    InstrumentedTask *t = (InstrumentedTask *)task;
+    halide_profiler_pipeline_stats *p = (halide_profiler_pipeline_stats *)pipeline_state;
+    const double ns_per_tick = instrumented_ns_per_tick;
+    for (int i = 0; i < t->num_funcs; i++) {
+        const uint64_t exclusive = instrumented_exclusive(t)[i];
+        const uint64_t inclusive = instrumented_inclusive(t)[i];
+        if (exclusive) {
+            atomic_fetch_add_sequentially_consistent(&p->funcs[i].time, (uint64_t)(exclusive * ns_per_tick));
+        }
+        if (inclusive) {
+            atomic_fetch_add_sequentially_consistent(&p->funcs[i].inclusive_time, (uint64_t)(inclusive * ns_per_tick));
+        }
+    }
+    return 0;
+}
+
+WEAK_INLINE int halide_profiler_instrumented_pipeline_end(void *pipeline_state, uint64_t start) {
+    using namespace Halide::Runtime::Internal::Synchronization;
+
+    halide_profiler_pipeline_stats *p = (halide_profiler_pipeline_stats *)pipeline_state;
+    const uint64_t elapsed = halide_profiler_instrumented_ticks() - start;
+    atomic_fetch_add_sequentially_consistent(&p->time, (uint64_t)(elapsed * instrumented_ns_per_tick));
+    return 0;
+}
 }
@@ -1,6 +1,9 @@
 #include "HalideRuntime.h"
 #include "mini_qurt.h"
 
+// There is no clock module on QuRT.
+#define THREAD_POOL_HAS_CLOCK 0
+
 constexpr int MAX_THREADS = 256;
 
 using namespace Halide::Runtime::Internal::Qurt;
@@ -72,6 +75,14 @@ WEAK void halide_join_thread(struct halide_thread *thread_arg) {
     free(t);
 }
 
+WEAK uintptr_t halide_current_thread_id() {
+    return qurt_thread_get_id();
+}
+
+WEAK bool halide_can_spawn_threads() {
+    return true;
+}
+
 }  // extern "C"
 
 namespace Halide {
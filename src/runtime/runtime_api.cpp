@@ -94,7 +94,9 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_get_cpu_features,
     (void *)&halide_get_gpu_device,
     (void *)&halide_get_library_symbol,
+    (void *)&halide_get_numa_node_count,
     (void *)&halide_get_symbol,
+    (void *)&halide_get_thread_pool,
     (void *)&halide_get_trace_file,
     (void *)&halide_hexagon_detach_device_handle,
     (void *)&halide_hexagon_device_interface,
@@ -112,16 +114,23 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_hexagon_set_performance_mode,
     (void *)&halide_hexagon_set_thread_priority,
     (void *)&halide_hexagon_wrap_device_handle,
+    (void *)&halide_huge_page_free,
+    (void *)&halide_huge_page_malloc,
     (void *)&halide_int64_to_string,
     (void *)&halide_join_thread,
     (void *)&halide_load_library,
     (void *)&halide_malloc,
     (void *)&halide_memoization_cache_cleanup,
     (void *)&halide_memoization_cache_evict,
+    (void *)&halide_memoization_cache_get_stats,
     (void *)&halide_memoization_cache_lookup,
     (void *)&halide_memoization_cache_release,
+    (void *)&halide_memoization_cache_set_file,
+    (void *)&halide_memoization_cache_set_pipeline_quota,
+    (void *)&halide_memoization_cache_set_policy,
     (void *)&halide_memoization_cache_set_size,
     (void *)&halide_memoization_cache_store,
+    (void *)&halide_memoization_cache_store_with_cost,
     (void *)&halide_metal_acquire_context,
     (void *)&halide_metal_detach_buffer,
     (void *)&halide_metal_device_interface,
@@ -166,19 +175,29 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_openglcompute_finalize_kernels,
     (void *)&halide_openglcompute_run,
     (void *)&halide_pointer_to_string,
+    (void *)&halide_pooled_free,
+    (void *)&halide_pooled_malloc,
+    (void *)&halide_pooled_malloc_release_unused,
+    (void *)&halide_pooled_malloc_set_cache_limit,
     (void *)&halide_print,
     (void *)&halide_profiler_get_pipeline_state,
     (void *)&halide_profiler_get_state,
+    (void *)&halide_profiler_instrumented_pipeline_start,
     (void *)&halide_profiler_memory_allocate,
     (void *)&halide_profiler_memory_free,
     (void *)&halide_profiler_pipeline_start,
+    (void *)&halide_profiler_record_timeline,
     (void *)&halide_profiler_report,
     (void *)&halide_profiler_reset,
     (void *)&halide_profiler_stack_peak_update,
+    (void *)&halide_profiler_write_chrome_trace,
+    (void *)&halide_profiler_write_pprof,
     (void *)&halide_qurt_hvx_lock,
     (void *)&halide_qurt_hvx_unlock,
     (void *)&halide_qurt_hvx_unlock_as_destructor,
     (void *)&halide_release_jit_module,
+    (void *)&halide_scratch_arena_acquire,
+    (void *)&halide_scratch_arena_release,
     (void *)&halide_semaphore_init,
     (void *)&halide_semaphore_release,
     (void *)&halide_semaphore_try_acquire,
@@ -189,14 +208,22 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_set_custom_free,
     (void *)&halide_set_custom_get_library_symbol,
     (void *)&halide_set_custom_get_symbol,
+    (void *)&halide_set_custom_get_thread_pool,
     (void *)&halide_set_custom_load_library,
     (void *)&halide_set_custom_malloc,
     (void *)&halide_set_custom_print,
+    (void *)&halide_set_custom_scratch_arena_acquire,
+    (void *)&halide_set_custom_scratch_arena_release,
     (void *)&halide_set_custom_trace,
     (void *)&halide_set_error_handler,
     (void *)&halide_set_gpu_device,
+    (void *)&halide_set_huge_page_prefault,
     (void *)&halide_set_num_threads,
+    (void *)&halide_set_numa_affinity,
     (void *)&halide_set_trace_file,
+    (void *)&halide_set_trace_flight_recorder,
+    (void *)&halide_set_trace_filter,
+    (void *)&halide_set_work_stealing,
     (void *)&halide_shutdown_thread_pool,
     (void *)&halide_shutdown_trace,
     (void *)&halide_sleep_ms,
@@ -204,7 +231,12 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_start_clock,
     (void *)&halide_start_timer_chain,
     (void *)&halide_string_to_string,
+    (void *)&halide_thread_pool_create,
+    (void *)&halide_thread_pool_destroy,
+    (void *)&halide_thread_pool_get_stats,
+    (void *)&halide_thread_pool_reset_stats,
     (void *)&halide_trace,
+    (void *)&halide_trace_flight_recorder_dump,
     (void *)&halide_trace_helper,
     (void *)&halide_uint64_to_string,
     (void *)&halide_use_jit_module,
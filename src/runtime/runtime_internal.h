@@ -149,6 +149,12 @@ WEAK void *halide_load_library(const char *name);
 // If lib is nullptr, this call should be equivalent to halide_get_symbol(name).
 WEAK void *halide_get_library_symbol(void *lib, const char *name);
 
+// An identifier for the calling thread, distinct from those of all
+// other running threads, and whether halide_spawn_thread can start
+// threads at all. Provided by the thread pool modules.
+WEAK uintptr_t halide_current_thread_id();
+WEAK bool halide_can_spawn_threads();
+
 WEAK int halide_start_clock(void *user_context);
 WEAK int64_t halide_current_time_ns(void *user_context);
 WEAK void halide_sleep_ms(void *user_context, int ms);
@@ -174,6 +180,21 @@ WEAK int halide_profiler_pipeline_start(void *user_context,
                                         int num_funcs,
                                         const uint64_t *func_names);
 WEAK int halide_host_cpu_count();
+// Set cpu_nodes[i] to the NUMA node of host cpu i (or -1 if it belongs
+// to none) for the first max_cpus cpus, and return the number of
+// nodes. Nodes are numbered densely from zero. Returns zero if the
+// topology can't be determined.
+WEAK int halide_host_numa_topology(int *cpu_nodes, int max_cpus);
+// The cpu the calling thread is running on, or -1 if unknown.
+WEAK int halide_host_current_cpu();
+// Restrict the calling thread to the given cpus. Returns zero on success.
+WEAK int halide_pin_current_thread(const int *cpus, int num_cpus);
+// Map the named file into memory, shared with any other process that
+// maps it, creating it or growing it to at least min_size bytes
+// first. On success sets *size to the size of the mapping. Returns
+// nullptr if the platform can't map files.
+WEAK void *halide_map_shared_file(void *user_context, const char *filename, size_t min_size, size_t *size);
+WEAK void halide_unmap_shared_file(void *user_context, void *addr, size_t size);
 
 WEAK int halide_device_and_host_malloc(void *user_context, struct halide_buffer_t *buf,
                                        const struct halide_device_interface_t *device_interface);
@@ -0,0 +1,47 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+namespace Halide {
+namespace Runtime {
+namespace Internal {
+
+WEAK void *default_scratch_arena_acquire(void *user_context, uint64_t size) {
+    if (size > (uint64_t)(size_t)-1) {
+        return nullptr;
+    }
+    return halide_malloc(user_context, (size_t)size);
+}
+
+WEAK void default_scratch_arena_release(void *user_context, void *ptr) {
+    halide_free(user_context, ptr);
+}
+
+WEAK halide_scratch_arena_acquire_t custom_scratch_arena_acquire = default_scratch_arena_acquire;
+WEAK halide_scratch_arena_release_t custom_scratch_arena_release = default_scratch_arena_release;
+
+}  // namespace Internal
+}  // namespace Runtime
+}  // namespace Halide
+
+extern "C" {
+
+WEAK halide_scratch_arena_acquire_t halide_set_custom_scratch_arena_acquire(halide_scratch_arena_acquire_t acquire) {
+    halide_scratch_arena_acquire_t result = custom_scratch_arena_acquire;
+    custom_scratch_arena_acquire = acquire;
+    return result;
+}
+
+WEAK halide_scratch_arena_release_t halide_set_custom_scratch_arena_release(halide_scratch_arena_release_t release) {
+    halide_scratch_arena_release_t result = custom_scratch_arena_release;
+    custom_scratch_arena_release = release;
+    return result;
+}
+
+WEAK void *halide_scratch_arena_acquire(void *user_context, uint64_t size) {
+    return custom_scratch_arena_acquire(user_context, size);
+}
+
+WEAK void halide_scratch_arena_release(void *user_context, void *ptr) {
+    custom_scratch_arena_release(user_context, ptr);
+}
+}
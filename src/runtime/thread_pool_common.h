@@ -1,5 +1,11 @@
 #define EXTENDED_DEBUG 0
 
+// Platforms without a clock module (e.g. QuRT) still count thread pool
+// events, but don't time them.
+#ifndef THREAD_POOL_HAS_CLOCK
+#define THREAD_POOL_HAS_CLOCK 1
+#endif
+
 #if EXTENDED_DEBUG
 // This code is currently setup for Linux debugging. Switch to using pthread_self on e.g. Mac OS X.
 extern "C" int syscall(int);
@@ -30,6 +36,29 @@ namespace Halide {
 namespace Runtime {
 namespace Internal {
 
+// When work stealing is enabled, the iterations of a parallel loop
+// are split into one contiguous range per thread. A range is packed
+// into a single word as a pair of offsets from the loop min, so that
+// the owning thread and thieves can both update it with a single
+// compare-and-swap. Loops too large to pack use the job queue.
+constexpr int range_bits = sizeof(uintptr_t) * 4;
+constexpr uintptr_t range_mask = ((uintptr_t)1 << range_bits) - 1;
+
+struct steal_range {
+    uintptr_t bounds;
+    // Whether a thread has taken this range as its own. Only accessed
+    // with the work queue lock held.
+    bool claimed;
+    // Keep ranges owned by different threads on different cache lines.
+    char padding[64 - sizeof(uintptr_t) - sizeof(bool)];
+};
+
+ALWAYS_INLINE uintptr_t pack_range(uintptr_t begin, uintptr_t end) {
+    return begin | (end << range_bits);
+}
+
+struct work_queue_t;
+
 struct work {
     halide_parallel_task_t task;
 
@@ -44,12 +73,24 @@ struct work {
     int threads_reserved;
 
     void *user_context;
+    // The thread pool this job was enqueued on.
+    work_queue_t *queue;
     int active_workers;
     int exit_status;
     int next_semaphore;
     // which condition variable is the owner sleeping on. nullptr if it isn't sleeping.
     bool owner_is_sleeping;
 
+    // If non-null, the iterations of this job are handed out via
+    // per-thread ranges instead of one at a time under the work queue
+    // lock. Each thread that joins the job claims one of the ranges.
+    steal_range *ranges;
+    int num_ranges;
+    int ranges_claimed;
+    // The ranges are divided into this many contiguous blocks, one per
+    // NUMA node. One if NUMA-aware scheduling is off.
+    int num_range_nodes;
+
     ALWAYS_INLINE bool make_runnable() {
         for (; next_semaphore < task.num_semaphores; next_semaphore++) {
             if (!halide_default_semaphore_try_acquire(task.semaphores[next_semaphore].semaphore,
@@ -92,7 +133,52 @@ WEAK int default_desired_num_threads() {
                halide_host_cpu_count();
 }
 
-// The work queue and thread pool is weak, so one big work queue is shared by all halide functions
+WEAK bool default_work_stealing() {
+    char *work_stealing_str = getenv("HL_WORK_STEALING");
+    return work_stealing_str && atoi(work_stealing_str) != 0;
+}
+
+WEAK bool default_numa_affinity() {
+    char *numa_affinity_str = getenv("HL_NUMA_AFFINITY");
+    return numa_affinity_str && atoi(numa_affinity_str) != 0;
+}
+
+constexpr int max_numa_cpus = 1024;
+
+// The NUMA topology of the host. Probed at most once, with the work
+// queue lock held, and never modified afterwards.
+struct numa_topology_t {
+    bool probed;
+    int num_nodes;
+    // The node of each cpu, or -1.
+    int cpu_nodes[max_numa_cpus];
+};
+
+WEAK numa_topology_t numa_topology = {};
+
+ALWAYS_INLINE uint64_t thread_pool_time_ns() {
+#if THREAD_POOL_HAS_CLOCK
+    return (uint64_t)halide_current_time_ns(nullptr);
+#else
+    return 0;
+#endif
+}
+
+WEAK void probe_numa_topology_already_locked() {
+    if (!numa_topology.probed) {
+        numa_topology.num_nodes = halide_host_numa_topology(numa_topology.cpu_nodes, max_numa_cpus);
+        numa_topology.probed = true;
+    }
+}
+
+ALWAYS_INLINE int current_numa_node() {
+    int cpu = halide_host_current_cpu();
+    return (cpu >= 0 && cpu < max_numa_cpus) ? numa_topology.cpu_nodes[cpu] : -1;
+}
+
+// The default work queue and thread pool is weak, so one big work
+// queue is shared by all halide functions that aren't given a thread
+// pool of their own via halide_get_thread_pool.
 struct work_queue_t {
     // all fields are protected by this mutex.
     halide_mutex mutex;
@@ -100,16 +186,39 @@ struct work_queue_t {
     // The desired number threads doing work (HL_NUM_THREADS).
     int desired_threads_working;
 
+    // Whether parallel loops are distributed by work stealing
+    // (HL_WORK_STEALING). Only meaningful once work_stealing_set is true.
+    bool work_stealing, work_stealing_set;
+
+    // Whether workers are pinned to NUMA nodes and parallel loops are
+    // distributed node-locally (HL_NUMA_AFFINITY). Only meaningful once
+    // numa_affinity_set is true.
+    bool numa_affinity, numa_affinity_set;
+
+    // Singly linked list of the pools made by halide_thread_pool_create,
+    // protected by thread_pools_mutex instead.
+    work_queue_t *next_pool;
+
+    // Counters for halide_thread_pool_get_stats. Slot 0 is shared by
+    // all threads waiting on jobs they enqueued, and slot i + 1 belongs
+    // to worker i. Kept across shutdowns.
+    halide_thread_pool_stats_t stats[MAX_THREADS + 1];
+
     // All fields after this must be zero in the initial state. See assert_zeroed
     // Field serves both to mark the offset in struct and as layout padding.
     int zero_marker;
 
-    // Singly linked list for job stack
+    // Singly linked list for job stack, and its length.
     work *jobs;
+    int jobs_queued;
 
     // The number threads created
     int threads_created;
 
+    // The number of workers that have started so far. Used to number
+    // them.
+    int workers_started;
+
     // Workers sleep on one of two condition variables, to make it
     // easier to wake up the right number if a small number of tasks
     // are enqueued. There are A-team workers and B-team workers. The
@@ -165,7 +274,239 @@ struct work_queue_t {
     }
 };
 
-WEAK work_queue_t work_queue = {};
+WEAK work_queue_t default_work_queue = {};
+
+WEAK halide_mutex thread_pools_mutex = {{0}};
+WEAK work_queue_t *thread_pools = nullptr;
+
+WEAK void initialize_work_queue_already_locked(work_queue_t *queue) {
+    if (!queue->initialized) {
+        queue->assert_zeroed();
+
+        // Compute the desired number of threads to use. Other code
+        // can also mess with this value, but only when the work queue
+        // is locked.
+        if (!queue->desired_threads_working) {
+            queue->desired_threads_working = default_desired_num_threads();
+        }
+        queue->desired_threads_working = clamp_num_threads(queue->desired_threads_working);
+        if (!queue->work_stealing_set) {
+            queue->work_stealing = default_work_stealing();
+            queue->work_stealing_set = true;
+        }
+        if (!queue->numa_affinity_set) {
+            queue->numa_affinity = default_numa_affinity();
+            queue->numa_affinity_set = true;
+        }
+        if (queue->numa_affinity) {
+            probe_numa_topology_already_locked();
+        }
+#if THREAD_POOL_HAS_CLOCK
+        halide_start_clock(nullptr);
+#endif
+        queue->initialized = true;
+    }
+}
+
+// The number of NUMA nodes the thread pool is spreading work
+// across. Must be called with the work queue lock held.
+ALWAYS_INLINE int numa_nodes_in_use(const work_queue_t *queue) {
+    return (queue->numa_affinity && numa_topology.num_nodes > 1) ? numa_topology.num_nodes : 1;
+}
+
+// Must be called with the work queue locked and initialized.
+ALWAYS_INLINE bool can_steal_work(const work &job) {
+    return (job.queue->work_stealing || numa_nodes_in_use(job.queue) > 1) &&
+           job.queue->desired_threads_working > 1 &&
+           !job.task.serial &&
+           !job.task.guided &&
+           job.task.num_semaphores == 0 &&
+           job.task.extent > 1 &&
+           (uintptr_t)job.task.extent <= range_mask;
+}
+
+ALWAYS_INLINE int num_steal_ranges(const work &job) {
+    return job.task.extent < job.queue->desired_threads_working ?
+               job.task.extent :
+               job.queue->desired_threads_working;
+}
+
+// The number of iterations a thread takes from a guided job at once:
+// an even share of what's left, so chunks shrink as the job drains.
+// The first iteration has already been made runnable. Jobs that
+// acquire semaphores need them once per iteration, so the chunk stops
+// growing if they run dry. Must be called with the work queue lock
+// held.
+WEAK int guided_chunk_size(const work_queue_t *queue, work *job) {
+    int target = job->task.extent / queue->desired_threads_working;
+    int iters = 1;
+    while (iters < target && job->make_runnable()) {
+        iters++;
+    }
+    return iters;
+}
+
+// Split the iterations of a job evenly across the given ranges. Must
+// be called with the work queue lock held.
+WEAK void init_steal_ranges(work *job, steal_range *ranges, int num_ranges) {
+    uintptr_t extent = job->task.extent;
+    for (int i = 0; i < num_ranges; i++) {
+        ranges[i].bounds = pack_range((extent * i) / num_ranges,
+                                      (extent * (i + 1)) / num_ranges);
+        ranges[i].claimed = false;
+    }
+    job->ranges = ranges;
+    job->num_ranges = num_ranges;
+    job->ranges_claimed = 0;
+    job->num_range_nodes = numa_nodes_in_use(job->queue);
+}
+
+// With NUMA-aware scheduling, node n owns the block of ranges
+// [first_range_on_node(n), first_range_on_node(n + 1)). The same
+// iterations go to the same node on every run of a loop, so pages
+// first touched by one run of a parallel loop are local to the
+// threads that touch them in later runs.
+ALWAYS_INLINE int first_range_on_node(const work *job, int node) {
+    return (node * job->num_ranges + job->num_range_nodes - 1) / job->num_range_nodes;
+}
+
+ALWAYS_INLINE int node_of_range(const work *job, int range) {
+    return (range * job->num_range_nodes) / job->num_ranges;
+}
+
+// Pick an unclaimed range for the calling thread, preferring one on
+// the thread's own NUMA node. There must be at least one unclaimed
+// range.
+WEAK int claim_range_already_locked(work *job) {
+    int range = -1;
+    if (job->num_range_nodes > 1) {
+        int node = current_numa_node();
+        if (node >= 0 && node < job->num_range_nodes) {
+            int end = first_range_on_node(job, node + 1);
+            for (int i = first_range_on_node(job, node); i < end && range < 0; i++) {
+                if (!job->ranges[i].claimed) {
+                    range = i;
+                }
+            }
+        }
+    }
+    for (int i = 0; i < job->num_ranges && range < 0; i++) {
+        if (!job->ranges[i].claimed) {
+            range = i;
+        }
+    }
+    job->ranges[range].claimed = true;
+    job->ranges_claimed++;
+    return range;
+}
+
+// Claim the first remaining iteration of a range. Ranges only ever
+// shrink, except when an empty range is refilled by its owning
+// thread, so this is safe to race with thieves.
+ALWAYS_INLINE bool pop_iteration(steal_range *range, int *idx) {
+    uintptr_t expected;
+    Synchronization::atomic_load_acquire(&range->bounds, &expected);
+    while (true) {
+        uintptr_t begin = expected & range_mask;
+        uintptr_t end = expected >> range_bits;
+        if (begin >= end) {
+            return false;
+        }
+        uintptr_t desired = pack_range(begin + 1, end);
+        if (Synchronization::atomic_cas_weak_relacq_relaxed(&range->bounds, &expected, &desired)) {
+            *idx = (int)begin;
+            return true;
+        }
+    }
+}
+
+// Move the back half of some other thread's range within [begin, end)
+// into the thief's (empty) range. Victims are visited starting from a
+// random one so that thieves don't all pile onto the same range.
+// Returns false if there was nothing left to steal.
+WEAK bool steal_iterations_from(work *job, int thief, int begin, int end, uint32_t seed) {
+    int start = (int)((seed >> 8) % (uint32_t)(end - begin));
+    for (int i = 0; i < end - begin; i++) {
+        int victim = begin + (start + i) % (end - begin);
+        if (victim == thief) {
+            continue;
+        }
+        steal_range *range = &job->ranges[victim];
+        uintptr_t expected;
+        Synchronization::atomic_load_acquire(&range->bounds, &expected);
+        while (true) {
+            uintptr_t begin = expected & range_mask;
+            uintptr_t end = expected >> range_bits;
+            if (begin >= end) {
+                break;
+            }
+            uintptr_t mid = begin + (end - begin) / 2;
+            uintptr_t desired = pack_range(begin, mid);
+            if (Synchronization::atomic_cas_weak_relacq_relaxed(&range->bounds, &expected, &desired)) {
+                uintptr_t stolen = pack_range(mid, end);
+                Synchronization::atomic_store_release(&job->ranges[thief].bounds, &stolen);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Steal iterations for the thief, preferring victims on its own NUMA
+// node so that the iterations stay near the memory they touch.
+WEAK bool steal_iterations(work *job, int thief, uint32_t *seed) {
+    *seed = *seed * 1664525 + 1013904223;
+    if (job->num_range_nodes > 1) {
+        int node = node_of_range(job, thief);
+        if (steal_iterations_from(job, thief, first_range_on_node(job, node),
+                                  first_range_on_node(job, node + 1), *seed)) {
+            return true;
+        }
+    }
+    return steal_iterations_from(job, thief, 0, job->num_ranges, *seed);
+}
+
+// Run iterations from the given range of a job, and then from other
+// threads' ranges, until none remain or one fails, on this thread or
+// any other. Called without the work queue lock held, so the calls
+// and steals made are counted in the caller's stats, to be added to
+// the pool's stats under the lock.
+WEAK int run_steal_ranges(work *job, int range, halide_thread_pool_stats_t *counts) {
+    uint32_t seed = (uint32_t)range * 2654435761U + 1;
+    int result = halide_error_code_success;
+    while (result == halide_error_code_success) {
+        // Once an iteration has failed, the job as a whole has, so
+        // don't start any more of it.
+        int exit_status;
+        Synchronization::atomic_load_acquire(&job->exit_status, &exit_status);
+        if (exit_status != halide_error_code_success) {
+            break;
+        }
+        int idx;
+        if (!pop_iteration(&job->ranges[range], &idx)) {
+            if (steal_iterations(job, range, &seed)) {
+                counts->steals++;
+                continue;
+            }
+            break;
+        }
+        counts->tasks_run++;
+        if (job->task_fn) {
+            result = halide_do_task(job->user_context, job->task_fn,
+                                    job->task.min + idx, job->task.closure);
+        } else {
+            result = halide_do_loop_task(job->user_context, job->task.fn,
+                                         job->task.min + idx, 1,
+                                         job->task.closure, job);
+        }
+    }
+    if (result != halide_error_code_success) {
+        // Tell the threads still working on the job to stop now,
+        // rather than once this thread has retaken the lock.
+        Synchronization::atomic_store_release(&job->exit_status, &result);
+    }
+    return result;
+}
 
 #if EXTENDED_DEBUG
 
@@ -181,9 +522,9 @@ WEAK void print_job(work *job, const char *indent, const char *prefix = nullptr)
     }
 }
 
-WEAK void dump_job_state() {
+WEAK void dump_job_state(work_queue_t *queue) {
     log_message("Dumping job state, jobs in queue:");
-    work *job = work_queue.jobs;
+    work *job = queue->jobs;
     while (job != nullptr) {
         print_job(job, "    ");
         job = job->next_job;
@@ -195,20 +536,89 @@ WEAK void dump_job_state() {
 
 // clang-format off
 #define print_job(job, indent, prefix)  do { /*nothing*/ } while (0)
-#define dump_job_state()                do { /*nothing*/ } while (0)
+#define dump_job_state(queue)           do { /*nothing*/ } while (0)
 // clang-format on
 
 #endif
 
+// The time between two readings of the clock, which may not be
+// monotonic on some platforms.
+ALWAYS_INLINE uint64_t elapsed_ns(uint64_t start, uint64_t end) {
+    return end > start ? end - start : 0;
+}
+
+// Times the idle stretches of a thread in worker_thread_already_locked
+// without reading the clock while it holds the queue lock, as reading
+// the clock may be a system call. Spins are timed directly. Sleeps
+// aren't; a thread that slept is credited with the time from its last
+// reading of the clock to its next one, which is taken when it next
+// spins or releases the lock to run a task. Sleeps that start a
+// stretch, before any spin, are not timed.
+struct idle_timer_t {
+    // The last reading of the clock in this stretch, or zero.
+    uint64_t last_ns = 0;
+    // Whether the thread has slept since then, and whether any of those
+    // sleeps was only waiting on semaphores.
+    bool slept = false, slept_blocked = false;
+    // Time to add to the thread's stats once it holds the lock.
+    uint64_t spin_ns = 0, sleep_ns = 0, semaphore_wait_ns = 0;
+
+    // Must be called without the lock held, except on exit.
+    ALWAYS_INLINE void read_clock() {
+        uint64_t now = thread_pool_time_ns();
+        if (slept && last_ns != 0) {
+            uint64_t t = elapsed_ns(last_ns, now);
+            sleep_ns += t;
+            semaphore_wait_ns += slept_blocked ? t : 0;
+        }
+        slept = slept_blocked = false;
+        last_ns = now;
+    }
+
+    ALWAYS_INLINE void sleep(bool blocked_on_semaphores) {
+        slept = true;
+        slept_blocked |= blocked_on_semaphores;
+    }
+
+    // Must be called with the lock released.
+    ALWAYS_INLINE void spin(bool blocked_on_semaphores) {
+        read_clock();
+        uint64_t start = last_ns;
+        halide_thread_yield();
+        last_ns = thread_pool_time_ns();
+        uint64_t t = elapsed_ns(start, last_ns);
+        spin_ns += t;
+        semaphore_wait_ns += blocked_on_semaphores ? t : 0;
+    }
+
+    // Must be called with the lock released.
+    ALWAYS_INLINE void end_stretch() {
+        if (slept) {
+            read_clock();
+        }
+        last_ns = 0;
+    }
+
+    // Must be called with the lock held.
+    ALWAYS_INLINE void flush(halide_thread_pool_stats_t *stats) {
+        stats->spin_ns += spin_ns;
+        stats->sleep_ns += sleep_ns;
+        stats->semaphore_wait_ns += semaphore_wait_ns;
+        spin_ns = sleep_ns = semaphore_wait_ns = 0;
+    }
+};
+
 WEAK void worker_thread(void *);
 
-WEAK void worker_thread_already_locked(work *owned_job) {
+WEAK void worker_thread_already_locked(work_queue_t *queue, halide_thread_pool_stats_t *stats, work *owned_job) {
     int spin_count = 0;
     const int max_spin_count = 40;
+    idle_timer_t idle_timer;
 
-    while (owned_job ? owned_job->running() : !work_queue.shutdown) {
-        work *job = work_queue.jobs;
-        work **prev_ptr = &work_queue.jobs;
+    while (owned_job ? owned_job->running() : !queue->shutdown) {
+        idle_timer.flush(stats);
+        work *job = queue->jobs;
+        work **prev_ptr = &queue->jobs;
 
         if (owned_job) {
             if (owned_job->exit_status != halide_error_code_success) {
@@ -218,6 +628,7 @@ WEAK void worker_thread_already_locked(work *owned_job) {
                         job = job->next_job;
                     }
                     *prev_ptr = job->next_job;
+                    queue->jobs_queued--;
                     job->task.extent = 0;
                     continue;  // So loop exit is always in the same place.
                 }
@@ -226,14 +637,15 @@ WEAK void worker_thread_already_locked(work *owned_job) {
                 // The wakeup can likely be only done under certain conditions, but it is only happening
                 // in when an error has already occured and it seems more important to ensure reliable
                 // termination than to optimize this path.
-                halide_cond_broadcast(&work_queue.wake_owners);
+                halide_cond_broadcast(&queue->wake_owners);
                 continue;
             }
         }
 
-        dump_job_state();
+        dump_job_state(queue);
 
         // Find a job to run, prefering things near the top of the stack.
+        bool blocked_on_semaphores = false;
         while (job) {
             print_job(job, "", "Considering job ");
             // Only schedule tasks with enough free worker threads
@@ -246,8 +658,8 @@ WEAK void worker_thread_already_locked(work *owned_job) {
 
             int threads_available;
             if (parent_job == nullptr) {
-                // The + 1 is because work_queue.threads_created does not include the main thread.
-                threads_available = (work_queue.threads_created + 1) - work_queue.threads_reserved;
+                // The + 1 is because queue->threads_created does not include the main thread.
+                threads_available = (queue->threads_created + 1) - queue->threads_reserved;
             } else {
                 if (parent_job->active_workers == 0) {
                     threads_available = parent_job->task.min_threads - parent_job->threads_reserved;
@@ -264,7 +676,8 @@ WEAK void worker_thread_already_locked(work *owned_job) {
             if (!can_use_this_thread_stack) {
                 log_message("Cannot run job " << job->task.name << " on this thread.");
             }
-            bool can_add_worker = (!job->task.serial || (job->active_workers == 0));
+            bool can_add_worker = (!job->task.serial || (job->active_workers == 0)) &&
+                                  (!job->ranges || (job->ranges_claimed < job->num_ranges));
             if (!can_add_worker) {
                 log_message("Cannot add worker to job " << job->task.name);
             }
@@ -274,6 +687,7 @@ WEAK void worker_thread_already_locked(work *owned_job) {
                     break;
                 } else {
                     log_message("Cannot acquire semaphores for " << job->task.name);
+                    blocked_on_semaphores = true;
                 }
             }
             prev_ptr = &(job->next_job);
@@ -285,32 +699,35 @@ WEAK void worker_thread_already_locked(work *owned_job) {
             if (owned_job) {
                 if (spin_count++ < max_spin_count) {
                     // Give the workers a chance to finish up before sleeping
-                    halide_mutex_unlock(&work_queue.mutex);
-                    halide_thread_yield();
-                    halide_mutex_lock(&work_queue.mutex);
+                    halide_mutex_unlock(&queue->mutex);
+                    idle_timer.spin(blocked_on_semaphores);
+                    halide_mutex_lock(&queue->mutex);
                 } else {
-                    work_queue.owners_sleeping++;
+                    queue->owners_sleeping++;
                     owned_job->owner_is_sleeping = true;
-                    halide_cond_wait(&work_queue.wake_owners, &work_queue.mutex);
+                    idle_timer.sleep(blocked_on_semaphores);
+                    halide_cond_wait(&queue->wake_owners, &queue->mutex);
                     owned_job->owner_is_sleeping = false;
-                    work_queue.owners_sleeping--;
+                    queue->owners_sleeping--;
                 }
             } else {
-                work_queue.workers_sleeping++;
-                if (work_queue.a_team_size > work_queue.target_a_team_size) {
+                queue->workers_sleeping++;
+                if (queue->a_team_size > queue->target_a_team_size) {
                     // Transition to B team
-                    work_queue.a_team_size--;
-                    halide_cond_wait(&work_queue.wake_b_team, &work_queue.mutex);
-                    work_queue.a_team_size++;
+                    queue->a_team_size--;
+                    idle_timer.sleep(blocked_on_semaphores);
+                    halide_cond_wait(&queue->wake_b_team, &queue->mutex);
+                    queue->a_team_size++;
                 } else if (spin_count++ < max_spin_count) {
                     // Spin waiting for new work
-                    halide_mutex_unlock(&work_queue.mutex);
-                    halide_thread_yield();
-                    halide_mutex_lock(&work_queue.mutex);
+                    halide_mutex_unlock(&queue->mutex);
+                    idle_timer.spin(blocked_on_semaphores);
+                    halide_mutex_lock(&queue->mutex);
                 } else {
-                    halide_cond_wait(&work_queue.wake_a_team, &work_queue.mutex);
+                    idle_timer.sleep(blocked_on_semaphores);
+                    halide_cond_wait(&queue->wake_a_team, &queue->mutex);
                 }
-                work_queue.workers_sleeping--;
+                queue->workers_sleeping--;
             }
             continue;
         } else {
@@ -325,8 +742,8 @@ WEAK void worker_thread_already_locked(work *owned_job) {
         job->active_workers++;
 
         if (job->parent_job == nullptr) {
-            work_queue.threads_reserved += job->task.min_threads;
-            log_message("Reserved " << job->task.min_threads << " on work queue for " << job->task.name << " giving " << work_queue.threads_reserved << " of " << work_queue.threads_created + 1);
+            queue->threads_reserved += job->task.min_threads;
+            log_message("Reserved " << job->task.min_threads << " on work queue for " << job->task.name << " giving " << queue->threads_reserved << " of " << queue->threads_created + 1);
         } else {
             job->parent_job->threads_reserved += job->task.min_threads;
             log_message("Reserved " << job->task.min_threads << " on " << job->parent_job->task.name << " for " << job->task.name << " giving " << job->parent_job->threads_reserved << " of " << job->parent_job->task.min_threads);
@@ -337,11 +754,14 @@ WEAK void worker_thread_already_locked(work *owned_job) {
         if (job->task.serial) {
             // Remove it from the stack while we work on it
             *prev_ptr = job->next_job;
+            queue->jobs_queued--;
 
             // Release the lock and do the task.
-            halide_mutex_unlock(&work_queue.mutex);
+            halide_mutex_unlock(&queue->mutex);
+            idle_timer.end_stretch();
             int total_iters = 0;
             int iters = 1;
+            uint64_t calls = 0;
             while (result == halide_error_code_success) {
                 // Claim as many iterations as possible
                 while ((job->task.extent - total_iters) > iters &&
@@ -358,8 +778,10 @@ WEAK void worker_thread_already_locked(work *owned_job) {
                                              job->task.closure, job);
                 total_iters += iters;
                 iters = 0;
+                calls++;
             }
-            halide_mutex_lock(&work_queue.mutex);
+            halide_mutex_lock(&queue->mutex);
+            stats->tasks_run += calls;
 
             job->task.min += total_iters;
             job->task.extent -= total_iters;
@@ -368,32 +790,61 @@ WEAK void worker_thread_already_locked(work *owned_job) {
             if (result != halide_error_code_success) {
                 job->task.extent = 0;  // Force job to be finished.
             } else if (job->task.extent > 0) {
-                job->next_job = work_queue.jobs;
-                work_queue.jobs = job;
+                job->next_job = queue->jobs;
+                queue->jobs = job;
+                queue->jobs_queued++;
+            }
+        } else if (job->ranges) {
+            // Take a range of iterations of our own, and then help
+            // with the other threads' ranges, all without the lock.
+            int range = claim_range_already_locked(job);
+            halide_thread_pool_stats_t counts = {};
+            halide_mutex_unlock(&queue->mutex);
+            idle_timer.end_stretch();
+            result = run_steal_ranges(job, range, &counts);
+            halide_mutex_lock(&queue->mutex);
+            stats->tasks_run += counts.tasks_run;
+            stats->steals += counts.steals;
+
+            // Every iteration has now been claimed by some thread, so
+            // there's no reason for anyone else to join this job.
+            if (job->task.extent != 0) {
+                work **job_ptr = &queue->jobs;
+                while (*job_ptr != job) {
+                    job_ptr = &((*job_ptr)->next_job);
+                }
+                *job_ptr = job->next_job;
+                queue->jobs_queued--;
+                job->task.extent = 0;
             }
         } else {
-            // Claim a task from it.
+            // Claim a task from it, or a chunk of them if it's guided.
+            // Jobs from do_par_for are never guided.
             work myjob = *job;
-            job->task.min++;
-            job->task.extent--;
+            int iters = job->task.guided ? guided_chunk_size(queue, job) : 1;
+            job->task.min += iters;
+            job->task.extent -= iters;
 
             // If there were no more tasks pending for this job, remove it
             // from the stack.
             if (job->task.extent == 0) {
                 *prev_ptr = job->next_job;
+                queue->jobs_queued--;
             }
+            stats->tasks_run++;
 
             // Release the lock and do the task.
-            halide_mutex_unlock(&work_queue.mutex);
+            halide_mutex_unlock(&queue->mutex);
+            idle_timer.end_stretch();
             if (myjob.task_fn) {
                 result = halide_do_task(myjob.user_context, myjob.task_fn,
                                         myjob.task.min, myjob.task.closure);
             } else {
                 result = halide_do_loop_task(myjob.user_context, myjob.task.fn,
-                                             myjob.task.min, 1,
+                                             myjob.task.min, iters,
                                              myjob.task.closure, job);
             }
-            halide_mutex_lock(&work_queue.mutex);
+            halide_mutex_lock(&queue->mutex);
         }
 
         if (result != halide_error_code_success) {
@@ -417,8 +868,8 @@ WEAK void worker_thread_already_locked(work *owned_job) {
         }
 
         if (job->parent_job == nullptr) {
-            work_queue.threads_reserved -= job->task.min_threads;
-            log_message("Returned " << job->task.min_threads << " to work queue for " << job->task.name << " giving " << work_queue.threads_reserved << " of " << work_queue.threads_created + 1);
+            queue->threads_reserved -= job->task.min_threads;
+            log_message("Returned " << job->task.min_threads << " to work queue for " << job->task.name << " giving " << queue->threads_reserved << " of " << queue->threads_created + 1);
         } else {
             job->parent_job->threads_reserved -= job->task.min_threads;
             log_message("Returned " << job->task.min_threads << " to " << job->parent_job->task.name << " for " << job->task.name << " giving " << job->parent_job->threads_reserved << " of " << job->parent_job->task.min_threads);
@@ -432,30 +883,56 @@ WEAK void worker_thread_already_locked(work *owned_job) {
         if (wake_owners ||
             (job->active_workers == 0 && (job->task.extent == 0 || job->exit_status != halide_error_code_success) && job->owner_is_sleeping)) {
             // The job is done or some owned job failed via sibling linkage. Wake up the owner.
-            halide_cond_broadcast(&work_queue.wake_owners);
+            halide_cond_broadcast(&queue->wake_owners);
         }
     }
+
+    // A thread waiting for its own job to finish usually sleeps until
+    // it does. This is the only time the clock is read with the lock
+    // held, at most once per job.
+    if (idle_timer.slept) {
+        idle_timer.read_clock();
+    }
+    idle_timer.flush(stats);
 }
 
+// Workers are numbered in the order they start, which picks their
+// slot in the pool's stats.
 WEAK void worker_thread(void *arg) {
-    halide_mutex_lock(&work_queue.mutex);
-    worker_thread_already_locked((work *)arg);
-    halide_mutex_unlock(&work_queue.mutex);
+    work_queue_t *queue = (work_queue_t *)arg;
+    halide_mutex_lock(&queue->mutex);
+    int worker = queue->workers_started++;
+    worker_thread_already_locked(queue, &queue->stats[worker + 1], nullptr);
+    halide_mutex_unlock(&queue->mutex);
 }
 
-WEAK void enqueue_work_already_locked(int num_jobs, work *jobs, work *task_parent) {
-    if (!work_queue.initialized) {
-        work_queue.assert_zeroed();
-
-        // Compute the desired number of threads to use. Other code
-        // can also mess with this value, but only when the work queue
-        // is locked.
-        if (!work_queue.desired_threads_working) {
-            work_queue.desired_threads_working = default_desired_num_threads();
+// Entry point for workers that belong to a NUMA node. The topology has
+// already been probed by the spawning thread. Workers are dealt out to
+// the nodes round-robin, so that each node gets an equal share of the
+// pool.
+WEAK void numa_worker_thread(void *arg) {
+    work_queue_t *queue = (work_queue_t *)arg;
+    halide_mutex_lock(&queue->mutex);
+    int worker = queue->workers_started++;
+    halide_mutex_unlock(&queue->mutex);
+    int node = worker % numa_topology.num_nodes;
+    int cpus[max_numa_cpus];
+    int num_cpus = 0;
+    for (int cpu = 0; cpu < max_numa_cpus; cpu++) {
+        if (numa_topology.cpu_nodes[cpu] == node) {
+            cpus[num_cpus++] = cpu;
         }
-        work_queue.desired_threads_working = clamp_num_threads(work_queue.desired_threads_working);
-        work_queue.initialized = true;
     }
+    if (halide_pin_current_thread(cpus, num_cpus) != 0) {
+        log_message("Failed to pin worker to NUMA node " << node);
+    }
+    halide_mutex_lock(&queue->mutex);
+    worker_thread_already_locked(queue, &queue->stats[worker + 1], nullptr);
+    halide_mutex_unlock(&queue->mutex);
+}
+
+WEAK void enqueue_work_already_locked(work_queue_t *queue, int num_jobs, work *jobs, work *task_parent) {
+    initialize_work_queue_already_locked(queue);
 
     // Gather some information about the work.
 
@@ -507,18 +984,19 @@ WEAK void enqueue_work_already_locked(int num_jobs, work *jobs, work *task_paren
         }
 
         // Spawn more threads if necessary.
-        while (work_queue.threads_created < MAX_THREADS &&
-               ((work_queue.threads_created < work_queue.desired_threads_working - 1) ||
-                (work_queue.threads_created + 1) - work_queue.threads_reserved < min_threads)) {
-            // We might need to make some new threads, if work_queue.desired_threads_working has
+        while (queue->threads_created < MAX_THREADS &&
+               ((queue->threads_created < queue->desired_threads_working - 1) ||
+                (queue->threads_created + 1) - queue->threads_reserved < min_threads)) {
+            // We might need to make some new threads, if queue->desired_threads_working has
             // increased, or if there aren't enough threads to complete this new task.
-            work_queue.a_team_size++;
-            work_queue.threads[work_queue.threads_created++] =
-                halide_spawn_thread(worker_thread, nullptr);
+            queue->a_team_size++;
+            queue->threads[queue->threads_created++] =
+                halide_spawn_thread(numa_nodes_in_use(queue) > 1 ? numa_worker_thread : worker_thread,
+                                    queue);
         }
-        log_message("enqueue_work_already_locked top level job " << jobs[0].task.name << " with min_threads " << min_threads << " work_queue.threads_created " << work_queue.threads_created << " work_queue.threads_reserved " << work_queue.threads_reserved);
+        log_message("enqueue_work_already_locked top level job " << jobs[0].task.name << " with min_threads " << min_threads << " queue->threads_created " << queue->threads_created << " queue->threads_reserved " << queue->threads_reserved);
         if (job_has_acquires || job_may_block) {
-            work_queue.threads_reserved++;
+            queue->threads_reserved++;
         }
     } else {
         log_message("enqueue_work_already_locked job " << jobs[0].task.name << " with min_threads " << min_threads << " task_parent " << task_parent->task.name << " task_parent->task.min_threads " << task_parent->task.min_threads << " task_parent->threads_reserved " << task_parent->threads_reserved);
@@ -534,31 +1012,40 @@ WEAK void enqueue_work_already_locked(int num_jobs, work *jobs, work *task_paren
     for (int i = num_jobs - 1; i >= 0; i--) {
         // We could bubble it downwards based on some heuristics, but
         // it's not strictly necessary to do so.
-        jobs[i].next_job = work_queue.jobs;
+        jobs[i].next_job = queue->jobs;
         jobs[i].siblings = &jobs[0];
         jobs[i].sibling_count = num_jobs;
         jobs[i].threads_reserved = 0;
-        work_queue.jobs = jobs + i;
+        queue->jobs = jobs + i;
+    }
+    queue->jobs_queued += num_jobs;
+
+    // Jobs are only enqueued by threads that will go on to wait for
+    // them.
+    halide_thread_pool_stats_t *stats = &queue->stats[0];
+    stats->jobs_enqueued += num_jobs;
+    if (queue->jobs_queued > stats->max_queue_depth) {
+        stats->max_queue_depth = queue->jobs_queued;
     }
 
     bool nested_parallelism =
-        work_queue.owners_sleeping ||
-        (work_queue.workers_sleeping < work_queue.threads_created);
+        queue->owners_sleeping ||
+        (queue->workers_sleeping < queue->threads_created);
 
     // Wake up an appropriate number of threads
-    if (nested_parallelism || workers_to_wake > work_queue.workers_sleeping) {
+    if (nested_parallelism || workers_to_wake > queue->workers_sleeping) {
         // If there's nested parallelism going on, we just wake up
         // everyone. TODO: make this more precise.
-        work_queue.target_a_team_size = work_queue.threads_created;
+        queue->target_a_team_size = queue->threads_created;
     } else {
-        work_queue.target_a_team_size = workers_to_wake;
+        queue->target_a_team_size = workers_to_wake;
     }
 
-    halide_cond_broadcast(&work_queue.wake_a_team);
-    if (work_queue.target_a_team_size > work_queue.a_team_size) {
-        halide_cond_broadcast(&work_queue.wake_b_team);
+    halide_cond_broadcast(&queue->wake_a_team);
+    if (queue->target_a_team_size > queue->a_team_size) {
+        halide_cond_broadcast(&queue->wake_b_team);
         if (stealable_jobs) {
-            halide_cond_broadcast(&work_queue.wake_owners);
+            halide_cond_broadcast(&queue->wake_owners);
         }
     }
 
@@ -566,7 +1053,7 @@ WEAK void enqueue_work_already_locked(int num_jobs, work *jobs, work *task_paren
         if (task_parent != nullptr) {
             task_parent->threads_reserved--;
         } else {
-            work_queue.threads_reserved--;
+            queue->threads_reserved--;
         }
     }
 }
@@ -578,6 +1065,45 @@ WEAK halide_do_parallel_tasks_t custom_do_parallel_tasks = halide_default_do_par
 WEAK halide_semaphore_init_t custom_semaphore_init = halide_default_semaphore_init;
 WEAK halide_semaphore_try_acquire_t custom_semaphore_try_acquire = halide_default_semaphore_try_acquire;
 WEAK halide_semaphore_release_t custom_semaphore_release = halide_default_semaphore_release;
+WEAK halide_get_thread_pool_t custom_get_thread_pool = halide_default_get_thread_pool;
+
+// The work queue parallel work from the given user context should go
+// to.
+ALWAYS_INLINE work_queue_t *get_work_queue(void *user_context) {
+    halide_thread_pool_t *pool = halide_get_thread_pool(user_context);
+    return pool ? (work_queue_t *)pool : &default_work_queue;
+}
+
+WEAK void shutdown_work_queue(work_queue_t *queue) {
+    if (queue->initialized) {
+        // Wake everyone up and tell them the party's over and it's time
+        // to go home
+        halide_mutex_lock(&queue->mutex);
+
+        queue->shutdown = true;
+        halide_cond_broadcast(&queue->wake_owners);
+        halide_cond_broadcast(&queue->wake_a_team);
+        halide_cond_broadcast(&queue->wake_b_team);
+        halide_mutex_unlock(&queue->mutex);
+
+        // Wait until they leave
+        for (int i = 0; i < queue->threads_created; i++) {
+            halide_join_thread(queue->threads[i]);
+        }
+
+        // Tidy up
+        queue->reset();
+    }
+}
+
+// A semaphore may be shared between pipelines running on different
+// pools, so any pool may have jobs that a release makes runnable.
+WEAK void wake_for_semaphore(work_queue_t *queue) {
+    halide_mutex_lock(&queue->mutex);
+    halide_cond_broadcast(&queue->wake_a_team);
+    halide_cond_broadcast(&queue->wake_owners);
+    halide_mutex_unlock(&queue->mutex);
+}
 
 }  // namespace Internal
 }  // namespace Runtime
@@ -615,6 +1141,7 @@ WEAK int halide_default_do_par_for(void *user_context, halide_task_t f,
     job.task.min = min;
     job.task.extent = size;
     job.task.serial = false;
+    job.task.guided = false;
     job.task.semaphores = nullptr;
     job.task.num_semaphores = 0;
     job.task.closure = closure;
@@ -622,6 +1149,7 @@ WEAK int halide_default_do_par_for(void *user_context, halide_task_t f,
     job.task.name = nullptr;
     job.task_fn = f;
     job.user_context = user_context;
+    job.queue = get_work_queue(user_context);
     job.exit_status = halide_error_code_success;
     job.active_workers = 0;
     job.next_semaphore = 0;
@@ -629,10 +1157,20 @@ WEAK int halide_default_do_par_for(void *user_context, halide_task_t f,
     job.siblings = &job;  // guarantees no other job points to the same siblings.
     job.sibling_count = 0;
     job.parent_job = nullptr;
-    halide_mutex_lock(&work_queue.mutex);
-    enqueue_work_already_locked(1, &job, nullptr);
-    worker_thread_already_locked(&job);
-    halide_mutex_unlock(&work_queue.mutex);
+    job.ranges = nullptr;
+    job.num_ranges = 0;
+    job.ranges_claimed = 0;
+    job.num_range_nodes = 1;
+    work_queue_t *queue = job.queue;
+    halide_mutex_lock(&queue->mutex);
+    initialize_work_queue_already_locked(queue);
+    if (can_steal_work(job)) {
+        int num_ranges = num_steal_ranges(job);
+        init_steal_ranges(&job, (steal_range *)__builtin_alloca(sizeof(steal_range) * num_ranges), num_ranges);
+    }
+    enqueue_work_already_locked(queue, 1, &job, nullptr);
+    worker_thread_already_locked(queue, &queue->stats[0], &job);
+    halide_mutex_unlock(&queue->mutex);
     return job.exit_status;
 }
 
@@ -641,6 +1179,11 @@ WEAK int halide_default_do_parallel_tasks(void *user_context, int num_tasks,
                                           void *task_parent) {
     work *jobs = (work *)__builtin_alloca(sizeof(work) * num_tasks);
 
+    // Nested tasks run on the same pool as their parent.
+    work_queue_t *queue = task_parent ?
+                              ((work *)task_parent)->queue :
+                              get_work_queue(user_context);
+
     for (int i = 0; i < num_tasks; i++) {
         if (tasks->extent <= 0) {
             // Skip extent zero jobs
@@ -650,29 +1193,41 @@ WEAK int halide_default_do_parallel_tasks(void *user_context, int num_tasks,
         jobs[i].task = *tasks++;
         jobs[i].task_fn = nullptr;
         jobs[i].user_context = user_context;
+        jobs[i].queue = queue;
         jobs[i].exit_status = halide_error_code_success;
         jobs[i].active_workers = 0;
         jobs[i].next_semaphore = 0;
         jobs[i].owner_is_sleeping = false;
         jobs[i].parent_job = (work *)task_parent;
+        jobs[i].ranges = nullptr;
+        jobs[i].num_ranges = 0;
+        jobs[i].ranges_claimed = 0;
+        jobs[i].num_range_nodes = 1;
     }
 
     if (num_tasks == 0) {
         return halide_error_code_success;
     }
 
-    halide_mutex_lock(&work_queue.mutex);
-    enqueue_work_already_locked(num_tasks, jobs, (work *)task_parent);
+    halide_mutex_lock(&queue->mutex);
+    initialize_work_queue_already_locked(queue);
+    for (int i = 0; i < num_tasks; i++) {
+        if (can_steal_work(jobs[i])) {
+            int num_ranges = num_steal_ranges(jobs[i]);
+            init_steal_ranges(jobs + i, (steal_range *)__builtin_alloca(sizeof(steal_range) * num_ranges), num_ranges);
+        }
+    }
+    enqueue_work_already_locked(queue, num_tasks, jobs, (work *)task_parent);
     int exit_status = halide_error_code_success;
     for (int i = 0; i < num_tasks; i++) {
         // It doesn't matter what order we join the tasks in, because
         // we'll happily assist with siblings too.
-        worker_thread_already_locked(jobs + i);
+        worker_thread_already_locked(queue, &queue->stats[0], jobs + i);
         if (jobs[i].exit_status != halide_error_code_success) {
             exit_status = jobs[i].exit_status;
         }
     }
-    halide_mutex_unlock(&work_queue.mutex);
+    halide_mutex_unlock(&queue->mutex);
     return exit_status;
 }
 
@@ -680,39 +1235,164 @@ WEAK int halide_set_num_threads(int n) {
     if (n < 0) {
         halide_error(nullptr, "halide_set_num_threads: must be >= 0.");
     }
+    work_queue_t *queue = &default_work_queue;
     // Don't make this an atomic swap - we don't want to be changing
     // the desired number of threads while another thread is in the
     // middle of a sequence of non-atomic operations.
-    halide_mutex_lock(&work_queue.mutex);
+    halide_mutex_lock(&queue->mutex);
     if (n == 0) {
         n = default_desired_num_threads();
     }
-    int old = work_queue.desired_threads_working;
-    work_queue.desired_threads_working = clamp_num_threads(n);
-    halide_mutex_unlock(&work_queue.mutex);
+    int old = queue->desired_threads_working;
+    queue->desired_threads_working = clamp_num_threads(n);
+    halide_mutex_unlock(&queue->mutex);
+    return old;
+}
+
+WEAK bool halide_set_work_stealing(bool enabled) {
+    work_queue_t *queue = &default_work_queue;
+    halide_mutex_lock(&queue->mutex);
+    if (!queue->work_stealing_set) {
+        queue->work_stealing = default_work_stealing();
+        queue->work_stealing_set = true;
+    }
+    bool old = queue->work_stealing;
+    queue->work_stealing = enabled;
+    halide_mutex_unlock(&queue->mutex);
     return old;
 }
 
+WEAK bool halide_set_numa_affinity(bool enabled) {
+    work_queue_t *queue = &default_work_queue;
+    halide_mutex_lock(&queue->mutex);
+    if (!queue->numa_affinity_set) {
+        queue->numa_affinity = default_numa_affinity();
+        queue->numa_affinity_set = true;
+    }
+    bool old = queue->numa_affinity;
+    queue->numa_affinity = enabled;
+    if (enabled) {
+        probe_numa_topology_already_locked();
+    }
+    halide_mutex_unlock(&queue->mutex);
+    return old;
+}
+
+WEAK int halide_get_numa_node_count() {
+    work_queue_t *queue = &default_work_queue;
+    halide_mutex_lock(&queue->mutex);
+    probe_numa_topology_already_locked();
+    int num_nodes = numa_topology.num_nodes > 1 ? numa_topology.num_nodes : 1;
+    halide_mutex_unlock(&queue->mutex);
+    return num_nodes;
+}
+
 WEAK void halide_shutdown_thread_pool() {
-    if (work_queue.initialized) {
-        // Wake everyone up and tell them the party's over and it's time
-        // to go home
-        halide_mutex_lock(&work_queue.mutex);
+    shutdown_work_queue(&default_work_queue);
+}
 
-        work_queue.shutdown = true;
-        halide_cond_broadcast(&work_queue.wake_owners);
-        halide_cond_broadcast(&work_queue.wake_a_team);
-        halide_cond_broadcast(&work_queue.wake_b_team);
-        halide_mutex_unlock(&work_queue.mutex);
+WEAK halide_thread_pool_t *halide_thread_pool_create(int num_threads) {
+    if (num_threads < 0) {
+        halide_error(nullptr, "halide_thread_pool_create: num_threads must be >= 0.");
+        return nullptr;
+    }
+    work_queue_t *queue = (work_queue_t *)halide_malloc(nullptr, sizeof(work_queue_t));
+    if (queue == nullptr) {
+        return nullptr;
+    }
+    memset(queue, 0, sizeof(work_queue_t));
+    queue->desired_threads_working = num_threads;
+
+    // Inherit any explicit settings of the default pool.
+    halide_mutex_lock(&default_work_queue.mutex);
+    queue->work_stealing = default_work_queue.work_stealing;
+    queue->work_stealing_set = default_work_queue.work_stealing_set;
+    queue->numa_affinity = default_work_queue.numa_affinity;
+    queue->numa_affinity_set = default_work_queue.numa_affinity_set;
+    halide_mutex_unlock(&default_work_queue.mutex);
+
+    halide_mutex_lock(&thread_pools_mutex);
+    queue->next_pool = thread_pools;
+    thread_pools = queue;
+    halide_mutex_unlock(&thread_pools_mutex);
+    return (halide_thread_pool_t *)queue;
+}
 
-        // Wait until they leave
-        for (int i = 0; i < work_queue.threads_created; i++) {
-            halide_join_thread(work_queue.threads[i]);
-        }
+WEAK void halide_thread_pool_destroy(halide_thread_pool_t *pool) {
+    if (pool == nullptr) {
+        return;
+    }
+    work_queue_t *queue = (work_queue_t *)pool;
+    halide_mutex_lock(&thread_pools_mutex);
+    work_queue_t **pool_ptr = &thread_pools;
+    while (*pool_ptr && *pool_ptr != queue) {
+        pool_ptr = &((*pool_ptr)->next_pool);
+    }
+    if (*pool_ptr) {
+        *pool_ptr = queue->next_pool;
+    }
+    halide_mutex_unlock(&thread_pools_mutex);
 
-        // Tidy up
-        work_queue.reset();
+    shutdown_work_queue(queue);
+    halide_free(nullptr, queue);
+}
+
+WEAK int halide_thread_pool_get_stats(halide_thread_pool_t *pool,
+                                      halide_thread_pool_stats_t *total,
+                                      halide_thread_pool_stats_t *per_thread,
+                                      int max_threads) {
+    work_queue_t *queue = pool ? (work_queue_t *)pool : &default_work_queue;
+    halide_mutex_lock(&queue->mutex);
+    int num_slots = 1;
+    for (int i = 1; i <= MAX_THREADS; i++) {
+        const halide_thread_pool_stats_t &s = queue->stats[i];
+        if (s.tasks_run || s.spin_ns || s.sleep_ns || i <= queue->threads_created) {
+            num_slots = i + 1;
+        }
+    }
+    if (total) {
+        memset(total, 0, sizeof(halide_thread_pool_stats_t));
+    }
+    for (int i = 0; i < num_slots; i++) {
+        const halide_thread_pool_stats_t &s = queue->stats[i];
+        if (total) {
+            total->tasks_run += s.tasks_run;
+            total->jobs_enqueued += s.jobs_enqueued;
+            total->steals += s.steals;
+            total->spin_ns += s.spin_ns;
+            total->sleep_ns += s.sleep_ns;
+            total->semaphore_wait_ns += s.semaphore_wait_ns;
+            if (s.max_queue_depth > total->max_queue_depth) {
+                total->max_queue_depth = s.max_queue_depth;
+            }
+        }
+        if (per_thread && i < max_threads) {
+            per_thread[i] = s;
+        }
     }
+    halide_mutex_unlock(&queue->mutex);
+    return num_slots;
+}
+
+WEAK void halide_thread_pool_reset_stats(halide_thread_pool_t *pool) {
+    work_queue_t *queue = pool ? (work_queue_t *)pool : &default_work_queue;
+    halide_mutex_lock(&queue->mutex);
+    memset(queue->stats, 0, sizeof(queue->stats));
+    halide_mutex_unlock(&queue->mutex);
+}
+
+WEAK halide_thread_pool_t *halide_default_get_thread_pool(void *user_context) {
+    return nullptr;
+}
+
+WEAK halide_get_thread_pool_t halide_set_custom_get_thread_pool(halide_get_thread_pool_t f) {
+    halide_get_thread_pool_t result = custom_get_thread_pool;
+    custom_get_thread_pool = f;
+    return result;
+}
+
+WEAK halide_thread_pool_t *halide_get_thread_pool(void *user_context) {
+    return custom_get_thread_pool(user_context);
 }
 
 struct halide_semaphore_impl_t {
@@ -731,10 +1411,12 @@ WEAK int halide_default_semaphore_release(halide_semaphore_t *s, int n) {
     // TODO(abadams|zvookin): Is this correct if an acquire can be for say count of 2 and the releases are 1 each?
     if (old_val == 0 && n != 0) {  // Don't wake if nothing released.
         // We may have just made a job runnable
-        halide_mutex_lock(&work_queue.mutex);
-        halide_cond_broadcast(&work_queue.wake_a_team);
-        halide_cond_broadcast(&work_queue.wake_owners);
-        halide_mutex_unlock(&work_queue.mutex);
+        wake_for_semaphore(&default_work_queue);
+        halide_mutex_lock(&thread_pools_mutex);
+        for (work_queue_t *queue = thread_pools; queue; queue = queue->next_pool) {
+            wake_for_semaphore(queue);
+        }
+        halide_mutex_unlock(&thread_pools_mutex);
     }
     return old_val + n;
 }
@@ -1,4 +1,208 @@
 #include "HalideRuntime.h"
+#include "runtime_atomics.h"
+#include "runtime_internal.h"
+#include "scoped_spin_lock.h"
+
+namespace Halide {
+namespace Runtime {
+namespace Internal {
+
+// The runtime trace filter, checked before a trace packet is built so
+// that tracing hooks left compiled in cost little when filtered out.
+const int trace_filter_max_dims = 8;
+const int trace_filter_max_funcs = 64;
+
+struct TraceFilter {
+    uint32_t sample_every;
+    int box_dimensions;
+    // Inclusive bounds.
+    int32_t box_min[trace_filter_max_dims], box_max[trace_filter_max_dims];
+    int num_funcs;
+    // The func names are copied into storage after the struct.
+    const char *funcs[trace_filter_max_funcs];
+};
+
+WEAK TraceFilter *trace_filter = nullptr;
+WEAK bool trace_filter_initialized = false;
+WEAK ScopedSpinLock::AtomicFlag trace_filter_lock = 0;
+// Counts the loads and stores that passed the other filters, for
+// sampling.
+WEAK uint32_t trace_filter_count = 0;
+
+// Build and install a new filter, or remove it if filter is null.
+// Must be called with trace_filter_lock held.
+WEAK int install_trace_filter(const halide_trace_filter_t *filter) {
+    using namespace Halide::Runtime::Internal::Synchronization;
+
+    TraceFilter *f = nullptr;
+    if (filter && (filter->sample_every > 1 || filter->box_dimensions > 0 || filter->num_funcs > 0)) {
+        if (filter->box_dimensions > trace_filter_max_dims) {
+            return halide_error_code_bad_dimensions;
+        }
+        if (filter->num_funcs > trace_filter_max_funcs) {
+            return halide_error_code_generic_error;
+        }
+        size_t names_size = 0;
+        for (int i = 0; i < filter->num_funcs; i++) {
+            names_size += strlen(filter->funcs[i]) + 1;
+        }
+        f = (TraceFilter *)malloc(sizeof(TraceFilter) + names_size);
+        if (!f) {
+            return halide_error_code_out_of_memory;
+        }
+        f->sample_every = filter->sample_every > 1 ? filter->sample_every : 1;
+        f->box_dimensions = filter->box_dimensions;
+        for (int i = 0; i < filter->box_dimensions; i++) {
+            f->box_min[i] = filter->box_min[i];
+            f->box_max[i] = filter->box_min[i] + filter->box_extent[i] - 1;
+        }
+        f->num_funcs = filter->num_funcs;
+        char *names = (char *)(f + 1);
+        for (int i = 0; i < filter->num_funcs; i++) {
+            const size_t len = strlen(filter->funcs[i]) + 1;
+            memcpy(names, filter->funcs[i], len);
+            f->funcs[i] = names;
+            names += len;
+        }
+    }
+
+    TraceFilter *old = trace_filter;
+    uint32_t zero = 0;
+    atomic_store_release(&trace_filter_count, &zero);
+    atomic_store_release(&trace_filter, &f);
+    bool initialized = true;
+    atomic_store_release(&trace_filter_initialized, &initialized);
+    free(old);
+    return halide_error_code_success;
+}
+
+// Set up the filter from HL_TRACE_SAMPLE, HL_TRACE_FUNCS and
+// HL_TRACE_BOX. Must be called with trace_filter_lock held.
+WEAK void init_trace_filter_from_env(void *user_context) {
+    halide_trace_filter_t filter;
+    memset(&filter, 0, sizeof(filter));
+
+    const char *sample = getenv("HL_TRACE_SAMPLE");
+    if (sample) {
+        const int n = atoi(sample);
+        filter.sample_every = n > 1 ? (uint32_t)n : 1;
+    }
+
+    // A comma-separated list of func names.
+    char names_storage[1024];
+    const char *names[trace_filter_max_funcs];
+    const char *funcs = getenv("HL_TRACE_FUNCS");
+    if (funcs && *funcs) {
+        size_t len = strlen(funcs);
+        if (len >= sizeof(names_storage)) {
+            len = sizeof(names_storage) - 1;
+        }
+        memcpy(names_storage, funcs, len);
+        names_storage[len] = 0;
+        char *p = names_storage;
+        while (p && filter.num_funcs < trace_filter_max_funcs) {
+            char *comma = (char *)strchr(p, ',');
+            if (comma) {
+                *comma = 0;
+            }
+            if (*p) {
+                names[filter.num_funcs++] = p;
+            }
+            p = comma ? comma + 1 : nullptr;
+        }
+        filter.funcs = names;
+    }
+
+    // A comma-separated list of min, extent pairs, one per dimension.
+    int32_t box[2 * trace_filter_max_dims];
+    int32_t box_min[trace_filter_max_dims], box_extent[trace_filter_max_dims];
+    const char *box_env = getenv("HL_TRACE_BOX");
+    if (box_env && *box_env) {
+        int n = 0;
+        for (const char *p = box_env; p && n < 2 * trace_filter_max_dims; n++) {
+            box[n] = atoi(p);
+            p = strchr(p, ',');
+            p = p ? p + 1 : nullptr;
+        }
+        filter.box_dimensions = n / 2;
+        for (int i = 0; i < filter.box_dimensions; i++) {
+            box_min[i] = box[2 * i];
+            box_extent[i] = box[2 * i + 1];
+        }
+        filter.box_min = box_min;
+        filter.box_extent = box_extent;
+    }
+
+    if (install_trace_filter(&filter) != halide_error_code_success) {
+        halide_print(user_context, "Ignoring bad HL_TRACE_* filter settings\n");
+    }
+}
+
+// Loads and stores may carry a vector of coordinates, with lanes
+// values for each dimension. They're in the box if any lane is.
+ALWAYS_INLINE bool in_trace_box(const TraceFilter *f, const int *coords, int lanes, int dimensions) {
+    const int dims = dimensions / lanes;
+    const int box_dims = dims < f->box_dimensions ? dims : f->box_dimensions;
+    for (int lane = 0; lane < lanes; lane++) {
+        bool inside = true;
+        for (int d = 0; d < box_dims && inside; d++) {
+            const int c = coords[d * lanes + lane];
+            inside = c >= f->box_min[d] && c <= f->box_max[d];
+        }
+        if (inside) {
+            return true;
+        }
+    }
+    return false;
+}
+
+WEAK bool trace_filter_passes(void *user_context, const char *func, const int *coords,
+                              int lanes, int code, int dimensions) {
+    using namespace Halide::Runtime::Internal::Synchronization;
+
+    bool initialized;
+    atomic_load_acquire(&trace_filter_initialized, &initialized);
+    if (!initialized) {
+        ScopedSpinLock lock(&trace_filter_lock);
+        if (!trace_filter_initialized) {
+            init_trace_filter_from_env(user_context);
+        }
+    }
+
+    TraceFilter *f;
+    atomic_load_acquire(&trace_filter, &f);
+    if (!f ||
+        code == halide_trace_begin_pipeline ||
+        code == halide_trace_end_pipeline ||
+        code == halide_trace_tag) {
+        return true;
+    }
+
+    if (f->num_funcs) {
+        bool found = false;
+        for (int i = 0; i < f->num_funcs && !found; i++) {
+            found = !strcmp(f->funcs[i], func);
+        }
+        if (!found) {
+            return false;
+        }
+    }
+
+    if (code != halide_trace_load && code != halide_trace_store) {
+        return true;
+    }
+
+    if (f->box_dimensions && lanes > 0 && !in_trace_box(f, coords, lanes, dimensions)) {
+        return false;
+    }
+
+    return f->sample_every == 1 ||
+           atomic_fetch_add_sequentially_consistent(&trace_filter_count, (uint32_t)1) % f->sample_every == 0;
+}
+
+}  // namespace Internal
+}  // namespace Runtime
+}  // namespace Halide
 
 extern "C" {
 
@@ -11,6 +215,12 @@ WEAK int halide_trace_helper(void *user_context,
                              int code,
                              int parent_id, int value_index, int dimensions,
                              const char *trace_tag) {
+    // Events that are filtered out never reach halide_trace, and get
+    // no id.
+    if (!Halide::Runtime::Internal::trace_filter_passes(user_context, func, coords, type_lanes, code, dimensions)) {
+        return 0;
+    }
+
     halide_trace_event_t event;
     event.func = func;
     event.value = value;
@@ -28,4 +238,10 @@ WEAK int halide_trace_helper(void *user_context,
     (void)halide_msan_annotate_memory_is_initialized(user_context, coords, dimensions * sizeof(int32_t));
     return halide_trace(user_context, &event);
 }
+
+WEAK int halide_set_trace_filter(const halide_trace_filter_t *filter) {
+    using namespace Halide::Runtime::Internal;
+    ScopedSpinLock lock(&trace_filter_lock);
+    return install_trace_filter(filter);
+}
 }
@@ -87,12 +87,40 @@ public:
     SharedExclusiveSpinLock() = default;
 };
 
-const static int buffer_size = 1024 * 1024;
+// Binary trace packets are staged in chunks, which a background
+// thread writes out to the trace file, so that tracing threads never
+// stall on a write. Each thread writes into the chunk of its own
+// shard. Threads pick their shard by hashing their thread id, so each
+// thread always uses the same one, and its packets stay in order.
+const static int buffer_size = 256 * 1024;
+const static int num_trace_shards = 16;
+
+// The most chunks there can be at once, whether being filled, waiting
+// to be written, or free. Tracing threads wait for the writer when
+// they're all in use.
+const static int max_trace_chunks = 4 * num_trace_shards;
+
+struct TraceChunk {
+    TraceChunk *next;
+    int fd;
+    uint32_t size;
+    uint8_t buf[buffer_size];
+};
+
+WEAK TraceChunk *take_trace_chunk(void *user_context);
+WEAK void queue_trace_chunk(void *user_context, TraceChunk *chunk);
+
+ALWAYS_INLINE int current_trace_shard() {
+    const uint64_t id = (uint64_t)halide_current_thread_id();
+    return (int)((id * 0x9e3779b97f4a7c15ULL) >> 60) % num_trace_shards;
+}
 
 class TraceBuffer {
     SharedExclusiveSpinLock lock;
     uint32_t cursor = 0, overage = 0;
-    uint8_t buf[buffer_size];
+    TraceChunk *chunk = nullptr;
+    // Keep neighbouring shards off the same cache line.
+    uint8_t padding[64];
 
     // Attempt to atomically acquire space in the buffer to write a
     // packet. Returns nullptr if the buffer was full.
@@ -102,7 +130,7 @@ class TraceBuffer {
         lock.acquire_shared();
         halide_abort_if_false(user_context, size <= buffer_size);
         uint32_t my_cursor = atomic_fetch_add_sequentially_consistent(&cursor, size);
-        if (my_cursor + size > sizeof(buf)) {
+        if (!chunk || my_cursor + size > buffer_size) {
             // Don't try to back it out: instead, just allow this request to fail
             // (along with all subsequent requests) and record the 'overage'
             // that was added and should be ignored; then, in the next flush,
@@ -111,24 +139,30 @@ class TraceBuffer {
             lock.release_shared();
             return nullptr;
         } else {
-            return (halide_trace_packet_t *)(buf + my_cursor);
+            return (halide_trace_packet_t *)(chunk->buf + my_cursor);
         }
     }
 
 public:
     // Wait for all writers to finish with their packets, stall any
-    // new writers, and flush the buffer to the fd.
-    ALWAYS_INLINE void flush(void *user_context, int fd) {
+    // new writers, and hand what's in the buffer to the writer
+    // thread. If need_space is true, make sure there's an empty chunk
+    // to carry on writing into.
+    ALWAYS_INLINE void flush(void *user_context, int fd, bool need_space) {
         lock.acquire_exclusive();
-        bool success = true;
-        if (cursor) {
-            cursor -= overage;
-            success = (cursor == (uint32_t)write(fd, buf, cursor));
-            cursor = 0;
-            overage = 0;
+        const uint32_t used = cursor - overage;
+        if (chunk && used) {
+            chunk->size = used;
+            chunk->fd = fd;
+            queue_trace_chunk(user_context, chunk);
+            chunk = nullptr;
+        }
+        if (!chunk && need_space) {
+            chunk = take_trace_chunk(user_context);
         }
+        cursor = 0;
+        overage = 0;
         lock.release_exclusive();
-        halide_abort_if_false(user_context, success && "Could not write to trace file");
     }
 
     // Acquire and return a packet's worth of space in the trace
@@ -140,7 +174,7 @@ public:
         halide_trace_packet_t *packet = nullptr;
         while (!(packet = try_acquire_packet(user_context, size))) {
             // Couldn't acquire space to write a packet. Flush and try again.
-            flush(user_context, fd);
+            flush(user_context, fd, true);
         }
         return packet;
     }
@@ -154,21 +188,496 @@ public:
         lock.release_shared();
     }
 
+    // Give up the (flushed) chunk, for freeing at shutdown.
+    ALWAYS_INLINE TraceChunk *take_chunk() {
+        TraceChunk *result = chunk;
+        chunk = nullptr;
+        return result;
+    }
+
     ALWAYS_INLINE void init() {
         cursor = 0;
         overage = 0;
+        chunk = nullptr;
         lock.init();
     }
 
     TraceBuffer() = default;
 };
 
-WEAK TraceBuffer *halide_trace_buffer = nullptr;
+// The compressed encoding, used when HL_TRACE_COMPRESS=1. Each chunk
+// becomes a self-contained block:
+//
+//   uint32_t magic, payload_bytes, num_packets;
+//   uint8_t payload[payload_bytes];
+//
+// The magic can't be mistaken for the size of a raw packet, so blocks
+// and raw packets can follow each other in the same file. Within a
+// block, each packet is encoded as:
+//
+//   varint func: 0 for a name that follows as (varint length, bytes),
+//                which is added to the block's dictionary if there's
+//                room, or else 1 + its index in the dictionary.
+//   uint8_t event
+//   svarint id, parent_id: deltas from the previous packet's.
+//   uint8_t type.code, type.bits; varint type.lanes
+//   varint value_index, dimensions
+//   svarint coordinates[dimensions]: deltas from the coordinates of
+//                the previous packet for the same dictionary entry
+//                (the first trace_delta_coords of them only).
+//   uint8_t value[type.lanes * type.bytes()]
+//   varint trace tag length, followed by its bytes.
+//
+// Signed varints are zigzag coded. tools/halide_trace_reader.h has
+// the decoder.
+const uint32_t trace_block_magic = 0x5a525448;  // "HTRZ"
+const int trace_dict_size = 256;
+const int trace_delta_coords = 64;
+const int trace_name_arena_size = 16 * 1024;
+
+struct TraceEncoder {
+    int num_funcs;
+    int last_func;
+    uint32_t arena_used;
+    int32_t prev_id, prev_parent_id;
+    const char *names[trace_dict_size];
+    int32_t coords[trace_dict_size][trace_delta_coords];
+    char arena[trace_name_arena_size];
+};
+
+ALWAYS_INLINE uint8_t *put_varint(uint8_t *p, uint32_t v) {
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+ALWAYS_INLINE uint8_t *put_svarint(uint8_t *p, uint32_t v) {
+    return put_varint(p, (v << 1) ^ (uint32_t)((int32_t)v >> 31));
+}
+
+ALWAYS_INLINE uint8_t *put_bytes(uint8_t *p, const void *src, uint32_t size) {
+    memcpy(p, src, size);
+    return p + size;
+}
+
+// An upper bound on the size of the encoding of size bytes of packets.
+ALWAYS_INLINE uint32_t max_encoded_size(uint32_t size) {
+    return 2 * size + 3 * sizeof(uint32_t);
+}
+
+// Returns the dictionary index of the func, or -1 if it wasn't in
+// the dictionary and there was no room to add it, writing the
+// reference to it to *p.
+WEAK int encode_func(TraceEncoder *enc, const char *func, uint8_t **p) {
+    if (enc->last_func >= 0 && !strcmp(enc->names[enc->last_func], func)) {
+        *p = put_varint(*p, enc->last_func + 1);
+        return enc->last_func;
+    }
+    for (int i = 0; i < enc->num_funcs; i++) {
+        if (!strcmp(enc->names[i], func)) {
+            *p = put_varint(*p, i + 1);
+            enc->last_func = i;
+            return i;
+        }
+    }
+    const uint32_t len = strlen(func);
+    *p = put_varint(*p, 0);
+    *p = put_varint(*p, len);
+    *p = put_bytes(*p, func, len);
+    if (enc->num_funcs == trace_dict_size ||
+        enc->arena_used + len + 1 > (uint32_t)trace_name_arena_size) {
+        return -1;
+    }
+    const int f = enc->num_funcs++;
+    char *name = enc->arena + enc->arena_used;
+    memcpy(name, func, len + 1);
+    enc->arena_used += len + 1;
+    enc->names[f] = name;
+    memset(enc->coords[f], 0, sizeof(enc->coords[f]));
+    enc->last_func = f;
+    return f;
+}
+
+// Encode a chunk of packets as a block at dst, returning the number of
+// bytes written.
+WEAK uint32_t encode_trace_chunk(TraceEncoder *enc, const TraceChunk *chunk, uint8_t *dst) {
+    enc->num_funcs = 0;
+    enc->last_func = -1;
+    enc->arena_used = 0;
+    enc->prev_id = 0;
+    enc->prev_parent_id = 0;
+
+    uint8_t *p = dst + 3 * sizeof(uint32_t);
+    uint32_t num_packets = 0;
+    for (uint32_t pos = 0; pos < chunk->size; num_packets++) {
+        const halide_trace_packet_t *packet = (const halide_trace_packet_t *)(chunk->buf + pos);
+        pos += packet->size;
+
+        const int f = encode_func(enc, packet->func(), &p);
+        *p++ = (uint8_t)packet->event;
+        p = put_svarint(p, (uint32_t)packet->id - (uint32_t)enc->prev_id);
+        p = put_svarint(p, (uint32_t)packet->parent_id - (uint32_t)enc->prev_parent_id);
+        enc->prev_id = packet->id;
+        enc->prev_parent_id = packet->parent_id;
+        *p++ = packet->type.code;
+        *p++ = packet->type.bits;
+        p = put_varint(p, packet->type.lanes);
+        p = put_varint(p, (uint32_t)packet->value_index);
+        p = put_varint(p, (uint32_t)packet->dimensions);
+
+        const int32_t *coords = packet->coordinates();
+        for (int i = 0; i < packet->dimensions; i++) {
+            if (f >= 0 && i < trace_delta_coords) {
+                p = put_svarint(p, (uint32_t)coords[i] - (uint32_t)enc->coords[f][i]);
+                enc->coords[f][i] = coords[i];
+            } else {
+                p = put_svarint(p, (uint32_t)coords[i]);
+            }
+        }
+        p = put_bytes(p, packet->value(), packet->type.lanes * packet->type.bytes());
+
+        const char *tag = packet->trace_tag();
+        const uint32_t tag_len = strlen(tag);
+        p = put_varint(p, tag_len);
+        p = put_bytes(p, tag, tag_len);
+    }
+
+    const uint32_t header[3] = {trace_block_magic,
+                                (uint32_t)(p - dst) - 3 * (uint32_t)sizeof(uint32_t),
+                                num_packets};
+    memcpy(dst, header, sizeof(header));
+    return (uint32_t)(p - dst);
+}
+
+// The state of the background thread that writes out chunks.
+struct TraceWriter {
+    halide_mutex mutex;
+    // Signalled whenever chunks are queued, or have been written.
+    halide_cond cond;
+    TraceChunk *queue_head, *queue_tail;
+    TraceChunk *free_chunks;
+    int num_chunks;
+    // True while the writer holds data that isn't in the file yet.
+    bool busy;
+    bool shutting_down;
+    bool failed;
+    halide_thread *thread;
+
+    // Consecutive chunks are coalesced here before being written, and
+    // compressed on the way if an encoder is present.
+    uint8_t *out;
+    uint32_t out_size;
+    int out_fd;
+    TraceEncoder *encoder;
+};
+
+const uint32_t trace_out_capacity = 2 * buffer_size + 64;
+
+WEAK TraceWriter trace_writer;
+
+WEAK void write_trace_out(TraceWriter *w) {
+    if (w->out_size) {
+        if ((ssize_t)w->out_size != write(w->out_fd, w->out, w->out_size)) {
+            w->failed = true;
+        }
+        w->out_size = 0;
+    }
+}
+
+WEAK void stage_trace_chunk(TraceWriter *w, const TraceChunk *chunk) {
+    const uint32_t max_size = w->encoder ? max_encoded_size(chunk->size) : chunk->size;
+    if (w->out_size && (w->out_fd != chunk->fd || w->out_size + max_size > trace_out_capacity)) {
+        write_trace_out(w);
+    }
+    w->out_fd = chunk->fd;
+    if (w->encoder) {
+        w->out_size += encode_trace_chunk(w->encoder, chunk, w->out + w->out_size);
+    } else {
+        memcpy(w->out + w->out_size, chunk->buf, chunk->size);
+        w->out_size += chunk->size;
+    }
+}
+
+WEAK void trace_writer_thread(void *) {
+    TraceWriter *w = &trace_writer;
+    halide_mutex_lock(&w->mutex);
+    while (true) {
+        while (!w->queue_head && !w->shutting_down) {
+            halide_cond_wait(&w->cond, &w->mutex);
+        }
+        TraceChunk *chunk = w->queue_head;
+        if (!chunk) {
+            break;
+        }
+        w->queue_head = chunk->next;
+        w->busy = true;
+        // Keep coalescing while there's more to come.
+        const bool more = w->queue_head != nullptr;
+        halide_mutex_unlock(&w->mutex);
+
+        stage_trace_chunk(w, chunk);
+        if (!more) {
+            write_trace_out(w);
+        }
+
+        halide_mutex_lock(&w->mutex);
+        chunk->next = w->free_chunks;
+        w->free_chunks = chunk;
+        w->busy = w->out_size != 0;
+        halide_cond_broadcast(&w->cond);
+    }
+    halide_mutex_unlock(&w->mutex);
+}
+
+WEAK TraceChunk *take_trace_chunk(void *user_context) {
+    TraceWriter *w = &trace_writer;
+    TraceChunk *chunk = nullptr;
+    halide_mutex_lock(&w->mutex);
+    while (true) {
+        if (w->free_chunks) {
+            chunk = w->free_chunks;
+            w->free_chunks = chunk->next;
+            break;
+        }
+        if (w->num_chunks < max_trace_chunks) {
+            chunk = (TraceChunk *)malloc(sizeof(TraceChunk));
+            w->num_chunks += chunk ? 1 : 0;
+            break;
+        }
+        halide_cond_wait(&w->cond, &w->mutex);
+    }
+    halide_mutex_unlock(&w->mutex);
+    halide_abort_if_false(user_context, chunk && "Could not allocate trace buffer");
+    return chunk;
+}
+
+WEAK void queue_trace_chunk(void *user_context, TraceChunk *chunk) {
+    TraceWriter *w = &trace_writer;
+    halide_mutex_lock(&w->mutex);
+    chunk->next = nullptr;
+    if (w->thread) {
+        if (w->queue_head) {
+            w->queue_tail->next = chunk;
+        } else {
+            w->queue_head = chunk;
+        }
+        w->queue_tail = chunk;
+        halide_cond_broadcast(&w->cond);
+    } else {
+        // There's no writer thread on this platform. Write it out
+        // ourselves.
+        stage_trace_chunk(w, chunk);
+        write_trace_out(w);
+        chunk->next = w->free_chunks;
+        w->free_chunks = chunk;
+    }
+    bool failed = w->failed;
+    halide_mutex_unlock(&w->mutex);
+    halide_abort_if_false(user_context, !failed && "Could not write to trace file");
+}
+
+// Wait until everything queued so far is in the file.
+WEAK void drain_trace_writer(void *user_context) {
+    TraceWriter *w = &trace_writer;
+    halide_mutex_lock(&w->mutex);
+    while (w->queue_head || w->busy) {
+        halide_cond_wait(&w->cond, &w->mutex);
+    }
+    bool failed = w->failed;
+    halide_mutex_unlock(&w->mutex);
+    halide_abort_if_false(user_context, !failed && "Could not write to trace file");
+}
+
+WEAK TraceBuffer *halide_trace_buffers = nullptr;
 WEAK int halide_trace_file = -1;  // -1 indicates uninitialized
 WEAK ScopedSpinLock::AtomicFlag halide_trace_file_lock = 0;
 WEAK bool halide_trace_file_initialized = false;
 WEAK void *halide_trace_file_internally_opened = nullptr;
 
+// Flush every shard other than skip (-1 for none) to the writer.
+WEAK void flush_trace_buffers(void *user_context, int fd, int skip) {
+    for (int i = 0; i < num_trace_shards; i++) {
+        if (i != skip) {
+            halide_trace_buffers[i].flush(user_context, fd, false);
+        }
+    }
+}
+
+// Set up the trace buffers and start the writer. Must be called with
+// halide_trace_file_lock held.
+WEAK void init_trace_buffers(void *user_context) {
+    using namespace Halide::Runtime::Internal::Synchronization;
+
+    if (halide_trace_buffers) {
+        return;
+    }
+    TraceWriter *w = &trace_writer;
+    w->out = (uint8_t *)malloc(trace_out_capacity);
+    const char *compress = getenv("HL_TRACE_COMPRESS");
+    if (compress && compress[0] == '1') {
+        w->encoder = (TraceEncoder *)malloc(sizeof(TraceEncoder));
+        halide_abort_if_false(user_context, w->encoder && "Could not allocate trace encoder");
+    }
+    TraceBuffer *buffers = (TraceBuffer *)malloc(num_trace_shards * sizeof(TraceBuffer));
+    halide_abort_if_false(user_context, w->out && buffers && "Could not allocate trace buffers");
+    for (int i = 0; i < num_trace_shards; i++) {
+        buffers[i].init();
+    }
+    w->shutting_down = false;
+    w->failed = false;
+    // Without threads, queue_trace_chunk writes each chunk out itself.
+    w->thread = halide_can_spawn_threads() ? halide_spawn_thread(trace_writer_thread, nullptr) : nullptr;
+    atomic_store_release(&halide_trace_buffers, &buffers);
+}
+
+// Flush everything, stop the writer, and free the trace buffers.
+WEAK void shutdown_trace_buffers() {
+    if (!halide_trace_buffers) {
+        return;
+    }
+    TraceWriter *w = &trace_writer;
+    flush_trace_buffers(nullptr, halide_trace_file, -1);
+    if (w->thread) {
+        halide_mutex_lock(&w->mutex);
+        w->shutting_down = true;
+        halide_cond_broadcast(&w->cond);
+        halide_mutex_unlock(&w->mutex);
+        halide_join_thread(w->thread);
+        w->thread = nullptr;
+    }
+    while (w->free_chunks) {
+        TraceChunk *next = w->free_chunks->next;
+        free(w->free_chunks);
+        w->free_chunks = next;
+    }
+    for (int i = 0; i < num_trace_shards; i++) {
+        free(halide_trace_buffers[i].take_chunk());
+    }
+    w->num_chunks = 0;
+    free(w->out);
+    free(w->encoder);
+    w->out = nullptr;
+    w->encoder = nullptr;
+    free(halide_trace_buffers);
+    halide_trace_buffers = nullptr;
+}
+
+const char *const trace_event_names[] = {"Load",
+                                         "Store",
+                                         "Begin realization",
+                                         "End realization",
+                                         "Produce",
+                                         "End produce",
+                                         "Consume",
+                                         "End consume",
+                                         "Begin pipeline",
+                                         "End pipeline",
+                                         "Tag"};
+
+// The flight recorder keeps the last few structural events (anything
+// other than a load or store) seen by each thread in memory, instead
+// of writing out a trace, so that they can be printed when something
+// goes wrong. As with the trace buffers, threads are sharded by thread
+// id.
+const int flight_record_max_coords = 8;
+const int flight_record_func_length = 48;
+
+struct FlightRecord {
+    int64_t time_ns;
+    int32_t id, parent_id;
+    int32_t event;
+    int32_t value_index;
+    int32_t dimensions;
+    int32_t coordinates[flight_record_max_coords];
+    char func[flight_record_func_length];
+};
+
+struct FlightRecorderShard {
+    ScopedSpinLock::AtomicFlag lock;
+    // The number of events ever recorded into this shard. The most
+    // recent is at (count - 1) % capacity.
+    uint32_t count;
+    FlightRecord *records;
+    // Keep neighbouring shards off the same cache line.
+    uint8_t padding[64];
+};
+
+WEAK FlightRecorderShard *flight_recorder = nullptr;
+WEAK int flight_recorder_capacity = 0;
+WEAK bool flight_recorder_initialized = false;
+
+// Must be called with halide_trace_file_lock held.
+WEAK int set_flight_recorder_already_locked(int events_per_thread) {
+    using namespace Halide::Runtime::Internal::Synchronization;
+
+    FlightRecorderShard *shards = nullptr;
+    if (events_per_thread > 0) {
+        const size_t shards_size = num_trace_shards * sizeof(FlightRecorderShard);
+        shards = (FlightRecorderShard *)malloc(shards_size +
+                                               num_trace_shards * events_per_thread * sizeof(FlightRecord));
+        if (!shards) {
+            return halide_error_code_out_of_memory;
+        }
+        memset(shards, 0, shards_size);
+        FlightRecord *records = (FlightRecord *)((uint8_t *)shards + shards_size);
+        for (int i = 0; i < num_trace_shards; i++) {
+            shards[i].records = records + i * events_per_thread;
+        }
+        halide_start_clock(nullptr);
+    }
+    FlightRecorderShard *old = flight_recorder;
+    flight_recorder_capacity = events_per_thread > 0 ? events_per_thread : 0;
+    atomic_store_release(&flight_recorder, &shards);
+    flight_recorder_initialized = true;
+    free(old);
+    return halide_error_code_success;
+}
+
+// Returns the flight recorder, or nullptr if it's off. It's turned on
+// by halide_set_trace_flight_recorder, or by HL_TRACE_FLIGHT_RECORDER.
+ALWAYS_INLINE FlightRecorderShard *get_flight_recorder() {
+    using namespace Halide::Runtime::Internal::Synchronization;
+
+    FlightRecorderShard *shards;
+    atomic_load_acquire(&flight_recorder, &shards);
+    if (!shards && !flight_recorder_initialized) {
+        ScopedSpinLock lock(&halide_trace_file_lock);
+        if (!flight_recorder_initialized) {
+            const char *env = getenv("HL_TRACE_FLIGHT_RECORDER");
+            (void)set_flight_recorder_already_locked(env ? atoi(env) : 0);
+        }
+        shards = flight_recorder;
+    }
+    return shards;
+}
+
+WEAK void record_flight_event(void *user_context, FlightRecorderShard *shards,
+                              int32_t id, const halide_trace_event_t *e) {
+    FlightRecorderShard &shard = shards[current_trace_shard()];
+    const int64_t now = halide_current_time_ns(user_context);
+
+    ScopedSpinLock lock(&shard.lock);
+    FlightRecord &r = shard.records[shard.count++ % (uint32_t)flight_recorder_capacity];
+    r.time_ns = now;
+    r.id = id;
+    r.parent_id = e->parent_id;
+    r.event = e->event;
+    r.value_index = e->value_index;
+    r.dimensions = e->dimensions < flight_record_max_coords ? e->dimensions : flight_record_max_coords;
+    for (int i = 0; i < r.dimensions; i++) {
+        r.coordinates[i] = e->coordinates[i];
+    }
+    size_t len = strlen(e->func);
+    if (len >= (size_t)flight_record_func_length) {
+        len = flight_record_func_length - 1;
+    }
+    memcpy(r.func, e->func, len);
+    r.func[len] = 0;
+}
+
 }  // namespace Internal
 }  // namespace Runtime
 }  // namespace Halide
@@ -182,9 +691,38 @@ WEAK int32_t halide_default_trace(void *user_context, const halide_trace_event_t
 
     int32_t my_id = atomic_fetch_add_sequentially_consistent(&ids, 1);
 
+    // The flight recorder replaces the usual output.
+    if (FlightRecorderShard *recorder = get_flight_recorder()) {
+        if (e->event != halide_trace_load && e->event != halide_trace_store) {
+            record_flight_event(user_context, recorder, my_id, e);
+        }
+        return my_id;
+    }
+
     // If we're dumping to a file, use a binary format
     int fd = halide_get_trace_file(user_context);
     if (fd > 0) {
+        TraceBuffer *buffers;
+        atomic_load_acquire(&halide_trace_buffers, &buffers);
+        if (!buffers) {
+            // The trace file was set directly with halide_set_trace_file.
+            ScopedSpinLock lock(&halide_trace_file_lock);
+            init_trace_buffers(user_context);
+            buffers = halide_trace_buffers;
+        }
+        const int shard = current_trace_shard();
+        TraceBuffer *buffer = buffers + shard;
+
+        // Anything other than a load or store marks a point that other
+        // threads' events may depend on, e.g. the start of a
+        // realization. Everything that happened before it must be
+        // queued before it, so flush the other shards first, and then
+        // its own shard after.
+        const bool ordered = e->event != halide_trace_load && e->event != halide_trace_store;
+        if (ordered) {
+            flush_trace_buffers(user_context, fd, shard);
+        }
+
         // Compute the total packet size
         uint32_t value_bytes = (uint32_t)(e->type.lanes * e->type.bytes());
         uint32_t header_bytes = (uint32_t)sizeof(halide_trace_packet_t);
@@ -195,7 +733,7 @@ WEAK int32_t halide_default_trace(void *user_context, const halide_trace_event_t
         uint32_t total_size = (total_size_without_padding + 3) & ~3;
 
         // Claim some space to write to in the trace buffer
-        halide_trace_packet_t *packet = halide_trace_buffer->acquire_packet(user_context, fd, total_size);
+        halide_trace_packet_t *packet = buffer->acquire_packet(user_context, fd, total_size);
 
         if (total_size > 4096) {
             print(nullptr) << total_size << "\n";
@@ -219,12 +757,16 @@ WEAK int32_t halide_default_trace(void *user_context, const halide_trace_event_t
         memcpy((void *)packet->trace_tag(), e->trace_tag ? e->trace_tag : "", trace_tag_bytes);
 
         // Release it
-        halide_trace_buffer->release_packet(packet);
+        buffer->release_packet(packet);
+
+        if (ordered) {
+            buffer->flush(user_context, fd, false);
+        }
 
-        // We should also flush the trace buffer if we hit an event
-        // that might be the end of the trace.
+        // We should also wait for the file to be complete if we hit
+        // an event that might be the end of the trace.
         if (e->event == halide_trace_end_pipeline) {
-            halide_trace_buffer->flush(user_context, fd);
+            drain_trace_writer(user_context);
         }
 
     } else {
@@ -238,22 +780,10 @@ WEAK int32_t halide_default_trace(void *user_context, const halide_trace_event_t
         halide_abort_if_false(user_context, print_bits <= 64 && "Tracing bad type");
 
         // Otherwise, use halide_print and a plain-text format
-        const char *event_types[] = {"Load",
-                                     "Store",
-                                     "Begin realization",
-                                     "End realization",
-                                     "Produce",
-                                     "End produce",
-                                     "Consume",
-                                     "End consume",
-                                     "Begin pipeline",
-                                     "End pipeline",
-                                     "Tag"};
-
         // Only print out the value on stores and loads.
         bool print_value = (e->event < 2);
 
-        ss << event_types[e->event] << " " << e->func << "." << e->value_index << "(";
+        ss << trace_event_names[e->event] << " " << e->func << "." << e->value_index << "(";
         if (e->type.lanes > 1) {
             ss << "<";
         }
@@ -371,10 +901,7 @@ WEAK int halide_get_trace_file(void *user_context) {
             halide_abort_if_false(user_context, file && "Failed to open trace file\n");
             halide_set_trace_file(fileno(file));
             halide_trace_file_internally_opened = file;
-            if (!halide_trace_buffer) {
-                halide_trace_buffer = (TraceBuffer *)malloc(sizeof(TraceBuffer));
-                halide_trace_buffer->init();
-            }
+            init_trace_buffers(user_context);
         } else {
             halide_set_trace_file(0);
         }
@@ -386,15 +913,98 @@ WEAK int32_t halide_trace(void *user_context, const halide_trace_event_t *e) {
     return (*halide_custom_trace)(user_context, e);
 }
 
+WEAK int halide_set_trace_flight_recorder(int events_per_thread) {
+    ScopedSpinLock lock(&halide_trace_file_lock);
+    return set_flight_recorder_already_locked(events_per_thread);
+}
+
+WEAK void halide_trace_flight_recorder_dump(void *user_context) {
+    FlightRecorderShard *shards = flight_recorder;
+    if (!shards) {
+        return;
+    }
+    const uint32_t capacity = (uint32_t)flight_recorder_capacity;
+    // Hold every shard's lock while printing, so the rings stay put.
+    for (int i = 0; i < num_trace_shards; i++) {
+        while (__atomic_test_and_set(&shards[i].lock, __ATOMIC_ACQUIRE)) {
+            // nothing
+        }
+    }
+
+    // Print the events of all the shards in id order, which is the
+    // order they were traced in. Ids are handed out before a shard's
+    // lock is taken, so threads sharing a shard can record them out of
+    // order; gather them all and sort them.
+    uint32_t total = 0;
+    for (int i = 0; i < num_trace_shards; i++) {
+        total += shards[i].count < capacity ? shards[i].count : capacity;
+    }
+    const FlightRecord **records = total ? (const FlightRecord **)malloc(total * sizeof(const FlightRecord *)) : nullptr;
+    if (total && !records) {
+        for (int i = 0; i < num_trace_shards; i++) {
+            __atomic_clear(&shards[i].lock, __ATOMIC_RELEASE);
+        }
+        halide_print(user_context, "Flight recorder: could not allocate memory to print events\n");
+        return;
+    }
+    uint32_t k = 0;
+    for (int i = 0; i < num_trace_shards; i++) {
+        const uint32_t n = shards[i].count < capacity ? shards[i].count : capacity;
+        // The oldest record still in the ring is the one after the
+        // newest, once it has wrapped.
+        const uint32_t oldest = shards[i].count < capacity ? 0 : shards[i].count % capacity;
+        for (uint32_t j = 0; j < n; j++) {
+            records[k++] = &shards[i].records[(oldest + j) % capacity];
+        }
+    }
+    // Shell sort, as there's no qsort in the runtime.
+    for (uint32_t gap = total / 2; gap > 0; gap /= 2) {
+        for (uint32_t i = gap; i < total; i++) {
+            const FlightRecord *r = records[i];
+            uint32_t j = i;
+            for (; j >= gap && records[j - gap]->id > r->id; j -= gap) {
+                records[j] = records[j - gap];
+            }
+            records[j] = r;
+        }
+    }
+
+    const int64_t now = halide_current_time_ns(user_context);
+    print(user_context) << "Flight recorder: the last " << total << " trace events, oldest first:\n";
+    for (uint32_t i = 0; i < total; i++) {
+        const FlightRecord *r = records[i];
+
+        StringStreamPrinter<1024> ss(user_context);
+        ss << "  " << (now - r->time_ns) / 1000 << "us ago: "
+           << trace_event_names[r->event] << " " << r->func;
+        if (r->event == halide_trace_begin_realization ||
+            r->event == halide_trace_produce ||
+            r->event == halide_trace_consume) {
+            // The coordinates are min, extent pairs.
+            ss << "(";
+            for (int j = 0; j + 1 < r->dimensions; j += 2) {
+                ss << (j ? ", " : "") << "[" << r->coordinates[j] << ", "
+                   << r->coordinates[j] + r->coordinates[j + 1] - 1 << "]";
+            }
+            ss << ")";
+        }
+        ss << " (id " << r->id << ", parent " << r->parent_id << ")\n";
+        halide_print(user_context, ss.str());
+    }
+    free(records);
+
+    for (int i = 0; i < num_trace_shards; i++) {
+        __atomic_clear(&shards[i].lock, __ATOMIC_RELEASE);
+    }
+}
+
 WEAK int halide_shutdown_trace() {
+    shutdown_trace_buffers();
     if (halide_trace_file_internally_opened) {
         int ret = fclose(halide_trace_file_internally_opened);
         halide_trace_file = 0;
         halide_trace_file_initialized = false;
         halide_trace_file_internally_opened = nullptr;
-        if (halide_trace_buffer) {
-            free(halide_trace_buffer);
-        }
         if (ret != 0) {
             return halide_error_code_trace_failed;
         }
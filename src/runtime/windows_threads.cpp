@@ -27,6 +27,7 @@ extern WIN32API void DeleteCriticalSection(CriticalSection *);
 extern WIN32API void EnterCriticalSection(CriticalSection *);
 extern WIN32API void LeaveCriticalSection(CriticalSection *);
 extern WIN32API int32_t WaitForSingleObject(Thread, int32_t timeout);
+extern WIN32API uint32_t GetCurrentThreadId();
 
 }  // extern "C"
 
@@ -75,6 +76,14 @@ WEAK void halide_join_thread(halide_thread *thread_arg) {
     free(thread);
 }
 
+WEAK uintptr_t halide_current_thread_id() {
+    return GetCurrentThreadId();
+}
+
+WEAK bool halide_can_spawn_threads() {
+    return true;
+}
+
 }  // extern "C"
 
 namespace Halide {
@@ -0,0 +1,94 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+int main(int argc, char **argv) {
+    Expr x = Variable::make(Int(32), "x");
+    Expr y = Variable::make(Int(32), "y");
+
+    // Outside of a hash-consing scope, every make returns a new node.
+    if ((x + y * 2).same_as(x + y * 2)) {
+        printf("Exprs were shared without hash-consing\n");
+        return 1;
+    }
+
+    {
+        ScopedHashConsing hash_consing;
+
+        Expr a = Variable::make(Int(32), "a");
+        Expr b = Variable::make(Int(32), "b");
+        Expr e1 = select(a < b, (a + b) * 3, (a + b) / 3);
+        Expr e2 = select(Variable::make(Int(32), "a") < b, (a + b) * 3, (a + b) / 3);
+        if (!e1.same_as(e2)) {
+            printf("Identical Exprs were not shared\n");
+            return 1;
+        }
+        const Select *s = e1.as<Select>();
+        if (!s || !s->true_value.as<Mul>()->a.same_as(s->false_value.as<Div>()->a)) {
+            printf("Common subexpression was not shared\n");
+            return 1;
+        }
+        if (hash_consing.hits() == 0) {
+            printf("Expected some makes to return an existing node\n");
+            return 1;
+        }
+
+        // Distinct nodes made entirely within the scope are known to
+        // differ without comparing them.
+        if (!hash_consed_and_distinct(a + b, a - b) || equal(a + b, a - b)) {
+            printf("a + b and a - b should be distinct\n");
+            return 1;
+        }
+
+        // Nodes that refer to things equal() ignores must still be
+        // compared properly.
+        Param<int> p1("p"), p2("p");
+        Expr v1 = Variable::make(Int(32), "p", p1.parameter());
+        Expr v2 = Variable::make(Int(32), "p", p2.parameter());
+        if (v1.same_as(v2) || !equal(v1 + 1, v2 + 1)) {
+            printf("Variables for different Parameters were mishandled\n");
+            return 1;
+        }
+
+        // Nodes from outside the scope are never considered distinct.
+        if (hash_consed_and_distinct(x, a)) {
+            printf("x was not made in the hash-consing scope\n");
+            return 1;
+        }
+
+        // Loads are never shared.
+        Expr l1 = Load::make(Int(32), "buf", a, Buffer<>(), Parameter(), const_true(), ModulusRemainder());
+        Expr l2 = Load::make(Int(32), "buf", a, Buffer<>(), Parameter(), const_true(), ModulusRemainder());
+        if (l1.same_as(l2) || !equal(l1, l2)) {
+            printf("Loads should not be shared\n");
+            return 1;
+        }
+
+        // Compiling a pipeline within the scope should give the same
+        // results as without it.
+        Func f("f"), g("g");
+        Var i("i"), j("j");
+        f(i, j) = (i + j) * (i + j) + 3;
+        g(i, j) = f(i, j) + f(i + 1, j) * (i + j);
+        f.compute_at(g, j).vectorize(i, 8);
+        g.vectorize(i, 8, TailStrategy::RoundUp);
+
+        Buffer<int> out = g.realize({64, 16});
+        for (int jj = 0; jj < out.height(); jj++) {
+            for (int ii = 0; ii < out.width(); ii++) {
+                int f0 = (ii + jj) * (ii + jj) + 3;
+                int f1 = (ii + 1 + jj) * (ii + 1 + jj) + 3;
+                int correct = f0 + f1 * (ii + jj);
+                if (out(ii, jj) != correct) {
+                    printf("out(%d, %d) = %d instead of %d\n", ii, jj, out(ii, jj), correct);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
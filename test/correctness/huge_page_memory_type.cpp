@@ -0,0 +1,83 @@
+#include "Halide.h"
+#include <atomic>
+#include <stdio.h>
+
+using namespace Halide;
+
+std::atomic<int> malloc_count{0};
+std::atomic<int> free_count{0};
+
+void *my_malloc(JITUserContext *user_context, size_t x) {
+    malloc_count++;
+    void *orig = malloc(x + 64);
+    void *ptr = (void *)((((size_t)orig + 64) >> 6) << 6);
+    ((void **)ptr)[-1] = orig;
+    return ptr;
+}
+
+void my_free(JITUserContext *user_context, void *ptr) {
+    free_count++;
+    free(((void **)ptr)[-1]);
+}
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] WebAssembly JIT does not support custom allocators.\n");
+        return 0;
+    }
+
+    // One intermediate big enough to be mapped with huge pages, and
+    // one small enough that it falls back to halide_malloc.
+    const int width = 1024, height = 1024;
+    Var x, y;
+    Func big, small, out;
+    big(x, y) = x + y * 2;
+    small(x) = x * 3;
+    out(x, y) = big(x, y) + big(x + 1, y) + small(x % 16);
+    big.compute_root().store_in(MemoryType::HugePage).parallel(y);
+    small.compute_root().store_in(MemoryType::HugePage).bound(x, 0, 16);
+    out.parallel(y);
+
+    out.jit_handlers().custom_malloc = my_malloc;
+    out.jit_handlers().custom_free = my_free;
+
+    // Exercise the parallel first-touch path too.
+#ifdef _WIN32
+    _putenv_s("HL_HUGE_PAGE_PREFAULT", "1");
+#else
+    setenv("HL_HUGE_PAGE_PREFAULT", "1", 1);
+#endif
+
+    for (int iter = 0; iter < 2; iter++) {
+        malloc_count = 0;
+        free_count = 0;
+
+        Buffer<int> result = out.realize({width, height});
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                int correct = 2 * x + 1 + 4 * y + (x % 16) * 3;
+                if (result(x, y) != correct) {
+                    printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                    return 1;
+                }
+            }
+        }
+
+        if (malloc_count != free_count) {
+            printf("%d mallocs but %d frees\n", (int)malloc_count, (int)free_count);
+            return 1;
+        }
+
+        // On Linux only the small allocation should reach
+        // halide_malloc. Elsewhere both do.
+        const int expected = (target.os == Target::Linux) ? 1 : 2;
+        if (malloc_count != expected) {
+            printf("Expected %d calls to halide_malloc, got %d\n", expected, (int)malloc_count);
+            return 1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
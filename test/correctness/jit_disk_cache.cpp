@@ -0,0 +1,99 @@
+#include "Halide.h"
+#include "halide_test_dirs.h"
+
+#include <cstdio>
+#include <string>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace Halide;
+
+#ifndef _WIN32
+namespace {
+
+// Count the cache entries in a directory, optionally deleting them.
+int cache_entries(const std::string &dir, bool remove) {
+    int count = 0;
+    DIR *d = opendir(dir.c_str());
+    if (!d) {
+        return 0;
+    }
+    while (dirent *e = readdir(d)) {
+        const std::string name = e->d_name;
+        if (name.rfind("halide_jit_", 0) == 0) {
+            count++;
+            if (remove) {
+                unlink((dir + "/" + name).c_str());
+            }
+        }
+    }
+    closedir(d);
+    return count;
+}
+
+}  // namespace
+#endif
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("[SKIP] Windows does not have a working setenv\n");
+#else
+    if (get_jit_target_from_environment().arch == Target::WebAssembly) {
+        printf("[SKIP] WebAssembly JIT does not use the JIT disk cache.\n");
+        return 0;
+    }
+
+    const std::string dir = Internal::get_test_tmp_dir() + "jit_disk_cache";
+    mkdir(dir.c_str(), 0755);
+    cache_entries(dir, true);
+    setenv("HL_JIT_CACHE_DIR", dir.c_str(), 1);
+
+    Func f("f");
+    Var x("x"), y("y");
+    f(x, y) = x + 3 * y;
+
+    // The first compilation writes the object code to the cache.
+    Callable first = f.compile_to_callable({});
+    if (cache_entries(dir, false) < 1) {
+        printf("Nothing was written to the JIT disk cache in %s\n", dir.c_str());
+        return 1;
+    }
+
+    // The second lowers to the same module, apart from the names
+    // unique_name made, so it links the cached object code instead of
+    // running LLVM.
+    const int hits = Internal::JITModule::disk_cache_hits();
+    Callable second = f.compile_to_callable({});
+    if (Internal::JITModule::disk_cache_hits() != hits + 1) {
+        printf("The second compilation didn't load from the JIT disk cache\n");
+        return 1;
+    }
+    if (cache_entries(dir, false) != 1) {
+        printf("Expected exactly one JIT disk cache entry in %s\n", dir.c_str());
+        return 1;
+    }
+
+    for (const Callable *c : {&first, &second}) {
+        Buffer<int> out(32, 16);
+        int result = (*c)(out);
+        if (result != 0) {
+            printf("Callable failed with %d\n", result);
+            return 1;
+        }
+        out.for_each_element([&](int x, int y) {
+            if (out(x, y) != x + 3 * y) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), x + 3 * y);
+                exit(1);
+            }
+        });
+    }
+
+    cache_entries(dir, true);
+    printf("Success!\n");
+#endif
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include "Halide.h"
+#include "halide_test_dirs.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+namespace {
+
+struct Pass {
+    std::string name;
+    double duration;
+    int64_t before, after;
+};
+
+std::vector<Pass> passes;
+
+// Only records the lowering passes.
+class PassLogger : public CompilerLogger {
+public:
+    void record_matched_simplifier_rule(const std::string &rulename, Expr expr) override {
+    }
+    void record_non_monotonic_loop_var(const std::string &loop_var, Expr expr) override {
+    }
+    void record_failed_to_prove(Expr failed_to_prove, Expr original_expr) override {
+    }
+    void record_object_code_size(uint64_t bytes) override {
+    }
+    void record_compilation_time(Phase phase, double duration) override {
+    }
+    void record_lowering_pass(const std::string &pass_name, double duration,
+                              int64_t ir_nodes_before, int64_t ir_nodes_after,
+                              int64_t peak_rss_delta) override {
+        passes.push_back({pass_name, duration, ir_nodes_before, ir_nodes_after});
+    }
+    std::ostream &emit_to_stream(std::ostream &o) override {
+        return o;
+    }
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("[SKIP] Windows does not have a working setenv\n");
+#else
+    std::string trace_file = Internal::get_test_tmp_dir() + "lowering_pass_timing.json";
+    Internal::ensure_no_file_exists(trace_file);
+    setenv("HL_LOWERING_TRACE_FILE", trace_file.c_str(), 1);
+
+    Func f("f"), g("g");
+    Var x("x"), y("y");
+    f(x, y) = x + y;
+    g(x, y) = f(x, y) + f(x + 1, y);
+    f.compute_at(g, y);
+    g.vectorize(x, 8);
+
+    set_compiler_logger(std::make_unique<PassLogger>());
+    g.compile_to_module({}, "g", get_host_target());
+    set_compiler_logger(nullptr);
+
+    // Each pass should start from the IR the previous pass produced.
+    bool found_flattening = false;
+    for (size_t i = 0; i < passes.size(); i++) {
+        const Pass &p = passes[i];
+        if (p.duration < 0 || p.after <= 0 ||
+            (i > 0 && p.before != passes[i - 1].after)) {
+            printf("Bad stats for pass %s: %f seconds, %lld -> %lld nodes\n",
+                   p.name.c_str(), p.duration, (long long)p.before, (long long)p.after);
+            return 1;
+        }
+        found_flattening |= (p.name == "storage flattening");
+    }
+    if (passes.size() < 20 || !found_flattening) {
+        printf("Expected a record for each lowering pass, but got %d\n", (int)passes.size());
+        return 1;
+    }
+
+    std::ifstream trace(trace_file);
+    std::stringstream contents;
+    contents << trace.rdbuf();
+    const std::string json = contents.str();
+    if (json.rfind("[\n", 0) != 0 ||
+        json.find("\"name\": \"storage flattening\", \"cat\": \"lowering\", \"ph\": \"X\"") == std::string::npos ||
+        json.find("\"pipeline\": \"g\"") == std::string::npos) {
+        printf("Unexpected lowering trace:\n%s\n", json.c_str());
+        return 1;
+    }
+
+    printf("Success!\n");
+#endif
+    return 0;
+}
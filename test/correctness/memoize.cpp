@@ -1,5 +1,6 @@
 #include "Halide.h"
 #include "HalideRuntime.h"
+#include "halide_test_dirs.h"
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -488,6 +489,90 @@ int main(int argc, char **argv) {
         Internal::JITSharedRuntime::memoization_cache_set_size(0);
     }
 
+    {
+        // Test parallel stores of many distinct keys into a cache
+        // small enough that pruning has to evict from other threads'
+        // cache shards.
+        Param<int> offset;
+
+        Func f;
+        Var x, y;
+        f(x, y) = cast<uint8_t>(memoize_tag(y, offset) + x);
+
+        Func g;
+        g(x, y) = f(x, y) + f(x + 1, y);
+        f.compute_at(g, y).memoize();
+        g.parallel(y);
+
+        Internal::JITSharedRuntime::memoization_cache_set_size(4096);
+        for (int v = 0; v < 8; v++) {
+            offset.set(v % 3);
+            Buffer<uint8_t> out = g.realize({128, 256});
+
+            for (int32_t j = 0; j < 256; j++) {
+                for (int32_t i = 0; i < 128; i++) {
+                    assert(out(i, j) == (uint8_t)(2 * j + 2 * i + 1));
+                }
+            }
+        }
+
+        // Return cache size to default.
+        Internal::JITSharedRuntime::memoization_cache_set_size(0);
+    }
+
+    {
+        // Test eviction policies and per-pipeline quotas
+        Param<float> val;
+
+        Func count_calls;
+        count_calls.define_extern("count_calls_with_arg", {cast<uint8_t>(val)}, UInt(8), 2);
+
+        Func f("memoize_quota_pipeline");
+        Var x, y;
+        f(x, y) = count_calls(x, y) + cast<uint8_t>(x);
+        count_calls.compute_root().memoize();
+
+        // Room for about five of the ten distinct results.
+        Internal::JITSharedRuntime::memoization_cache_set_size(20000);
+        for (halide_memoization_cache_policy_t policy : {halide_memoization_cache_policy_lru,
+                                                         halide_memoization_cache_policy_lfu,
+                                                         halide_memoization_cache_policy_probation,
+                                                         halide_memoization_cache_policy_cost_aware}) {
+            Internal::JITSharedRuntime::memoization_cache_set_policy(policy);
+            for (int v = 0; v < 100; v++) {
+                int r = (v * v) % 10;
+                val.set((float)r);
+                Buffer<uint8_t> out = f.realize({64, 64});
+                for (int32_t j = 0; j < 64; j++) {
+                    for (int32_t i = 0; i < 64; i++) {
+                        assert(out(i, j) == (uint8_t)(r + i));
+                    }
+                }
+            }
+        }
+        Internal::JITSharedRuntime::memoization_cache_set_policy(halide_memoization_cache_policy_lru);
+        Internal::JITSharedRuntime::memoization_cache_set_size(0);
+
+        // With a quota that only fits one result, alternating between
+        // two values of val misses every time.
+        Internal::JITSharedRuntime::memoization_cache_set_pipeline_quota(f.name(), 5000);
+        call_count_with_arg = 0;
+        for (int v = 0; v < 4; v++) {
+            val.set(100.0f + (v % 2));
+            f.realize({64, 64});
+        }
+        assert(call_count_with_arg == 4);
+
+        // Without the quota, both stay resident.
+        Internal::JITSharedRuntime::memoization_cache_set_pipeline_quota(f.name(), 0);
+        call_count_with_arg = 0;
+        for (int v = 0; v < 4; v++) {
+            val.set(102.0f + (v % 2));
+            f.realize({64, 64});
+        }
+        assert(call_count_with_arg == 2);
+    }
+
     {
         // Test multiple argument memoize_tag. This can be unsafe but
         // models cases where one uses a hash of image data as part of
@@ -734,6 +819,106 @@ int main(int argc, char **argv) {
         assert(call_count == 8);
     }
 
+    // Test the cache statistics.
+    {
+        Param<float> val;
+
+        Func count_calls("memoize_stats_func");
+        count_calls.define_extern("count_calls_with_arg", {cast<uint8_t>(val)}, UInt(8), 2);
+
+        Func f("memoize_stats_pipeline");
+        Var x, y;
+        f(x, y) = count_calls(x, y) + cast<uint8_t>(x);
+        count_calls.compute_root().memoize();
+
+        call_count_with_arg = 0;
+        for (float v : {1.0f, 1.0f, 2.0f, 1.0f, 2.0f}) {
+            val.set(v);
+            f.realize({10, 10});
+        }
+        assert(call_count_with_arg == 2);
+
+        std::vector<halide_memoization_cache_func_stats_t> func_stats;
+        halide_memoization_cache_stats_t stats =
+            Internal::JITSharedRuntime::memoization_cache_get_stats(&func_stats);
+        assert((int)func_stats.size() == stats.num_funcs);
+
+        bool found = false;
+        uint64_t hits = 0, misses = 0;
+        int64_t bytes = 0;
+        for (const auto &fs : func_stats) {
+            hits += fs.hits;
+            misses += fs.misses;
+            bytes += fs.bytes;
+            if (std::string(fs.func_name) == count_calls.name()) {
+                assert(std::string(fs.pipeline_name) == f.name());
+                assert(fs.hits == 3 && fs.misses == 2 && fs.stores == 2);
+                assert(fs.entries == 2 && fs.bytes == 200);
+                found = true;
+            }
+        }
+        assert(found);
+        assert(hits == stats.hits && misses == stats.misses && bytes == stats.current_size);
+    }
+
+    // Test the persistent cache file. This must come last, as the file
+    // stays in use for the rest of the process.
+    {
+        call_count = 0;
+        Func count_calls("count_calls_file");
+        count_calls.define_extern("count_calls", {}, UInt(8), 2);
+
+        Var x("x"), y("y");
+        Func f("memoize_file_f");
+        f(x, y) = count_calls(x, y) + cast<uint8_t>(x);
+        f.compute_root().memoize();
+
+        Func g("memoize_file_g");
+        g(x, y) = f(x, y) * 2;
+
+        std::string cache_file = Internal::get_test_tmp_dir() + "memoize_cache_file.bin";
+        Internal::ensure_no_file_exists(cache_file);
+        Internal::JITSharedRuntime::memoization_cache_set_file(cache_file, 1 << 20);
+
+        Buffer<uint8_t> result1 = g.realize({10, 10});
+        Buffer<uint8_t> result2 = g.realize({10, 10});
+        assert(call_count == 1);
+
+        // Flush the in-memory cache. The result is still in the file.
+        Internal::JITSharedRuntime::memoization_cache_set_size(1);
+        Internal::JITSharedRuntime::memoization_cache_set_size(0);
+
+        Buffer<uint8_t> result3 = g.realize({10, 10});
+        assert(call_count == 1);
+
+        for (int i = 0; i < 10; i++) {
+            for (int j = 0; j < 10; j++) {
+                assert(result1(i, j) == (42 + i) * 2);
+                assert(result2(i, j) == (42 + i) * 2);
+                assert(result3(i, j) == (42 + i) * 2);
+            }
+        }
+
+        // A different definition with the same names must not find
+        // the results above in the file.
+        Func count_calls2("count_calls_file");
+        count_calls2.define_extern("count_calls", {}, UInt(8), 2);
+        Func f2("memoize_file_f");
+        f2(x, y) = count_calls2(x, y) + cast<uint8_t>(y);
+        f2.compute_root().memoize();
+
+        Func g2("memoize_file_g");
+        g2(x, y) = f2(x, y) * 2;
+
+        Buffer<uint8_t> result4 = g2.realize({10, 10});
+        assert(call_count == 2);
+        for (int i = 0; i < 10; i++) {
+            for (int j = 0; j < 10; j++) {
+                assert(result4(i, j) == (42 + j) * 2);
+            }
+        }
+    }
+
     printf("Success!\n");
     return 0;
 }
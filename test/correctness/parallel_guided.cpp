@@ -0,0 +1,73 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+class CountGuidedLoops : public IRMutator {
+    Stmt visit(const For *op) override {
+        if (op->for_type == ForType::Parallel &&
+            op->partition == TaskPartition::Guided) {
+            guided_loops++;
+        }
+        return IRMutator::visit(op);
+    }
+
+public:
+    int guided_loops = 0;
+};
+
+int main(int argc, char **argv) {
+    Var x, y;
+
+    // A reduction whose cost varies a lot from row to row.
+    Func imbalanced;
+    RDom r(0, 200);
+    imbalanced(x, y) = 0;
+    imbalanced(x, y) += select(r < (y * 37) % 200, (x + r) % 5, 0);
+
+    // A producer consumed asynchronously, so that the guided loop of
+    // the consumer has to acquire semaphores.
+    Func producer;
+    producer(x, y) = x * y;
+
+    Func inner;
+    inner(x, y) = imbalanced(x, y) + producer(x, y);
+
+    Func out;
+    out(x, y) = inner(x, y) * 2;
+
+    imbalanced.compute_root().parallel(y, TaskPartition::Guided);
+    imbalanced.update().parallel(y, TaskPartition::Guided);
+    producer.compute_at(out, y).async();
+    inner.compute_at(out, y).parallel(x, TaskPartition::Guided);
+    out.parallel(y, TaskPartition::Guided);
+
+    CountGuidedLoops checker;
+    out.add_custom_lowering_pass(&checker, []() {});
+
+    const int width = 64, height = 300;
+    Buffer<int> result = out.realize({width, height});
+
+    if (checker.guided_loops != 4) {
+        printf("Expected 4 guided parallel loops after lowering, got %d\n", checker.guided_loops);
+        return 1;
+    }
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int sum = 0;
+            for (int i = 0; i < (y * 37) % 200; i++) {
+                sum += (x + i) % 5;
+            }
+            int correct = (sum + x * y) * 2;
+            if (result(x, y) != correct) {
+                printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                return 1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] WebAssembly JIT does not link the pooled allocator by default.\n");
+        return 0;
+    }
+    target = target.with_feature(Target::PooledMalloc);
+
+    // Heap-allocate a differently-sized intermediate on every tile of
+    // a parallel loop, so that blocks are freed and reused across
+    // threads and across size classes.
+    Param<int> tile;
+    Var x, y, xo, xi;
+    Func f, g;
+    f(x, y) = x * 3 + y;
+    g(x, y) = f(x - 1, y) + f(x + 1, y);
+    g.split(x, xo, xi, tile, TailStrategy::GuardWithIf).parallel(y);
+    f.compute_at(g, xo);
+    g.compile_jit(target);
+
+    const int width = 1000, height = 64;
+    for (int t : {7, 100, 33, 500, 1000, 100, 7}) {
+        tile.set(t);
+        for (int iter = 0; iter < 3; iter++) {
+            Buffer<int> out = g.realize({width, height}, target);
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    int correct = 6 * x + 2 * y;
+                    if (out(x, y) != correct) {
+                        printf("out(%d, %d) = %d instead of %d (tile %d)\n", x, y, out(x, y), correct, t);
+                        return 1;
+                    }
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
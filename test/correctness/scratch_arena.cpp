@@ -0,0 +1,100 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+int malloc_count = 0;
+size_t malloc_bytes = 0;
+
+void *my_malloc(JITUserContext *user_context, size_t x) {
+    malloc_count++;
+    malloc_bytes += x;
+    void *orig = malloc(x + 64);
+    void *ptr = (void *)((((size_t)orig + 64) >> 6) << 6);
+    ((void **)ptr)[-1] = orig;
+    return ptr;
+}
+
+void my_free(JITUserContext *user_context, void *ptr) {
+    free(((void **)ptr)[-1]);
+}
+
+// Count the allocations that were pointed into the arena.
+class CountSlices : public IRMutator {
+    using IRMutator::visit;
+
+    Stmt visit(const Allocate *op) override {
+        if (op->new_expr.defined() && expr_uses_var(op->new_expr, "__scratch_arena")) {
+            slices++;
+        }
+        return IRMutator::visit(op);
+    }
+
+public:
+    int slices = 0;
+};
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] WebAssembly JIT does not support custom allocators.\n");
+        return 0;
+    }
+    target = target.with_feature(Target::ScratchArena);
+
+    // A chain of root stages. Each one is dead once the next has been
+    // computed, so two slices of the arena are enough for all four.
+    Var x, y;
+    Func f[4];
+    f[0](x, y) = x + y;
+    for (int i = 1; i < 4; i++) {
+        f[i](x, y) = f[i - 1](x, y) * 2 + i;
+        f[i - 1].compute_root();
+    }
+    f[3].compute_root();
+    Func out;
+    out(x, y) = f[3](x, y) + 1;
+
+    CountSlices counter;
+    out.add_custom_lowering_pass(&counter, []() {});
+    out.jit_handlers().custom_malloc = my_malloc;
+    out.jit_handlers().custom_free = my_free;
+    out.compile_jit(target);
+
+    if (counter.slices != 4) {
+        printf("Expected 4 allocations in the arena, got %d\n", counter.slices);
+        return 1;
+    }
+
+    const int size = 100;
+    for (int iter = 0; iter < 2; iter++) {
+        malloc_count = 0;
+        malloc_bytes = 0;
+        Buffer<int> result = out.realize({size, size}, target);
+
+        if (malloc_count != 1) {
+            printf("Expected one allocation per invocation, got %d\n", malloc_count);
+            return 1;
+        }
+        // Two stages' worth, plus alignment.
+        const size_t one_stage = size * size * sizeof(int);
+        if (malloc_bytes < 2 * one_stage || malloc_bytes >= 3 * one_stage) {
+            printf("Unexpected arena size %d\n", (int)malloc_bytes);
+            return 1;
+        }
+
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                int correct = (((x + y) * 2 + 1) * 2 + 2) * 2 + 3 + 1;
+                if (result(x, y) != correct) {
+                    printf("result(%d, %d) = %d instead of %d\n", x, y, result(x, y), correct);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include "Halide.h"
+#include <sstream>
+#include <stdio.h>
+
+using namespace Halide;
+
+namespace {
+
+std::string print_module(const Module &m) {
+    std::ostringstream s;
+    for (const auto &f : m.functions()) {
+        s << f.name << "\n"
+          << f.body << "\n";
+    }
+    return s.str();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    ImageParam input(Int(32), 2, "input");
+    Param<int> offset("offset");
+    Func f("f"), g("g"), h("h");
+    Var x("x"), y("y"), xi("xi");
+    RDom r(0, 10, "r");
+
+    f(x, y) = input(x, y) * 2 + offset;
+    g(x, y) = f(x, y) + f(x + 1, y);
+    g(x, y) += r * f(x, r);
+    h(x, y) = g(x, y) + f.in()(x, y);
+
+    f.compute_at(h, y);
+    f.in().compute_at(h, y).vectorize(x, 4);
+    g.compute_root().update().split(x, x, xi, 8);
+    h.split(x, x, xi, 16).vectorize(xi, 8);
+
+    Pipeline p(h);
+    p.add_requirement(offset > 0, "offset must be positive");
+    std::vector<uint8_t> data = p.serialize();
+
+    // Reconnect the deserialized pipeline to the same params.
+    Pipeline q = Pipeline::deserialize(data, {{input.name(), input.parameter()},
+                                              {offset.name(), offset.parameter()}});
+    if (q.outputs().size() != 1 || q.outputs()[0].name() != "h") {
+        printf("Deserialized pipeline has the wrong outputs\n");
+        return 1;
+    }
+
+    // Serializing the deserialized pipeline should give the same
+    // bytes, as long as the params haven't changed in between.
+    if (q.serialize() != data) {
+        printf("Serialization did not round trip\n");
+        return 1;
+    }
+
+    Buffer<int> in(64, 20);
+    in.for_each_element([&](int x, int y) { in(x, y) = x * 3 + y; });
+    input.set(in);
+    offset.set(7);
+
+    Buffer<int> expected = p.realize({48, 8});
+    Buffer<int> actual = q.realize({48, 8});
+    for (int y = 0; y < expected.height(); y++) {
+        for (int x = 0; x < expected.width(); x++) {
+            if (expected(x, y) != actual(x, y)) {
+                printf("actual(%d, %d) = %d instead of %d\n", x, y, actual(x, y), expected(x, y));
+                return 1;
+            }
+        }
+    }
+
+    // Lowered modules round trip too.
+    Target t = get_host_target();
+    Module m = p.compile_to_module({input, offset}, "serialize_pipeline", t);
+    Module m2 = deserialize_module(serialize_module(m));
+    if (m2.name() != m.name() || m2.target() != m.target()) {
+        printf("Deserialized module has the wrong name or target\n");
+        return 1;
+    }
+    std::string before = print_module(m), after = print_module(m2);
+    if (before != after) {
+        printf("Module IR changed after a round trip:\n%s\nvs\n%s\n", before.c_str(), after.c_str());
+        return 1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
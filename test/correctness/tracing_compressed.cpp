@@ -0,0 +1,83 @@
+#include "Halide.h"
+#include "halide_test_dirs.h"
+#include "halide_trace_reader.h"
+
+#include <cstdio>
+#include <map>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("[SKIP] Windows does not have a working setenv\n");
+#else
+    if (get_jit_target_from_environment().arch == Target::WebAssembly) {
+        printf("[SKIP] WebAssembly JIT does not support trace files.\n");
+        return 0;
+    }
+
+    // Write a compressed binary trace from several threads at once,
+    // and check it decodes to the events we expect.
+    std::string trace_file = Internal::get_test_tmp_dir() + "tracing_compressed.trace";
+    Internal::ensure_no_file_exists(trace_file);
+    setenv("HL_TRACE_FILE", trace_file.c_str(), 1);
+    setenv("HL_TRACE_COMPRESS", "1", 1);
+
+    Func f("f"), g("g");
+    Var x("x"), y("y");
+    f(x, y) = x + 3 * y;
+    g(x, y) = f(x, y) + f(x + 1, y);
+    f.compute_at(g, y).trace_stores();
+    f.trace_loads();
+    g.parallel(y).trace_stores();
+
+    const int W = 100, H = 64;
+    Buffer<int> out = g.realize({W, H});
+
+    FILE *file = fopen(trace_file.c_str(), "rb");
+    if (!file) {
+        printf("Could not open %s\n", trace_file.c_str());
+        return 1;
+    }
+    Halide::Trace::PacketReader reader([=](void *d, size_t size) {
+        return fread(d, 1, size, file) == size;
+    });
+
+    struct {
+        halide_trace_packet_t header;
+        uint8_t payload[4096];
+    } packet;
+    std::map<std::string, int> stores;
+    int pipelines = 0;
+    while (reader.next(&packet.header, sizeof(packet))) {
+        const halide_trace_packet_t &p = packet.header;
+        if (p.event == halide_trace_end_pipeline) {
+            pipelines++;
+        }
+        if (p.event != halide_trace_store) {
+            continue;
+        }
+        const int32_t *c = p.coordinates();
+        const int value = *(const int32_t *)p.value();
+        const int expected = p.func() == std::string("f") ?
+                                 c[0] + 3 * c[1] :
+                                 2 * c[0] + 1 + 6 * c[1];
+        if (p.dimensions != 2 || value != expected) {
+            printf("Bad store to %s(%d, %d): %d instead of %d\n",
+                   p.func(), c[0], c[1], value, expected);
+            return 1;
+        }
+        stores[p.func()]++;
+    }
+    fclose(file);
+
+    if (pipelines != 1 || stores["f"] != (W + 1) * H || stores["g"] != W * H) {
+        printf("Unexpected trace: %d pipelines, %d stores to f, %d stores to g\n",
+               pipelines, stores["f"], stores["g"]);
+        return 1;
+    }
+
+    printf("Success!\n");
+#endif
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+namespace {
+
+int f_stores = 0, f_realizations = 0, g_events = 0;
+
+int my_trace(JITUserContext *user_context, const halide_trace_event_t *e) {
+    if (e->event == halide_trace_begin_pipeline ||
+        e->event == halide_trace_end_pipeline ||
+        e->event == halide_trace_tag) {
+        return 1;
+    }
+    if (e->func == std::string("g")) {
+        g_events++;
+    } else if (e->event == halide_trace_store) {
+        const int x = e->coordinates[0], y = e->coordinates[1];
+        if (x < 10 || x >= 30 || y < 5 || y >= 15) {
+            printf("Store to f(%d, %d) is outside the trace box\n", x, y);
+            exit(1);
+        }
+        f_stores++;
+    } else if (e->event == halide_trace_begin_realization) {
+        f_realizations++;
+    }
+    return 1;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("[SKIP] Windows does not have a working setenv\n");
+#else
+    if (get_jit_target_from_environment().arch == Target::WebAssembly) {
+        printf("[SKIP] WebAssembly JIT does not support trace filters.\n");
+        return 0;
+    }
+
+    // The filter is read from the environment when the first event is
+    // traced.
+    setenv("HL_TRACE_FUNCS", "f", 1);
+    setenv("HL_TRACE_BOX", "10,20,5,10", 1);
+    setenv("HL_TRACE_SAMPLE", "2", 1);
+
+    Func f("f"), g("g");
+    Var x("x"), y("y");
+    f(x, y) = x + y;
+    g(x, y) = f(x, y) * 2;
+    f.compute_root().trace_stores().trace_realizations();
+    g.trace_stores().trace_realizations();
+
+    g.jit_handlers().custom_trace = &my_trace;
+    g.realize({64, 32});
+
+    // There are 20 x 10 stores in the box, and we sample every second
+    // one of them.
+    if (f_stores != 100 || f_realizations != 1 || g_events != 0) {
+        printf("Unexpected events: %d stores to f, %d realizations of f, %d events for g\n",
+               f_stores, f_realizations, g_events);
+        return 1;
+    }
+
+    printf("Success!\n");
+#endif
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <string>
+
+using namespace Halide;
+
+namespace {
+
+std::string printed;
+bool error_occurred = false;
+
+void my_print(JITUserContext *ctx, const char *msg) {
+    printed += msg;
+}
+
+void my_error(JITUserContext *ctx, const char *msg) {
+    printf("Expected: %s\n", msg);
+    error_occurred = true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("[SKIP] Windows does not have a working setenv\n");
+#else
+    if (get_jit_target_from_environment().arch == Target::WebAssembly) {
+        printf("[SKIP] WebAssembly JIT does not support the flight recorder.\n");
+        return 0;
+    }
+
+    // Keep the last 8 events of each thread, and print them when the
+    // pipeline fails.
+    setenv("HL_TRACE_FLIGHT_RECORDER", "8", 1);
+
+    Func f("f"), g("g"), h("h");
+    Var x("x"), y("y");
+    Param<int> split("split");
+
+    f(x, y) = x + y;
+    h(x, y) = f(x, y);
+    g(x, y) = h(x % split, y % split) + 1;
+
+    f.compute_at(g, y).trace_realizations();
+    h.compute_at(g, x).trace_realizations();
+    g.trace_realizations();
+
+    // Fail an assertion partway through the pipeline.
+    h.bound(x, 0, 10);
+    split.set(11);
+
+    g.jit_handlers().custom_print = my_print;
+    g.jit_handlers().custom_error = my_error;
+    g.realize({40, 40});
+
+    if (!error_occurred) {
+        printf("There was supposed to be an error\n");
+        return 1;
+    }
+
+    // Nothing should have been traced as it happened, and the last few
+    // events should have been printed on the error.
+    if (printed.find("Flight recorder: the last ") != 0 ||
+        printed.find("Begin realization f") == std::string::npos ||
+        printed.find("Produce f") == std::string::npos) {
+        printf("Unexpected output:\n%s\n", printed.c_str());
+        return 1;
+    }
+
+    printf("Success!\n");
+#endif
+    return 0;
+}
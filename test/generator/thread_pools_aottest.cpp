@@ -0,0 +1,139 @@
+#include "HalideBuffer.h"
+#include "HalideRuntime.h"
+
+#include <mutex>
+#include <set>
+#include <stdio.h>
+#include <thread>
+
+#include "thread_pools.h"
+
+using namespace Halide::Runtime;
+
+// The user_context passed to the pipeline. Says which pool to run on,
+// and records which threads ran tasks.
+struct PoolContext {
+    halide_thread_pool_t *pool;
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+};
+
+halide_thread_pool_t *my_get_thread_pool(void *user_context) {
+    return user_context ? ((PoolContext *)user_context)->pool : nullptr;
+}
+
+int my_do_loop_task(void *user_context, halide_loop_task_t f, int min, int extent,
+                    uint8_t *closure, void *task_parent) {
+    PoolContext *ctx = (PoolContext *)user_context;
+    {
+        std::lock_guard<std::mutex> lock(ctx->mutex);
+        ctx->threads.insert(std::this_thread::get_id());
+    }
+    return halide_default_do_loop_task(user_context, f, min, extent, closure, task_parent);
+}
+
+int run(PoolContext *ctx, int iterations) {
+    Buffer<int, 2> input(64, 64);
+    input.for_each_element([&](int x, int y) { input(x, y) = x + y * 3; });
+    Buffer<int, 2> output(64, 64);
+    for (int i = 0; i < iterations; i++) {
+        if (thread_pools(ctx, input, output) != 0) {
+            printf("Pipeline failed\n");
+            return 1;
+        }
+        for (int y = 0; y < output.height(); y++) {
+            for (int x = 0; x < output.width(); x++) {
+                int correct = input(x, y) * 2 + 1 + y;
+                if (output(x, y) != correct) {
+                    printf("output(%d, %d) = %d instead of %d\n", x, y, output(x, y), correct);
+                    return 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    halide_set_custom_get_thread_pool(my_get_thread_pool);
+    halide_set_custom_do_loop_task(my_do_loop_task);
+
+    PoolContext a, b;
+    a.pool = halide_thread_pool_create(3);
+    b.pool = halide_thread_pool_create(4);
+    if (!a.pool || !b.pool) {
+        printf("Failed to create thread pools\n");
+        return 1;
+    }
+
+    // Run the pipeline on both pools at once.
+    int result_a = 0, result_b = 0;
+    std::thread::id caller_a, caller_b;
+    std::thread thread_a([&]() {
+        caller_a = std::this_thread::get_id();
+        result_a = run(&a, 100);
+    });
+    std::thread thread_b([&]() {
+        caller_b = std::this_thread::get_id();
+        result_b = run(&b, 100);
+    });
+    thread_a.join();
+    thread_b.join();
+    if (result_a || result_b) {
+        return 1;
+    }
+
+    // Apart from the calling threads, each pool's tasks must have run
+    // on that pool's own workers.
+    a.threads.erase(caller_a);
+    b.threads.erase(caller_b);
+    for (const auto &id : a.threads) {
+        if (b.threads.count(id)) {
+            printf("A worker thread ran tasks for both pools\n");
+            return 1;
+        }
+    }
+
+    // Each pool counted the work it was given.
+    for (PoolContext *ctx : {&a, &b}) {
+        halide_thread_pool_stats_t total, per_thread[16];
+        int num_threads = halide_thread_pool_get_stats(ctx->pool, &total, per_thread, 16);
+        if (num_threads < 1 || num_threads > 16) {
+            printf("Unexpected number of threads in stats: %d\n", num_threads);
+            return 1;
+        }
+        // Every pipeline call enqueues at least one job.
+        if (total.tasks_run == 0 || total.jobs_enqueued < 100 || total.max_queue_depth < 1) {
+            printf("Unexpected stats: tasks_run %llu jobs_enqueued %llu max_queue_depth %d\n",
+                   (unsigned long long)total.tasks_run,
+                   (unsigned long long)total.jobs_enqueued,
+                   total.max_queue_depth);
+            return 1;
+        }
+        uint64_t tasks_run = 0;
+        for (int i = 0; i < num_threads; i++) {
+            tasks_run += per_thread[i].tasks_run;
+        }
+        if (tasks_run != total.tasks_run) {
+            printf("Per-thread stats don't add up to the total\n");
+            return 1;
+        }
+        halide_thread_pool_reset_stats(ctx->pool);
+        halide_thread_pool_get_stats(ctx->pool, &total, nullptr, 0);
+        if (total.tasks_run != 0 || total.jobs_enqueued != 0) {
+            printf("Stats were not reset\n");
+            return 1;
+        }
+    }
+
+    // A pool can be destroyed and the pipeline rerun on the default pool.
+    halide_thread_pool_destroy(a.pool);
+    halide_thread_pool_destroy(b.pool);
+    a.pool = nullptr;
+    if (run(&a, 10)) {
+        return 1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,31 @@
+#include "Halide.h"
+
+namespace {
+
+class ThreadPools : public Halide::Generator<ThreadPools> {
+public:
+    Input<Buffer<int, 2>> input{"input"};
+    Output<Buffer<int, 2>> output{"output"};
+
+    void generate() {
+        Var x, y;
+
+        // An async producer and a nested parallel loop, so that both
+        // semaphore wakeups and nested tasks go through the pool.
+        Func producer{"producer"};
+        producer(x, y) = input(x, y) * 2;
+
+        Func inner{"inner"};
+        inner(x, y) = producer(x, y) + 1;
+
+        output(x, y) = inner(x, y) + y;
+
+        producer.compute_at(output, y).async();
+        inner.compute_at(output, y).parallel(x, 16);
+        output.parallel(y);
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(ThreadPools, thread_pools)
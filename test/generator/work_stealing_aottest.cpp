@@ -0,0 +1,80 @@
+#include "HalideBuffer.h"
+#include "HalideRuntime.h"
+
+#include <stdio.h>
+
+#include "work_stealing.h"
+
+using namespace Halide::Runtime;
+
+int expected(int x, int y) {
+    int e = x + y;
+    for (int r = 0; r < (y * y) % 256; r++) {
+        e += (x + r) % 7;
+    }
+    return e;
+}
+
+int run_and_check(int num_threads, bool use_work_stealing) {
+    halide_set_num_threads(num_threads);
+    halide_set_work_stealing(use_work_stealing);
+
+    Buffer<int, 2> out(100, 300);
+    for (int i = 0; i < 20; i++) {
+        out.fill(0);
+        int ret = work_stealing(out);
+        if (ret) {
+            printf("Non zero exit code: %d\n", ret);
+            return 1;
+        }
+        for (int y = 0; y < out.height(); y++) {
+            for (int x = 0; x < out.width(); x++) {
+                if (out(x, y) != expected(x, y)) {
+                    printf("out(%d, %d) = %d instead of %d (threads = %d, work stealing = %d)\n",
+                           x, y, out(x, y), expected(x, y), num_threads, (int)use_work_stealing);
+                    return 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    // Alternate between the scheduling modes and across a range of
+    // thread counts, including ones larger than the extent of the
+    // parallel loops.
+    for (int num_threads : {1, 2, 3, 8, 17, 64}) {
+        for (bool use_work_stealing : {true, false}) {
+            if (run_and_check(num_threads, use_work_stealing)) {
+                return 1;
+            }
+        }
+    }
+
+    // NUMA-aware scheduling implies work stealing, and must give the
+    // same results whether or not this host has more than one node.
+    if (halide_get_numa_node_count() < 1) {
+        printf("Expected at least one NUMA node\n");
+        return 1;
+    }
+    halide_set_numa_affinity(true);
+    halide_shutdown_thread_pool();
+    for (int num_threads : {2, 8, 17}) {
+        if (run_and_check(num_threads, false)) {
+            return 1;
+        }
+    }
+    halide_set_numa_affinity(false);
+
+    // The setting survives shutting down the thread pool.
+    halide_set_work_stealing(true);
+    halide_shutdown_thread_pool();
+    if (!halide_set_work_stealing(false)) {
+        printf("Work stealing setting was lost across thread pool shutdown\n");
+        return 1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
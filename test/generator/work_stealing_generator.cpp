@@ -0,0 +1,35 @@
+#include "Halide.h"
+
+namespace {
+
+class WorkStealing : public Halide::Generator<WorkStealing> {
+public:
+    Output<Buffer<int, 2>> output{"output"};
+
+    void generate() {
+        Var x, y;
+
+        // A stage whose cost varies wildly across rows, so that some
+        // threads finish their share of the rows long before others.
+        Func imbalanced{"imbalanced"};
+        RDom r(0, 256);
+        imbalanced(x, y) = 0;
+        imbalanced(x, y) += select(r < (y * y) % 256, (x + r) % 7, 0);
+
+        // A producer consumed asynchronously, so that the consumer's
+        // parallel loop must acquire semaphores.
+        Func producer{"producer"};
+        producer(x, y) = x + y;
+
+        output(x, y) = imbalanced(x, y) + producer(x, y);
+
+        imbalanced.compute_root().parallel(y);
+        imbalanced.update().parallel(y);
+        producer.compute_at(output, y).async();
+        output.parallel(y).parallel(x, 8);
+    }
+};
+
+}  // namespace
+
+HALIDE_REGISTER_GENERATOR(WorkStealing, work_stealing)
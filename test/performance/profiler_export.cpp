@@ -0,0 +1,76 @@
+#include "Halide.h"
+#include "halide_test_dirs.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+
+using namespace Halide;
+
+std::string read_file(const std::string &filename) {
+    std::ifstream f(filename, std::ios::binary);
+    std::stringstream contents;
+    contents << f.rdbuf();
+    return contents.str();
+}
+
+void my_print(JITUserContext *, const char *msg) {
+}
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+
+    const std::string trace_file = Internal::get_test_tmp_dir() + "profiler_export.json";
+    const std::string pprof_file = Internal::get_test_tmp_dir() + "profiler_export.pb";
+    Internal::ensure_no_file_exists(trace_file);
+    Internal::ensure_no_file_exists(pprof_file);
+
+#ifdef _WIN32
+    _putenv_s("HL_PROFILER_CHROME_TRACE", trace_file.c_str());
+    _putenv_s("HL_PROFILER_PPROF", pprof_file.c_str());
+#else
+    setenv("HL_PROFILER_CHROME_TRACE", trace_file.c_str(), 1);
+    setenv("HL_PROFILER_PPROF", pprof_file.c_str(), 1);
+#endif
+
+    // An expensive Func that the sampling profiler can't miss.
+    Func slow("slow_func"), out("out");
+    Var x, y;
+    Expr e = cast<float>(x + y);
+    for (int i = 0; i < 200; i++) {
+        e = sin(e);
+    }
+    slow(x, y) = e;
+    out(x, y) = slow(x, y) * 2.0f;
+    slow.compute_root();
+
+    out.jit_handlers().custom_print = my_print;
+    Buffer<float> im = out.realize({1000, 1000}, target.with_feature(Target::Profile));
+
+    // The files are written whenever the report is printed, which the
+    // JIT does at the end of every realization.
+    Internal::assert_file_exists(trace_file);
+    Internal::assert_file_exists(pprof_file);
+
+    const std::string trace = read_file(trace_file);
+    if (trace.find("\"traceEvents\"") == std::string::npos ||
+        trace.find("\"name\": \"slow_func\"") == std::string::npos) {
+        printf("Chrome trace doesn't mention slow_func:\n%s\n", trace.c_str());
+        return 1;
+    }
+
+    // Func names are in the pprof string table verbatim.
+    const std::string pprof = read_file(pprof_file);
+    if (pprof.find("nanoseconds") == std::string::npos ||
+        pprof.find("slow_func") == std::string::npos) {
+        printf("pprof profile doesn't mention slow_func\n");
+        return 1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
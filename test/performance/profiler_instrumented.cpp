@@ -0,0 +1,88 @@
+#include "Halide.h"
+
+#include <stdio.h>
+#include <string>
+
+using namespace Halide;
+
+std::string report;
+
+void my_print(JITUserContext *, const char *msg) {
+    report += msg;
+}
+
+// Find the percentage of the pipeline's time the report bills to the
+// named Func, or -1 if it isn't listed.
+int percentage_for(const std::string &name) {
+    size_t pos = report.find("  " + name + ":");
+    if (pos == std::string::npos) {
+        return -1;
+    }
+    pos = report.find('(', pos);
+    if (pos == std::string::npos) {
+        return -1;
+    }
+    return atoi(report.c_str() + pos + 1);
+}
+
+int run_test(bool parallel) {
+    Target target = get_jit_target_from_environment().with_feature(Target::ProfileInstrumented);
+
+    // An expensive Func feeding a cheap one. Every boundary is timed,
+    // so the split should come out the same every run.
+    Func slow("slow_func"), out("cheap_func");
+    Var x, y;
+    Expr e = cast<float>(x + y);
+    for (int i = 0; i < 200; i++) {
+        e = sin(e);
+    }
+    slow(x, y) = e;
+    out(x, y) = slow(x, y) * 2.0f;
+    slow.compute_root();
+    if (parallel) {
+        slow.parallel(y);
+        out.parallel(y);
+    }
+
+    report.clear();
+    out.jit_handlers().custom_print = my_print;
+    out.realize({1000, 1000}, target);
+
+    const int slow_percent = percentage_for("slow_func");
+    const int cheap_percent = percentage_for("cheap_func");
+    if (slow_percent < 0 || cheap_percent < 0) {
+        printf("Report is missing a Func:\n%s\n", report.c_str());
+        return 1;
+    }
+    if (slow_percent < 5 * cheap_percent) {
+        printf("slow_func should dominate, but got %d%% vs %d%%:\n%s\n",
+               slow_percent, cheap_percent, report.c_str());
+        return 1;
+    }
+    if (report.find(" inclusive: ") == std::string::npos) {
+        printf("Report is missing inclusive times:\n%s\n", report.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+
+    printf("Testing serial pipeline...\n");
+    if (run_test(false)) {
+        return 1;
+    }
+
+    printf("Testing parallel pipeline...\n");
+    if (run_test(true)) {
+        return 1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include "Halide.h"
+
+#include <stdio.h>
+#include <string>
+
+using namespace Halide;
+
+std::string report;
+
+void my_print(JITUserContext *, const char *msg) {
+    report += msg;
+}
+
+int run_test(const Target &t) {
+    // A blur with a clamped boundary condition, which loop partitioning
+    // splits into a prologue, a steady state, and an epilogue.
+    ImageParam input(Float(32), 2);
+    Func clamped = BoundaryConditions::repeat_edge(input);
+    Func blur("blur");
+    Var x, y;
+    blur(x, y) = (clamped(x - 1, y) + clamped(x, y) + clamped(x + 1, y)) / 3;
+    blur.vectorize(x, 8).parallel(y);
+
+    Buffer<float> in(1024, 1024);
+    in.fill(1.0f);
+    input.set(in);
+
+    report.clear();
+    blur.jit_handlers().custom_print = my_print;
+    blur.realize({1024, 1024}, t.with_feature(Target::ProfileLoops));
+
+    // Loops are reported as a tree under the Func, by their names
+    // relative to it.
+    for (const char *line : {"\n  blur:", "\n    s0.y:", "\n      s0.x.x:"}) {
+        if (report.find(line) == std::string::npos) {
+            printf("Report is missing \"%s\":\n%s\n", line + 1, report.c_str());
+            return 1;
+        }
+    }
+    if (report.find(".prologue:") == std::string::npos &&
+        report.find(".epilogue:") == std::string::npos) {
+        printf("Report doesn't break out the partitioned loops:\n%s\n", report.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.arch == Target::WebAssembly) {
+        printf("[SKIP] Performance tests are meaningless and/or misleading under WebAssembly interpreter.\n");
+        return 0;
+    }
+
+    printf("Testing sampling profiler...\n");
+    if (run_test(target.with_feature(Target::Profile))) {
+        return 1;
+    }
+
+    printf("Testing instrumented profiler...\n");
+    if (run_test(target.with_feature(Target::ProfileInstrumented))) {
+        return 1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
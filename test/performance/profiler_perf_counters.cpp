@@ -0,0 +1,64 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <string.h>
+
+using namespace Halide;
+
+bool saw_counters = false;
+unsigned long long cycles = 0, instructions = 0;
+float expensive_ipc = -1;
+
+void my_print(JITUserContext *, const char *msg) {
+    unsigned long long c, i;
+    if (sscanf(msg, " cycles: %llu  instructions: %llu", &c, &i) == 2) {
+        saw_counters = true;
+        cycles = c;
+        instructions = i;
+    }
+    const char *ipc = strstr(msg, " ipc: ");
+    if (strstr(msg, " expensive:") == msg && ipc) {
+        sscanf(ipc, " ipc: %f", &expensive_ipc);
+    }
+}
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (target.os != Target::Linux || target.arch != Target::X86) {
+        printf("[SKIP] Hardware performance counters are only supported on x86 Linux.\n");
+        return 0;
+    }
+
+    setenv("HL_PROFILER_PERF_COUNTERS", "1", 1);
+
+    Func cheap("cheap"), expensive("expensive"), out("out");
+    Var x, y;
+    cheap(x, y) = cast<float>(x + y);
+    Expr e = cheap(x, y);
+    for (int i = 0; i < 100; i++) {
+        e = sin(e);
+    }
+    expensive(x, y) = e;
+    out(x, y) = expensive(x, y) + cheap(x, y);
+    cheap.compute_root().parallel(y);
+    expensive.compute_root().parallel(y);
+    out.parallel(y);
+
+    out.jit_handlers().custom_print = my_print;
+    Buffer<float> im = out.realize({1000, 1000}, target.with_feature(Target::Profile));
+
+    if (!saw_counters) {
+        // Most likely perf_event_paranoid forbids it, or we're in a
+        // VM without a PMU. The profiler should still have worked.
+        printf("[SKIP] Hardware performance counters are not available.\n");
+        return 0;
+    }
+
+    printf("cycles: %llu instructions: %llu ipc of expensive: %f\n", cycles, instructions, expensive_ipc);
+    if (instructions == 0 || expensive_ipc <= 0) {
+        printf("Counters were opened but nothing was billed to the pipeline\n");
+        return 1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
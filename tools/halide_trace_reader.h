@@ -0,0 +1,214 @@
+#ifndef HALIDE_TRACE_READER_H
+#define HALIDE_TRACE_READER_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "HalideRuntime.h"
+#include "halide_trace_config.h"
+
+namespace Halide {
+namespace Trace {
+
+// Reads the packets of a binary trace, as written by the default
+// halide_trace when HL_TRACE_FILE is set. Handles both plain trace
+// files and ones written with HL_TRACE_COMPRESS=1, which consist of
+// blocks of delta-coded packets (see src/runtime/tracing.cpp for the
+// encoding). Compressed packets are decoded back into the usual
+// halide_trace_packet_t layout.
+class PacketReader {
+public:
+    // Fill a buffer with exactly the given number of bytes. Returns
+    // false on a clean EOF.
+    using ReadFn = std::function<bool(void *, size_t)>;
+
+    explicit PacketReader(ReadFn read, ErrorFunc error = default_error)
+        : read(std::move(read)), error(std::move(error)) {
+    }
+
+    // Read the next packet into dst, which has room for capacity
+    // bytes. Returns false at the end of the trace.
+    bool next(halide_trace_packet_t *dst, size_t capacity) {
+        if (packets_left == 0) {
+            uint32_t size;
+            if (!read(&size, sizeof(size))) {
+                return false;
+            }
+            if (size != block_magic) {
+                return read_raw_packet(size, dst, capacity);
+            }
+            start_block();
+            if (packets_left == 0) {
+                return next(dst, capacity);
+            }
+        }
+        packets_left--;
+        decode_packet(dst, capacity);
+        return true;
+    }
+
+private:
+    static constexpr uint32_t block_magic = 0x5a525448;  // "HTRZ"
+    static constexpr int dict_size = 256;
+    static constexpr int delta_coords = 64;
+    static constexpr uint32_t name_arena_size = 16 * 1024;
+
+    ReadFn read;
+    ErrorFunc error;
+
+    // The current compressed block.
+    std::vector<uint8_t> block;
+    size_t pos = 0;
+    uint32_t packets_left = 0;
+
+    // The state the encoder kept, which resets at each block.
+    std::vector<std::string> names;
+    std::vector<std::vector<int32_t>> coords;
+    uint32_t arena_used = 0;
+    uint32_t prev_id = 0, prev_parent_id = 0;
+
+    void fail(const std::string &msg) {
+        error(msg);
+        // In case the error handler returns.
+        exit(1);
+    }
+
+    bool read_raw_packet(uint32_t size, halide_trace_packet_t *dst, size_t capacity) {
+        constexpr size_t header_size = sizeof(halide_trace_packet_t);
+        if (size < header_size || size > capacity) {
+            fail("Bad trace packet size " + std::to_string(size));
+        }
+        dst->size = size;
+        if (!read((uint8_t *)dst + sizeof(size), size - sizeof(size))) {
+            fail("Unexpected EOF mid-packet");
+        }
+        return true;
+    }
+
+    void start_block() {
+        uint32_t header[2];
+        if (!read(header, sizeof(header))) {
+            fail("Unexpected EOF in trace block header");
+        }
+        block.resize(header[0]);
+        if (header[0] && !read(block.data(), header[0])) {
+            fail("Unexpected EOF mid-block");
+        }
+        pos = 0;
+        packets_left = header[1];
+        names.clear();
+        coords.clear();
+        arena_used = 0;
+        prev_id = 0;
+        prev_parent_id = 0;
+    }
+
+    uint8_t get_byte() {
+        if (pos >= block.size()) {
+            fail("Truncated trace block");
+        }
+        return block[pos++];
+    }
+
+    uint32_t get_varint() {
+        uint32_t v = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            const uint8_t b = get_byte();
+            v |= (uint32_t)(b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                return v;
+            }
+        }
+        fail("Bad varint in trace block");
+        return 0;
+    }
+
+    uint32_t get_svarint() {
+        const uint32_t v = get_varint();
+        return (v >> 1) ^ (0 - (v & 1));
+    }
+
+    const uint8_t *get_bytes(size_t size) {
+        if (pos + size > block.size()) {
+            fail("Truncated trace block");
+        }
+        const uint8_t *p = block.data() + pos;
+        pos += size;
+        return p;
+    }
+
+    void decode_packet(halide_trace_packet_t *dst, size_t capacity) {
+        int f = -1;
+        std::string func;
+        const uint32_t ref = get_varint();
+        if (ref == 0) {
+            const uint32_t len = get_varint();
+            func.assign((const char *)get_bytes(len), len);
+            if ((int)names.size() < dict_size && arena_used + len + 1 <= name_arena_size) {
+                f = (int)names.size();
+                names.push_back(func);
+                coords.emplace_back(delta_coords, 0);
+                arena_used += len + 1;
+            }
+        } else if (ref <= names.size()) {
+            f = (int)ref - 1;
+            func = names[f];
+        } else {
+            fail("Bad func reference in trace block");
+        }
+
+        halide_trace_packet_t header;
+        memset((void *)&header, 0, sizeof(header));
+        header.event = (halide_trace_event_code_t)get_byte();
+        prev_id += get_svarint();
+        prev_parent_id += get_svarint();
+        header.id = (int32_t)prev_id;
+        header.parent_id = (int32_t)prev_parent_id;
+        header.type.code = (halide_type_code_t)get_byte();
+        header.type.bits = get_byte();
+        header.type.lanes = (uint16_t)get_varint();
+        header.value_index = (int32_t)get_varint();
+        header.dimensions = (int32_t)get_varint();
+
+        const size_t coords_bytes = header.dimensions * sizeof(int32_t);
+        const size_t value_bytes = header.type.lanes * header.type.bytes();
+        std::vector<int32_t> c(header.dimensions);
+        for (int i = 0; i < header.dimensions; i++) {
+            uint32_t v = get_svarint();
+            if (f >= 0 && i < delta_coords) {
+                v += (uint32_t)coords[f][i];
+                coords[f][i] = (int32_t)v;
+            }
+            c[i] = (int32_t)v;
+        }
+        const uint8_t *value = get_bytes(value_bytes);
+        const uint32_t tag_len = get_varint();
+        const char *tag = (const char *)get_bytes(tag_len);
+
+        const size_t total = sizeof(halide_trace_packet_t) + coords_bytes + value_bytes +
+                             func.size() + 1 + tag_len + 1;
+        header.size = (uint32_t)((total + 3) & ~(size_t)3);
+        if (header.size > capacity) {
+            fail("Trace packet too large (" + std::to_string(header.size) + " bytes)");
+        }
+        memset((void *)dst, 0, header.size);
+        memcpy(dst, &header, sizeof(header));
+        if (coords_bytes) {
+            memcpy((void *)dst->coordinates(), c.data(), coords_bytes);
+        }
+        memcpy((void *)dst->value(), value, value_bytes);
+        memcpy((void *)dst->func(), func.c_str(), func.size() + 1);
+        char *dst_tag = (char *)dst->trace_tag();
+        memcpy(dst_tag, tag, tag_len);
+        dst_tag[tag_len] = 0;
+    }
+};
+
+}  // namespace Trace
+}  // namespace Halide
+
+#endif  // HALIDE_TRACE_READER_H
@@ -1,8 +1,11 @@
 #include "HalideTraceUtils.h"
+#include "halide_trace_reader.h"
 #include <cassert>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <map>
+#include <memory>
 
 namespace Halide {
 namespace Internal {
@@ -12,21 +15,19 @@ bool Packet::read_from_stdin() {
 }
 
 bool Packet::read_from_filedesc(FILE *fdesc) {
-    size_t header_size = sizeof(halide_trace_packet_t);
-    if (!Packet::read(this, header_size, fdesc)) {
-        return false;
+    // The reader keeps decoding state for compressed traces, so keep
+    // one per stream.
+    static std::map<FILE *, std::unique_ptr<Halide::Trace::PacketReader>> readers;
+    auto &reader = readers[fdesc];
+    if (!reader) {
+        reader = std::make_unique<Halide::Trace::PacketReader>(
+            [=](void *d, size_t size) { return Packet::read(d, size, fdesc); },
+            [](const std::string &msg) {
+                fprintf(stderr, "%s\n", msg.c_str());
+                abort();
+            });
     }
-    size_t payload_size = size - header_size;
-    if (payload_size > sizeof(payload)) {
-        fprintf(stderr, "Payload larger than %d bytes in trace stream (%d)\n", (int)sizeof(payload), (int)payload_size);
-        abort();
-        return false;
-    }
-    if (!Packet::read(payload, payload_size, fdesc)) {
-        fprintf(stderr, "Unexpected EOF mid-packet");
-        return false;
-    }
-    return true;
+    return reader->next(this, sizeof(*this));
 }
 
 bool Packet::read(void *d, size_t size, FILE *fdesc) {
@@ -86,12 +86,14 @@ struct Packet : public halide_trace_packet_t {
     // Grab a packet from stdin. Returns false when stdin closes.
     bool read_from_stdin();
 
-    // Grab a packet from a particular fctl file descriptor. Returns false when end is reached.
+    // Grab a packet from a particular fctl file descriptor. Returns
+    // false when end is reached. Compressed traces (HL_TRACE_COMPRESS=1)
+    // are decoded transparently.
     bool read_from_filedesc(FILE *fdesc);
 
 private:
     // Do a blocking read of some number of bytes from a unistd file descriptor.
-    bool read(void *d, size_t size, FILE *fdesc);
+    static bool read(void *d, size_t size, FILE *fdesc);
 };
 
 }  // namespace Internal
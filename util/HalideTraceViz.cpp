@@ -27,6 +27,7 @@
 #include "inconsolata.h"
 
 #include "halide_trace_config.h"
+#include "halide_trace_reader.h"
 
 using namespace Halide;
 using namespace Halide::Trace;
@@ -168,17 +169,11 @@ struct PacketAndPayload : public halide_trace_packet_t {
     }
 
     bool read() {
-        constexpr size_t header_size = sizeof(halide_trace_packet_t);
-        if (!read_or_die(this, header_size)) {
-            return false;  // EOF
-        }
-
-        const size_t payload_size = this->size - header_size;
-        if (payload_size > sizeof(this->payload) || !read_or_die(this->payload, payload_size)) {
-            // Shouldn't ever get EOF here
-            fail() << "Unable to read packet payload of size " << payload_size;
-        }
-        return true;
+        // Handles both raw and compressed traces.
+        static Halide::Trace::PacketReader reader(read_or_die, [](const std::string &msg) {
+            fail() << msg;
+        });
+        return reader.next(this, sizeof(*this));
     }
 };
 